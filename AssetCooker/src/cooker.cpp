@@ -0,0 +1,624 @@
+#include "cooker.h"
+
+#include "graphics/ebcencoder.h"
+#include "graphics/ecookedasset.h"
+#include "graphics/egltf.h"
+#include "graphics/eimage.h"
+#include "graphics/emipgen.h"
+#include "graphics/etexconvert.h"
+#include "utils/efileutils.h"
+#include "utils/ehash.h"
+#include "utils/ejobsystem.h"
+#include "utils/ejson.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <regex>
+
+#ifdef _WIN32
+#include <d3dcompiler.h>
+#endif
+
+namespace EProject
+{
+    namespace fs = std::filesystem;
+
+    namespace
+    {
+        // Bump when a cook function changes its output, every key changes with it
+        constexpr uint64_t cCookerVersion = 4;
+
+        const char* cManifestName = "manifest.txt";
+        const char* cSettingsExt = ".import";
+
+        struct ShaderStageDesc
+        {
+            const char* entryPoint;
+            const char* target;
+            ShaderType type;
+        };
+
+        // Entry points the runtime uses, cooked when the source defines them
+        constexpr ShaderStageDesc cDefaultStages[] =
+        {
+            { "vs_main", "vs_5_0", ShaderType::Vertex },
+            { "hs_main", "hs_5_0", ShaderType::Hull },
+            { "ds_main", "ds_5_0", ShaderType::Domain },
+            { "gs_main", "gs_5_0", ShaderType::Geometry },
+            { "ps_main", "ps_5_0", ShaderType::Pixel },
+            { "cs_main", "cs_5_0", ShaderType::Compute },
+        };
+
+        fs::path getSettingsPath(const fs::path& source)
+        {
+            auto res = source;
+            res += cSettingsExt;
+            return res;
+        }
+
+        ShaderType getShaderType(const std::string& target)
+        {
+            for (const auto& stage : cDefaultStages)
+            {
+                if (target.compare(0, 2, stage.target, 2) == 0)
+                {
+                    return stage.type;
+                }
+            }
+
+            throw std::runtime_error("AssetCooker: Unknown shader target: " + target);
+        }
+
+        bool definesEntryPoint(const std::string& text, const std::string& entryPoint)
+        {
+            const std::regex re("\\b" + entryPoint + "\\s*\\(");
+            return std::regex_search(text, re);
+        }
+
+        std::vector<uint8_t> cookMesh(const fs::path& path)
+        {
+            std::vector<MeshData> meshes;
+            if (!GLTFLoader::load(path, meshes))
+            {
+                throw std::runtime_error("AssetCooker: glTF uses features the native loader doesn't support");
+            }
+
+            std::vector<uint8_t> out;
+            CookedAsset::writeMeshes(meshes, out);
+            return out;
+        }
+
+        // "compression": "auto" (default), "none", "bc1", "bc3", "bc4", "bc5" or "bc7"
+        TextureFmt getCompressedFormat(const std::string& name, bool srgb, const DecodedImage& image)
+        {
+            if (name.empty() || name == "auto")
+            {
+                return BCEncoder::chooseFormat(image.pixels.get(), image.size, srgb);
+            }
+
+            if (name == "none")
+            {
+                return srgb ? TextureFmt::RGBA8_SRGB : TextureFmt::RGBA8;
+            }
+
+            if (name == "bc1")
+            {
+                return srgb ? TextureFmt::BC1_SRGB : TextureFmt::BC1;
+            }
+
+            if (name == "bc3")
+            {
+                return srgb ? TextureFmt::BC3_SRGB : TextureFmt::BC3;
+            }
+
+            if (name == "bc7")
+            {
+                return srgb ? TextureFmt::BC7_SRGB : TextureFmt::BC7;
+            }
+
+            if (name == "bc4" && !srgb)
+            {
+                return TextureFmt::BC4;
+            }
+
+            if (name == "bc5" && !srgb)
+            {
+                return TextureFmt::BC5;
+            }
+
+            throw std::runtime_error("AssetCooker: Unknown texture compression " + name + (srgb ? " for an sRGB texture" : ""));
+        }
+
+        // "quality": "fast", "normal" (default) or "high"
+        BCQuality getQuality(const std::string& name)
+        {
+            if (name == "fast")
+            {
+                return BCQuality::Fast;
+            }
+
+            if (name == "high")
+            {
+                return BCQuality::High;
+            }
+
+            if (name.empty() || name == "normal")
+            {
+                return BCQuality::Normal;
+            }
+
+            throw std::runtime_error("AssetCooker: Unknown texture quality " + name);
+        }
+
+        // "mipFilter": "box", "kaiser" (default) or "lanczos"
+        MipFilter getMipFilter(const std::string& name)
+        {
+            if (name == "box")
+            {
+                return MipFilter::Box;
+            }
+
+            if (name == "lanczos")
+            {
+                return MipFilter::Lanczos;
+            }
+
+            if (name.empty() || name == "kaiser")
+            {
+                return MipFilter::Kaiser;
+            }
+
+            throw std::runtime_error("AssetCooker: Unknown mip filter " + name);
+        }
+
+        // HDR sources become RGBA16f, 16 bit ones R16 or RGBA16. Both keep a single level
+        // and skip block compression.
+        std::vector<uint8_t> cookWideTexture(const ImageSource& src, bool flipY)
+        {
+            glm::ivec2 size;
+            int channels = 0;
+            ImageDecoder::getInfo(src, size, channels);
+
+            const bool gray16 = !ImageDecoder::isHDR(src) && channels == 1;
+
+            const auto image = ImageDecoder::decodeNative(src, gray16 ? 1 : 4, flipY);
+            if (!image.pixels)
+            {
+                throw std::runtime_error("AssetCooker: Image decode failed: " + image.error);
+            }
+
+            CookedAsset::Texture texture;
+            texture.width = static_cast<uint32_t>(image.size.x);
+            texture.height = static_cast<uint32_t>(image.size.y);
+            texture.mipCount = 1;
+
+            if (image.type == PixelType::Float)
+            {
+                const size_t count = static_cast<size_t>(image.size.x) * image.size.y * 4;
+
+                texture.format = TextureFmt::RGBA16f;
+                texture.data.resize(count * sizeof(uint16_t));
+
+                TextureConvert::floatToHalf(reinterpret_cast<const float*>(image.pixels.get()), count, reinterpret_cast<uint16_t*>(texture.data.data()));
+            }
+            else
+            {
+                texture.format = gray16 ? TextureFmt::R16 : TextureFmt::RGBA16;
+                texture.data.assign(image.pixels.get(), image.pixels.get() + image.getByteSize());
+            }
+
+            std::vector<uint8_t> out;
+            CookedAsset::writeTexture(texture, out);
+            return out;
+        }
+
+        std::vector<uint8_t> cookTexture(const std::vector<uint8_t>& data, const JsonValue& settings)
+        {
+            const ImageSource src = { data.data(), data.size() };
+            const bool flipY = settings["flipY"].asBool(false);
+
+            if (ImageDecoder::isHDR(src) || ImageDecoder::is16Bit(src))
+            {
+                return cookWideTexture(src, flipY);
+            }
+
+            const bool srgb = settings["srgb"].asBool(false);
+
+            const auto image = ImageDecoder::decode(src, 4, flipY);
+            if (!image.pixels)
+            {
+                throw std::runtime_error("AssetCooker: Image decode failed: " + image.error);
+            }
+
+            // "premultiplyAlpha": true for sprites drawn with One, Inv_Src_Alpha blending
+            if (settings["premultiplyAlpha"].asBool(false))
+            {
+                TextureConvert::premultiplyAlpha(image.pixels.get(), static_cast<size_t>(image.size.x) * image.size.y);
+            }
+
+            CookedAsset::Texture texture;
+            texture.width = static_cast<uint32_t>(image.size.x);
+            texture.height = static_cast<uint32_t>(image.size.y);
+            texture.format = getCompressedFormat(settings["compression"].asString(), srgb, image);
+
+            // D3D11 wants the top level of a block compressed texture in whole blocks
+            if (BCEncoder::isSupported(texture.format) && (image.size.x % 4 != 0 || image.size.y % 4 != 0))
+            {
+                texture.format = srgb ? TextureFmt::RGBA8_SRGB : TextureFmt::RGBA8;
+            }
+
+            MipSource mipSrc;
+            mipSrc.rgba = image.pixels.get();
+            mipSrc.size = image.size;
+            mipSrc.settings.filter = getMipFilter(settings["mipFilter"].asString());
+            mipSrc.settings.srgb = srgb;
+            mipSrc.settings.normalMap = settings["normalMap"].asBool(texture.format == TextureFmt::BC5);
+            mipSrc.settings.alphaCutoff = settings["alphaCutoff"].asFloat(0.0f);
+            mipSrc.settings.maxLevels = settings["mips"].asBool(true) ? 0 : 1;
+
+            const auto chain = MipGenerator::generate(mipSrc);
+            const auto quality = getQuality(settings["quality"].asString());
+
+            texture.mipCount = static_cast<uint32_t>(chain.getLevelCount());
+
+            for (int level = 0; level < chain.getLevelCount(); ++level)
+            {
+                if (BCEncoder::isSupported(texture.format))
+                {
+                    const auto blocks = BCEncoder::encode(chain.getLevel(level), chain.sizes[level], texture.format, quality);
+                    texture.data.insert(texture.data.end(), blocks.begin(), blocks.end());
+                }
+                else
+                {
+                    texture.data.insert(texture.data.end(), chain.getLevel(level), chain.getLevel(level) + chain.getLevelSize(level));
+                }
+            }
+
+            std::vector<uint8_t> out;
+            CookedAsset::writeTexture(texture, out);
+            return out;
+        }
+
+        std::vector<uint8_t> cookShader(const fs::path& path, const std::vector<uint8_t>& data, const JsonValue& settings)
+        {
+            std::vector<std::pair<std::string, std::string>> entries;
+
+            if (settings.has("stages"))
+            {
+                const auto& stages = settings["stages"];
+                for (size_t i = 0; i < stages.size(); ++i)
+                {
+                    entries.emplace_back(stages[i]["entry"].asString(), stages[i]["target"].asString());
+                }
+            }
+            else
+            {
+                // Include only files have none of the entry points and cook into an empty blob
+                const std::string text(data.begin(), data.end());
+                for (const auto& stage : cDefaultStages)
+                {
+                    if (definesEntryPoint(text, stage.entryPoint))
+                    {
+                        entries.emplace_back(stage.entryPoint, stage.target);
+                    }
+                }
+            }
+
+            // Same defines as ShaderProgram::compileFromFile unless the settings override them
+            std::vector<std::pair<std::string, std::string>> defines = { { "HLSL5", "1" }, { "DISABLE_WAVE_INTRINSICS", "1" } };
+
+            if (settings.has("defines"))
+            {
+                const auto& defs = settings["defines"];
+
+                defines.clear();
+                for (size_t i = 0; i < defs.size(); ++i)
+                {
+                    defines.emplace_back(defs.getKey(i), defs[i].asString());
+                }
+            }
+
+            std::vector<CookedAsset::ShaderStage> stages;
+
+            for (const auto& [entryPoint, target] : entries)
+            {
+                CookedAsset::ShaderStage stage;
+                stage.type = getShaderType(target);
+                stage.entryPoint = entryPoint;
+                stage.target = target;
+
+#ifdef _WIN32
+                std::vector<D3D_SHADER_MACRO> macros;
+                for (const auto& [name, value] : defines)
+                {
+                    macros.push_back({ name.c_str(), value.c_str() });
+                }
+                macros.push_back({ nullptr, nullptr });
+
+                ComPtr<ID3DBlob> code;
+                ComPtr<ID3DBlob> errors;
+
+                const HRESULT hr = D3DCompileFromFile(path.wstring().c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, entryPoint.c_str(), target.c_str(),
+                    D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, &code, &errors);
+
+                if (FAILED(hr))
+                {
+                    const std::string message = errors ? static_cast<const char*>(errors->GetBufferPointer()) : "unknown error";
+                    throw std::runtime_error("AssetCooker: " + entryPoint + " compilation failed: " + message);
+                }
+
+                const auto bytes = static_cast<const uint8_t*>(code->GetBufferPointer());
+                stage.bytecode.assign(bytes, bytes + code->GetBufferSize());
+#else
+                throw std::runtime_error("AssetCooker: Shader cooking needs d3dcompiler");
+#endif
+
+                stages.push_back(std::move(stage));
+            }
+
+            std::vector<uint8_t> out;
+            CookedAsset::writeShader(stages, out);
+            return out;
+        }
+    }
+
+    AssetCooker::AssetCooker(const fs::path& dataDir, const fs::path& cacheDir) : m_dataDir(fs::absolute(dataDir).lexically_normal()), m_cache(cacheDir)
+    {
+        if (!fs::is_directory(m_dataDir))
+        {
+            throw std::runtime_error("AssetCooker: Data directory not found: " + m_dataDir.u8string());
+        }
+
+        m_manifest.load(m_cache.getRoot() / cManifestName);
+    }
+
+    bool AssetCooker::getKind(const fs::path& path, CookKind& kind)
+    {
+        const auto ext = getLowerExt(path);
+
+        if (GLTFLoader::isSupported(path))
+        {
+            kind = CookKind::Mesh;
+        }
+        else if (ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp" || ext == ".hdr")
+        {
+            kind = CookKind::Texture;
+        }
+        else if (ext == ".hlsl")
+        {
+            kind = CookKind::Shader;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    AssetCooker::Stats AssetCooker::cook(bool force)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        const auto cacheRoot = fs::absolute(m_cache.getRoot()).lexically_normal();
+
+        std::vector<Source> sources;
+
+        for (auto it = fs::recursive_directory_iterator(m_dataDir); it != fs::recursive_directory_iterator(); ++it)
+        {
+            if (it->is_directory() && it->path() == cacheRoot)
+            {
+                it.disable_recursion_pending();
+                continue;
+            }
+
+            Source src;
+            if (it->is_regular_file() && getKind(it->path(), src.kind))
+            {
+                src.path = it->path();
+                src.name = getName(src.path);
+                sources.push_back(std::move(src));
+            }
+        }
+
+        getJobSystem()->parallelFor(sources.size(), [this, &sources, force](size_t i)
+        {
+            auto& src = sources[i];
+
+            try
+            {
+                process(src, m_manifest.find(src.name), force);
+            }
+            catch (const std::exception& ex)
+            {
+                src.result = Result::Failed;
+                src.error = ex.what();
+            }
+        });
+
+        Stats stats;
+        stats.sources = sources.size();
+
+        CookManifest manifest;
+
+        for (auto& src : sources)
+        {
+            switch (src.result)
+            {
+            case Result::UpToDate: ++stats.upToDate; break;
+            case Result::CacheHit: ++stats.cacheHits; break;
+            case Result::Cooked: ++stats.cooked; break;
+            case Result::Failed: ++stats.failed; break;
+            }
+
+            stats.bytesWritten += src.bytes;
+
+            if (src.result == Result::Failed)
+            {
+                std::cout << "Failed " << src.name << ": " << src.error << std::endl;
+                continue;
+            }
+
+            manifest.set(src.name, std::move(src.entry));
+        }
+
+        // Sources that were removed from the data dir drop out of the manifest, their blobs stay
+        m_manifest = std::move(manifest);
+        m_manifest.save(m_cache.getRoot() / cManifestName);
+
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "AssetCooker: " << stats.sources << " sources, " << stats.upToDate << " up to date, " << stats.cacheHits << " cache hits, "
+            << stats.cooked << " cooked (" << stats.bytesWritten / 1024 << " KB), " << stats.failed << " failed in " << seconds << " s" << std::endl;
+
+        return stats;
+    }
+
+    void AssetCooker::process(Source& src, const CookManifest::Entry* prev, bool force) const
+    {
+        // Fast path: nothing touched since the last run
+        if (!force && prev && computeStamp(src, prev->dependencies) == prev->stamp && m_cache.has(prev->key))
+        {
+            src.entry = *prev;
+            src.result = Result::UpToDate;
+            return;
+        }
+
+        std::vector<uint8_t> data;
+        if (!readFile(src.path, data))
+        {
+            throw std::runtime_error("AssetCooker: Can't read source");
+        }
+
+        std::vector<uint8_t> settingsData;
+        readFile(getSettingsPath(src.path), settingsData);
+
+        const auto settings = settingsData.empty() ? JsonValue() : JsonValue::parse(reinterpret_cast<const char*>(settingsData.data()), settingsData.size());
+
+        EHash::Hasher64 hasher;
+        hasher.update(cCookerVersion);
+        hasher.update(static_cast<uint64_t>(CookedAsset::cVersion));
+        hasher.update(static_cast<uint64_t>(src.kind));
+        hasher.update(static_cast<uint64_t>(settingsData.size())).update(settingsData.data(), settingsData.size());
+        hasher.update(static_cast<uint64_t>(data.size())).update(data.data(), data.size());
+
+        src.entry.dependencies.clear();
+
+        std::vector<uint8_t> depData;
+        for (const auto& dep : collectDependencies(src, data))
+        {
+            if (!readFile(dep, depData))
+            {
+                throw std::runtime_error("AssetCooker: Can't read dependency: " + dep.u8string());
+            }
+
+            src.entry.dependencies.push_back(getName(dep));
+
+            hasher.update(src.entry.dependencies.back());
+            hasher.update(static_cast<uint64_t>(depData.size())).update(depData.data(), depData.size());
+        }
+
+        src.entry.key = hasher.finish();
+        src.entry.stamp = computeStamp(src, src.entry.dependencies);
+
+        if (!force && m_cache.has(src.entry.key))
+        {
+            src.result = Result::CacheHit;
+            return;
+        }
+
+        std::vector<uint8_t> blob;
+
+        switch (src.kind)
+        {
+        case CookKind::Mesh:
+            blob = cookMesh(src.path);
+            break;
+        case CookKind::Texture:
+            blob = cookTexture(data, settings);
+            break;
+        case CookKind::Shader:
+            blob = cookShader(src.path, data, settings);
+            break;
+        }
+
+        m_cache.store(src.entry.key, blob.data(), blob.size());
+
+        src.bytes = blob.size();
+        src.result = Result::Cooked;
+    }
+
+    std::vector<fs::path> AssetCooker::collectDependencies(const Source& src, const std::vector<uint8_t>& data) const
+    {
+        std::vector<fs::path> res;
+
+        if (src.kind == CookKind::Mesh)
+        {
+            const auto json = JsonValue::parse(reinterpret_cast<const char*>(data.data()), data.size());
+
+            const auto& buffers = json["buffers"];
+            for (size_t i = 0; i < buffers.size(); ++i)
+            {
+                const auto& uri = buffers[i]["uri"].asString();
+                if (!uri.empty() && !isDataUri(uri))
+                {
+                    res.push_back((src.path.parent_path() / fs::u8path(decodeUri(uri))).lexically_normal());
+                }
+            }
+        }
+        else if (src.kind == CookKind::Shader)
+        {
+            // The source itself is first, missing includes are left for the compiler to report
+            const auto includes = collectIncludes(src.path);
+            for (size_t i = 1; i < includes.size(); ++i)
+            {
+                std::error_code ec;
+                if (fs::is_regular_file(includes[i], ec))
+                {
+                    res.push_back(includes[i]);
+                }
+            }
+        }
+
+        return res;
+    }
+
+    uint64_t AssetCooker::computeStamp(const Source& src, const std::vector<std::string>& dependencies) const
+    {
+        EHash::Hasher64 hasher;
+
+        auto addFile = [&hasher](const fs::path& path)
+        {
+            std::error_code ec;
+            const auto size = fs::file_size(path, ec);
+
+            if (ec)
+            {
+                hasher.update(~0ull);
+                return;
+            }
+
+            hasher.update(static_cast<uint64_t>(size));
+            hasher.update(static_cast<uint64_t>(fs::last_write_time(path, ec).time_since_epoch().count()));
+        };
+
+        hasher.update(cCookerVersion);
+        addFile(src.path);
+        addFile(getSettingsPath(src.path));
+
+        for (const auto& dep : dependencies)
+        {
+            hasher.update(dep);
+            addFile(m_dataDir / fs::u8path(dep));
+        }
+
+        return hasher.finish();
+    }
+
+    std::string AssetCooker::getName(const fs::path& path) const
+    {
+        return path.lexically_normal().lexically_relative(m_dataDir).generic_u8string();
+    }
+}
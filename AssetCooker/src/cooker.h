@@ -0,0 +1,74 @@
+#pragma once
+
+#include "utils/eddc.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace EProject
+{
+    enum class CookKind
+    {
+        Mesh,
+        Texture,
+        Shader
+    };
+
+    // Walks the data directory and cooks every known source into the derived data cache.
+    // A source key hashes the source bytes, its dependencies (glTF buffers, shader includes)
+    // and the import settings from an optional "<source>.import" json next to it.
+    class AssetCooker
+    {
+    public:
+        struct Stats
+        {
+            size_t sources = 0;
+            size_t upToDate = 0;    // stamps matched, inputs were not read
+            size_t cacheHits = 0;   // inputs changed but the key was already cooked
+            size_t cooked = 0;
+            size_t failed = 0;
+            size_t bytesWritten = 0;
+        };
+
+        AssetCooker(const std::filesystem::path& dataDir, const std::filesystem::path& cacheDir);
+
+        // force ignores the manifest stamps and rehashes every input
+        Stats cook(bool force);
+
+        static bool getKind(const std::filesystem::path& path, CookKind& kind);
+
+    private:
+        enum class Result
+        {
+            UpToDate,
+            CacheHit,
+            Cooked,
+            Failed
+        };
+
+        struct Source
+        {
+            std::filesystem::path path;
+            std::string name;
+            CookKind kind = CookKind::Mesh;
+
+            CookManifest::Entry entry;
+            Result result = Result::Failed;
+            std::string error;
+            size_t bytes = 0;
+        };
+
+        void process(Source& src, const CookManifest::Entry* prev, bool force) const;
+
+        std::vector<std::filesystem::path> collectDependencies(const Source& src, const std::vector<uint8_t>& data) const;
+        uint64_t computeStamp(const Source& src, const std::vector<std::string>& dependencies) const;
+
+        std::string getName(const std::filesystem::path& path) const;
+
+    private:
+        std::filesystem::path m_dataDir;
+        DerivedDataCache m_cache;
+        CookManifest m_manifest;
+    };
+}
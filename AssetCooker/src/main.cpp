@@ -0,0 +1,103 @@
+#include "cooker.h"
+#include "packer.h"
+#include "texbench.h"
+
+#include <iostream>
+#include <string>
+
+using namespace EProject;
+
+// AssetCooker [--data <dir>] [--cache <dir>] [--force]   cook into the derived data cache
+// AssetCooker [--data <dir>] --pack <archive>              pack loose data files
+// AssetCooker [--data <dir>] --bench <archive>             compare reads against loose files
+// AssetCooker --bench-decode <dir>                         compare serial and batch image decoding
+// AssetCooker --bench-bc <dir>                             block compression speed and quality per preset
+// Defaults match the game layout: Data, DerivedData and Data.pak next to the working directory.
+int main(int argc, char** argv)
+{
+    const auto root = std::filesystem::current_path().parent_path();
+
+    std::filesystem::path dataDir = root / "Data";
+    std::filesystem::path cacheDir = root / "DerivedData";
+    std::filesystem::path packPath;
+    std::filesystem::path benchPath;
+    std::filesystem::path decodePath;
+    std::filesystem::path compressPath;
+    bool force = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+
+        if (arg == "--data" && i + 1 < argc)
+        {
+            dataDir = std::filesystem::u8path(argv[++i]);
+        }
+        else if (arg == "--cache" && i + 1 < argc)
+        {
+            cacheDir = std::filesystem::u8path(argv[++i]);
+        }
+        else if (arg == "--pack" && i + 1 < argc)
+        {
+            packPath = std::filesystem::u8path(argv[++i]);
+        }
+        else if (arg == "--bench" && i + 1 < argc)
+        {
+            benchPath = std::filesystem::u8path(argv[++i]);
+        }
+        else if (arg == "--bench-decode" && i + 1 < argc)
+        {
+            decodePath = std::filesystem::u8path(argv[++i]);
+        }
+        else if (arg == "--bench-bc" && i + 1 < argc)
+        {
+            compressPath = std::filesystem::u8path(argv[++i]);
+        }
+        else if (arg == "--force")
+        {
+            force = true;
+        }
+        else
+        {
+            std::cout << "Usage: AssetCooker [--data <dir>] [--cache <dir>] [--force] [--pack <archive>] [--bench <archive>] [--bench-decode <dir>] [--bench-bc <dir>]" << std::endl;
+            return 2;
+        }
+    }
+
+    try
+    {
+        if (!packPath.empty())
+        {
+            packData(dataDir, packPath);
+            return 0;
+        }
+
+        if (!benchPath.empty())
+        {
+            benchmarkData(dataDir, benchPath, 3);
+            return 0;
+        }
+
+        if (!decodePath.empty())
+        {
+            benchmarkDecode(decodePath, 2);
+            return 0;
+        }
+
+        if (!compressPath.empty())
+        {
+            benchmarkCompression(compressPath);
+            return 0;
+        }
+
+        AssetCooker cooker(dataDir, cacheDir);
+        const auto stats = cooker.cook(force);
+
+        return stats.failed ? 1 : 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,229 @@
+#include "packer.h"
+
+#include "graphics/eimage.h"
+#include "utils/ehash.h"
+#include "utils/ejobsystem.h"
+#include "utils/emappedfile.h"
+#include "utils/evfs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+
+namespace EProject
+{
+    namespace fs = std::filesystem;
+
+    namespace
+    {
+        bool isCompressible(const fs::path& path)
+        {
+            auto ext = path.extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(::tolower(c)); });
+
+            return ext != ".jpg" && ext != ".jpeg" && ext != ".png";
+        }
+
+        double getSeconds(const std::chrono::steady_clock::time_point& start)
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        // Opens every file and hashes its bytes so mapped pages are really read
+        double readAll(const VirtualFileSystem& vfs, const std::vector<fs::path>& files, size_t& bytes)
+        {
+            const auto start = std::chrono::steady_clock::now();
+
+            std::vector<size_t> sizes(files.size());
+
+            getJobSystem()->parallelFor(files.size(), [&](size_t i)
+            {
+                FileView view;
+                if (!vfs.open(files[i], view))
+                {
+                    throw std::runtime_error("AssetCooker: Can't open " + files[i].u8string());
+                }
+
+                EHash::hash64(view.getData(), view.getSize());
+                sizes[i] = view.getSize();
+            });
+
+            bytes = 0;
+            for (const auto size : sizes)
+            {
+                bytes += size;
+            }
+
+            return getSeconds(start);
+        }
+    }
+
+    void packData(const fs::path& dataDir, const fs::path& archivePath)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const auto root = fs::absolute(dataDir).lexically_normal();
+
+        std::vector<fs::path> files;
+        for (const auto& it : fs::recursive_directory_iterator(root))
+        {
+            if (it.is_regular_file() && it.path().extension() != ".import")
+            {
+                files.push_back(it.path());
+            }
+        }
+
+        // Directory order keeps files of one model next to each other
+        std::sort(files.begin(), files.end());
+
+        std::vector<std::vector<uint8_t>> contents(files.size());
+
+        getJobSystem()->parallelFor(files.size(), [&](size_t i)
+        {
+            std::ifstream file(files[i], std::ios::binary | std::ios::ate);
+            contents[i].resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0, std::ios::beg);
+            file.read(reinterpret_cast<char*>(contents[i].data()), contents[i].size());
+
+            if (!file.good())
+            {
+                throw std::runtime_error("AssetCooker: Can't read " + files[i].u8string());
+            }
+        });
+
+        size_t totalSize = 0;
+
+        ArchiveWriter writer;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            totalSize += contents[i].size();
+            writer.add(files[i].lexically_relative(root).generic_u8string(), std::move(contents[i]), isCompressible(files[i]));
+        }
+
+        writer.write(archivePath, ArchiveWriter::Options());
+
+        std::cout << "AssetCooker: Packed " << files.size() << " files, " << totalSize / 1024 << " KB into " << fs::file_size(archivePath) / 1024
+            << " KB in " << getSeconds(start) << " s" << std::endl;
+    }
+
+    void benchmarkData(const fs::path& dataDir, const fs::path& archivePath, int rounds)
+    {
+        auto archive = std::make_shared<Archive>();
+        if (!archive->open(archivePath))
+        {
+            throw std::runtime_error("AssetCooker: Can't open " + archivePath.u8string());
+        }
+
+        const auto root = fs::absolute(dataDir).lexically_normal();
+
+        std::vector<fs::path> files;
+        for (size_t i = 0; i < archive->getEntryCount(); ++i)
+        {
+            files.push_back(root / fs::u8path(archive->getName(archive->getEntry(i))));
+        }
+
+        archive = nullptr;
+
+        for (int round = 0; round < rounds; ++round)
+        {
+            size_t bytes = 0;
+
+            VirtualFileSystem loose;
+            loose.setRoot(root);
+
+            const double looseTime = readAll(loose, files, bytes);
+
+            const auto mountStart = std::chrono::steady_clock::now();
+
+            VirtualFileSystem packed;
+            packed.setRoot(root);
+            packed.mount(archivePath);
+
+            const double mountTime = getSeconds(mountStart);
+            const double packedTime = readAll(packed, files, bytes) + mountTime;
+
+            std::cout << "AssetCooker: " << (round == 0 ? "first" : "warm ") << " round, " << files.size() << " files, " << bytes / 1024 << " KB: loose "
+                << looseTime * 1000.0 << " ms, packed " << packedTime * 1000.0 << " ms (mount " << mountTime * 1000.0 << " ms)" << std::endl;
+        }
+    }
+
+    void benchmarkDecode(const fs::path& imageDir, int rounds)
+    {
+        std::vector<fs::path> files;
+        for (const auto& it : fs::recursive_directory_iterator(imageDir))
+        {
+            if (it.is_regular_file() && !isCompressible(it.path()))
+            {
+                files.push_back(it.path());
+            }
+        }
+
+        std::sort(files.begin(), files.end());
+
+        std::vector<MappedFile> mapped(files.size());
+        std::vector<ImageSource> sources;
+        size_t inputBytes = 0;
+
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (!mapped[i].open(files[i]))
+            {
+                throw std::runtime_error("AssetCooker: Can't open " + files[i].u8string());
+            }
+
+            // Touch the pages so file IO isn't part of the timing
+            EHash::hash64(mapped[i].getData(), mapped[i].getSize());
+
+            sources.push_back({ mapped[i].getData(), mapped[i].getSize() });
+            inputBytes += mapped[i].getSize();
+        }
+
+        const auto report = [&](const char* name, double seconds, const std::vector<DecodedImage>& images)
+        {
+            size_t outputBytes = 0;
+            for (const auto& image : images)
+            {
+                if (!image.pixels)
+                {
+                    throw std::runtime_error("AssetCooker: Image decode failed: " + image.error);
+                }
+
+                outputBytes += image.getByteSize();
+            }
+
+            const double inMB = inputBytes / (1024.0 * 1024.0);
+            const double outMB = outputBytes / (1024.0 * 1024.0);
+
+            std::cout << "AssetCooker: " << name << " " << images.size() << " images, " << inMB << " MB -> " << outMB << " MB in " << seconds * 1000.0
+                << " ms (" << inMB / seconds << " MB/s in, " << outMB / seconds << " MB/s out)" << std::endl;
+        };
+
+        for (int round = 0; round < rounds; ++round)
+        {
+            std::cout << "AssetCooker: " << (round == 0 ? "Cold" : "Warm") << " pool" << std::endl;
+
+            {
+                const auto start = std::chrono::steady_clock::now();
+
+                std::vector<DecodedImage> images;
+                for (const auto& src : sources)
+                {
+                    images.push_back(ImageDecoder::decode(src, 4));
+                }
+
+                report("serial", getSeconds(start), images);
+            }
+
+            {
+                const auto start = std::chrono::steady_clock::now();
+                const auto images = ImageDecoder::decodeBatch(sources, 4);
+
+                report("batch ", getSeconds(start), images);
+            }
+        }
+
+        const auto stats = getPixelBufferPool()->getStats();
+        std::cout << "AssetCooker: Pixel pool reused " << stats.reused << " of " << stats.allocations << " blocks, " << stats.cachedBytes / (1024 * 1024)
+            << " MB cached" << std::endl;
+    }
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <filesystem>
+
+namespace EProject
+{
+    // Packs every loose file under dataDir into one archive. Already compressed
+    // images are stored as is so they stay zero-copy, everything else gets LZ4 blocks.
+    void packData(const std::filesystem::path& dataDir, const std::filesystem::path& archivePath);
+
+    // Opens and touches every archive entry through the file system, once from loose files
+    // and once from the archive. The first round is cold only if the OS file cache was dropped.
+    void benchmarkData(const std::filesystem::path& dataDir, const std::filesystem::path& archivePath, int rounds);
+
+    // Decodes every image under imageDir one by one and then as one parallel batch.
+    // Reports input and output throughput and the wall time of both.
+    void benchmarkDecode(const std::filesystem::path& imageDir, int rounds);
+}
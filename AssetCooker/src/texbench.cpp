@@ -0,0 +1,133 @@
+#include "texbench.h"
+
+#include "graphics/ebcencoder.h"
+#include "graphics/eimage.h"
+#include "utils/efileutils.h"
+#include "utils/emappedfile.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <string>
+
+namespace EProject
+{
+    namespace fs = std::filesystem;
+
+    namespace
+    {
+        struct FormatStats
+        {
+            size_t images = 0;
+            size_t pixels = 0;
+            size_t bytes = 0;
+            double seconds = 0.0;
+            double psnr = 0.0;
+        };
+
+        const char* getFormatName(TextureFmt fmt)
+        {
+            switch (fmt)
+            {
+            case TextureFmt::BC1: return "BC1";
+            case TextureFmt::BC3: return "BC3";
+            case TextureFmt::BC4: return "BC4";
+            case TextureFmt::BC5: return "BC5";
+            case TextureFmt::BC7: return "BC7";
+            default: return "?";
+            }
+        }
+
+        const char* getQualityName(BCQuality quality)
+        {
+            switch (quality)
+            {
+            case BCQuality::Fast: return "fast";
+            case BCQuality::Normal: return "normal";
+            default: return "high";
+            }
+        }
+
+        bool isImage(const fs::path& path)
+        {
+            const auto ext = getLowerExt(path);
+            return ext == ".png" || ext == ".jpg" || ext == ".jpeg" || ext == ".tga" || ext == ".bmp";
+        }
+    }
+
+    void benchmarkCompression(const fs::path& imageDir)
+    {
+        std::vector<fs::path> files;
+        for (const auto& it : fs::recursive_directory_iterator(imageDir))
+        {
+            if (it.is_regular_file() && isImage(it.path()))
+            {
+                files.push_back(it.path());
+            }
+        }
+
+        std::sort(files.begin(), files.end());
+
+        std::vector<MappedFile> mapped(files.size());
+        std::vector<ImageSource> sources;
+
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (!mapped[i].open(files[i]))
+            {
+                throw std::runtime_error("AssetCooker: Can't open " + files[i].u8string());
+            }
+
+            sources.push_back({ mapped[i].getData(), mapped[i].getSize() });
+        }
+
+        const auto images = ImageDecoder::decodeBatch(sources, 4);
+
+        std::vector<TextureFmt> formats;
+        for (size_t i = 0; i < images.size(); ++i)
+        {
+            if (!images[i].pixels)
+            {
+                throw std::runtime_error("AssetCooker: Image decode failed: " + files[i].u8string() + " (" + images[i].error + ")");
+            }
+
+            formats.push_back(BCEncoder::chooseFormat(images[i].pixels.get(), images[i].size, false));
+        }
+
+        for (const auto quality : { BCQuality::Fast, BCQuality::Normal, BCQuality::High })
+        {
+            std::map<TextureFmt, FormatStats> stats;
+
+            for (size_t i = 0; i < images.size(); ++i)
+            {
+                const auto& image = images[i];
+
+                for (const auto fmt : { formats[i], TextureFmt::BC7 })
+                {
+                    const auto start = std::chrono::steady_clock::now();
+                    const auto blocks = BCEncoder::encode(image.pixels.get(), image.size, fmt, quality);
+                    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+                    const auto decoded = BCEncoder::decode(blocks.data(), image.size, fmt);
+
+                    auto& s = stats[fmt];
+                    ++s.images;
+                    s.pixels += static_cast<size_t>(image.size.x) * image.size.y;
+                    s.bytes += blocks.size();
+                    s.seconds += seconds;
+                    s.psnr += std::min(BCEncoder::computePSNR(image.pixels.get(), decoded.data(), image.size, fmt), 99.0);
+                }
+            }
+
+            for (const auto& [fmt, s] : stats)
+            {
+                const double mpix = s.pixels / 1e6;
+
+                std::cout << "AssetCooker: " << getFormatName(fmt) << " " << getQualityName(quality) << ": " << s.images << " images, " << mpix << " MPix -> "
+                    << s.bytes / 1024 << " KB in " << s.seconds << " s (" << mpix / s.seconds << " MPix/s), PSNR " << s.psnr / s.images << " dB" << std::endl;
+            }
+        }
+    }
+}
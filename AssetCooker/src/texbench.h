@@ -0,0 +1,10 @@
+#pragma once
+
+#include <filesystem>
+
+namespace EProject
+{
+    // Encodes every image under imageDir with each quality preset, once in the format the
+    // cooker would pick and once as BC7. Reports throughput and PSNR per format.
+    void benchmarkCompression(const std::filesystem::path& imageDir);
+}
@@ -0,0 +1,98 @@
+#include "cachebench.h"
+
+#include "eutils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace EProject
+{
+    namespace
+    {
+        constexpr size_t cAssetsCount = 1024;
+        constexpr size_t cLookupsPerThread = 1000000;
+
+        class DummyAsset final : public IAsset
+        {
+        public:
+            void init() override {}
+            bool load(const GDevicePtr&) override { return true; }
+            bool unload() override { return true; }
+        };
+    }
+
+    void benchmarkCacheHits(int maxThreads)
+    {
+        AssetCache cache;
+
+        std::vector<PathKey> keys;
+        for (size_t i = 0; i < cAssetsCount; ++i)
+        {
+            keys.emplace_back("Models/Scene/asset_" + std::to_string(i) + ".bin");
+            cache.insert(keys.back(), std::make_shared<DummyAsset>());
+        }
+
+        const auto loader = []() -> std::shared_ptr<IAsset> { throw std::runtime_error("Benchmarks: Cache miss"); };
+
+        double single = 0.0;
+
+        for (int threads = 1; threads <= maxThreads; threads *= 2)
+        {
+            std::atomic<int> ready = 0;
+            std::atomic<bool> go = false;
+            std::vector<std::thread> workers;
+
+            for (int t = 0; t < threads; ++t)
+            {
+                workers.emplace_back([&, t]()
+                {
+                    // Each thread walks the keys with its own stride, like independent systems would
+                    size_t index = static_cast<size_t>(t) * 7919;
+
+                    ++ready;
+                    while (!go)
+                    {
+                        std::this_thread::yield();
+                    }
+
+                    for (size_t i = 0; i < cLookupsPerThread; ++i)
+                    {
+                        index = (index + 31) % cAssetsCount;
+                        cache.getOrLoad(keys[index], loader);
+                    }
+                });
+            }
+
+            while (ready < threads)
+            {
+                std::this_thread::yield();
+            }
+
+            const auto start = std::chrono::steady_clock::now();
+            go = true;
+
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const double rate = threads * cLookupsPerThread / seconds / 1e6;
+
+            if (threads == 1)
+            {
+                single = rate;
+            }
+
+            std::cout << "Benchmarks: " << threads << " threads: " << rate << " M hits/s (" << rate / single << "x)" << std::endl;
+        }
+
+        const auto stats = cache.getStats();
+        std::cout << "Benchmarks: " << stats.hits << " hits, " << stats.misses << " misses" << std::endl;
+    }
+}
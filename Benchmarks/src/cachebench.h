@@ -0,0 +1,8 @@
+#pragma once
+
+namespace EProject
+{
+    // Cache hits through AssetCache::getOrLoad from 1 up to maxThreads threads at once.
+    // Reports the lookup rate per thread count and its scaling over a single thread.
+    void benchmarkCacheHits(int maxThreads);
+}
@@ -0,0 +1,157 @@
+#include "loadbench.h"
+
+#include "egapi.h"
+#include "eutils.h"
+#include "graphics/emesh.h"
+#include "utils/ejobsystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace EProject
+{
+    namespace fs = std::filesystem;
+
+    namespace
+    {
+        const char* const cScenes[] = { "Helmet/DamagedHelmet.gltf", "SciFiHelmet/SciFiHelmet.gltf", "Sponza/Sponza.gltf" };
+
+        double secondsSince(const std::chrono::steady_clock::time_point& start)
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        size_t getPeakMemory()
+        {
+#ifdef _WIN32
+            PROCESS_MEMORY_COUNTERS counters = {};
+            GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+            return counters.PeakWorkingSetSize;
+#else
+            rusage usage = {};
+            getrusage(RUSAGE_SELF, &usage);
+            return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+        }
+    }
+
+    void benchmarkLoad(const fs::path& modelsDir, int runs)
+    {
+        auto dev = std::make_shared<GDevice>();
+
+        std::cout << "Benchmarks: " << getJobSystem()->getWorkersCount() << " worker threads, best of " << runs << " runs" << std::endl;
+
+        std::vector<fs::path> scenes;
+        double serialTotal = 0.0;
+
+        for (const auto* name : cScenes)
+        {
+            const auto path = modelsDir / fs::u8path(name);
+
+            double best = 0.0;
+            size_t meshes = 0;
+
+            try
+            {
+                for (int run = 0; run < runs; ++run)
+                {
+                    const auto start = std::chrono::steady_clock::now();
+
+                    auto mesh = std::make_shared<MeshInstance>(path);
+                    mesh->load(dev);
+                    mesh->init();
+
+                    const double seconds = secondsSince(start);
+                    best = run == 0 ? seconds : std::min(best, seconds);
+                    meshes = mesh->getMeshData().size();
+                }
+            }
+            catch (const std::exception& ex)
+            {
+                std::cout << "Benchmarks: " << name << " skipped: " << ex.what() << std::endl;
+                continue;
+            }
+
+            std::cout << "Benchmarks: " << name << ": " << meshes << " meshes in " << best * 1000.0 << " ms" << std::endl;
+
+            scenes.push_back(path);
+            serialTotal += best;
+        }
+
+        if (scenes.empty())
+        {
+            throw std::runtime_error("Benchmarks: No scene loaded from " + modelsDir.u8string());
+        }
+
+        double concurrent = 0.0;
+
+        for (int run = 0; run < runs; ++run)
+        {
+            // A fresh manager each run, so nothing comes from the cache
+            AssetManager manager(dev);
+
+            const auto start = std::chrono::steady_clock::now();
+            const auto loaded = manager.getAssets<MeshInstance>(scenes);
+            const double seconds = secondsSince(start);
+
+            concurrent = run == 0 ? seconds : std::min(concurrent, seconds);
+        }
+
+        std::cout << "Benchmarks: " << scenes.size() << " scenes serial " << serialTotal * 1000.0 << " ms, concurrent " << concurrent * 1000.0
+            << " ms (" << serialTotal / concurrent << "x)" << std::endl;
+    }
+
+    void benchmarkImporter(const fs::path& modelsDir, bool native, int runs)
+    {
+        auto dev = std::make_shared<GDevice>();
+
+        MeshInstance::setNativeGLTF(native);
+
+        const char* importer = native ? "glTF" : "Assimp";
+        const size_t startPeak = getPeakMemory();
+
+        for (const auto* name : cScenes)
+        {
+            const auto path = modelsDir / fs::u8path(name);
+
+            double best = 0.0;
+            size_t vertices = 0;
+
+            try
+            {
+                for (int run = 0; run < runs; ++run)
+                {
+                    const auto start = std::chrono::steady_clock::now();
+
+                    auto mesh = std::make_shared<MeshInstance>(path);
+                    mesh->load(dev);
+
+                    const double seconds = secondsSince(start);
+                    best = run == 0 ? seconds : std::min(best, seconds);
+                    vertices = mesh->getVertexCount();
+                }
+            }
+            catch (const std::exception& ex)
+            {
+                std::cout << "Benchmarks: " << importer << " " << name << " skipped: " << ex.what() << std::endl;
+                continue;
+            }
+
+            std::cout << "Benchmarks: " << importer << " " << name << ": " << vertices << " vertices in " << best * 1000.0 << " ms, peak "
+                << getPeakMemory() / (1024 * 1024) << " MB" << std::endl;
+        }
+
+        std::cout << "Benchmarks: " << importer << " peak memory " << getPeakMemory() / (1024 * 1024) << " MB (" << startPeak / (1024 * 1024) << " MB before loading)" << std::endl;
+    }
+}
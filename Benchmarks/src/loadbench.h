@@ -0,0 +1,14 @@
+#pragma once
+
+#include <filesystem>
+
+namespace EProject
+{
+    // Loads the sample scenes (DamagedHelmet, SciFiHelmet, Sponza) one after another and then
+    // concurrently through AssetManager::getAssets. Reports wall time per scene and the speedup.
+    void benchmarkLoad(const std::filesystem::path& modelsDir, int runs);
+
+    // Loads the sample scenes with one importer, the native glTF loader or Assimp. Reports load
+    // time and the peak resident memory of the process, so run it once per importer.
+    void benchmarkImporter(const std::filesystem::path& modelsDir, bool native, int runs);
+}
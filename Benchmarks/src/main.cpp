@@ -0,0 +1,133 @@
+#include "cachebench.h"
+#include "loadbench.h"
+#include "queuebench.h"
+#include "recordbench.h"
+#include "setterbench.h"
+#include "streambench.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <string>
+
+using namespace EProject;
+
+// Benchmarks [--data <dir>] [--runs <n>] --load                    serial vs concurrent load of the sample scenes
+// Benchmarks [--data <dir>] [--runs <n>] --gltf <native|assimp>     load time and peak memory of one importer
+// Benchmarks [--data <dir>] --stream                                frame time spikes while streaming the scenes
+// Benchmarks --cache [threads]                                      asset cache hit rate from 1 to 8 (or threads) threads
+// Benchmarks [--runs <n>] --queue [items]                           render queue key sort of 100k (or items) draws per frame
+// Benchmarks [--runs <n>] --setters [draws]                         name vs handle shader setters over 10k (or draws) draws
+// Benchmarks [--runs <n>] --record [threads]                        render queue submit of 100k packets on 1 to 8 (or threads) workers
+// Runs headless on the null graphics backend. Data defaults to the game layout next to the working directory.
+int main(int argc, char** argv)
+{
+    std::filesystem::path dataDir = std::filesystem::current_path().parent_path() / "Data";
+    int runs = 3;
+    std::string mode;
+    bool native = true;
+    int threads = 8;
+    size_t items = 100000;
+    size_t draws = 10000;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+
+        if (arg == "--data" && i + 1 < argc)
+        {
+            dataDir = std::filesystem::u8path(argv[++i]);
+        }
+        else if (arg == "--runs" && i + 1 < argc)
+        {
+            runs = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--load" || arg == "--stream")
+        {
+            mode = arg;
+        }
+        else if (arg == "--cache" || arg == "--record")
+        {
+            mode = arg;
+
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+            {
+                threads = std::max(1, std::stoi(argv[++i]));
+            }
+        }
+        else if (arg == "--queue")
+        {
+            mode = arg;
+
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+            {
+                items = std::max<size_t>(2, std::stoul(argv[++i]));
+            }
+        }
+        else if (arg == "--setters")
+        {
+            mode = arg;
+
+            if (i + 1 < argc && std::isdigit(static_cast<unsigned char>(argv[i + 1][0])))
+            {
+                draws = std::max<size_t>(1, std::stoul(argv[++i]));
+            }
+        }
+        else if (arg == "--gltf" && i + 1 < argc && (std::string(argv[i + 1]) == "native" || std::string(argv[i + 1]) == "assimp"))
+        {
+            mode = arg;
+            native = std::string(argv[++i]) == "native";
+        }
+        else
+        {
+            mode.clear();
+            break;
+        }
+    }
+
+    if (mode.empty())
+    {
+        std::cout << "Usage: Benchmarks [--data <dir>] [--runs <n>] --load | --gltf <native|assimp> | --stream | --cache [threads] | --queue [items] | --setters [draws] | --record [threads]" << std::endl;
+        return 2;
+    }
+
+    try
+    {
+        if (mode == "--load")
+        {
+            benchmarkLoad(dataDir / "Models", runs);
+        }
+        else if (mode == "--gltf")
+        {
+            benchmarkImporter(dataDir / "Models", native, runs);
+        }
+        else if (mode == "--stream")
+        {
+            benchmarkStreaming(dataDir / "Models");
+        }
+        else if (mode == "--cache")
+        {
+            benchmarkCacheHits(threads);
+        }
+        else if (mode == "--queue")
+        {
+            // Sorting is quick, more frames give a steadier average
+            benchmarkQueueSort(items, runs * 100);
+        }
+        else if (mode == "--setters")
+        {
+            benchmarkShaderSetters(draws, runs);
+        }
+        else if (mode == "--record")
+        {
+            benchmarkRecording(items, threads, runs * 10);
+        }
+
+        return 0;
+    }
+    catch (const std::exception& ex)
+    {
+        std::cout << ex.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,80 @@
+#include "queuebench.h"
+
+#include "graphics/erenderqueue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+namespace EProject
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        constexpr uint32_t cPrograms = 8;
+        constexpr uint32_t cMaterials = 2000;
+
+        std::vector<SortItem> makeFrame(size_t items, std::mt19937& rng)
+        {
+            std::uniform_int_distribution<uint32_t> program(0, cPrograms - 1);
+            std::uniform_int_distribution<uint32_t> material(0, cMaterials - 1);
+            std::uniform_real_distribution<float> depth(0.1f, 500.0f);
+
+            std::vector<SortItem> frame(items);
+            for (size_t i = 0; i < items; ++i)
+            {
+                const uint64_t key = i % 10 == 0
+                    ? SortKey::blended(0, 1, depth(rng), program(rng), material(rng))
+                    : SortKey::opaque(0, 0, program(rng), material(rng), depth(rng));
+
+                frame[i] = { key, uint32_t(i) };
+            }
+
+            return frame;
+        }
+
+        double toMs(Clock::duration d)
+        {
+            return std::chrono::duration<double, std::milli>(d).count();
+        }
+    }
+
+    void benchmarkQueueSort(size_t items, int frames)
+    {
+        std::mt19937 rng(42);
+
+        std::vector<SortItem> sorted;
+        std::vector<SortItem> scratch;
+        std::vector<uint32_t> histograms;
+
+        double radix = 0.0;
+        double stable = 0.0;
+
+        for (int f = 0; f < frames; ++f)
+        {
+            const auto frame = makeFrame(items, rng);
+
+            sorted.assign(frame.begin(), frame.end());
+            auto start = Clock::now();
+            radixSort(sorted, scratch, histograms);
+            radix += toMs(Clock::now() - start);
+
+            auto reference = frame;
+            start = Clock::now();
+            std::stable_sort(reference.begin(), reference.end(), [](const SortItem& a, const SortItem& b) { return a.key < b.key; });
+            stable += toMs(Clock::now() - start);
+
+            if (!std::equal(sorted.begin(), sorted.end(), reference.begin(), [](const SortItem& a, const SortItem& b) { return a.key == b.key && a.index == b.index; }))
+            {
+                throw std::runtime_error("Benchmarks: radixSort order differs from std::stable_sort");
+            }
+        }
+
+        std::cout << "Benchmarks: " << items << " sort items, " << frames << " frames" << std::endl;
+        std::cout << "Benchmarks: radixSort " << radix / frames << " ms, std::stable_sort " << stable / frames << " ms per frame" << std::endl;
+    }
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+namespace EProject
+{
+    // Sorts the draw keys of a synthetic frame (few programs, many materials, random depth, a tenth
+    // blended) with radixSort and std::stable_sort, buffers reused across frames like RenderQueue does.
+    void benchmarkQueueSort(size_t items, int frames);
+}
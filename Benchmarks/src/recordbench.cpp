@@ -0,0 +1,124 @@
+#include "recordbench.h"
+
+#include "egapi.h"
+#include "graphics/erenderqueue.h"
+#include "utils/ejobsystem.h"
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace EProject
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        constexpr int cPrograms = 8;
+        constexpr int cGeometry = 256;
+
+        struct Scene
+        {
+            std::vector<ShaderProgramPtr> programs;
+            std::vector<ShaderValue<glm::mat4>> worlds;
+            std::vector<ShaderValue<glm::vec4>> colors;
+            std::vector<VertexBufferPtr> vbos;
+            std::vector<IndexBufferPtr> ibos;
+        };
+
+        Scene makeScene(GDevice& device)
+        {
+            Scene scene;
+
+            for (int i = 0; i < cPrograms; ++i)
+            {
+                auto program = device.createShaderProgram();
+                scene.worlds.push_back(program->findValue<glm::mat4>("world"));
+                scene.colors.push_back(program->findValue<glm::vec4>("color"));
+                scene.programs.push_back(program);
+            }
+
+            for (int i = 0; i < cGeometry; ++i)
+            {
+                scene.vbos.push_back(device.createVertexBuffer());
+                scene.ibos.push_back(device.createIndexBuffer());
+            }
+
+            return scene;
+        }
+
+        double submitFrame(GDevice& device, RenderQueue& queue, const Scene& scene, size_t packets, std::mt19937& rng)
+        {
+            std::uniform_int_distribution<int> program(0, cPrograms - 1);
+            std::uniform_int_distribution<int> geometry(0, cGeometry - 1);
+            std::uniform_real_distribution<float> depth(0.1f, 500.0f);
+
+            device.beginFrame();
+
+            for (size_t i = 0; i < packets; ++i)
+            {
+                const int p = program(rng);
+                const int g = geometry(rng);
+
+                const uint32_t constants = queue.beginConstants();
+                queue.setValue(scene.worlds[p], glm::mat4(float(i)));
+                queue.setValue(scene.colors[p], glm::vec4(float(i % 7) / 7.0f));
+                queue.endConstants();
+
+                RenderQueue::DrawPacket packet;
+                packet.program = scene.programs[p].get();
+                packet.geometry = queue.addGeometry(scene.vbos[g], scene.ibos[g]);
+                packet.constants = constants;
+                packet.count = 36;
+
+                queue.push(SortKey::opaque(0, 0, queue.getProgramId(packet.program), 0, depth(rng)), packet);
+            }
+
+            // Only the submit is timed, building the packets is the same for every job system
+            const auto start = Clock::now();
+            queue.submit(device);
+            return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        }
+    }
+
+    void benchmarkRecording(size_t packets, int workers, int frames)
+    {
+        auto device = std::make_shared<GDevice>();
+
+        // The command log would cost more than the recording
+        device->setRecording(false);
+
+        const Scene scene = makeScene(*device);
+
+        std::cout << "Benchmarks: " << packets << " packets, " << frames << " frames" << std::endl;
+
+        double serial = 0.0;
+
+        for (int w = 1; w <= workers; w = w < workers ? std::min(w * 2, workers) : workers + 1)
+        {
+            JobSystem jobs(static_cast<size_t>(w));
+            RenderQueue queue(&jobs);
+            std::mt19937 rng(42);
+
+            // Untimed frame grows the queue tables and the constant ring first
+            submitFrame(*device, queue, scene, packets, rng);
+
+            double total = 0.0;
+            for (int f = 0; f < frames; ++f)
+            {
+                total += submitFrame(*device, queue, scene, packets, rng);
+            }
+
+            const double ms = total / frames;
+            if (w == 1)
+            {
+                serial = ms;
+            }
+
+            std::cout << "Benchmarks: " << w << " workers, submit " << ms << " ms per frame, x" << serial / ms << std::endl;
+        }
+    }
+}
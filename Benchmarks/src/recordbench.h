@@ -0,0 +1,11 @@
+#pragma once
+
+#include <cstddef>
+
+namespace EProject
+{
+    // Submits a synthetic frame of packets (few programs, many geometry buffers, constants on every
+    // packet) through RenderQueue on job systems of 1 up to workers threads, the submitting thread
+    // helps each of them. The null device's command log is off. Reports the submit time per frame and the speedup over one worker.
+    void benchmarkRecording(size_t packets, int workers, int frames);
+}
@@ -0,0 +1,126 @@
+#include "setterbench.h"
+
+#include "egapi.h"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+namespace EProject
+{
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        struct Handles
+        {
+            ShaderValue<glm::mat4> world;
+            ShaderValue<glm::mat4> viewProj;
+            ShaderValue<glm::vec4> baseColor;
+            ShaderValue<glm::vec3> cameraPos;
+            ShaderValue<float> metallic;
+            ShaderValue<float> roughness;
+        };
+
+        glm::vec4 drawColor(size_t i)
+        {
+            return glm::vec4(float(i % 7) / 7.0f, 0.5f, 0.25f, 1.0f);
+        }
+
+        double byName(ShaderProgram& program, size_t draws, bool draw, const glm::mat4& viewProj)
+        {
+            const auto start = Clock::now();
+
+            for (size_t i = 0; i < draws; ++i)
+            {
+                program.setValue("world", glm::mat4(float(i)));
+                program.setValue("viewProj", viewProj);
+                program.setValue("baseColor", drawColor(i));
+                program.setValue("cameraPos", glm::vec3(0.0f, 2.0f, -5.0f));
+                program.setValue("metallic", 0.5f);
+                program.setValue("roughness", float(i % 3) * 0.25f);
+                if (draw)
+                {
+                    program.draw(PrimTopology::Triangle, 0, 3);
+                }
+            }
+
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / double(draws);
+        }
+
+        double byHandle(ShaderProgram& program, const Handles& h, size_t draws, bool draw, const glm::mat4& viewProj)
+        {
+            const auto start = Clock::now();
+
+            for (size_t i = 0; i < draws; ++i)
+            {
+                program.setValue(h.world, glm::mat4(float(i)));
+                program.setValue(h.viewProj, viewProj);
+                program.setValue(h.baseColor, drawColor(i));
+                program.setValue(h.cameraPos, glm::vec3(0.0f, 2.0f, -5.0f));
+                program.setValue(h.metallic, 0.5f);
+                program.setValue(h.roughness, float(i % 3) * 0.25f);
+                if (draw)
+                {
+                    program.draw(PrimTopology::Triangle, 0, 3);
+                }
+            }
+
+            return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / double(draws);
+        }
+    }
+
+    void benchmarkShaderSetters(size_t draws, int runs)
+    {
+        auto device = std::make_shared<GDevice>();
+        auto program = device->createShaderProgram();
+
+        // The command log would cost more than the setters
+        device->setRecording(false);
+
+        Handles h;
+        h.world = program->findValue<glm::mat4>("world");
+        h.viewProj = program->findValue<glm::mat4>("viewProj");
+        h.baseColor = program->findValue<glm::vec4>("baseColor");
+        h.cameraPos = program->findValue<glm::vec3>("cameraPos");
+        h.metallic = program->findValue<float>("metallic");
+        h.roughness = program->findValue<float>("roughness");
+
+        const glm::mat4 viewProj(2.0f);
+
+        // Untimed frames grow the constant ring first
+        for (int f = 0; f < ConstantRing::cFramesInFlight; ++f)
+        {
+            device->beginFrame();
+            byName(*program, draws, true, viewProj);
+        }
+
+        std::cout << "Benchmarks: " << draws << " draws, six globals each, " << runs << " runs" << std::endl;
+
+        for (bool draw : { false, true })
+        {
+            double names = 0.0;
+            double handles = 0.0;
+
+            // Alternating which path goes first keeps the previous frame's cache state out of the comparison
+            for (int r = 0; r < runs; ++r)
+            {
+                for (int pass = 0; pass < 2; ++pass)
+                {
+                    device->beginFrame();
+
+                    if ((r + pass) % 2 == 0)
+                    {
+                        names += byName(*program, draws, draw, viewProj);
+                    }
+                    else
+                    {
+                        handles += byHandle(*program, h, draws, draw, viewProj);
+                    }
+                }
+            }
+
+            std::cout << "Benchmarks: " << (draw ? "setters and draw" : "setters only") << ": by name " << names / runs << " ns, by handle " << handles / runs << " ns per draw" << std::endl;
+        }
+    }
+}
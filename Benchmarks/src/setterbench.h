@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstddef>
+
+namespace EProject
+{
+    // Sets six globals of a PBR-like program and draws, once through the name setters and once
+    // through handles resolved up front, on the null device so only the CPU side is measured.
+    void benchmarkShaderSetters(size_t draws, int runs);
+}
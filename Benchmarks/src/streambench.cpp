@@ -0,0 +1,156 @@
+#include "streambench.h"
+
+#include "egapi.h"
+#include "eutils.h"
+#include "graphics/emesh.h"
+#include "utils/efileutils.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace EProject
+{
+    namespace fs = std::filesystem;
+
+    namespace
+    {
+        using Clock = std::chrono::steady_clock;
+
+        constexpr double cFrameBudget = 1000.0 / 60.0;
+
+        const char* const cScenes[] = { "Helmet/DamagedHelmet.gltf", "SciFiHelmet/SciFiHelmet.gltf", "Sponza/Sponza.gltf" };
+
+        bool isImage(const fs::path& path)
+        {
+            const auto ext = getLowerExt(path);
+            return ext == ".png" || ext == ".jpg" || ext == ".jpeg";
+        }
+
+        // Runs frames until frame() returns false, sleeping off the rest of every frame like vsync would.
+        // Returns the CPU time of each frame in ms.
+        std::vector<double> runFrames(const std::function<bool()>& frame)
+        {
+            std::vector<double> times;
+
+            bool running = true;
+            while (running)
+            {
+                const auto start = Clock::now();
+                running = frame();
+
+                const double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+                times.push_back(ms);
+
+                if (ms < cFrameBudget)
+                {
+                    std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(cFrameBudget - ms));
+                }
+            }
+
+            return times;
+        }
+
+        void report(const char* name, std::vector<double> times, size_t failed)
+        {
+            std::sort(times.begin(), times.end());
+
+            const size_t over = static_cast<size_t>(times.end() - std::upper_bound(times.begin(), times.end(), cFrameBudget));
+            const double p99 = times[std::min(times.size() - 1, times.size() * 99 / 100)];
+
+            std::cout << "Benchmarks: " << name << ": " << times.size() << " frames, median " << times[times.size() / 2] << " ms, p99 " << p99
+                << " ms, max " << times.back() << " ms, " << over << " over " << cFrameBudget << " ms";
+
+            if (failed)
+            {
+                std::cout << ", " << failed << " assets failed";
+            }
+
+            std::cout << std::endl;
+        }
+    }
+
+    void benchmarkStreaming(const fs::path& modelsDir)
+    {
+        auto dev = std::make_shared<GDevice>();
+
+        std::vector<fs::path> meshes;
+        std::vector<fs::path> textures;
+
+        for (const auto* name : cScenes)
+        {
+            const auto path = modelsDir / fs::u8path(name);
+            meshes.push_back(path);
+
+            for (const auto& it : fs::directory_iterator(path.parent_path()))
+            {
+                if (it.is_regular_file() && isImage(it.path()))
+                {
+                    textures.push_back(it.path());
+                }
+            }
+        }
+
+        std::sort(textures.begin(), textures.end());
+
+        std::cout << "Benchmarks: Streaming " << meshes.size() << " meshes and " << textures.size() << " textures" << std::endl;
+
+        {
+            AssetManager manager(dev);
+
+            const size_t total = meshes.size() + textures.size();
+            size_t done = 0;
+            size_t failed = 0;
+
+            const auto onLoaded = [&done, &failed](bool ok) { ++done; failed += ok ? 0 : 1; };
+
+            for (const auto& path : meshes)
+            {
+                manager.loadAsync<MeshInstance>(path, 1.0f, [&onLoaded](const Asset<MeshInstance>& asset) { onLoaded(asset != nullptr); });
+            }
+
+            for (const auto& path : textures)
+            {
+                manager.loadAsync<Texture2D>(path, 0.0f, [&onLoaded](const Asset<Texture2D>& asset) { onLoaded(asset != nullptr); });
+            }
+
+            const auto times = runFrames([&]()
+            {
+                manager.update();
+                return done < total;
+            });
+
+            report("loadAsync", times, failed);
+        }
+
+        {
+            AssetManager manager(dev);
+
+            size_t next = 0;
+            size_t failed = 0;
+
+            // What a level load did before: one blocking load per frame
+            const auto times = runFrames([&]()
+            {
+                try
+                {
+                    const bool ok = next < meshes.size() ? manager.getAsset<MeshInstance>(meshes[next]) != nullptr : manager.getAsset<Texture2D>(textures[next - meshes.size()]) != nullptr;
+                    failed += ok ? 0 : 1;
+                }
+                catch (const std::exception&)
+                {
+                    ++failed;
+                }
+
+                manager.update();
+                return ++next < meshes.size() + textures.size();
+            });
+
+            report("getAsset", times, failed);
+        }
+    }
+}
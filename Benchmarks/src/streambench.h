@@ -0,0 +1,10 @@
+#pragma once
+
+#include <filesystem>
+
+namespace EProject
+{
+    // Streams the sample scenes and all their textures while running a 60 Hz frame loop, once with
+    // loadAsync and once with a synchronous getAsset per frame. Reports the frame time spikes of both.
+    void benchmarkStreaming(const std::filesystem::path& modelsDir);
+}
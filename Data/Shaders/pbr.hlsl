@@ -4,20 +4,29 @@
 cbuffer Globals
 {
     matrix vp;
-    matrix model;
-    matrix invModel;
     float4 lightPositions[4];
     float4 lightColours[4];
     float4 camPos;
     float4 customData;
+    uint instanceBase;
+};
+
+struct InstanceData
+{
+    matrix model;
 };
 
 Texture2D albedoTex : register(t0);
 Texture2D normalTex : register(t1);
 Texture2D metallRoghnessTex : register(t2);
 
+StructuredBuffer<InstanceData> instances : register(t3);
+
 SamplerState samplerDefault : register(s1);
 
+// Scale of the constant ambient term until the IBL is in
+static const float AmbientIntensity = 0.03;
+
 struct VsInput
 {
     float3 pos : POS;
@@ -37,9 +46,11 @@ struct VsOutput
     float3x3 tangentBasis : TBASIS;
 };
 
-VsOutput vs_main(VsInput input)
+VsOutput vs_main(VsInput input, uint instanceId : SV_InstanceID)
 {
     VsOutput output;
+
+    const matrix model = instances[instanceBase + instanceId].model;
     
     output.position = float4(input.pos, 1.0);
     output.position = mul(output.position, model);
@@ -58,10 +69,13 @@ VsOutput vs_main(VsInput input)
 
 float4 ps_main(VsOutput input) : SV_TARGET
 {
-    const float3 albedo = albedoTex.SampleLevel(samplerDefault, input.uv, 0).rgb;
-    const float3 normal = normalTex.SampleLevel(samplerDefault, input.uv, 0).rgb;
+    const float3 albedo = albedoTex.Sample(samplerDefault, input.uv).rgb;
+    const float3 normal = normalTex.Sample(samplerDefault, input.uv).rgb;
 
-    const float2 mr = metallRoghnessTex.SampleLevel(samplerDefault, input.uv, 0).gb;
+    // Occlusion, roughness, metalness
+    const float3 orm = metallRoghnessTex.Sample(samplerDefault, input.uv).rgb;
+    const float ao = orm.r;
+    const float2 mr = orm.gb;
 
     const float3 normalSpace = normalize(normal * 2.0 - 1.0);
     const float3 N = normalize(mul(input.tangentBasis, normalSpace));
@@ -82,7 +96,7 @@ float4 ps_main(VsOutput input) : SV_TARGET
     directLight = brdfTerm;
 
     // IBL part
-    float3 ambientLight = 0.0;
+    const float3 ambientLight = ibl() * AmbientIntensity * albedo * ao;
 
-    return float4(directLight, 1.0);
+    return float4(directLight + ambientLight, 1.0);
 } 
\ No newline at end of file
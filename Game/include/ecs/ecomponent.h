@@ -14,7 +14,7 @@ namespace ECS
         inline static ComponentIDType counter;
     public:
         template<typename C>
-        inline constexpr static ComponentIDType type = counter++;
+        inline static const ComponentIDType type = counter++;
     };
 
 #define MAKE_COMPONENT(class_name)\
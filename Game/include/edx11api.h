@@ -73,6 +73,14 @@ namespace EProject
         case TextureFmt::D24_S8: return DXGI_FORMAT_D24_UNORM_S8_UINT;
         case TextureFmt::D32f: return DXGI_FORMAT_R32_TYPELESS;
         case TextureFmt::D32f_S8: return DXGI_FORMAT_R32G8X24_TYPELESS;
+        case TextureFmt::BC1: return DXGI_FORMAT_BC1_UNORM;
+        case TextureFmt::BC1_SRGB: return DXGI_FORMAT_BC1_UNORM_SRGB;
+        case TextureFmt::BC3: return DXGI_FORMAT_BC3_UNORM;
+        case TextureFmt::BC3_SRGB: return DXGI_FORMAT_BC3_UNORM_SRGB;
+        case TextureFmt::BC4: return DXGI_FORMAT_BC4_UNORM;
+        case TextureFmt::BC5: return DXGI_FORMAT_BC5_UNORM;
+        case TextureFmt::BC7: return DXGI_FORMAT_BC7_UNORM;
+        case TextureFmt::BC7_SRGB: return DXGI_FORMAT_BC7_UNORM_SRGB;
         default:
             return DXGI_FORMAT_UNKNOWN;
         }
@@ -104,6 +112,14 @@ namespace EProject
         case TextureFmt::D24_S8: return DXGI_FORMAT_D24_UNORM_S8_UINT;
         case TextureFmt::D32f: return DXGI_FORMAT_R32_FLOAT;
         case TextureFmt::D32f_S8: return DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS;
+        case TextureFmt::BC1: return DXGI_FORMAT_BC1_UNORM;
+        case TextureFmt::BC1_SRGB: return DXGI_FORMAT_BC1_UNORM_SRGB;
+        case TextureFmt::BC3: return DXGI_FORMAT_BC3_UNORM;
+        case TextureFmt::BC3_SRGB: return DXGI_FORMAT_BC3_UNORM_SRGB;
+        case TextureFmt::BC4: return DXGI_FORMAT_BC4_UNORM;
+        case TextureFmt::BC5: return DXGI_FORMAT_BC5_UNORM;
+        case TextureFmt::BC7: return DXGI_FORMAT_BC7_UNORM;
+        case TextureFmt::BC7_SRGB: return DXGI_FORMAT_BC7_UNORM_SRGB;
         default:
             return DXGI_FORMAT_UNKNOWN;
         }
@@ -1,14 +1,36 @@
 #pragma once
 
+// D3D11 on Windows, the headless recording device everywhere else. Define one of
+// these in the project to pick the backend explicitly.
+#if !defined(EPROJECT_GAPI_D3D11) && !defined(EPROJECT_GAPI_NULL)
+#ifdef _WIN32
+#define EPROJECT_GAPI_D3D11
+#else
+#define EPROJECT_GAPI_NULL
+#endif
+#endif
+
+#ifdef EPROJECT_GAPI_D3D11
 #include "dx11gapi.h"
-#include <memory>
+#include <d3d11_1.h>
 #include <wrl.h>
+#endif
+#include <memory>
 #include <glmh.h>
 #include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace EProject
 {
+#ifdef EPROJECT_GAPI_D3D11
     using namespace Microsoft::WRL;
+#endif
 
     enum class TextureFmt
     {
@@ -19,6 +41,7 @@ namespace EProject
         R32, RG32, RGB32, RGBA32,
         R32f, RG32f, RGB32f, RGBA32f,
         D16, D24_S8, D32f, D32f_S8,
+        BC1, BC1_SRGB, BC3, BC3_SRGB, BC4, BC5, BC7, BC7_SRGB,
     };
 
     enum class PrimTopology
@@ -57,9 +80,9 @@ namespace EProject
 
         std::size_t operator() (const Sampler& s) const
         {
-            return std::hash<TexFilter>()(filter) ^ std::hash<TexFilter>()(mipfilter) ^ std::hash<int>()(anisotropy) ^
-                   std::hash<TexWrap>()(wrap_x) ^ std::hash<TexWrap>()(wrap_y) ^ std::hash<TexWrap>()(wrap_z) ^ 
-                   std::hash<glm::vec4>()(border) ^ std::hash<Compare>()(comparison);
+            return std::hash<TexFilter>()(s.filter) ^ std::hash<TexFilter>()(s.mipfilter) ^ std::hash<int>()(s.anisotropy) ^
+                   std::hash<TexWrap>()(s.wrap_x) ^ std::hash<TexWrap>()(s.wrap_y) ^ std::hash<TexWrap>()(s.wrap_z) ^ 
+                   std::hash<glm::vec4>()(s.border) ^ std::hash<Compare>()(s.comparison);
         }
     };
 
@@ -86,54 +109,201 @@ namespace EProject
 
     struct DrawIndexedCmd
     {
-        UINT indexCount;
-        UINT instanceCount;
-        UINT startIndex;
-        INT  baseVertex;
-        UINT baseInstance;
+        uint32_t indexCount;
+        uint32_t instanceCount;
+        uint32_t startIndex;
+        int32_t  baseVertex;
+        uint32_t baseInstance;
+    };
+
+#ifdef EPROJECT_GAPI_NULL
+    enum class GpuCommandType
+    {
+        BeginFrame, EndFrame, SetFrameBuffer, Clear, Blit, SetStates, SetProgram,
+        CreateBuffer, UploadBuffer, CreateTexture, UploadTexture, CreateInputLayout,
+        SetValue, SetResource, SetInputBuffers, Draw, DrawIndexed,
+    };
+
+    // One entry of the null device command log
+    struct GpuCommand
+    {
+        GpuCommandType type;
+        const void* object = nullptr;   // program, buffer, texture or framebuffer involved
+        std::string name;               // value or resource name
+        uint64_t bytes = 0;
+        int first = 0;
+        int count = 0;
+        int instances = 0;
+        int baseVertex = 0;
+        PrimTopology topology = PrimTopology::Triangle;
+    };
+
+    struct GpuCounters
+    {
+        uint64_t drawCalls = 0;
+        uint64_t drawnIndices = 0;
+        uint64_t drawnVertices = 0;
+        uint64_t stateChanges = 0;
+        uint64_t programChanges = 0;
+        uint64_t valueSets = 0;
+        uint64_t resourceBinds = 0;
+        uint64_t uploads = 0;
+        uint64_t uploadedBytes = 0;
+        uint64_t createdResources = 0;
+        uint64_t maps = 0;                  // Map/Unmap pairs a D3D11 device would make
     };
+#endif
 
+    class GDevice;
+
+    // Rasterizer, depth and blend states are immutable blocks cached by their canonical
+    // descriptor. Setters only edit a copy of the current block, validateStates looks the
+    // result up and binds what differs from the device, push/pop save and restore handles.
     class States
     {
+    public:
+        struct FrameStats
+        {
+            uint32_t binds = 0;         // state objects set on the device
+            uint32_t filtered = 0;      // changes that ended up at the bound state
+            uint32_t created = 0;       // new state objects
+        };
+
+#ifdef EPROJECT_GAPI_D3D11
     private:
-        struct StateData
+        template<typename Desc>
+        struct DescHash
         {
-            D3D11_RASTERIZER_DESC m_r_desc;
-            ComPtr<ID3D11RasterizerState> m_r_state;
-            UINT m_stencil_ref;
-            D3D11_DEPTH_STENCIL_DESC m_d_desc;
-            ComPtr<ID3D11DepthStencilState> m_d_state;
-            D3D11_BLEND_DESC m_b_desc;
-            ComPtr<ID3D11BlendState> m_b_state;
-
-            inline StateData(States* st)
+            std::size_t operator()(const Desc& d) const
             {
-                m_r_desc = st->m_r_desc;
-                m_d_desc = st->m_d_desc;
-                m_b_desc = st->m_b_desc;
-                m_r_state = st->m_r_state;
-                m_d_state = st->m_d_state;
-                m_b_state = st->m_b_state;
-                m_stencil_ref = st->m_stencil_ref;
+                // FNV-1a over the canonical bytes
+                const uint8_t* p = reinterpret_cast<const uint8_t*>(&d);
+                uint64_t h = 14695981039346656037ull;
+                for (size_t i = 0; i < sizeof(Desc); i++)
+                {
+                    h = (h ^ p[i]) * 1099511628211ull;
+                }
+                return std::size_t(h);
             }
         };
+
+        template<typename Desc>
+        struct DescEqual
+        {
+            bool operator()(const Desc& a, const Desc& b) const
+            {
+                return memcmp(&a, &b, sizeof(Desc)) == 0;
+            }
+        };
+
+        template<typename Desc, typename Object>
+        using StateCache = std::unordered_map<Desc, ComPtr<Object>, DescHash<Desc>, DescEqual<Desc>>;
+
+        using RasterizerCache = StateCache<D3D11_RASTERIZER_DESC, ID3D11RasterizerState>;
+        using DepthStencilCache = StateCache<D3D11_DEPTH_STENCIL_DESC, ID3D11DepthStencilState>;
+        using BlendCache = StateCache<D3D11_BLEND_DESC, ID3D11BlendState>;
+
+        struct StateData
+        {
+            const RasterizerCache::value_type* r = nullptr;
+            const DepthStencilCache::value_type* d = nullptr;
+            const BlendCache::value_type* b = nullptr;
+            UINT stencilRef = 0;
+        };
+
+        const D3D11_RASTERIZER_DESC& rasterizerDesc() const { return m_r_edit ? m_r_desc : m_current.r->first; }
+        const D3D11_DEPTH_STENCIL_DESC& depthDesc() const { return m_d_edit ? m_d_desc : m_current.d->first; }
+        const D3D11_BLEND_DESC& blendDesc() const { return m_b_edit ? m_b_desc : m_current.b->first; }
+
+        D3D11_RASTERIZER_DESC& editRasterizer();
+        D3D11_DEPTH_STENCIL_DESC& editDepth();
+        D3D11_BLEND_DESC& editBlend();
+
     private:
         ID3D11Device* m_device;
         ID3D11DeviceContext* m_deviceContext;
 
-        D3D11_RASTERIZER_DESC m_r_desc;
-        ComPtr<ID3D11RasterizerState> m_r_state;
+        RasterizerCache m_r_cache;
+        DepthStencilCache m_d_cache;
+        BlendCache m_b_cache;
 
-        UINT m_stencil_ref;
+        // Edited copies of the current blocks, valid while the matching flag is set
+        D3D11_RASTERIZER_DESC m_r_desc;
         D3D11_DEPTH_STENCIL_DESC m_d_desc;
-        ComPtr<ID3D11DepthStencilState> m_d_state;
-
         D3D11_BLEND_DESC m_b_desc;
-        ComPtr<ID3D11BlendState> m_b_state;
+        bool m_r_edit = false;
+        bool m_d_edit = false;
+        bool m_b_edit = false;
+
+        StateData m_current;
+        StateData m_bound;
 
         std::vector<StateData> m_states;
+#else
+    private:
+        struct BlendTarget
+        {
+            bool enable = false;
+            Blend src = Blend::One;
+            Blend dst = Blend::One;
+            BlendFunc func = BlendFunc::Add;
+            Blend srcAlpha = Blend::One;
+            Blend dstAlpha = Blend::One;
+            BlendFunc funcAlpha = BlendFunc::Add;
+            bool colorWrite = true;
+
+            bool operator==(const BlendTarget& b) const
+            {
+                return enable == b.enable && src == b.src && dst == b.dst && func == b.func &&
+                       srcAlpha == b.srcAlpha && dstAlpha == b.dstAlpha && funcAlpha == b.funcAlpha && colorWrite == b.colorWrite;
+            }
+        };
+
+        struct StateData
+        {
+            bool wireframe = false;
+            CullMode cull = CullMode::Back;
+            bool depthEnable = false;
+            bool depthWrite = true;
+            Compare depthFunc = Compare::Less;
+            BlendTarget blend[8];
+
+            bool operator==(const StateData& s) const;
+            std::size_t hash() const;
+        };
+
+        struct hash_fn
+        {
+            std::size_t operator() (const StateData& s) const
+            {
+                return s.hash();
+            }
+        };
+
+        static constexpr uint32_t cNoBlock = ~0u;
+
+        GDevice* m_device;
+
+        std::vector<StateData> m_blocks;
+        std::unordered_map<StateData, uint32_t, hash_fn> m_blockIds;
+
+        // State as set, m_edit tells it may differ from block m_current
+        StateData m_state;
+        bool m_edit = false;
+
+        uint32_t m_current = cNoBlock;
+        uint32_t m_bound = cNoBlock;
+
+        std::vector<uint32_t> m_states;
+#endif
+        bool m_changed = true;
+
+        FrameStats m_frameStats;
+        FrameStats m_lastFrameStats;
+
     private:
         void setDefaultStates();
+        void resolve();
     public:
         void push();
         void pop();
@@ -153,7 +323,15 @@ namespace EProject
         void setColorWrite(bool enable, int rt_index = -1);
 
         void validateStates();
+
+        void beginFrame();
+        // Counts of the last finished frame
+        const FrameStats& getFrameStats() const { return m_lastFrameStats; }
+#ifdef EPROJECT_GAPI_D3D11
         States(ID3D11Device* device, ID3D11DeviceContext* device_context);
+#else
+        explicit States(GDevice* device);
+#endif
     };
 
     class ShaderProgram;
@@ -161,6 +339,8 @@ namespace EProject
     class IndexBuffer;
     class UniformBuffer;
     class StructuredBuffer;
+    class ConstantRing;
+    class InputLayoutCache;
     class GPUTexture2D;
     class Framebuffer;
 
@@ -181,17 +361,28 @@ namespace EProject
         friend class StructuredBuffer;
         friend class GPUTexture2D;
         friend class Framebuffer;
+        friend class States;
+        friend class ConstantRing;
+        friend class InputLayoutCache;
     public:
+#ifdef EPROJECT_GAPI_D3D11
         GDevice(HWND wnd, bool sRGB);
+#else
+        explicit GDevice(const glm::ivec2& size = glm::ivec2(1280, 720), bool sRGB = false);
+#endif
         ~GDevice();
 
         FrameBufferPtr setFrameBuffer(const FrameBufferPtr& fbo, bool update_viewport = true);
         glm::ivec2 currentFrameBufferSize() const;
 
+#ifdef EPROJECT_GAPI_D3D11
         ID3D11Device* getDX11Device() const;
         ID3D11DeviceContext* getDX11DeviceContext() const;
+#endif
 
         States* getStates();
+        ConstantRing* getConstantRing();
+        InputLayoutCache* getInputLayouts();
 
         ShaderProgram* getActiveProgram();
 
@@ -211,7 +402,20 @@ namespace EProject
         void endFrame();
 
         bool isSRGB() const;
+#ifdef EPROJECT_GAPI_D3D11
         HWND getWindow() const;
+#else
+        void setWindowSize(const glm::ivec2& size);
+
+        // Everything the device was asked to do since clearCommandLog, counters keep
+        // counting with recording off so benchmarks don't pay for the log
+        void setRecording(bool enable);
+        const std::vector<GpuCommand>& getCommandLog() const;
+        void clearCommandLog();
+
+        const GpuCounters& getCounters() const;
+        void resetCounters();
+#endif
 
     protected:
 
@@ -224,14 +428,20 @@ namespace EProject
         void setDefaultFramebuffer();
         void setViewport(const glm::vec2& size);
 
+#ifdef EPROJECT_GAPI_D3D11
         ID3D11SamplerState* obtainSampler(const Sampler& s);
-
+#else
+        // nullptr with recording off, the caller fills the rest of the command
+        GpuCommand* record(GpuCommandType type, const void* object);
+#endif
 
     private:
+#ifdef EPROJECT_GAPI_D3D11
         HWND m_hwnd;
 
         ComPtr<ID3D11Device> m_dev;
         ComPtr<ID3D11DeviceContext> m_context;
+        ComPtr<ID3D11DeviceContext1> m_context1;
         ComPtr<IDXGISwapChain> m_swapChain;
         
         ComPtr<ID3D11Texture2D> m_backBuffer;
@@ -241,8 +451,15 @@ namespace EProject
         ComPtr<ID3D11DepthStencilView> m_depthStencilView;
 
         std::unordered_map<Sampler, ComPtr<ID3D11SamplerState>, Sampler> m_samplers;
+#else
+        std::vector<GpuCommand> m_log;
+        GpuCounters m_counters;
+        bool m_recording = true;
+#endif
 
         std::unique_ptr<States> m_states;
+        std::unique_ptr<ConstantRing> m_constants;
+        std::unique_ptr<InputLayoutCache> m_inputLayouts;
         glm::ivec2 m_lastWndSize;
         bool m_isSrgb;
     };
@@ -262,12 +479,34 @@ namespace EProject
 
     struct ShaderInput
     {
-        std::wstring filePath;
+        std::filesystem::path filePath;
         std::string target;
         std::string entyPoint;
         ShaderType type = ShaderType::Vertex;
     };
 
+    // Parameter handles are resolved once after ShaderProgram::create, so the setters that
+    // take them skip the name lookups. They belong to the program that issued them and
+    // have to be resolved again after the program is rebuilt.
+    struct ShaderValueHandle
+    {
+        int offsets[6] = { -1, -1, -1, -1, -1, -1 };
+        int size = 0;
+        uint32_t stageMask = 0;
+
+        bool isValid() const { return stageMask != 0; }
+    };
+
+    template<typename T>
+    struct ShaderValue : ShaderValueHandle {};
+
+    struct ShaderResource
+    {
+        int slot = -1;
+
+        bool isValid() const { return slot >= 0; }
+    };
+
     enum class LayoutType { Byte, Word, UInt, Float };
 
     struct LayoutField
@@ -291,14 +530,91 @@ namespace EProject
         std::size_t hash() const;
     };
 
+    // One instance per distinct layout for the whole process, layouts are compared by
+    // pointer everywhere else. Thread safe.
+    const Layout* internLayout(const Layout& layout);
+
+    // Input layouts shared by all programs of a device, keyed by the vertex shader input
+    // signature, the vertex and instance layouts and the instance step rate. Safe to use
+    // from any thread. save() writes the keys with their signatures, load() creates them
+    // again so a warm start doesn't create layouts on the first draws.
+    class InputLayoutCache
+    {
+    public:
+#ifdef EPROJECT_GAPI_D3D11
+        using Handle = ID3D11InputLayout*;
+#else
+        using Handle = const void*;
+#endif
+
+        struct Stats
+        {
+            uint32_t hits = 0;
+            uint32_t created = 0;       // on lookup
+            uint32_t loaded = 0;        // by load()
+        };
+
+        explicit InputLayoutCache(GDevice* device);
+
+        // Keeps the signature bytes for creating layouts later, returns their hash
+        uint64_t addSignature(const void* data, size_t size);
+
+        // nullptr without layouts
+        Handle get(uint64_t signature, const Layout* vertices, const Layout* instances, int step_rate);
+
+        // A failed save keeps the previous file, a cache file that is missing, corrupt or from
+        // another version doesn't load and leaves the cache as it was
+        bool save(const std::filesystem::path& path) const;
+        bool load(const std::filesystem::path& path);
+
+        size_t size() const;
+        Stats getStats() const;
+
+    private:
+        struct Key
+        {
+            uint64_t signature;
+            const Layout* vertices;
+            const Layout* instances;
+            int step_rate;
+
+            bool operator==(const Key& k) const;
+        };
+
+        struct KeyHash
+        {
+            std::size_t operator()(const Key& k) const;
+        };
+
+        struct Entry
+        {
+#ifdef EPROJECT_GAPI_D3D11
+            ComPtr<ID3D11InputLayout> layout;
+#endif
+        };
+
+        // false when the device rejects the layout for the signature
+        bool create(const Key& key, Entry& entry);
+        static Handle getHandle(const Entry& entry);
+
+    private:
+        GDevice* m_device;
+        mutable std::mutex m_mutex;
+        std::unordered_map<uint64_t, std::string> m_signatures;
+        std::unordered_map<Key, Entry, KeyHash> m_entries;
+        Stats m_stats;
+    };
+
     class ShaderProgram : public DeviceHolder
     {
+        friend class CommandBuffer;
     private:
 
         const ShaderType cShaders[6] = { ShaderType::Vertex, ShaderType::Hull, ShaderType::Domain, ShaderType::Geometry, ShaderType::Pixel, ShaderType::Compute };
 
         enum class SlotKind { Uniform, Texture, Buffer, Sampler };
 
+#ifdef EPROJECT_GAPI_D3D11
         struct ShaderSlot
         {
             SlotKind kind;
@@ -310,19 +626,25 @@ namespace EProject
             ComPtr<ID3D11Buffer> buffer;
             ID3D11SamplerState* sampler;
 
+            // Globals live in the device constant ring and are bound by range
+            UINT firstConstant = 0;
+            UINT numConstants = 0;
+
             void select(ID3D11DeviceContext* dev) const;
+            void selectRange(ID3D11DeviceContext1* dev) const;
             ShaderSlot() : kind(SlotKind::Uniform), layout(nullptr), sampler(nullptr) {}
         };
 
-        struct InputLayoutData
+#else
+        // Without reflection slots appear on first use, binds are compared by object
+        struct ShaderSlot
         {
-            const Layout* vertices;
-            const Layout* instances;
-            int step_rate;
-            ComPtr<ID3D11InputLayout> m_dx_layout;
-            InputLayoutData();
-            void rebuildLayout(ID3D11Device* device, const std::string& shader_code);
+            SlotKind kind;
+            std::string name;
+            const void* resource = nullptr;
+            Sampler sampler = {};
         };
+#endif
 
     public:
 
@@ -332,6 +654,12 @@ namespace EProject
         bool compileFromFile(const ShaderInput& input);
         bool create();
 
+        // What compileFromFile got so far, enough to build the program again
+        const std::vector<ShaderInput>& getInputs() const { return m_inputs; }
+
+        // The compiled files and everything they #include, recursively
+        std::vector<std::filesystem::path> getSourceFiles() const;
+
         void activateProgram();
         void setInputBuffers(const VertexBufferPtr& vbo, const IndexBufferPtr& ibo, const VertexBufferPtr& instances, int instanceStepRate);
 
@@ -353,29 +681,90 @@ namespace EProject
         //void setResource(const char* name, const Texture3DPtr& tex);
         void setResource(const char* name, const Sampler& s);
 
+        template<typename T>
+        ShaderValue<T> findValue(const char* name)
+        {
+            ShaderValue<T> h;
+            resolveValue(name, sizeof(T), h);
+            return h;
+        }
+
+        ShaderResource findResource(const char* name);
 
-    private:
+        template<typename T>
+        void setValue(const ShaderValue<T>& h, const T& v)
+        {
+            writeValue(h, &v, sizeof(T));
+        }
 
-        void autoReflect(const void* data, int data_size, ShaderType st);
+        void setResource(const ShaderResource& h, const UniformBufferPtr& ubo);
+        void setResource(const ShaderResource& h, const StructuredBufferPtr& sbo);
+        void setResource(const ShaderResource& h, const GPUTexture2DPtr& tex, bool as_array = false, bool as_cubemap = false);
+        void setResource(const ShaderResource& h, const Sampler& s);
+
+
+    private:
 
         void selectInputBuffers();
         void selectTopology(PrimTopology pt);
 
         bool isProgramActive() const;
 
-        ID3D11InputLayout* getLayout(const Layout* vertices, const Layout* instances, int step_rate);
+        void resolveValue(const char* name, int size, ShaderValueHandle& h);
+        void writeValue(const ShaderValueHandle& h, const void* data, int size);
+
+        // Where prepareGlobals copied the globals to, for the stages in the mask
+        struct GlobalsRange
+        {
+            uint32_t stages = 0;
+#ifdef EPROJECT_GAPI_D3D11
+            ComPtr<ID3D11Buffer> buffers[6];
+            UINT firstConstant[6] = {};
+            UINT numConstants[6] = {};
+#endif
+        };
+
+        // Copies the globals written since the last draw into the constant ring and binds them
+        void uploadGlobals();
+
+        // The same in two steps. prepareGlobals doesn't flush, so a command buffer copies the globals
+        // of all its draws first and maps the ring once. bindGlobals then makes the draw use its copy.
+        GlobalsRange prepareGlobals();
+        void bindGlobals(const GlobalsRange& range);
+
+#ifdef EPROJECT_GAPI_D3D11
+        void autoReflect(const void* data, int data_size, ShaderType st);
 
         int obtainSlotIdx(SlotKind kind, const std::string& name, const Layout* layout);
-        int findSlot(const char* name);
+        int findSlot(const char* name) const;
+#else
+        void bindResource(SlotKind kind, const ShaderResource& h, const void* resource, const Sampler* sampler = nullptr);
+#endif
 
     private:
 
+        bool m_globals_dirty = false;
+        uint64_t m_globalsFrame = 0;
+
+#ifdef EPROJECT_GAPI_D3D11
         UniformBufferPtr m_ub[6];
-        bool m_globals_dirty;
+        int m_globalsSlot[6] = { -1, -1, -1, -1, -1, -1 };
 
         ID3D10Blob* m_shaderData[6] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
         std::array<std::string, 6> m_shaderCode = { std::string(), std::string(), std::string(), std::string(), std::string(), std::string() };
         ComPtr<ID3D11DeviceChild> m_shaders[6] = { nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+#else
+        struct ValueData
+        {
+            std::string name;
+            int offset;
+            int size;
+        };
+
+        // Packed in resolve order, all in the vertex stage
+        std::vector<ValueData> m_values;
+        std::vector<uint8_t> m_globals;
+#endif
 
         std::vector<ShaderSlot> m_slots;
 
@@ -384,8 +773,15 @@ namespace EProject
         VertexBufferPtr m_selectedInstances;
         int m_selectedInstanceStep;
 
-        std::vector<InputLayoutData> m_layouts;
+        // Vertex input signature in the device input layout cache, 0 without a vertex stage.
+        // The last lookup is kept, rebinding buffers of the same layouts skips the cache.
+        uint64_t m_signature = 0;
+        const Layout* m_inputVertices = nullptr;
+        const Layout* m_inputInstances = nullptr;
+        int m_inputStepRate = 0;
+        InputLayoutCache::Handle m_inputLayout = nullptr;
 
+        std::vector<ShaderInput> m_inputs;
     };
 
     class VertexBuffer : public DeviceHolder
@@ -401,7 +797,11 @@ namespace EProject
         const Layout* getLayout() const;
     private:
         const Layout* m_layout = nullptr;
+#ifdef EPROJECT_GAPI_D3D11
         ComPtr<ID3D11Buffer> m_handle;
+#else
+        std::vector<uint8_t> m_data;
+#endif
         int m_vertCount = 0;
     };
 
@@ -417,7 +817,11 @@ namespace EProject
         int getIndexCount() const;
 
     private:
+#ifdef EPROJECT_GAPI_D3D11
         ComPtr<ID3D11Buffer> m_handle;
+#else
+        std::vector<uint8_t> m_data;
+#endif
         int m_indCount = 0;
     };
 
@@ -437,6 +841,7 @@ namespace EProject
         int getVertexCount() const;
 
     private:
+#ifdef EPROJECT_GAPI_D3D11
         ComPtr<ID3D11ShaderResourceView> getShaderResource();
         ComPtr<ID3D11UnorderedAccessView> getUnorderedAccess();
 
@@ -444,6 +849,9 @@ namespace EProject
         ComPtr<ID3D11Buffer> m_handle;
         ComPtr<ID3D11ShaderResourceView> m_srv;
         ComPtr<ID3D11UnorderedAccessView> m_uav;
+#else
+        std::vector<uint8_t> m_data;
+#endif
         int m_stride = 0;
         int m_vert_count = 0;
         bool m_UAV_access = false;
@@ -482,15 +890,7 @@ namespace EProject
                 m_curr_layout.stride = stride_size;
             }
 
-            auto it = m_cache.find(m_curr_layout);
-
-            if (it == m_cache.end())
-            {
-                m_cache.insert({ m_curr_layout, std::make_unique<Layout>(m_curr_layout) });
-                it = m_cache.find(m_curr_layout);
-            }
-
-            return it->second.get();
+            return internLayout(m_curr_layout);
         }
 
         LayoutSelector* reset()
@@ -501,19 +901,10 @@ namespace EProject
         };
 
     private:
-        struct hash_fn
-        {
-            std::size_t operator() (const Layout& l) const
-            {
-                return l.hash();
-            }
-        };
-
-    private:
-        std::unordered_map<Layout, std::unique_ptr<Layout>, hash_fn> m_cache;
         Layout m_curr_layout;
     };
 
+    // Per thread builder, the layouts it ends in are interned
     LayoutSelector* getLayoutSelector();
 
     class UniformBuffer : public DeviceHolder
@@ -533,7 +924,9 @@ namespace EProject
         void validateDynamicData();
        
         const Layout* getLayout() const;
+#ifdef EPROJECT_GAPI_D3D11
         ComPtr<ID3D11Buffer> getHandle();
+#endif
 
     private:
         void setValue(void* dest, const void* data, int datasize);
@@ -541,12 +934,63 @@ namespace EProject
 
     private:
         std::vector<char> m_data;
+#ifdef EPROJECT_GAPI_D3D11
         ComPtr<ID3D11Buffer> m_handle;
+#endif
         const Layout* m_layout;
         int m_elements_count;
         bool m_dirty = false;
     };
 
+    // Frame-scoped linear allocator for constant data. Everything allocated since the last
+    // flush reaches the GPU with one map, so draws share a buffer and bind it by offset.
+    // Space is only reused once the frames that wrote it can't be in flight anymore.
+    class ConstantRing
+    {
+    public:
+        static constexpr int cAlignment = 256;       // D3D11.1 constant offsets are in 16 x 16 byte steps
+        static constexpr int cFramesInFlight = 3;
+
+        struct Allocation
+        {
+            int offset = 0;
+            int size = 0;
+            void* data = nullptr;
+        };
+
+        ConstantRing(GDevice* device, int capacity);
+
+        // Valid for writing until the next flush
+        Allocation allocate(int size);
+        void flush();
+
+        // Retires the space written cFramesInFlight frames ago
+        void beginFrame();
+
+        uint64_t getFrame() const;
+        int getCapacity() const;
+#ifdef EPROJECT_GAPI_D3D11
+        ID3D11Buffer* getHandle() const;
+#endif
+
+    private:
+        void grow(int min_free);
+        void createBuffer();
+
+    private:
+        GDevice* m_device;
+        std::vector<uint8_t> m_shadow;
+        int m_head = 0;
+        int m_flushed = 0;
+        int m_used = 0;
+        uint64_t m_frame = 1;
+        std::array<int, cFramesInFlight> m_frameBytes = {};
+#ifdef EPROJECT_GAPI_D3D11
+        ComPtr<ID3D11Buffer> m_handle;
+        bool m_discard = true;
+#endif
+    };
+
     class GPUTexture2D : public DeviceHolder 
     {
         friend class Framebuffer;
@@ -565,7 +1009,9 @@ namespace EProject
 
         void readBack(void* data, int mip, int array_slice);
     
+#ifdef EPROJECT_GAPI_D3D11
         ID3D11ShaderResourceView* _getShaderResView(bool as_array, bool as_cubemap);
+#endif
     private:
         struct ivec3_hasher
         {
@@ -584,6 +1030,7 @@ namespace EProject
         };
 
     private:
+#ifdef EPROJECT_GAPI_D3D11
         ComPtr<ID3D11RenderTargetView> buildRenderTarget(int mip, int slice_start, int slice_count) const;
         ComPtr<ID3D11DepthStencilView> buildDepthStencil(int mip, int slice_start, int slice_count, bool read_only) const;
         ComPtr<ID3D11ShaderResourceView> getShaderResource(bool as_array, bool as_cubemap);
@@ -596,6 +1043,10 @@ namespace EProject
         ComPtr<ID3D11ShaderResourceView> m_srv[4];
 
         std::unordered_map<glm::ivec3, ComPtr<ID3D11UnorderedAccessView>, ivec3_hasher> m_uav;
+#else
+        // slice * m_mips_count + mip
+        std::vector<std::vector<uint8_t>> m_levels;
+#endif
         
         TextureFmt m_fmt;
         glm::ivec2 m_size;
@@ -603,12 +1054,27 @@ namespace EProject
         int m_mips_count;
     };
 
-    static int getPixelsSize(TextureFmt fmt);    
+    int getPixelsSize(TextureFmt fmt);    
+
+    // Bytes of a 4x4 block for compressed formats, 0 otherwise
+    int getBlockSize(TextureFmt fmt);
+
+    // Bytes of a pixel row, or of a row of 4x4 blocks for compressed formats
+    int getRowPitch(TextureFmt fmt, int width);
+    int getSlicePitch(TextureFmt fmt, glm::ivec2 size);
 
     class Framebuffer : public DeviceHolder
     {
         friend class GDevice;
     private:
+#ifdef EPROJECT_GAPI_D3D11
+        static constexpr int cColorSlots = D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT;
+        static constexpr int cUAVSlots = D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT + D3D11_PS_CS_UAV_REGISTER_COUNT;
+#else
+        static constexpr int cColorSlots = 8;
+        static constexpr int cUAVSlots = 16;
+#endif
+
         struct Tex2DParams
         {
             int mip;
@@ -628,7 +1094,9 @@ namespace EProject
             GPUTexture2DPtr tex;
             Tex2DParams tex_params;
             StructuredBufferPtr buf;
+#ifdef EPROJECT_GAPI_D3D11
             ComPtr<ID3D11UnorderedAccessView> view;
+#endif
             int initial_counter;
             
             UAVSlot()
@@ -686,20 +1154,22 @@ namespace EProject
         void prepareSlots();
     private:
         
-        GPUTexture2DPtr m_tex[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+        GPUTexture2DPtr m_tex[cColorSlots];
         GPUTexture2DPtr m_depth;
 
-        Tex2DParams m_tex_params[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+        Tex2DParams m_tex_params[cColorSlots];
         Tex2DParams m_depth_params;
 
-        UAVSlot m_uav[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT + D3D11_PS_CS_UAV_REGISTER_COUNT];
+        UAVSlot m_uav[cUAVSlots];
 
-        ComPtr<ID3D11RenderTargetView> m_color_views[D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT];
+#ifdef EPROJECT_GAPI_D3D11
+        ComPtr<ID3D11RenderTargetView> m_color_views[cColorSlots];
         ComPtr<ID3D11DepthStencilView> m_depth_view;
 
         std::vector<ID3D11RenderTargetView*> m_colors_to_bind;
         std::vector<ID3D11UnorderedAccessView*> m_uav_to_bind;
         std::vector<UINT> m_uav_initial_counts;
+#endif
 
         glm::ivec2 m_size;
         int m_rtv_count = 0;
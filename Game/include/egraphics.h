@@ -3,9 +3,12 @@
 #include "emath.h"
 #include "egapi.h"
 #include "eutils.h"
+#include "graphics/erenderqueue.h"
 
 #include <world/ecomponents.h>
 
+#include <future>
+
 namespace EProject
 {
     struct VertexPosColor
@@ -73,6 +76,28 @@ namespace EProject
 
     };
 
+    // Builds a program again on the job system when one of its files or includes changes.
+    // The new program takes over at the start of a frame, a failed compile keeps the old one.
+    class ShaderHotReload
+    {
+    public:
+        void watch(const ShaderProgramPtr& program, AssetManager& mng);
+
+        // The rebuilt program once it's ready, nullptr otherwise
+        ShaderProgramPtr update();
+
+    private:
+        void addDependencies();
+        void recompile();
+
+    private:
+        ShaderProgramPtr m_program;
+        AssetManager* m_mng = nullptr;
+
+        std::future<ShaderProgramPtr> m_pending;
+        bool m_queued = false;
+    };
+
     class Render2D : public DeviceHolder
     {
     public:
@@ -85,6 +110,9 @@ namespace EProject
         void setTextureLayer(int index);
         void markDirty();
 
+        // Swaps in hot reloaded shaders, call before drawing a frame
+        void updateShaders();
+
         void drawQuad(const glm::vec3& _pos, const glm::vec4& _color);
         void drawQuad(const glm::vec2& _pos, const glm::vec3& _color);
         void drawQuad(const glm::vec2& _pos);
@@ -100,6 +128,8 @@ namespace EProject
         void createBaseShader();
         void createShaderSemantics();
 
+        GPUTexture2DPtr createSpriteTexture(const Asset<Texture2D>& tex);
+
     private:
 
         static constexpr size_t batchCount = 1024;
@@ -108,7 +138,11 @@ namespace EProject
         IndexBufferPtr m_ib;
 
         ShaderProgramPtr m_triangle;
+        ShaderHotReload m_triangleReload;
         StructuredBufferPtr m_sb;
+
+        std::filesystem::path m_spritePath;
+        GPUTexture2DPtr m_spriteTex;
     
         const Layout* m_posColorLayout = nullptr;
         const Layout* m_posTextureLayout = nullptr;
@@ -118,6 +152,12 @@ namespace EProject
 
         //std::vector<VertexPosColor> m_vertexQuadBatch = {};
         std::vector<VertexPosTex> m_vertexQuadBatch = {};
+
+        // Quads are blended, they go to the GPU back to front
+        std::vector<SortItem> m_quadOrder;
+        std::vector<SortItem> m_sortScratch;
+        std::vector<uint32_t> m_sortHistograms;
+        std::vector<VertexPosTex> m_sortedQuads;
         std::vector<int> m_indexBuffer = {};
     
         int m_numVert = 0;
@@ -137,25 +177,121 @@ namespace EProject
 
         void setGeometryPass(const DirectLightComponent& dirLight);
 
+        // Grouped by renderable, each group is culled and queued as instanced draws when the
+        // geometry pass changes or on submit
         void drawMeshModel(const StaticMeshComponent& mshPtr, const TransformComponent& trs);
         void drawMeshModel(const SkinnedMeshComponent& mshPtr, const TransformComponent& trs);
 
+        void submit();
+
+        using FrameStats = RenderQueue::Stats;
+
+        void resetFrameStats() { m_frameStats = {}; }
+        const FrameStats& getFrameStats() const { return m_frameStats; }
+
+        // Swaps in hot reloaded shaders, call before drawing a frame
+        void updateShaders();
+
     private:
+        static constexpr uint32_t cOpaquePass = 0;
+        static constexpr size_t cInstancesPerTask = 1024;
+
+        struct DrawBatch
+        {
+            uint32_t material;
+            size_t first;
+            size_t count;
+        };
+
+        struct InstanceEntry
+        {
+            glm::mat4 model;    // column major
+            float maxScale;
+            bool uniformScale;
+        };
+
+        // Entities of one geometry pass sharing a renderable
+        struct InstanceGroup
+        {
+            const StaticMeshRenderable* renderable;
+            std::vector<InstanceEntry> instances;
+        };
+
+        // A range of a group's instances, culled on the job system. A lone entity is one
+        // task culled per cluster.
+        struct CullTask
+        {
+            uint32_t group;
+            size_t first;
+            size_t count;
+        };
+
+        struct CullView
+        {
+            glm::mat4 viewProj;     // column major
+            Frustum frustum;
+            glm::vec3 camPos;
+        };
+
+        // What a task leaves to queue, kept across frames for the memory
+        struct CullResult
+        {
+            std::vector<glm::mat4> instances;   // transposed
+            std::vector<DrawIndexedCmd> drawCmds;
+            std::vector<DrawBatch> drawBatches;
+            float depth;
+        };
+
+        struct PBRParams
+        {
+            ShaderValue<glm::mat4> viewProjectionMatrix;
+            ShaderValue<uint32_t> instanceBase;
+            ShaderValue<glm::vec3> cameraPos;
+            ShaderValue<glm::vec3> lightPositions;
+            ShaderValue<glm::vec3> lightColours;
+
+            ShaderResource albedoTexture;
+            ShaderResource normalTexture;
+            ShaderResource metallRoghnessTexture;
+            ShaderResource samplerDefault;
+            ShaderResource instances;
+        };
+
 
         void createPBRShader();
         void createShaderSemantics();
         void drawMesh();
 
+        void flushInstances();
+        void cull(const CullTask& task, const CullView& view, CullResult& out) const;
+        void queueClusters(const StaticMeshRenderable& mdl, const CullResult& result);
+        void queueInstances(const StaticMeshRenderable& mdl, size_t firstResult, size_t lastResult);
+        uint32_t addInstanceConstants(uint32_t instanceBase);
+        uint32_t addMaterial(const StaticMeshRenderable& mdl, uint32_t materialId);
+
     private:
 
         ShaderProgramPtr m_pbr;
-        StructuredBufferPtr m_sb;
+        ShaderHotReload m_pbrReload;
 
         std::shared_ptr<AssetManager> m_mng;
         Camera3DPtr m_cam3DPtr;
 
         DirectLightComponent m_dirLight;
 
-        std::unordered_map<const char*, const char*> m_shaderSemanticsc;
+        std::vector<InstanceGroup> m_groups;
+        std::unordered_map<const StaticMeshRenderable*, uint32_t> m_groupIds;
+
+        std::vector<CullTask> m_cullTasks;
+        std::vector<CullResult> m_cullResults;
+
+        // Transposed model matrices of every queued instance, uploaded once on submit
+        std::vector<glm::mat4> m_instanceData;
+        StructuredBufferPtr m_instanceBuffer;
+
+        RenderQueue m_queue;
+        FrameStats m_frameStats;
+
+        PBRParams m_pbrParams;
     };
 }
@@ -113,9 +113,71 @@ namespace EProject
 
     struct Plane
     {
+        glm::vec3 m_normal = { 0.0f, 1.0f, 0.0f };
+        float m_dist = 0.0f;
 
+        Plane() = default;
+        explicit Plane(const glm::vec4& v) : m_normal(v.xyz()), m_dist(v.w) {}
+
+        inline float distance(const glm::vec3& p) const
+        {
+            return glm::dot(m_normal, p) + m_dist;
+        }
+
+        inline void normalize()
+        {
+            const float len = glm::length(m_normal);
+            if (len > 0.0f)
+            {
+                m_normal /= len;
+                m_dist /= len;
+            }
+        }
     };
 
+    struct Frustum
+    {
+        enum { Left = 0, Right, Bottom, Top, Near, Far, Count };
+
+        Plane m_planes[Count];
 
+        // Planes of the clip space volume of a D3D style (0..w depth) matrix.
+        // Pass proj * view * model to get the planes in model space.
+        static Frustum fromMatrix(const glm::mat4& m)
+        {
+            const glm::vec4 r0 = glm::row(m, 0);
+            const glm::vec4 r1 = glm::row(m, 1);
+            const glm::vec4 r2 = glm::row(m, 2);
+            const glm::vec4 r3 = glm::row(m, 3);
+
+            Frustum res = {};
+            res.m_planes[Left] = Plane(r3 + r0);
+            res.m_planes[Right] = Plane(r3 - r0);
+            res.m_planes[Bottom] = Plane(r3 + r1);
+            res.m_planes[Top] = Plane(r3 - r1);
+            res.m_planes[Near] = Plane(r2);
+            res.m_planes[Far] = Plane(r3 - r2);
+
+            for (auto& p : res.m_planes)
+            {
+                p.normalize();
+            }
+
+            return res;
+        }
+
+        inline bool intersects(const glm::vec3& center, float radius) const
+        {
+            for (const auto& p : m_planes)
+            {
+                if (p.distance(center) < -radius)
+                {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+    };
 
 }
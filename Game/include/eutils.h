@@ -2,9 +2,17 @@
 
 #include "egapi.h"
 #include "emath.h"
+#include "graphics/eimage.h"
+#include "utils/efilewatcher.h"
+#include "utils/ejobsystem.h"
+#include "utils/evfs.h"
 
 #include <unordered_map>
 #include <filesystem>
+#include <iosfwd>
+#include <queue>
+#include <typeindex>
+#include <unordered_set>
 
 namespace EProject
 {
@@ -32,7 +40,7 @@ namespace EProject
 #ifdef _WIN32
             _wfopen_s(&m_f, m_path.wstring().c_str(), write ? L"wb" : L"rb");
 #else
-            fopen_s(&m_f, m_path.string().c_str(), write ? L"wb" : L"rb");
+            m_f = fopen(m_path.string().c_str(), write ? "wb" : "rb");
 #endif
         }
 
@@ -200,9 +208,13 @@ namespace EProject
     public:
 
         static std::filesystem::path getDataDir();
+        static std::filesystem::path getDataArchive();
         static std::filesystem::path getShadersDir();
         static std::filesystem::path getTexturesDir();
         static std::filesystem::path getModelsDir();
+
+        // Written by the game, safe to delete
+        static std::filesystem::path getCacheDir();
     };
 
     class IAsset
@@ -212,20 +224,40 @@ namespace EProject
         IAsset(const std::filesystem::path& p);
         virtual ~IAsset() = default;
 
+        // CPU setup after load(), on the decoding worker for async loads
         virtual void init() = 0;
 
+        // Optional IO stage of an async load, runs on the IO thread before load()
+        virtual bool read() { return true; }
+
         virtual bool load(const GDevicePtr& _ptr) = 0;
         virtual bool unload() = 0;
         
+        // CPU bytes held by the loaded data
+        virtual size_t getMemoryUsage() const { return 0; }
+
+        // Hash of the source payload, assets of one type with equal hashes are folded into one
+        // instance. 0 opts out.
+        uint64_t getContentHash() const { return m_contentHash; }
+        void setContentHash(uint64_t hash) { m_contentHash = hash; }
+
+        const std::filesystem::path& getPath() const { return m_path; }
+
         const std::string& getTag() const { return m_tag; }
         std::string& getTag() { return m_tag; }
  
         bool isValid() const { return m_valid; }
 
+        void touch(uint64_t frame) { m_lastUsed.store(frame, std::memory_order_relaxed); }
+        uint64_t getLastUsed() const { return m_lastUsed.load(std::memory_order_relaxed); }
+
     protected:
         std::string m_tag = "";
         std::filesystem::path m_path;
         bool m_valid = false;
+        uint64_t m_contentHash = 0;
+
+        std::atomic<uint64_t> m_lastUsed = 0;
     };
 
     struct PathKey
@@ -250,52 +282,417 @@ namespace EProject
 
         void init() override;
 
+        bool read() override;
         bool load(const GDevicePtr& _ptr) override;
         bool unload() override;
 
+        // Takes pixels decoded elsewhere, e.g. by a batch decode
+        bool setImage(DecodedImage&& image);
+
+        size_t getMemoryUsage() const override;
+
         TextureFmt  getFormat() const { return m_fmt; }
         glm::ivec2  getSize()   const { return m_size; }
         const void* getData()   const;
 
     private:
+        FileView m_file;
         stbi_uc* m_data = nullptr;
         TextureFmt m_fmt = TextureFmt::RGBA8;
         glm::ivec2 m_size = glm::ivec2(0);
+        size_t m_byteSize = 0;
     };
 
     template<typename T>
     using Asset = std::shared_ptr<T>;
 
+    enum class AssetState
+    {
+        Queued,
+        Loading,
+        Ready,
+        Failed
+    };
+
+    struct AssetRequest
+    {
+        PathKey key;
+        float priority = 0.0f;
+        uint64_t order = 0;
+
+        std::shared_ptr<IAsset> asset;
+        std::atomic<AssetState> state = AssetState::Queued;
+        std::string error;
+
+        // The asset is an already loaded one with the same content
+        bool shared = false;
+
+        // Hot reload of a changed file, replaces the cached asset once done
+        bool reload = false;
+
+        // Main thread only
+        std::vector<std::function<void(const std::shared_ptr<IAsset>&)>> callbacks;
+    };
+
+    using AssetRequestPtr = std::shared_ptr<AssetRequest>;
+
+    template<typename T>
+    class AssetHandle
+    {
+    public:
+        AssetHandle() = default;
+        explicit AssetHandle(AssetRequestPtr request) : m_request(std::move(request)) {}
+
+        bool isValid() const { return m_request != nullptr; }
+        bool isReady() const { return m_request && m_request->state == AssetState::Ready; }
+        bool isFailed() const { return m_request && m_request->state == AssetState::Failed; }
+
+        AssetState getState() const { return m_request ? m_request->state.load() : AssetState::Failed; }
+
+        Asset<T> get() const { return isReady() ? std::static_pointer_cast<T>(m_request->asset) : nullptr; }
+
+    private:
+        AssetRequestPtr m_request;
+    };
+
+    // Sharded asset cache. A hit reads the shard's immutable snapshot through an atomic pointer and
+    // writes only its thread's reader slot, so lookups take no lock and share no written cache line.
+    // Writers lock the shard, publish a copy and free old snapshots once no reader can still see them.
+    class AssetCache final
+    {
+    public:
+        static constexpr size_t cShardsCount = 16;
+        static constexpr size_t cReadersCount = 64;
+
+        struct Stats
+        {
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t joins = 0;
+        };
+
+        AssetCache();
+        ~AssetCache();
+
+        AssetCache(const AssetCache&) = delete;
+        AssetCache& operator=(const AssetCache&) = delete;
+
+        std::shared_ptr<IAsset> find(const PathKey& key) const;
+
+        // Keeps the already cached asset if there is one and returns it
+        std::shared_ptr<IAsset> insert(const PathKey& key, const std::shared_ptr<IAsset>& asset);
+
+        // Runs loader once per key, concurrent callers wait for the same result (or exception)
+        std::shared_ptr<IAsset> getOrLoad(const PathKey& key, const std::function<std::shared_ptr<IAsset>()>& loader);
+
+        // The same for loads that don't fit one loader call, like a batch decode. beginLoad claims the
+        // key and returns false if it's cached or already loading. Every claimed key must be finished
+        // with endLoad (returns the cached instance) or failLoad, getOrLoad callers wait until then.
+        bool beginLoad(const PathKey& key);
+        std::shared_ptr<IAsset> endLoad(const PathKey& key, const std::shared_ptr<IAsset>& asset);
+        void failLoad(const PathKey& key, std::exception_ptr error);
+
+        // Drops the entry only if asset is still the cached one
+        bool erase(const PathKey& key, const std::shared_ptr<IAsset>& asset);
+
+        // Swaps in asset, holders of the old one keep it until they let go
+        void replace(const PathKey& key, const std::shared_ptr<IAsset>& asset);
+
+        // func runs under the shard lock and must not call back into the cache. Snapshots nobody reads
+        // anymore are freed first, so use_count sees the cache's own references and the callers' ones
+        void forEach(const std::function<void(const PathKey&, const std::shared_ptr<IAsset>&)>& func) const;
+
+        size_t size() const;
+        Stats getStats() const;
+
+    private:
+        using Map = std::unordered_map<PathKey, std::shared_ptr<IAsset>, PathKey>;
+        using InFlight = std::shared_future<std::shared_ptr<IAsset>>;
+
+        struct Loading
+        {
+            std::promise<std::shared_ptr<IAsset>> promise;
+            InFlight result;
+        };
+
+        struct Retired
+        {
+            const Map* map = nullptr;
+            uint64_t epoch = 0;
+        };
+
+        struct alignas(64) Shard
+        {
+            std::atomic<const Map*> assets = nullptr;
+
+            // Writers only
+            std::mutex mutex;
+            std::vector<Retired> retired;
+            std::unordered_map<PathKey, Loading, PathKey> inFlight;
+        };
+
+        // Owned by one thread. epoch is the cache epoch it saw when its lookup started, 0 outside one
+        struct alignas(64) Reader
+        {
+            std::atomic<uint64_t> epoch = 0;
+            std::atomic<uint64_t> hits = 0;
+            std::atomic<bool> claimed = false;
+        };
+
+        Shard& getShard(const PathKey& key) const;
+        Reader* getReader() const;
+
+        // Lock free unless this thread found no free reader slot
+        std::shared_ptr<IAsset> lookup(Shard& shard, const PathKey& key, bool hit) const;
+
+        // Called with the shard mutex held. publish swaps in map and retires the current one
+        void publish(Shard& shard, const Map* map) const;
+        void reclaim(Shard& shard) const;
+
+        // Caches asset unless error is set, and wakes the callers waiting for the key
+        std::shared_ptr<IAsset> finishLoad(const PathKey& key, std::shared_ptr<IAsset> asset, std::exception_ptr error);
+
+    private:
+        const uint64_t m_id;
+
+        mutable Shard m_shards[cShardsCount];
+        mutable Reader m_readers[cReadersCount];
+
+        // Bumped on every publish, readers only load it
+        mutable std::atomic<uint64_t> m_epoch = 1;
+
+        // Counts hits of threads without a reader slot
+        mutable std::atomic<uint64_t> m_lockedHits = 0;
+
+        // Misses and joins run a load or wait for one, a shared counter costs nothing there
+        std::atomic<uint64_t> m_misses = 0;
+        std::atomic<uint64_t> m_joins = 0;
+    };
+
     class AssetManager final
     {
     public:
+        using ReloadListener = std::function<void(const std::filesystem::path&, const std::shared_ptr<IAsset>&)>;
 
         explicit AssetManager(const GDevicePtr& _ptr);
+        ~AssetManager();
+
+        AssetManager(const AssetManager&) = delete;
+        AssetManager& operator=(const AssetManager&) = delete;
+
+        // Queues the asset and returns right away. Higher priority loads first.
+        // The callback runs on the main thread from update(), or immediately if the asset is cached.
+        // A failed load calls it with nullptr.
+        template<typename T>
+        AssetHandle<T> loadAsync(const std::filesystem::path& _pathKey, float priority = 0.0f, std::function<void(const Asset<T>&)> onLoaded = {})
+        {
+            static_assert(std::is_base_of<IAsset, T>::value, "AssetManager: Asset not from base IAsset class!");
+
+            std::function<void(const std::shared_ptr<IAsset>&)> callback;
+            if (onLoaded)
+            {
+                callback = [onLoaded = std::move(onLoaded)](const std::shared_ptr<IAsset>& asset) { onLoaded(std::static_pointer_cast<T>(asset)); };
+            }
+
+            return AssetHandle<T>(queueRequest(_pathKey, priority, std::move(callback), [](const std::filesystem::path& p) { return std::make_shared<T>(p); }));
+        }
+
+        // Finishes completed async loads: caching and callbacks, init() already ran with the decode. Call once
+        // per frame on the main thread. A callback that throws fails its request instead of escaping.
+        // Also where hot reloaded assets are swapped in.
+        void update();
+
+        // Files changed under dir are read loose and reloaded in the background
+        void watch(const std::filesystem::path& dir);
 
+        // A change of dependency reloads dependent as well, e.g. a shader and its includes
+        void addDependency(const std::filesystem::path& dependent, const std::filesystem::path& dependency);
+
+        // Runs on the main thread for every changed file (and its dependents) once its new asset is
+        // in the cache. Files the cache doesn't hold, like shaders, come with nullptr.
+        void addReloadListener(ReloadListener listener);
+
+        size_t getPendingCount() const { return m_pending.size(); }
+
+        // Budget of CPU memory for one asset type, 0 means unlimited
+        template<typename T>
+        void setBudget(size_t bytes)
+        {
+            std::lock_guard<std::mutex> lock(m_budgetMutex);
+            m_budgets[std::type_index(typeid(T))] = bytes;
+        }
+
+        template<typename T>
+        size_t getMemoryUsage() const
+        {
+            const std::type_index type(typeid(T));
+            size_t bytes = 0;
+
+            // Aliases of shared content are counted once
+            std::unordered_set<const IAsset*> counted;
+
+            m_cache.forEach([&bytes, &type, &counted](const PathKey&, const std::shared_ptr<IAsset>& asset)
+            {
+                if (std::type_index(typeid(*asset)) == type && counted.insert(asset.get()).second)
+                {
+                    bytes += asset->getMemoryUsage();
+                }
+            });
+
+            return bytes;
+        }
+
+        // Evicts least recently used assets nobody references until every type fits its budget.
+        // Evicted assets load again on the next request. Returns the number of freed bytes.
+        size_t collectGarbage();
+
+        // Thread safe, concurrent requests for the same asset share one load
         template<typename T>
         Asset<T> getAsset(const std::filesystem::path& _pathKey)
         {
             static_assert(std::is_base_of<IAsset, T>::value, "AssetManager: Asset not from base IAsset class!");
 
-            auto it = m_cache.find(_pathKey);
-            if (it == m_cache.end())
+            auto asset = m_cache.getOrLoad(PathKey(_pathKey), [this, &_pathKey]() -> std::shared_ptr<IAsset>
             {
-                auto result = std::make_unique<T>(_pathKey);
-                bool loaded = result->load(m_ptr);               
+                registerFactory(typeid(T), [](const std::filesystem::path& p) { return std::make_shared<T>(p); });
+
+                auto result = std::make_shared<T>(_pathKey);
 
-                if (loaded)
+                // A byte identical file loaded under another path is returned instead
+                if (result->read())
                 {
-                    result->init();
-                    it = m_cache.insert({ std::move(_pathKey), std::move(result) }).first;
-                }                                              
+                    if (auto shared = findByContent(PathKey(_pathKey), result->getContentHash(), typeid(T)))
+                    {
+                        return shared;
+                    }
+                }
+
+                if (!result->load(m_ptr))
+                {
+                    return nullptr;
+                }
+
+                result->init();
+                return registerContent(PathKey(_pathKey), result);
+            });
+
+            if (asset)
+            {
+                asset->touch(m_frame.load(std::memory_order_relaxed));
             }
 
-            return std::static_pointer_cast<T>(it->second);
+            return std::static_pointer_cast<T>(asset);
+        }
+
+        // Loads the assets concurrently on the job system. The caller takes part in the loads,
+        // so this is safe to call from inside a job.
+        template<typename T>
+        std::vector<Asset<T>> getAssets(const std::vector<std::filesystem::path>& paths)
+        {
+            std::vector<Asset<T>> result(paths.size());
+
+            getJobSystem()->parallelFor(paths.size(), [this, &paths, &result](size_t i)
+            {
+                result[i] = getAsset<T>(paths[i]);
+            });
+
+            return result;
         }
 
+        // Reads the uncached textures and decodes them in one batch on all cores
+        std::vector<Asset<Texture2D>> getTextures(const std::vector<std::filesystem::path>& paths);
+
+        const AssetCache& getCache() const { return m_cache; }
+
+        struct SharedContent
+        {
+            PathKey owner;
+            std::vector<PathKey> aliases;
+            size_t reclaimedBytes = 0;
+        };
+
+        // Every loaded payload referenced by more than one path
+        std::vector<SharedContent> getSharedContent() const;
+
+        // Reclaimed memory per scene (the folder of the aliased files)
+        void printSharedContent(std::ostream& out) const;
+
     private:
-        std::unordered_map<PathKey, std::shared_ptr<IAsset>, PathKey> m_cache;
+        using AssetFactory = std::function<std::shared_ptr<IAsset>(const std::filesystem::path&)>;
+
+        struct RequestCompare
+        {
+            bool operator()(const AssetRequestPtr& a, const AssetRequestPtr& b) const
+            {
+                return a->priority != b->priority ? a->priority < b->priority : a->order > b->order;
+            }
+        };
+
+        // Shared with the decode jobs, so they never touch a destroyed manager
+        struct CompletionQueue
+        {
+            std::mutex mutex;
+            std::vector<AssetRequestPtr> requests;
+        };
+
+        struct ContentEntry
+        {
+            std::weak_ptr<IAsset> asset;
+            PathKey owner;
+            std::vector<PathKey> aliases;
+        };
+
+        AssetRequestPtr queueRequest(const std::filesystem::path& path, float priority, std::function<void(const std::shared_ptr<IAsset>&)>&& callback, const AssetFactory& factory);
+        void pushRequest(const AssetRequestPtr& request);
+        void ioLoop();
+
+        // Remembers how to create assets of a type again for hot reload
+        void registerFactory(const std::type_index& type, const AssetFactory& factory);
+
+        // Polls the watcher and queues reloads of the changed files and their dependents
+        void reloadChanged();
+        void notifyReload(const std::filesystem::path& path, const std::shared_ptr<IAsset>& asset);
+
+        // Live asset of the same type and content loaded under another path, key becomes its alias
+        std::shared_ptr<IAsset> findByContent(const PathKey& key, uint64_t hash, const std::type_index& type);
+
+        // Same as findByContent, without a match asset becomes the owner of its content
+        std::shared_ptr<IAsset> registerContent(const PathKey& key, const std::shared_ptr<IAsset>& asset);
+
+        // Batch decode of the keys getTextures claimed, fills their result slots
+        void loadTextures(const std::vector<std::filesystem::path>& paths, const std::vector<size_t>& missing, std::vector<Asset<Texture2D>>& result);
+
+    private:
+        AssetCache m_cache;
         GDevicePtr m_ptr;
+
+        std::atomic<uint64_t> m_frame = 0;
+
+        std::unordered_map<std::type_index, size_t> m_budgets;
+        std::mutex m_budgetMutex;
+
+        std::unordered_map<uint64_t, ContentEntry> m_content;
+        mutable std::mutex m_contentMutex;
+
+        std::unordered_map<std::type_index, AssetFactory> m_factories;
+        std::mutex m_factoryMutex;
+
+        // Main thread only, paths are normalized
+        std::unique_ptr<FileWatcher> m_watcher;
+        std::unordered_map<PathKey, std::vector<PathKey>, PathKey> m_dependents;
+        std::vector<ReloadListener> m_reloadListeners;
+
+        // Main thread only
+        std::unordered_map<PathKey, AssetRequestPtr, PathKey> m_pending;
+        uint64_t m_requestCounter = 0;
+
+        std::priority_queue<AssetRequestPtr, std::vector<AssetRequestPtr>, RequestCompare> m_ioQueue;
+        std::mutex m_ioMutex;
+        std::condition_variable m_ioCv;
+        bool m_ioStop = false;
+        std::thread m_ioThread;
+
+        std::shared_ptr<CompletionQueue> m_completed;
     };
 
     using AssetManagerPtr = std::shared_ptr<AssetManager>;
@@ -7,6 +7,7 @@
 #define NOMINMAX
 #include <windows.h>
 #include <eheader.h>
+#include <chrono>
 
 namespace EProject
 {
@@ -79,6 +80,10 @@ namespace EProject
         World m_world;
 
         float m_zoom = 60.0f;
+
+        std::chrono::high_resolution_clock::time_point m_current;
+        std::chrono::high_resolution_clock::time_point m_last;
+        std::chrono::duration<float> m_deltaTime;
     };
 
     void MessageLoop(const std::function<void()> idle_proc);
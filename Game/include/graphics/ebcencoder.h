@@ -0,0 +1,42 @@
+#pragma once
+
+#include "egapi.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace EProject
+{
+    enum class BCQuality
+    {
+        Fast,   // bounding box endpoints
+        Normal, // principal axis endpoints
+        High    // principal axis plus least squares refinement, tries every BC7 p-bit pair
+    };
+
+    // CPU encoder for the block compressed formats. Blocks are independent, so rows of
+    // blocks are spread over the job system and palette fitting uses SSE where available.
+    // BC7 is written in mode 6 only (one subset, RGBA, 4 bit indices).
+    class BCEncoder
+    {
+    public:
+        static bool isSupported(TextureFmt fmt);
+
+        // Bytes of a 4x4 block, 0 for formats the encoder doesn't write
+        static size_t getBlockBytes(TextureFmt fmt);
+        static size_t getEncodedSize(TextureFmt fmt, glm::ivec2 size);
+
+        // Picks by content: BC4 for grey masks, BC5 for tangent space normal maps,
+        // BC3 when there is alpha and BC1 otherwise. sRGB textures never get BC4/BC5.
+        static TextureFmt chooseFormat(const uint8_t* rgba, glm::ivec2 size, bool srgb);
+
+        // rgba: 4 bytes per pixel. Partial edge blocks repeat the last row and column.
+        static std::vector<uint8_t> encode(const uint8_t* rgba, glm::ivec2 size, TextureFmt fmt, BCQuality quality);
+
+        // Back to 4 bytes per pixel, missing channels are 0 and alpha 255
+        static std::vector<uint8_t> decode(const uint8_t* blocks, glm::ivec2 size, TextureFmt fmt);
+
+        // Over the channels the format stores, infinity for identical images
+        static double computePSNR(const uint8_t* a, const uint8_t* b, glm::ivec2 size, TextureFmt fmt);
+    };
+}
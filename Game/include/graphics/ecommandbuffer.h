@@ -0,0 +1,123 @@
+#pragma once
+
+#include "egapi.h"
+
+#include <functional>
+#include <vector>
+
+namespace EProject
+{
+    class JobSystem;
+
+    struct RenderStates
+    {
+        bool depthEnable = true;
+        bool depthWrite = true;
+        CullMode cull = CullMode::Back;
+        bool blend = false;
+        Blend src = Blend::One;
+        Blend dst = Blend::Zero;
+
+        bool operator==(const RenderStates& s) const
+        {
+            return depthEnable == s.depthEnable && depthWrite == s.depthWrite && cull == s.cull &&
+                   blend == s.blend && src == s.src && dst == s.dst;
+        }
+    };
+
+    // Draw, bind, state and upload commands packed into one linear buffer. Recording touches
+    // nothing but the buffer, so any thread can record its own; submit replays it through the
+    // device on the render thread. Resources are held until reset, values and uploads are
+    // copied in. Handles belong to the program set before them.
+    class CommandBuffer
+    {
+    public:
+        CommandBuffer() = default;
+
+        void setProgram(ShaderProgram* program);
+        void setStates(const RenderStates& states);
+
+        template<typename T>
+        void setValue(const ShaderValue<T>& h, const T& v)
+        {
+            writeValue(h, &v, sizeof(T));
+        }
+        void writeValue(const ShaderValueHandle& h, const void* data, int size);
+
+        void setResource(const ShaderResource& h, const GPUTexture2DPtr& tex);
+        void setResource(const ShaderResource& h, const Sampler& s);
+        void setInputBuffers(const VertexBufferPtr& vbo, const IndexBufferPtr& ibo, const VertexBufferPtr& instances = nullptr, int instanceStepRate = 0);
+
+        void uploadVertices(const VertexBufferPtr& vbo, int start_vertex, int num_vertices, const void* data);
+        void uploadUniforms(const UniformBufferPtr& ubo, int start_element, int num_elements, const void* data);
+
+        void draw(PrimTopology pt, int vert_start, int vert_count, int instance_count = -1, int base_instance = 0);
+        void drawIndexed(PrimTopology pt, int index_start, int index_count, int instance_count = -1, int base_vertex = 0, int base_instance = 0);
+
+        void submit(GDevice& device) const;
+
+        // Replays count buffers in order, their constants reach the GPU with one flush
+        static void submit(GDevice& device, const CommandBuffer* buffers, size_t count);
+
+        // Keeps the memory for the next recording
+        void reset();
+
+        size_t getCommandCount() const { return m_count; }
+        size_t getSizeBytes() const { return m_data.size(); }
+
+    private:
+        enum class CommandType : uint32_t
+        {
+            SetProgram, SetStates, SetValue, SetTexture, SetSampler, SetInputBuffers,
+            UploadVertices, UploadUniforms, Draw, DrawIndexed,
+        };
+
+        // Every command starts 8 byte aligned, size includes the header and inline data
+        struct CommandHeader
+        {
+            CommandType type;
+            uint32_t size;
+        };
+
+        template<typename T>
+        void push(CommandType type, const T& cmd, const void* extra = nullptr, size_t extraSize = 0);
+
+        template<typename T>
+        uint32_t hold(std::vector<T>& table, const T& object);
+
+        // The two passes of submit: writing values and copying the globals of every draw,
+        // then the replay, which binds each draw's copy instead of the values
+        void prepareGlobals(std::vector<ShaderProgram::GlobalsRange>& globals) const;
+        void replay(GDevice& device, const std::vector<ShaderProgram::GlobalsRange>& globals, size_t& draw) const;
+
+    private:
+        std::vector<uint8_t> m_data;
+        size_t m_count = 0;
+
+        std::vector<GPUTexture2DPtr> m_textures;
+        std::vector<VertexBufferPtr> m_vertexBuffers;
+        std::vector<IndexBufferPtr> m_indexBuffers;
+        std::vector<UniformBufferPtr> m_uniformBuffers;
+    };
+
+    // Records [0, count) in fixed chunks on the job system, chunk i into buffer i. The split
+    // doesn't depend on which thread ran what, so submit replays the same order every time.
+    class ParallelRecorder
+    {
+    public:
+        explicit ParallelRecorder(JobSystem* jobs = nullptr);
+
+        void record(size_t count, size_t chunkSize, const std::function<void(size_t first, size_t last, CommandBuffer& cb)>& func);
+        void submit(GDevice& device) const;
+
+        // Drops what the buffers hold, keeps their memory
+        void reset();
+
+        const std::vector<CommandBuffer>& getBuffers() const { return m_buffers; }
+
+    private:
+        JobSystem* m_jobs;
+        std::vector<CommandBuffer> m_buffers;
+        size_t m_used = 0;
+    };
+}
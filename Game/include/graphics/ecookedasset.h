@@ -0,0 +1,56 @@
+#pragma once
+
+#include "graphics/emesh.h"
+
+namespace EProject
+{
+    // Binary layouts written by the AssetCooker into the derived data cache.
+    // Blobs are only valid for the same cooker version, a version bump changes every key.
+    namespace CookedAsset
+    {
+        static constexpr uint32_t cMagic = 0x414B4345; // "ECKA"
+        static constexpr uint32_t cVersion = 1;
+
+        enum class Kind : uint32_t
+        {
+            Mesh = 1,
+            Texture = 2,
+            Shader = 3
+        };
+
+        struct Header
+        {
+            uint32_t magic = cMagic;
+            uint32_t version = cVersion;
+            Kind kind = Kind::Mesh;
+            uint32_t count = 0;
+        };
+
+        struct Texture
+        {
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t mipCount = 1;
+            TextureFmt format = TextureFmt::RGBA8;
+            std::vector<uint8_t> data;  // every mip level, largest first
+        };
+
+        struct ShaderStage
+        {
+            ShaderType type = ShaderType::Vertex;
+            std::string entryPoint;
+            std::string target;
+            std::vector<uint8_t> bytecode;
+        };
+
+        // Material texture paths are kept relative to the source model, as in the file
+        void writeMeshes(const std::vector<MeshData>& meshes, std::vector<uint8_t>& out);
+        void writeTexture(const Texture& texture, std::vector<uint8_t>& out);
+        void writeShader(const std::vector<ShaderStage>& stages, std::vector<uint8_t>& out);
+
+        // Return false on a kind or version mismatch, truncated data throws
+        bool readMeshes(const uint8_t* data, size_t size, std::vector<MeshData>& out);
+        bool readTexture(const uint8_t* data, size_t size, Texture& out);
+        bool readShader(const uint8_t* data, size_t size, std::vector<ShaderStage>& out);
+    }
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "graphics/emesh.h"
+
+namespace EProject
+{
+    // Direct .gltf reader: json + external buffers opened through the file system (archive views
+    // or mapped loose files), accessors are read in place.
+    // Output matches the Assimp import path: left handed, flipped winding, mesh space vertices
+    // and one MeshData per primitive.
+    class GLTFLoader
+    {
+    public:
+        static bool isSupported(const std::filesystem::path& path);
+
+        // Returns false (and leaves out untouched) when the file uses features that are not
+        // handled here (embedded buffers, compression extensions, non triangle primitives).
+        // Broken files throw.
+        static bool load(const std::filesystem::path& path, std::vector<MeshData>& out);
+    };
+}
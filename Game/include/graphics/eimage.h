@@ -0,0 +1,113 @@
+#pragma once
+
+#include "glmh.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace EProject
+{
+    // Recycles large blocks in size classes (four per power of two). stb_image allocates
+    // through it, so decoded pixels and decoder scratch memory go back to the pool when
+    // freed instead of to the heap.
+    class PixelBufferPool
+    {
+    public:
+        struct Stats
+        {
+            size_t allocations = 0;
+            size_t reused = 0;
+            size_t cachedBytes = 0;
+        };
+
+        ~PixelBufferPool();
+
+        void* allocate(size_t size);
+        void* reallocate(void* ptr, size_t size);
+        void release(void* ptr);
+
+        // Pre-allocates blocks so a batch decode doesn't hit the heap, as far as the cache limit allows
+        void reserve(const std::vector<size_t>& sizes);
+
+        // Frees every cached block, AssetManager::collectGarbage calls it
+        void trim();
+
+        void setMaxCachedBytes(size_t bytes);
+
+        Stats getStats() const;
+
+    private:
+        static constexpr size_t cMinPooledSize = 64 * 1024;
+
+        static size_t getSizeClass(size_t size);
+
+        void* allocateBlock(size_t sizeClass);
+
+    private:
+        mutable std::mutex m_mutex;
+        std::map<size_t, std::vector<void*>> m_free;
+
+        // Enough to recycle the scratch buffers of a batch, decoded pixels live with their textures
+        size_t m_maxCachedBytes = 8 * 1024 * 1024;
+        Stats m_stats;
+    };
+
+    PixelBufferPool* getPixelBufferPool();
+
+    struct PixelDeleter
+    {
+        void operator()(uint8_t* ptr) const;
+    };
+
+    using PixelBuffer = std::unique_ptr<uint8_t[], PixelDeleter>;
+
+    enum class PixelType
+    {
+        UInt8,
+        UInt16,
+        Float
+    };
+
+    struct DecodedImage
+    {
+        glm::ivec2 size = glm::ivec2(0);
+        int channels = 0;
+        PixelType type = PixelType::UInt8;
+        PixelBuffer pixels;
+        std::string error;
+
+        size_t getChannelSize() const { return type == PixelType::UInt8 ? 1 : type == PixelType::UInt16 ? 2 : 4; }
+        size_t getByteSize() const { return static_cast<size_t>(size.x) * size.y * channels * getChannelSize(); }
+    };
+
+    struct ImageSource
+    {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+    };
+
+    class ImageDecoder
+    {
+    public:
+        // channels: 1..4, 0 keeps the file channel count
+        static bool getInfo(const ImageSource& src, glm::ivec2& size, int& channels);
+
+        static bool isHDR(const ImageSource& src);
+        static bool is16Bit(const ImageSource& src);
+
+        // Failures leave pixels empty and fill error
+        static DecodedImage decode(const ImageSource& src, int channels, bool flipY = false);
+
+        // Keeps the source precision: HDR files give floats, 16 bit files uint16
+        static DecodedImage decodeNative(const ImageSource& src, int channels, bool flipY = false);
+
+        // Headers are parsed first to pre-allocate every output, then all images are
+        // decoded on the job system
+        static std::vector<DecodedImage> decodeBatch(const std::vector<ImageSource>& sources, int channels, bool flipY = false);
+    };
+}
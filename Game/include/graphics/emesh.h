@@ -1,6 +1,7 @@
 #pragma once
 
 #include <eutils.h>
+#include "graphics/emeshlet.h"
 
 namespace EProject
 {
@@ -68,6 +69,7 @@ namespace EProject
 
         void addIndex(int32_t index);
         void addMaterial(const Material& mat);
+        void setIndices(std::vector<int32_t>&& mshIndices);
 
         const AABB& getAABB() const;
 
@@ -86,13 +88,18 @@ namespace EProject
         MeshData() = default;
 
         void addVertex(const MeshVertex& mshVertex);
+        void setVertices(std::vector<MeshVertex>&& mshVertices);
+        void reserve(size_t numVertices, size_t numIndices);
 
         const AABB& calculateAABB();
+        void buildMeshlets();
         
         const Material& getMaterial() const;
         size_t getVertexCount() const;
 
         const MeshVertex* getVertexData() const { return vertices.data(); }
+        size_t getMemoryUsage() const;
+        const std::vector<Meshlet>& getMeshlets() const { return meshlets; }
 
     public:
         uint32_t startVertex = 0;
@@ -101,6 +108,7 @@ namespace EProject
         uint32_t materialId = -1;
     private:
         std::vector<MeshVertex> vertices;
+        std::vector<Meshlet> meshlets;
     };
 
     class SkinnedMeshData : public Mesh
@@ -132,14 +140,23 @@ namespace EProject
         bool load(const GDevicePtr& _ptr) override;
         bool unload() override;
 
+        size_t getMemoryUsage() const override;
+
         void calculateAABB();
 
         const std::vector<MeshData>& getMeshData() const { return m_data; }
+        const AABB& getAABB() const { return bbox; }
 
         size_t getVertexCount() const;
         size_t getIndicesCount() const;
         size_t getMaterialsCount() const;
 
+        // Off routes glTF files through Assimp as well, for comparing the importers
+        static void setNativeGLTF(bool enabled);
+
+    private:
+        bool loadAssimp();
+
     private:
         std::vector<MeshData> m_data;
         AABB bbox;
@@ -152,29 +169,61 @@ namespace EProject
     class StaticMeshRenderable
     {
     public:
+        struct MaterialGPU
+        {
+            GPUTexture2DPtr albedoTex;
+            GPUTexture2DPtr normalTex;
+            GPUTexture2DPtr metallRoghnessTex;
+        };
+
+        // One entry per MeshData, the list is sorted by material
+        struct SubmeshDraw
+        {
+            uint32_t material = 0;
+            uint32_t meshData = 0;
+            uint32_t startIndex = 0;
+            uint32_t indexCount = 0;
+            int32_t baseVertex = 0;
+        };
+
         StaticMeshRenderable() = default;
 
         void setModelName(const std::string& mdlName) { m_modelName = mdlName; };
         void createOnGPU(const MeshInstancePtr& mshInst, const GDevicePtr& dev, AssetManagerPtr& mng);
 
+        // Queues the material textures, onReady runs on the main thread once all of them finished
+        void loadTexturesAsync(const MeshInstancePtr& mshInst, AssetManagerPtr& mng, std::function<void()> onReady);
+
+        // Hot reload: uploads again only the textures made from file, or everything if file is the mesh.
+        // Returns false when the renderable doesn't use file.
+        bool reloadFile(const std::filesystem::path& file, const std::shared_ptr<IAsset>& asset, const GDevicePtr& dev, AssetManagerPtr& mng);
+
+        const MeshInstancePtr& getMeshInstancePtr() const { return m_meshPtr; }
+
         const VertexBufferPtr& getVertexBufferPtr() const { return m_vb; }
         const IndexBufferPtr& getIndexBufferPtr() const { return m_ib; }
 
-        const GPUTexture2DPtr& getAlbedoTexturePtr() const { return m_albedoTex; }
-        const GPUTexture2DPtr& getNormalTexturePtr() const { return m_normalTex; }
-        const GPUTexture2DPtr& getMetallRoughnessTexturePtr() const { return m_metallRoghnessTex; }
+        const std::vector<MaterialGPU>& getMaterials() const { return m_materials; }
+        const std::vector<SubmeshDraw>& getDrawList() const { return m_drawList; }
 
     private:
 
-        GPUTexture2DPtr setupTexture(const GDevicePtr& dev, AssetManagerPtr& mng, const PathKey& key);
+        std::vector<std::filesystem::path> getTextureFiles(const MeshInstancePtr& mshInst) const;
+        // Decodes, builds mip chains for and uploads every material texture not uploaded yet
+        void uploadTextures(const MeshInstancePtr& mshInst, const GDevicePtr& dev, AssetManagerPtr& mng);
+        // occlusion is packed into the red channel when set
+        PathKey getTextureKey(const std::filesystem::path& file, const std::filesystem::path& occlusion = {}) const;
+        GPUTexture2DPtr findTexture(const PathKey& key) const;
+        MaterialGPU getMaterialGPU(const Material& mat) const;
 
     private:
         VertexBufferPtr m_vb;
         IndexBufferPtr m_ib;
 
-        GPUTexture2DPtr m_albedoTex;
-        GPUTexture2DPtr m_normalTex;
-        GPUTexture2DPtr m_metallRoghnessTex;
+        std::vector<MaterialGPU> m_materials;
+        std::vector<SubmeshDraw> m_drawList;
+
+        std::unordered_map<PathKey, GPUTexture2DPtr, PathKey> m_textures;
 
         MeshInstancePtr m_meshPtr;
         std::string m_modelName;
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "egapi.h"
+#include "emath.h"
+
+#include <vector>
+
+namespace EProject
+{
+    class MeshData;
+
+    // Contiguous run of triangles inside MeshData index list.
+    struct Meshlet
+    {
+        uint32_t startIndex = 0;
+        uint32_t indexCount = 0;
+        uint32_t vertexCount = 0;
+
+        glm::vec3 center = { 0, 0, 0 };
+        float radius = 0.0f;
+
+        // Backface cone, cutoff == 1 means the cone is too wide to ever be culled
+        glm::vec3 coneAxis = { 0, 0, 1 };
+        float coneCutoff = 1.0f;
+    };
+
+    class MeshletBuilder
+    {
+    public:
+        static constexpr size_t cMaxVertices = 64;
+        static constexpr size_t cMaxTriangles = 124;
+
+        // Reorders the triangles of msh so that every meshlet is grown from adjacent triangles,
+        // each one adding the fewest vertices and lying nearest to the meshlet's center. Compact
+        // meshlets get tight bounds and cones, which is what makes them worth culling.
+        static std::vector<Meshlet> build(MeshData& msh, size_t maxVertices = cMaxVertices, size_t maxTriangles = cMaxTriangles);
+
+    private:
+        static void computeBounds(const MeshData& msh, Meshlet& meshlet);
+    };
+
+    class ClusterCuller
+    {
+    public:
+        struct Stats
+        {
+            size_t meshlets = 0;
+            size_t visible = 0;
+            size_t frustumCulled = 0;
+            size_t coneCulled = 0;
+            size_t ranges = 0;
+        };
+
+        ClusterCuller() = default;
+
+        // viewProj and model are column major (not the transposed matrices sent to the shaders)
+        void setView(const glm::mat4& viewProj, const glm::mat4& model, const glm::vec3& camPos, bool coneCulling = true);
+
+        // Appends compacted index ranges of the visible meshlets
+        void cull(const MeshData& msh, std::vector<DrawIndexedCmd>& out);
+
+        const Stats& getStats() const { return m_stats; }
+        void resetStats() { m_stats = {}; }
+
+    private:
+        bool isBackfacing(const Meshlet& meshlet) const;
+        void emitRange(uint32_t startIndex, uint32_t indexCount, int32_t baseVertex, std::vector<DrawIndexedCmd>& out);
+
+    private:
+        Frustum m_frustum;
+        glm::vec3 m_camPos = { 0, 0, 0 };
+        bool m_coneCulling = true;
+
+        Stats m_stats;
+    };
+}
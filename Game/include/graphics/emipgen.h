@@ -0,0 +1,61 @@
+#pragma once
+
+#include "glmh.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace EProject
+{
+    enum class MipFilter
+    {
+        Box,
+        Kaiser,
+        Lanczos
+    };
+
+    struct MipSettings
+    {
+        MipFilter filter = MipFilter::Kaiser;
+
+        bool srgb = false;          // colour channels are filtered in linear space
+        bool normalMap = false;     // xyz renormalized on every level
+        bool wrap = true;           // taps past the edge wrap around instead of clamping
+
+        float alphaCutoff = 0.0f;   // > 0 scales alpha so every level keeps the alpha test coverage of the top
+        int maxLevels = 0;          // 0 means down to 1x1
+    };
+
+    // RGBA8 levels back to back, level 0 is the source image
+    struct MipChain
+    {
+        std::vector<glm::ivec2> sizes;
+        std::vector<size_t> offsets;
+        std::vector<uint8_t> data;
+
+        int getLevelCount() const { return static_cast<int>(sizes.size()); }
+        const uint8_t* getLevel(int level) const { return data.data() + offsets[level]; }
+        size_t getLevelSize(int level) const { return static_cast<size_t>(sizes[level].x) * sizes[level].y * 4; }
+    };
+
+    struct MipSource
+    {
+        const uint8_t* rgba = nullptr;
+        glm::ivec2 size = glm::ivec2(0);
+        MipSettings settings;
+    };
+
+    // Every level is filtered from the previous one kept in float, so rounding doesn't
+    // accumulate down the chain. Rows of a level run on the job system and the kernel
+    // accumulation works on whole RGBA pixels with SSE where available.
+    class MipGenerator
+    {
+    public:
+        static int getLevelCount(glm::ivec2 size);
+
+        static MipChain generate(const MipSource& src);
+
+        // All textures at once, small ones keep the cores busy while large levels are filtered
+        static std::vector<MipChain> generateBatch(const std::vector<MipSource>& sources);
+    };
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "graphics/ecommandbuffer.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace EProject
+{
+    struct SortItem
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    // Stable LSD radix sort by key, 11 bits per pass. Passes where every key has the same
+    // digit are skipped, so fields that don't vary in a frame cost nothing. scratch and
+    // histograms are only working memory, kept by the caller to reuse across frames.
+    void radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch, std::vector<uint32_t>& histograms);
+
+    // 64 bit draw keys, most significant first:
+    //   opaque:  layer:4 | pass:4 | 0:1 | program:11 | material:22 | depth:22, front to back
+    //   blended: layer:4 | pass:4 | 0:1 | depth:32, back to front | program:11 | material:12
+    // Opaque fields line up with the radix digits, a frame with one pass and program sorts in
+    // three passes.
+    namespace SortKey
+    {
+        constexpr uint32_t cLayers = 16;
+        constexpr uint32_t cPasses = 16;
+
+        // Float bits flipped so they compare as unsigned in the same order as the floats
+        uint32_t depth(float d);
+
+        uint64_t opaque(uint32_t layer, uint32_t pass, uint32_t program, uint32_t material, float depth);
+        uint64_t blended(uint32_t layer, uint32_t pass, float depth, uint32_t program, uint32_t material);
+
+        inline uint32_t layer(uint64_t key) { return uint32_t(key >> 60); }
+        inline uint32_t pass(uint64_t key) { return uint32_t(key >> 56) & 0xF; }
+    }
+
+    // Systems emit draw packets during the frame, submit() sorts them by key and records
+    // them into command buffers, binding programs, materials, buffers, constants and pass
+    // states only when they differ from the previous packet. Chunks of sort items are
+    // recorded in parallel, each starting from scratch. Tables (materials, geometry, constants) live until submit.
+    class RenderQueue
+    {
+    public:
+        static constexpr uint32_t cNone = ~0u;
+        static constexpr int cMaterialTextures = 4;
+
+        using PassStates = RenderStates;
+
+        struct DrawPacket
+        {
+            ShaderProgram* program = nullptr;
+            uint32_t material = cNone;
+            uint32_t geometry = cNone;
+            uint32_t constants = cNone;
+            uint32_t first = 0;
+            uint32_t count = 0;
+            int32_t baseVertex = 0;
+            uint32_t instanceCount = 0;     // 0 draws without instancing
+            PrimTopology topology = PrimTopology::Triangle;
+            bool indexed = true;
+        };
+
+        struct Stats
+        {
+            uint32_t packets = 0;
+            uint32_t sortItems = 0;
+            uint32_t drawCalls = 0;
+            uint32_t instances = 0;
+            uint32_t programBinds = 0;
+            uint32_t materialBinds = 0;
+            uint32_t geometryBinds = 0;
+            uint32_t constantBinds = 0;
+            uint32_t stateChanges = 0;
+        };
+
+        // Records on the given job system, the global one by default
+        explicit RenderQueue(JobSystem* jobs = nullptr);
+
+        void setPassStates(uint32_t pass, const PassStates& states);
+
+        // Small id for sort keys, valid until submit like the tables below. A program freed by a
+        // reload can't pass its id on to one allocated at the same address in a later frame.
+        uint32_t getProgramId(const ShaderProgram* program);
+
+        // Registered once per frame per key, returns the existing id otherwise. Material slots
+        // are resolved per program, a material only goes with packets of that program.
+        uint32_t addMaterial(const void* key, const ShaderResource* slots, const GPUTexture2DPtr* textures, int count);
+        uint32_t addGeometry(const VertexBufferPtr& vbo, const IndexBufferPtr& ibo);
+
+        // Values written before the draws that reference the block, set with the setValue
+        // calls below between begin and end. Handles belong to the packets' program too.
+        uint32_t beginConstants();
+        template<typename T>
+        void setValue(const ShaderValue<T>& h, const T& v)
+        {
+            addValue(h, &v, sizeof(T));
+        }
+        void endConstants();
+
+        void push(uint64_t key, const DrawPacket& packet);
+
+        void submit(GDevice& device);
+        void clear();
+
+        size_t size() const { return m_packets.size(); }
+
+        const Stats& getStats() const { return m_stats; }
+
+    private:
+        struct MaterialData
+        {
+            ShaderResource slots[cMaterialTextures];
+            GPUTexture2DPtr textures[cMaterialTextures];
+            int count = 0;
+        };
+
+        struct GeometryData
+        {
+            VertexBufferPtr vbo;
+            IndexBufferPtr ibo;
+        };
+
+        struct ValueData
+        {
+            ShaderValueHandle handle;
+            uint32_t offset;
+            int size;
+        };
+
+        struct ConstantsData
+        {
+            uint32_t first;
+            uint32_t count;
+        };
+
+        // Packets of one sort item
+        struct Run
+        {
+            uint32_t first;
+            uint32_t count;
+        };
+
+        void addValue(const ShaderValueHandle& h, const void* data, int size);
+
+        // Sorted items [first, last) into cb
+        void recordItems(size_t first, size_t last, CommandBuffer& cb, Stats& stats) const;
+
+    private:
+        static constexpr size_t cItemsPerChunk = 1024;
+
+        std::vector<SortItem> m_items;
+        std::vector<SortItem> m_scratch;
+        std::vector<uint32_t> m_histograms;
+        std::vector<Run> m_runs;
+        std::vector<DrawPacket> m_packets;
+
+        std::vector<MaterialData> m_materials;
+        std::unordered_map<const void*, uint32_t> m_materialIds;
+        std::vector<GeometryData> m_geometry;
+        std::unordered_map<const VertexBuffer*, uint32_t> m_geometryIds;
+
+        std::vector<ValueData> m_values;
+        std::vector<uint8_t> m_valueBytes;
+        std::vector<ConstantsData> m_constants;
+
+        std::unordered_map<const ShaderProgram*, uint32_t> m_programIds;
+
+        PassStates m_passStates[SortKey::cPasses];
+        ParallelRecorder m_recorder;
+
+        Stats m_stats;
+        std::vector<Stats> m_chunkStats;
+    };
+}
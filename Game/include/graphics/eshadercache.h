@@ -0,0 +1,68 @@
+#pragma once
+
+#include "utils/eddc.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace EProject
+{
+    struct ShaderCompileDesc
+    {
+        std::filesystem::path filePath;
+        std::string entryPoint;
+        std::string target;
+        std::vector<std::pair<std::string, std::string>> defines;
+        uint32_t flags = 0;
+    };
+
+    // Hash of the source, its include closure (paths relative to the source and contents),
+    // defines, entry point, target, flags and the compiler version. An edit anywhere in the
+    // closure makes a new key, moving the whole tree doesn't. 0 when the source can't be read.
+    uint64_t computeShaderKey(const ShaderCompileDesc& desc, uint64_t compilerVersion);
+
+    // Compiled bytecode in a derived data cache under computeShaderKey. Entries carry the key,
+    // size and a hash of the bytecode, a damaged entry is compiled again and replaced. Safe to
+    // use from any thread.
+    class ShaderCache
+    {
+    public:
+        // Returns false with the compiler output in errors
+        using CompileFunc = std::function<bool(const ShaderCompileDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors)>;
+
+        struct Stats
+        {
+            uint32_t hits = 0;
+            uint32_t compiled = 0;
+            uint32_t corrupt = 0;       // entries that failed the checks
+            uint32_t failed = 0;
+        };
+
+        ShaderCache(const std::filesystem::path& root, uint64_t compilerVersion, CompileFunc compile);
+
+        uint64_t computeKey(const ShaderCompileDesc& desc) const;
+
+        bool get(const ShaderCompileDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors);
+
+        Stats getStats() const;
+
+    private:
+        bool read(uint64_t key, std::vector<uint8_t>& bytecode);
+        void write(uint64_t key, const std::vector<uint8_t>& bytecode) const;
+
+    private:
+        DerivedDataCache m_cache;
+        uint64_t m_compilerVersion;
+        CompileFunc m_compile;
+
+        std::atomic<uint32_t> m_hits = 0;
+        std::atomic<uint32_t> m_compiled = 0;
+        std::atomic<uint32_t> m_corrupt = 0;
+        std::atomic<uint32_t> m_failed = 0;
+    };
+}
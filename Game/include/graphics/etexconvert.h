@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace EProject
+{
+    // Pixel conversions run on load and at cook time. The kernels work on four pixels
+    // (or four floats) per SSE2 step with a scalar tail.
+    class TextureConvert
+    {
+    public:
+        struct ChannelSource
+        {
+            const uint8_t* rgba = nullptr;  // null writes fill
+            int channel = 0;
+            uint8_t fill = 255;
+        };
+
+        // One RGBA8 image out of single channels of up to four RGBA8 images of the same size
+        static void packChannels(const ChannelSource (&sources)[4], size_t pixels, uint8_t* out);
+
+        // rgb *= a in place, rounded like a GPU unorm multiply
+        static void premultiplyAlpha(uint8_t* rgba, size_t pixels);
+
+        // Round to nearest even, overflow gives infinity and NaN stays NaN
+        static void floatToHalf(const float* in, size_t count, uint16_t* out);
+    };
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "utils/emappedfile.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace EProject
+{
+    // Single file package: entries, then a table of contents sorted by name hash, then names.
+    // Uncompressed entries are served straight from the mapping, compressed ones are split
+    // into independent LZ4 blocks that are decoded in parallel.
+    class Archive
+    {
+    public:
+        static constexpr uint32_t cMagic = 0x4B415045; // "EPAK"
+        static constexpr uint32_t cVersion = 1;
+
+        struct Header
+        {
+            uint32_t magic = cMagic;
+            uint32_t version = cVersion;
+            uint32_t entryCount = 0;
+            uint32_t reserved = 0;
+            uint64_t tocOffset = 0;
+            uint64_t namesOffset = 0;
+            uint64_t namesSize = 0;
+        };
+
+        struct Entry
+        {
+            uint64_t hash = 0;
+            uint64_t offset = 0;
+            uint64_t storedSize = 0;
+            uint64_t size = 0;
+            uint32_t nameOffset = 0;
+            uint32_t nameSize = 0;
+            uint32_t blockSize = 0;     // 0 for uncompressed entries
+            uint32_t blockCount = 0;
+        };
+
+        // Blocks that didn't shrink are stored raw and flagged in their size
+        static constexpr uint32_t cRawBlockFlag = 0x80000000u;
+
+        Archive() = default;
+
+        Archive(const Archive&) = delete;
+        Archive& operator=(const Archive&) = delete;
+
+        // Broken archives throw, a missing file returns false
+        bool open(const std::filesystem::path& path);
+
+        const std::filesystem::path& getPath() const { return m_path; }
+        size_t getEntryCount() const { return m_entryCount; }
+        const Entry& getEntry(size_t idx) const { return m_toc[idx]; }
+        std::string getName(const Entry& entry) const;
+
+        // Names are data dir relative with '/' separators, lookup ignores case
+        const Entry* find(const std::string& name) const;
+
+        // Zero-copy view, null for compressed entries
+        const uint8_t* getView(const Entry& entry) const;
+        bool read(const Entry& entry, std::vector<uint8_t>& out) const;
+
+        static uint64_t hashName(const std::string& name);
+
+    private:
+        std::filesystem::path m_path;
+        MappedFile m_file;
+
+        const Entry* m_toc = nullptr;
+        size_t m_entryCount = 0;
+        const char* m_names = nullptr;
+    };
+
+    using ArchivePtr = std::shared_ptr<Archive>;
+
+    class ArchiveWriter
+    {
+    public:
+        struct Options
+        {
+            size_t alignment = 4096;
+            uint32_t blockSize = 64 * 1024;
+        };
+
+        void add(const std::string& name, std::vector<uint8_t>&& data, bool compress);
+
+        // Compresses on the job system, throws on IO errors
+        void write(const std::filesystem::path& path, const Options& options) const;
+
+    private:
+        struct Item
+        {
+            std::string name;
+            std::vector<uint8_t> data;
+            bool compress = false;
+        };
+
+        std::vector<Item> m_items;
+    };
+}
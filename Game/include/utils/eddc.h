@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace EProject
+{
+    // Content addressed store for cooked data. Every blob lives under root/xx/<key>
+    // where key is the hash of everything the cook result depends on, so an entry
+    // never needs to be invalidated: changed inputs simply produce a new key.
+    class DerivedDataCache
+    {
+    public:
+        explicit DerivedDataCache(const std::filesystem::path& root);
+
+        const std::filesystem::path& getRoot() const { return m_root; }
+        std::filesystem::path getPath(uint64_t key) const;
+
+        bool has(uint64_t key) const;
+        bool load(uint64_t key, std::vector<uint8_t>& out) const;
+
+        // Writes to a temporary file first, concurrent stores of the same key are safe
+        void store(uint64_t key, const void* data, size_t size) const;
+
+        static std::string keyToString(uint64_t key);
+        static bool keyFromString(const std::string& str, uint64_t& key);
+
+    private:
+        std::filesystem::path m_root;
+    };
+
+    // Source file (relative to the data dir, generic separators) to cache key mapping
+    // written by the cooker. The stamp is a hash of input sizes and write times,
+    // when it matches the inputs are not read again.
+    class CookManifest
+    {
+    public:
+        struct Entry
+        {
+            uint64_t key = 0;
+            uint64_t stamp = 0;
+            std::vector<std::string> dependencies;
+        };
+
+        bool load(const std::filesystem::path& path);
+        void save(const std::filesystem::path& path) const;
+
+        const Entry* find(const std::string& source) const;
+        void set(const std::string& source, Entry entry);
+        void erase(const std::string& source);
+
+        const std::map<std::string, Entry>& getEntries() const { return m_entries; }
+
+    private:
+        std::map<std::string, Entry> m_entries;
+    };
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace EProject
+{
+    // Whole file, false when it can't be opened or read
+    bool readFile(const std::filesystem::path& path, std::vector<uint8_t>& data);
+    bool readFile(const std::filesystem::path& path, std::string& text);
+
+    // Extension with the dot in lower case, ".png" for "Albedo.PNG"
+    std::string getLowerExt(const std::filesystem::path& path);
+
+    // Percent escapes of a relative glTF uri, a malformed escape is kept as it is
+    std::string decodeUri(const std::string& uri);
+
+    // Embedded payload, there is no file behind such a uri
+    bool isDataUri(const std::string& uri);
+
+    // Targets of the quoted includes in a source text, in order. Whitespace around '#' and
+    // "include" is allowed, include lines inside block comments are reported as well.
+    std::vector<std::string> scanIncludes(const std::string& text);
+
+    // The source and every file it includes, recursively, in discovery order. Include paths are
+    // relative to the including file like D3D_COMPILE_STANDARD_FILE_INCLUDE resolves them.
+    // Missing files are listed but not followed, the compiler reports them.
+    std::vector<std::filesystem::path> collectIncludes(const std::filesystem::path& source);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace EProject
+{
+    // Watches a directory tree on a background thread (ReadDirectoryChangesW on Windows,
+    // inotify on Linux) and collects the files written in it.
+    class FileWatcher
+    {
+    public:
+        explicit FileWatcher(const std::filesystem::path& root);
+        ~FileWatcher();
+
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher& operator=(const FileWatcher&) = delete;
+
+        bool isWatching() const { return m_watching; }
+
+        // Files changed since the last call that stayed untouched for settleTime,
+        // editors often save in several writes
+        std::vector<std::filesystem::path> poll(std::chrono::milliseconds settleTime = std::chrono::milliseconds(50));
+
+    private:
+        void run();
+        void onChanged(const std::filesystem::path& path);
+
+#ifndef _WIN32
+        // inotify isn't recursive, every directory gets its own watch
+        void addWatch(const std::filesystem::path& dir);
+#endif
+
+    private:
+        std::filesystem::path m_root;
+
+        std::mutex m_mutex;
+        std::unordered_map<std::filesystem::path::string_type, std::chrono::steady_clock::time_point> m_changes;
+
+        std::atomic<bool> m_stop = false;
+        bool m_watching = false;
+        std::thread m_thread;
+
+#ifdef _WIN32
+        void* m_dir = nullptr;
+        void* m_stopEvent = nullptr;
+#else
+        int m_fd = -1;
+        std::unordered_map<int, std::filesystem::path> m_watches;
+#endif
+    };
+}
@@ -0,0 +1,186 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace EHash
+{
+    // Streaming XXH64. Used as a content hash for cooked data, the output is stable across
+    // platforms and runs so it can be stored on disk.
+    class Hasher64
+    {
+    public:
+        explicit Hasher64(uint64_t seed = 0)
+        {
+            reset(seed);
+        }
+
+        void reset(uint64_t seed = 0)
+        {
+            m_acc[0] = seed + cPrime1 + cPrime2;
+            m_acc[1] = seed + cPrime2;
+            m_acc[2] = seed;
+            m_acc[3] = seed - cPrime1;
+            m_seed = seed;
+            m_total = 0;
+            m_tailSize = 0;
+        }
+
+        Hasher64& update(const void* data, size_t size)
+        {
+            auto ptr = static_cast<const uint8_t*>(data);
+            m_total += size;
+
+            if (m_tailSize + size < sizeof(m_tail))
+            {
+                if (size)
+                {
+                    std::memcpy(m_tail + m_tailSize, ptr, size);
+                }
+
+                m_tailSize += size;
+                return *this;
+            }
+
+            if (m_tailSize)
+            {
+                const size_t fill = sizeof(m_tail) - m_tailSize;
+                std::memcpy(m_tail + m_tailSize, ptr, fill);
+                consume(m_tail);
+
+                ptr += fill;
+                size -= fill;
+                m_tailSize = 0;
+            }
+
+            for (; size >= sizeof(m_tail); ptr += sizeof(m_tail), size -= sizeof(m_tail))
+            {
+                consume(ptr);
+            }
+
+            std::memcpy(m_tail, ptr, size);
+            m_tailSize = size;
+
+            return *this;
+        }
+
+        Hasher64& update(const std::string& str)
+        {
+            // Length goes first so "ab"+"c" and "a"+"bc" differ
+            return update(static_cast<uint64_t>(str.size())).update(str.data(), str.size());
+        }
+
+        Hasher64& update(uint64_t value)
+        {
+            return update(&value, sizeof(value));
+        }
+
+        uint64_t finish() const
+        {
+            uint64_t h = 0;
+
+            if (m_total >= sizeof(m_tail))
+            {
+                h = rotl(m_acc[0], 1) + rotl(m_acc[1], 7) + rotl(m_acc[2], 12) + rotl(m_acc[3], 18);
+
+                for (const uint64_t acc : m_acc)
+                {
+                    h ^= round(0, acc);
+                    h = h * cPrime1 + cPrime4;
+                }
+            }
+            else
+            {
+                h = m_seed + cPrime5;
+            }
+
+            h += m_total;
+
+            const uint8_t* ptr = m_tail;
+            size_t size = m_tailSize;
+
+            for (; size >= 8; ptr += 8, size -= 8)
+            {
+                h ^= round(0, read64(ptr));
+                h = rotl(h, 27) * cPrime1 + cPrime4;
+            }
+
+            if (size >= 4)
+            {
+                h ^= static_cast<uint64_t>(read32(ptr)) * cPrime1;
+                h = rotl(h, 23) * cPrime2 + cPrime3;
+                ptr += 4;
+                size -= 4;
+            }
+
+            for (; size > 0; ++ptr, --size)
+            {
+                h ^= *ptr * cPrime5;
+                h = rotl(h, 11) * cPrime1;
+            }
+
+            h ^= h >> 33;
+            h *= cPrime2;
+            h ^= h >> 29;
+            h *= cPrime3;
+            h ^= h >> 32;
+
+            return h;
+        }
+
+    private:
+        static constexpr uint64_t cPrime1 = 0x9E3779B185EBCA87ULL;
+        static constexpr uint64_t cPrime2 = 0xC2B2AE3D27D4EB4FULL;
+        static constexpr uint64_t cPrime3 = 0x165667B19E3779F9ULL;
+        static constexpr uint64_t cPrime4 = 0x85EBCA77C2B2AE63ULL;
+        static constexpr uint64_t cPrime5 = 0x27D4EB2F165667C5ULL;
+
+        static uint64_t rotl(uint64_t x, int r)
+        {
+            return (x << r) | (x >> (64 - r));
+        }
+
+        static uint64_t round(uint64_t acc, uint64_t input)
+        {
+            acc += input * cPrime2;
+            acc = rotl(acc, 31);
+            return acc * cPrime1;
+        }
+
+        static uint64_t read64(const uint8_t* ptr)
+        {
+            uint64_t v;
+            std::memcpy(&v, ptr, sizeof(v));
+            return v;
+        }
+
+        static uint32_t read32(const uint8_t* ptr)
+        {
+            uint32_t v;
+            std::memcpy(&v, ptr, sizeof(v));
+            return v;
+        }
+
+        void consume(const uint8_t* block)
+        {
+            for (int i = 0; i < 4; ++i)
+            {
+                m_acc[i] = round(m_acc[i], read64(block + i * 8));
+            }
+        }
+
+        uint64_t m_acc[4] = {};
+        uint64_t m_seed = 0;
+        uint64_t m_total = 0;
+
+        uint8_t m_tail[32] = {};
+        size_t m_tailSize = 0;
+    };
+
+    inline uint64_t hash64(const void* data, size_t size, uint64_t seed = 0)
+    {
+        return Hasher64(seed).update(data, size).finish();
+    }
+}
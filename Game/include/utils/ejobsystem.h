@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace EProject
+{
+    class JobSystem final
+    {
+    public:
+        explicit JobSystem(size_t workersCount = 0);
+        ~JobSystem();
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        size_t getWorkersCount() const { return m_workers.size(); }
+
+        template<typename F>
+        auto submit(F&& func) -> std::future<decltype(func())>
+        {
+            using R = decltype(func());
+
+            auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(func));
+            std::future<R> result = task->get_future();
+
+            push([task]() { (*task)(); });
+
+            return result;
+        }
+
+        // Runs func(i) for i in [0, count). The calling thread takes part in the work,
+        // so it is safe to call from inside a job.
+        void parallelFor(size_t count, const std::function<void(size_t)>& func);
+
+    private:
+        void push(std::function<void()>&& job);
+        void workerLoop();
+
+    private:
+        std::vector<std::thread> m_workers;
+        std::deque<std::function<void()>> m_jobs;
+
+        std::mutex m_mutex;
+        std::condition_variable m_cv;
+        bool m_stop = false;
+    };
+
+    JobSystem* getJobSystem();
+}
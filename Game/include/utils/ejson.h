@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace EProject
+{
+    // Read-only JSON document tree. Object members keep file order,
+    // lookups are linear which is fine for the small objects of asset formats.
+    class JsonValue
+    {
+    public:
+        enum class Type
+        {
+            Null,
+            Bool,
+            Number,
+            String,
+            Array,
+            Object
+        };
+
+        JsonValue() = default;
+
+        static JsonValue parse(const char* data, size_t size);
+
+        Type getType() const { return m_type; }
+
+        bool isNull() const { return m_type == Type::Null; }
+        bool isNumber() const { return m_type == Type::Number; }
+        bool isString() const { return m_type == Type::String; }
+        bool isArray() const { return m_type == Type::Array; }
+        bool isObject() const { return m_type == Type::Object; }
+
+        bool has(const char* key) const;
+        size_t size() const { return m_items.size(); }
+
+        // Missing keys and out of range indices return a null value
+        const JsonValue& operator[](const char* key) const;
+        const JsonValue& operator[](size_t idx) const;
+        const JsonValue& operator[](int idx) const { return (*this)[static_cast<size_t>(idx)]; }
+
+        const std::string& getKey(size_t idx) const { return m_keys[idx]; }
+
+        bool asBool(bool def = false) const;
+        double asNumber(double def = 0.0) const;
+        float asFloat(float def = 0.0f) const { return static_cast<float>(asNumber(def)); }
+        int asInt(int def = 0) const { return static_cast<int>(asNumber(def)); }
+        size_t asSize(size_t def = 0) const { return static_cast<size_t>(asNumber(static_cast<double>(def))); }
+        const std::string& asString() const { return m_string; }
+
+    private:
+        friend class JsonParser;
+
+        Type m_type = Type::Null;
+        bool m_bool = false;
+        double m_number = 0.0;
+        std::string m_string;
+
+        std::vector<std::string> m_keys;
+        std::vector<JsonValue> m_items;
+    };
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "utils/earchive.h"
+
+#include <shared_mutex>
+#include <unordered_set>
+
+namespace EProject
+{
+    // Read-only bytes of a file: a view into a mounted archive, a mapping of a loose
+    // file or a decompressed copy. Keeps whatever it points into alive.
+    class FileView
+    {
+    public:
+        FileView() = default;
+
+        FileView(const FileView&) = delete;
+        FileView& operator=(const FileView&) = delete;
+
+        FileView(FileView&& r) noexcept;
+        FileView& operator=(FileView&& r) noexcept;
+
+        bool isOpen() const { return m_data != nullptr; }
+
+        const uint8_t* getData() const { return m_data; }
+        size_t getSize() const { return m_size; }
+
+        // Heap bytes owned by the view, mapped bytes are not counted
+        size_t getMemoryUsage() const { return m_storage.capacity(); }
+
+        void close();
+
+    private:
+        friend class VirtualFileSystem;
+
+        const uint8_t* m_data = nullptr;
+        size_t m_size = 0;
+
+        std::vector<uint8_t> m_storage;
+        MappedFile m_mapping;
+        ArchivePtr m_archive;
+    };
+
+    // Resolves paths under the data root against mounted archives first (latest mount wins)
+    // and falls back to loose files. Paths outside the root are always loose.
+    class VirtualFileSystem
+    {
+    public:
+        void setRoot(const std::filesystem::path& root);
+        const std::filesystem::path& getRoot() const { return m_root; }
+
+        bool mount(const std::filesystem::path& archivePath);
+        void unmountAll();
+
+        size_t getMountCount() const;
+
+        bool exists(const std::filesystem::path& path) const;
+        bool open(const std::filesystem::path& path, FileView& view) const;
+
+        // The loose file wins over the archives from now on, e.g. after it was edited
+        void overrideLoose(const std::filesystem::path& path);
+
+    private:
+        std::string getName(const std::filesystem::path& path) const;
+        std::string getRelativeName(const std::filesystem::path& path) const;
+
+    private:
+        std::filesystem::path m_root;
+
+        mutable std::shared_mutex m_mutex;
+        std::vector<ArchivePtr> m_archives;
+        std::unordered_set<std::string> m_looseOverrides;
+    };
+
+    VirtualFileSystem* getFileSystem();
+}
@@ -46,7 +46,6 @@ public:
 
     StaticMeshRenderablePtr m_model;
     ShaderProgramPtr m_shader;
-    StructuredBufferPtr m_sb;
 };
 
 class SkinnedMeshComponent final
@@ -1,9 +1,15 @@
 #include "egapi.h"
+#include "eutils.h"
+#include "graphics/eshadercache.h"
+#include "utils/efileutils.h"
+#include <algorithm>
 #include <cassert>
 #include <fstream>
 #include <sstream>
+#ifdef EPROJECT_GAPI_D3D11
 #include <d3dcompiler.h>
 #include "edx11api.h"
+#endif
 
 #include <filesystem>
 
@@ -39,89 +45,274 @@ namespace EProject
         }
     }
 
+    int getBlockSize(TextureFmt fmt)
+    {
+        switch (fmt) {
+        case TextureFmt::BC1: return 8;
+        case TextureFmt::BC1_SRGB: return 8;
+        case TextureFmt::BC3: return 16;
+        case TextureFmt::BC3_SRGB: return 16;
+        case TextureFmt::BC4: return 8;
+        case TextureFmt::BC5: return 16;
+        case TextureFmt::BC7: return 16;
+        case TextureFmt::BC7_SRGB: return 16;
+        default:
+            return 0;
+        }
+    }
+
+    int getRowPitch(TextureFmt fmt, int width)
+    {
+        const int blockSize = getBlockSize(fmt);
+        return blockSize ? (width + 3) / 4 * blockSize : getPixelsSize(fmt) * width;
+    }
+
+    int getSlicePitch(TextureFmt fmt, glm::ivec2 size)
+    {
+        const int rows = getBlockSize(fmt) ? (size.y + 3) / 4 : size.y;
+        return getRowPitch(fmt, size.x) * rows;
+    }
+
+    void States::beginFrame()
+    {
+        m_lastFrameStats = m_frameStats;
+        m_frameStats = {};
+    }
+
+#ifdef EPROJECT_GAPI_D3D11
+    namespace
+    {
+        BOOL toBOOL(BOOL b)
+        {
+            return b ? TRUE : FALSE;
+        }
+
+        // Fields D3D ignores in this state are reset and padding is zeroed, so equal states hash
+        // and compare equal
+        D3D11_RASTERIZER_DESC canonical(const D3D11_RASTERIZER_DESC& d)
+        {
+            D3D11_RASTERIZER_DESC c = d;
+            c.FrontCounterClockwise = toBOOL(d.FrontCounterClockwise);
+            c.DepthClipEnable = toBOOL(d.DepthClipEnable);
+            c.ScissorEnable = toBOOL(d.ScissorEnable);
+            c.MultisampleEnable = toBOOL(d.MultisampleEnable);
+            c.AntialiasedLineEnable = toBOOL(d.AntialiasedLineEnable);
+            return c;
+        }
+
+        D3D11_DEPTH_STENCIL_DESC canonical(const D3D11_DEPTH_STENCIL_DESC& d)
+        {
+            D3D11_DEPTH_STENCIL_DESC c;
+            memset(&c, 0, sizeof(c));
+
+            c.DepthEnable = toBOOL(d.DepthEnable);
+            c.DepthWriteMask = d.DepthWriteMask;
+            c.DepthFunc = d.DepthFunc;
+            c.StencilEnable = toBOOL(d.StencilEnable);
+
+            if (d.StencilEnable)
+            {
+                c.StencilReadMask = d.StencilReadMask;
+                c.StencilWriteMask = d.StencilWriteMask;
+                c.FrontFace = d.FrontFace;
+                c.BackFace = d.BackFace;
+            }
+
+            return c;
+        }
+
+        D3D11_BLEND_DESC canonical(const D3D11_BLEND_DESC& d)
+        {
+            D3D11_BLEND_DESC c;
+            memset(&c, 0, sizeof(c));
+
+            c.AlphaToCoverageEnable = toBOOL(d.AlphaToCoverageEnable);
+            c.IndependentBlendEnable = toBOOL(d.IndependentBlendEnable);
+
+            for (int i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
+            {
+                // Without independent blend every target uses the first one
+                const auto& src = d.RenderTarget[c.IndependentBlendEnable ? i : 0];
+                auto& rt = c.RenderTarget[i];
+
+                rt.BlendEnable = toBOOL(src.BlendEnable);
+                rt.SrcBlend = src.BlendEnable ? src.SrcBlend : D3D11_BLEND_ONE;
+                rt.DestBlend = src.BlendEnable ? src.DestBlend : D3D11_BLEND_ONE;
+                rt.BlendOp = src.BlendEnable ? src.BlendOp : D3D11_BLEND_OP_ADD;
+                rt.SrcBlendAlpha = src.BlendEnable ? src.SrcBlendAlpha : D3D11_BLEND_ONE;
+                rt.DestBlendAlpha = src.BlendEnable ? src.DestBlendAlpha : D3D11_BLEND_ONE;
+                rt.BlendOpAlpha = src.BlendEnable ? src.BlendOpAlpha : D3D11_BLEND_OP_ADD;
+                rt.RenderTargetWriteMask = src.RenderTargetWriteMask;
+            }
+
+            return c;
+        }
+
+        bool sameTarget(const D3D11_RENDER_TARGET_BLEND_DESC& a, const D3D11_RENDER_TARGET_BLEND_DESC& b)
+        {
+            return a.BlendEnable == b.BlendEnable && a.SrcBlend == b.SrcBlend && a.DestBlend == b.DestBlend && a.BlendOp == b.BlendOp &&
+                   a.SrcBlendAlpha == b.SrcBlendAlpha && a.DestBlendAlpha == b.DestBlendAlpha && a.BlendOpAlpha == b.BlendOpAlpha &&
+                   a.RenderTargetWriteMask == b.RenderTargetWriteMask;
+        }
+
+        template<typename Cache, typename Desc, typename Create>
+        const typename Cache::value_type* findBlock(Cache& cache, const Desc& desc, uint32_t& created, Create create)
+        {
+            const Desc key = canonical(desc);
+
+            auto it = cache.find(key);
+            if (it == cache.end())
+            {
+                typename Cache::mapped_type state;
+                getD3DErr(create(&key, &state));
+                it = cache.emplace(key, state).first;
+                ++created;
+            }
+
+            return &*it;
+        }
+    }
+
     void States::setDefaultStates()
     {
-        m_r_desc.FillMode = D3D11_FILL_SOLID;
-        m_r_desc.CullMode = D3D11_CULL_BACK;
-        m_r_desc.FrontCounterClockwise = true;
-        m_r_desc.DepthBias = 0;
-        m_r_desc.DepthBiasClamp = 0;
-        m_r_desc.SlopeScaledDepthBias = 0;
-        m_r_desc.DepthClipEnable = true;
-        m_r_desc.ScissorEnable = false;
-        m_r_desc.MultisampleEnable = false;
-        m_r_desc.AntialiasedLineEnable = false;
-        m_r_state = nullptr;
-
-        m_stencil_ref = 0xff;
-        m_d_desc.DepthEnable = false;
-        m_d_desc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
-        m_d_desc.DepthFunc = D3D11_COMPARISON_LESS;
-        m_d_desc.StencilEnable = false;
-        m_d_desc.StencilReadMask = 0xff;
-        m_d_desc.StencilWriteMask = 0xff;
-        m_d_desc.FrontFace.StencilFailOp = D3D11_STENCIL_OP_KEEP;
-        m_d_desc.FrontFace.StencilDepthFailOp = D3D11_STENCIL_OP_KEEP;
-        m_d_desc.FrontFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
-        m_d_desc.FrontFace.StencilFunc = D3D11_COMPARISON_NEVER;
-        m_d_desc.BackFace.StencilFailOp = D3D11_STENCIL_OP_KEEP;
-        m_d_desc.BackFace.StencilDepthFailOp = D3D11_STENCIL_OP_KEEP;
-        m_d_desc.BackFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
-        m_d_desc.BackFace.StencilFunc = D3D11_COMPARISON_NEVER;
-        m_d_state = nullptr;
-
-        m_b_desc.AlphaToCoverageEnable = false;
-        m_b_desc.IndependentBlendEnable = true;
+        D3D11_RASTERIZER_DESC& r = editRasterizer();
+        r.FillMode = D3D11_FILL_SOLID;
+        r.CullMode = D3D11_CULL_BACK;
+        r.FrontCounterClockwise = true;
+        r.DepthBias = 0;
+        r.DepthBiasClamp = 0;
+        r.SlopeScaledDepthBias = 0;
+        r.DepthClipEnable = true;
+        r.ScissorEnable = false;
+        r.MultisampleEnable = false;
+        r.AntialiasedLineEnable = false;
+
+        m_current.stencilRef = 0xff;
+
+        D3D11_DEPTH_STENCIL_DESC& d = editDepth();
+        d.DepthEnable = false;
+        d.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+        d.DepthFunc = D3D11_COMPARISON_LESS;
+        d.StencilEnable = false;
+        d.StencilReadMask = 0xff;
+        d.StencilWriteMask = 0xff;
+        d.FrontFace.StencilFailOp = D3D11_STENCIL_OP_KEEP;
+        d.FrontFace.StencilDepthFailOp = D3D11_STENCIL_OP_KEEP;
+        d.FrontFace.StencilPassOp = D3D11_STENCIL_OP_KEEP;
+        d.FrontFace.StencilFunc = D3D11_COMPARISON_NEVER;
+        d.BackFace = d.FrontFace;
+
+        D3D11_BLEND_DESC& b = editBlend();
+        b.AlphaToCoverageEnable = false;
+        b.IndependentBlendEnable = true;
         
         for (int i = 0; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
         {
-            m_b_desc.RenderTarget[i].BlendEnable = false;
-            m_b_desc.RenderTarget[i].SrcBlend = D3D11_BLEND_ONE;
-            m_b_desc.RenderTarget[i].DestBlend = D3D11_BLEND_ONE;
-            m_b_desc.RenderTarget[i].BlendOp = D3D11_BLEND_OP_ADD;
-            m_b_desc.RenderTarget[i].SrcBlendAlpha = D3D11_BLEND_ONE;
-            m_b_desc.RenderTarget[i].SrcBlendAlpha = D3D11_BLEND_ONE;
-            m_b_desc.RenderTarget[i].BlendOpAlpha = D3D11_BLEND_OP_ADD;
-            m_b_desc.RenderTarget[i].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+            b.RenderTarget[i].BlendEnable = false;
+            b.RenderTarget[i].SrcBlend = D3D11_BLEND_ONE;
+            b.RenderTarget[i].DestBlend = D3D11_BLEND_ONE;
+            b.RenderTarget[i].BlendOp = D3D11_BLEND_OP_ADD;
+            b.RenderTarget[i].SrcBlendAlpha = D3D11_BLEND_ONE;
+            b.RenderTarget[i].DestBlendAlpha = D3D11_BLEND_ONE;
+            b.RenderTarget[i].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+            b.RenderTarget[i].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+        }
+
+        resolve();
+    }
+
+    D3D11_RASTERIZER_DESC& States::editRasterizer()
+    {
+        if (!m_r_edit)
+        {
+            if (m_current.r)
+            {
+                m_r_desc = m_current.r->first;
+            }
+            m_r_edit = true;
+        }
+
+        m_changed = true;
+        return m_r_desc;
+    }
+
+    D3D11_DEPTH_STENCIL_DESC& States::editDepth()
+    {
+        if (!m_d_edit)
+        {
+            if (m_current.d)
+            {
+                m_d_desc = m_current.d->first;
+            }
+            m_d_edit = true;
         }
 
-        m_b_state = nullptr;
+        m_changed = true;
+        return m_d_desc;
+    }
+
+    D3D11_BLEND_DESC& States::editBlend()
+    {
+        if (!m_b_edit)
+        {
+            if (m_current.b)
+            {
+                m_b_desc = m_current.b->first;
+            }
+            m_b_edit = true;
+        }
+
+        m_changed = true;
+        return m_b_desc;
+    }
+
+    void States::resolve()
+    {
+        if (m_r_edit)
+        {
+            m_current.r = findBlock(m_r_cache, m_r_desc, m_frameStats.created,
+                [this](const D3D11_RASTERIZER_DESC* desc, ID3D11RasterizerState** state) { return m_device->CreateRasterizerState(desc, state); });
+            m_r_edit = false;
+        }
+
+        if (m_d_edit)
+        {
+            m_current.d = findBlock(m_d_cache, m_d_desc, m_frameStats.created,
+                [this](const D3D11_DEPTH_STENCIL_DESC* desc, ID3D11DepthStencilState** state) { return m_device->CreateDepthStencilState(desc, state); });
+            m_d_edit = false;
+        }
+
+        if (m_b_edit)
+        {
+            m_current.b = findBlock(m_b_cache, m_b_desc, m_frameStats.created,
+                [this](const D3D11_BLEND_DESC* desc, ID3D11BlendState** state) { return m_device->CreateBlendState(desc, state); });
+            m_b_edit = false;
+        }
     }
 
     void States::push()
     {
-        m_states.emplace_back(this);
-        m_r_state = nullptr;
-        m_d_state = nullptr;
-        m_b_state = nullptr;
+        resolve();
+        m_states.push_back(m_current);
     }
 
     void States::pop()
     {
-        const auto& last = m_states.back();
+        m_current = m_states.back();
+        m_states.pop_back();
 
-        m_r_desc = last.m_r_desc;
-        m_d_desc = last.m_d_desc;
-        m_b_desc = last.m_b_desc;
-        m_r_state = last.m_r_state;
-        m_d_state = last.m_d_state;
-        m_b_state = last.m_b_state;
-        m_stencil_ref = last.m_stencil_ref;
-        
-        if (m_r_state)
-            m_deviceContext->RSSetState(m_r_state.Get());
-        if (m_d_state)
-            m_deviceContext->OMSetDepthStencilState(m_d_state.Get(), m_stencil_ref);
-        if (m_b_state)
-            m_deviceContext->OMSetBlendState(m_b_state.Get(), nullptr, 0xffffffff);
+        m_r_edit = false;
+        m_d_edit = false;
+        m_b_edit = false;
+        m_changed = true;
     }
 
     void States::setWireframe(bool wire)
     {
-        if ((m_r_desc.FillMode == D3D11_FILL_WIREFRAME) != wire)
+        const D3D11_FILL_MODE fill = wire ? D3D11_FILL_WIREFRAME : D3D11_FILL_SOLID;
+        if (rasterizerDesc().FillMode != fill)
         {
-            m_r_desc.FillMode = wire ? D3D11_FILL_WIREFRAME : D3D11_FILL_SOLID;
-            m_r_state = nullptr;
+            editRasterizer().FillMode = fill;
         }
     }
 
@@ -135,38 +326,34 @@ namespace EProject
         case CullMode::Front: dx_cm = D3D11_CULL_FRONT; break;
         }
         
-        if (m_r_desc.CullMode != dx_cm)
+        if (rasterizerDesc().CullMode != dx_cm)
         {
-            m_r_desc.CullMode = dx_cm;
-            m_r_state = nullptr;
+            editRasterizer().CullMode = dx_cm;
         }
     }
 
     void States::setDepthEnable(bool enable)
     {
-        if (static_cast<bool>(m_d_desc.DepthEnable) != enable) 
+        if (static_cast<bool>(depthDesc().DepthEnable) != enable) 
         {
-            m_d_desc.DepthEnable = enable;
-            m_d_state = nullptr;
+            editDepth().DepthEnable = enable;
         }
     }
 
     void States::setDepthWrite(bool enable)
     {
-        if ((m_d_desc.DepthWriteMask == D3D11_DEPTH_WRITE_MASK_ALL) != enable)
+        if ((depthDesc().DepthWriteMask == D3D11_DEPTH_WRITE_MASK_ALL) != enable)
         {
-            m_d_desc.DepthWriteMask = enable ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
-            m_d_state = nullptr;
+            editDepth().DepthWriteMask = enable ? D3D11_DEPTH_WRITE_MASK_ALL : D3D11_DEPTH_WRITE_MASK_ZERO;
         }
     }
 
     void States::setDepthFunc(Compare cmp)
     {
         D3D11_COMPARISON_FUNC dx_cmp = toDX(cmp);
-        if (m_d_desc.DepthFunc != dx_cmp)
+        if (depthDesc().DepthFunc != dx_cmp)
         {
-            m_d_desc.DepthFunc = dx_cmp;
-            m_d_state = nullptr;
+            editDepth().DepthFunc = dx_cmp;
         }
     }
 
@@ -177,111 +364,88 @@ namespace EProject
 
     void States::setBlendSeparateAlpha(bool enable, Blend src_color, Blend dst_color, BlendFunc bf_color, Blend src_alpha, Blend dst_alpha, BlendFunc bf_alpha, int rt_index)
     {
-        if (m_b_desc.IndependentBlendEnable != (rt_index >= 0))
+        if (static_cast<bool>(blendDesc().IndependentBlendEnable) != (rt_index >= 0))
         {
-            m_b_desc.IndependentBlendEnable = (rt_index >= 0);
-            m_b_state = nullptr;
+            editBlend().IndependentBlendEnable = (rt_index >= 0);
         }
 
-        D3D11_BLEND dx_src_blend = enable ? toDX(src_color) : D3D11_BLEND_ONE;
-        D3D11_BLEND dx_dst_blend = enable ? toDX(dst_color) : D3D11_BLEND_ONE;
-        D3D11_BLEND_OP dx_blend_op = enable ? toDX(bf_color) : D3D11_BLEND_OP_ADD;
-        D3D11_BLEND dx_src_alpha_blend = enable ? toDX(src_alpha) : D3D11_BLEND_ONE;
-        D3D11_BLEND dx_dst_alpha_blend = enable ? toDX(dst_alpha) : D3D11_BLEND_ONE;
-        D3D11_BLEND_OP dx_blend_alpha_op = enable ? toDX(bf_alpha) : D3D11_BLEND_OP_ADD;
+        const int n = (rt_index < 0) ? 0 : rt_index;
 
-        int n = (rt_index < 0) ? 0 : rt_index;
-        
-        if (static_cast<bool>(m_b_desc.RenderTarget[n].BlendEnable) != enable)
-        {
-            m_b_desc.RenderTarget[n].BlendEnable = enable;
-            m_b_state = nullptr;
-        }
-        
-        if (m_b_desc.RenderTarget[n].SrcBlend != dx_src_blend)
-        {
-            m_b_desc.RenderTarget[n].SrcBlend = dx_src_blend;
-            m_b_state = nullptr;
-        }
-        
-        if (m_b_desc.RenderTarget[n].DestBlend != dx_dst_blend)
-        {
-            m_b_desc.RenderTarget[n].DestBlend = dx_dst_blend;
-            m_b_state = nullptr;
-        }
-        
-        if (m_b_desc.RenderTarget[n].BlendOp != dx_blend_op)
-        {
-            m_b_desc.RenderTarget[n].BlendOp = dx_blend_op;
-            m_b_state = nullptr;
-        }
-        
-        if (m_b_desc.RenderTarget[n].SrcBlendAlpha != dx_src_alpha_blend)
-        {
-            m_b_desc.RenderTarget[n].SrcBlendAlpha = dx_src_alpha_blend;
-            m_b_state = nullptr;
-        }
-        
-        if (m_b_desc.RenderTarget[n].DestBlendAlpha != dx_dst_alpha_blend)
-        {
-            m_b_desc.RenderTarget[n].DestBlendAlpha = dx_dst_alpha_blend;
-            m_b_state = nullptr;
-        }
-        
-        if (m_b_desc.RenderTarget[n].BlendOpAlpha != dx_blend_alpha_op)
-        {
-            m_b_desc.RenderTarget[n].BlendOpAlpha = dx_blend_alpha_op;
-            m_b_state = nullptr;
-        }
+        D3D11_RENDER_TARGET_BLEND_DESC target = blendDesc().RenderTarget[n];
+        target.BlendEnable = enable;
+        target.SrcBlend = enable ? toDX(src_color) : D3D11_BLEND_ONE;
+        target.DestBlend = enable ? toDX(dst_color) : D3D11_BLEND_ONE;
+        target.BlendOp = enable ? toDX(bf_color) : D3D11_BLEND_OP_ADD;
+        target.SrcBlendAlpha = enable ? toDX(src_alpha) : D3D11_BLEND_ONE;
+        target.DestBlendAlpha = enable ? toDX(dst_alpha) : D3D11_BLEND_ONE;
+        target.BlendOpAlpha = enable ? toDX(bf_alpha) : D3D11_BLEND_OP_ADD;
 
-        if (rt_index < 0)
+        const int last = (rt_index < 0) ? D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT : n + 1;
+        for (int i = n; i < last; i++)
         {
-            for (int i = 1; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
-                m_b_desc.RenderTarget[i] = m_b_desc.RenderTarget[0];
+            if (!sameTarget(blendDesc().RenderTarget[i], target))
+            {
+                editBlend().RenderTarget[i] = target;
+            }
         }
     }
 
     void States::setColorWrite(bool enable, int rt_index)
     {
-        if (m_b_desc.IndependentBlendEnable != (rt_index >= 0))
+        if (static_cast<bool>(blendDesc().IndependentBlendEnable) != (rt_index >= 0))
         {
-            m_b_desc.IndependentBlendEnable = (rt_index >= 0);
-            m_b_state = nullptr;
+            editBlend().IndependentBlendEnable = (rt_index >= 0);
         }
-        
-        int n = (rt_index < 0) ? 0 : rt_index;
-        if (static_cast<bool>(m_b_desc.RenderTarget[n].RenderTargetWriteMask) != enable)
-        {
-            m_b_desc.RenderTarget[n].RenderTargetWriteMask = enable ? D3D11_COLOR_WRITE_ENABLE_ALL : 0;
-            m_b_state = nullptr;
-        }
-        
-        if (rt_index < 0) 
+
+        const int n = (rt_index < 0) ? 0 : rt_index;
+        const UINT8 mask = enable ? D3D11_COLOR_WRITE_ENABLE_ALL : 0;
+
+        const int last = (rt_index < 0) ? D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT : n + 1;
+        for (int i = n; i < last; i++)
         {
-            for (int i = 1; i < D3D11_SIMULTANEOUS_RENDER_TARGET_COUNT; i++)
-                m_b_desc.RenderTarget[i] = m_b_desc.RenderTarget[0];
+            if (blendDesc().RenderTarget[i].RenderTargetWriteMask != mask)
+            {
+                editBlend().RenderTarget[i].RenderTargetWriteMask = mask;
+            }
         }
     }
 
     void States::validateStates()
     {
-        if (!m_r_state)
+        if (!m_changed)
         {
-            getD3DErr(m_device->CreateRasterizerState(&m_r_desc, &m_r_state));
-            m_deviceContext->RSSetState(m_r_state.Get());
+            return;
         }
-        
-        if (!m_d_state)
+
+        m_changed = false;
+        resolve();
+
+        const uint32_t binds = m_frameStats.binds;
+
+        if (m_current.r != m_bound.r)
         {
-            getD3DErr(m_device->CreateDepthStencilState(&m_d_desc, &m_d_state));
-            m_deviceContext->OMSetDepthStencilState(m_d_state.Get(), m_stencil_ref);
+            m_deviceContext->RSSetState(m_current.r->second.Get());
+            ++m_frameStats.binds;
         }
-        
-        if (!m_b_state)
+
+        if (m_current.d != m_bound.d || m_current.stencilRef != m_bound.stencilRef)
         {
-            getD3DErr(m_device->CreateBlendState(&m_b_desc, &m_b_state));
-            m_deviceContext->OMSetBlendState(m_b_state.Get(), nullptr, 0xffffffff);
+            m_deviceContext->OMSetDepthStencilState(m_current.d->second.Get(), m_current.stencilRef);
+            ++m_frameStats.binds;
         }
+
+        if (m_current.b != m_bound.b)
+        {
+            m_deviceContext->OMSetBlendState(m_current.b->second.Get(), nullptr, 0xffffffff);
+            ++m_frameStats.binds;
+        }
+
+        if (m_frameStats.binds == binds)
+        {
+            ++m_frameStats.filtered;
+        }
+
+        m_bound = m_current;
     }
 
     States::States(ID3D11Device* device, ID3D11DeviceContext* device_context)
@@ -335,6 +499,16 @@ namespace EProject
 
         m_states = std::make_unique<States>(m_dev.Get(), m_context.Get());
 
+        D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+        getD3DErr(m_dev->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options)));
+        if (!options.ConstantBufferOffsetting || !options.MapNoOverwriteOnDynamicConstantBuffer)
+        {
+            throw std::runtime_error("GDevice: constant buffer offsetting isn't supported");
+        }
+        getD3DErr(m_context.As(&m_context1));
+        m_constants = std::make_unique<ConstantRing>(this, 4 << 20);
+        m_inputLayouts = std::make_unique<InputLayoutCache>(this);
+
         D3D11_TEXTURE2D_DESC descDepth;
         ZeroMemory(&descDepth, sizeof(descDepth));
         descDepth.Width = m_lastWndSize.x;
@@ -504,12 +678,23 @@ namespace EProject
     {
         return m_context.Get();
     }
+#endif
 
     States* GDevice::getStates()
     {
         return m_states.get();
     }
 
+    ConstantRing* GDevice::getConstantRing()
+    {
+        return m_constants.get();
+    }
+
+    InputLayoutCache* GDevice::getInputLayouts()
+    {
+        return m_inputLayouts.get();
+    }
+
     FrameBufferPtr GDevice::getActiveFrameBuffer() const
     {
         return m_activeFbo.lock();
@@ -555,8 +740,12 @@ namespace EProject
         return std::make_shared<StructuredBuffer>(shared_from_this());
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     void GDevice::beginFrame()
     {
+        m_states->beginFrame();
+        m_constants->beginFrame();
+
         RECT rct;
         GetClientRect(m_hwnd, &rct);
         glm::ivec2 new_wnd_size = glm::ivec2(rct.right - rct.left, rct.bottom - rct.top);
@@ -592,12 +781,14 @@ namespace EProject
     {
         m_swapChain->Present(1, 0);
     }
+#endif
 
     bool GDevice::isSRGB() const
     {
         return m_isSrgb;
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     HWND GDevice::getWindow() const
     {
         return m_hwnd;
@@ -625,7 +816,6 @@ namespace EProject
 
     ShaderProgram::ShaderProgram(const GDevicePtr& device) : DeviceHolder(device)
     {
-        m_globals_dirty = false;
         m_selectedInstanceStep = 0;
     }
 
@@ -634,71 +824,93 @@ namespace EProject
         if (m_device->m_activeProgram == this) m_device->m_activeProgram = nullptr;
     }
 
-    bool ShaderProgram::compileFromFile(const ShaderInput& input)
+    namespace
     {
-        if (!std::filesystem::exists(input.filePath))
+        // Bytecode keyed by the source, its includes and the compile settings, warm starts skip D3DCompile
+        ShaderCache& getShaderCache()
         {
-            return false;
-        }
+            static ShaderCache cache(PathHandler::getCacheDir() / "Shaders", D3D_COMPILER_VERSION,
+                [](const ShaderCompileDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors)
+                {
+                    std::vector<D3D_SHADER_MACRO> macros;
+                    for (const auto& [name, value] : desc.defines)
+                    {
+                        macros.push_back({ name.c_str(), value.c_str() });
+                    }
+                    macros.push_back({ nullptr, nullptr });
 
-        ID3DBlob* compiledShader = nullptr;
-        ID3DBlob* errorMessages = nullptr;
-        
-        D3D_SHADER_MACRO defines[] =
-        {
-            "HLSL5", "1",
-            "DISABLE_WAVE_INTRINSICS", "1",
-            NULL, NULL
-        };
+                    ComPtr<ID3DBlob> code;
+                    ComPtr<ID3DBlob> messages;
 
-        int flags = 0;
+                    const HRESULT hr = D3DCompileFromFile(desc.filePath.wstring().c_str(), macros.data(), D3D_COMPILE_STANDARD_FILE_INCLUDE, desc.entryPoint.c_str(), desc.target.c_str(),
+                        desc.flags, 0, &code, &messages);
 
-        const char* target = input.target.c_str();
-        const char* entryPoint = input.entyPoint.c_str();
-        
-        HRESULT hr = (D3DCompileFromFile(input.filePath.c_str(), defines, D3D_COMPILE_STANDARD_FILE_INCLUDE, entryPoint, target,
-            flags, 0, &compiledShader, &errorMessages));
+                    if (FAILED(hr))
+                    {
+                        errors = messages ? static_cast<const char*>(messages->GetBufferPointer()) : "unknown error";
+                        return false;
+                    }
+
+                    const auto bytes = static_cast<const uint8_t*>(code->GetBufferPointer());
+                    bytecode.assign(bytes, bytes + code->GetBufferSize());
+                    return true;
+                });
 
-        if (FAILED(hr) && errorMessages)
+            return cache;
+        }
+    }
+
+    bool ShaderProgram::compileFromFile(const ShaderInput& input)
+    {
+        if (!std::filesystem::exists(input.filePath))
         {
-            const char* errorMsg = (const char*)errorMessages->GetBufferPointer();
-            
-            MessageBox(nullptr, (LPCWSTR)errorMsg, L"Shader Compilation Error", MB_RETRYCANCEL);
             return false;
         }
 
-        m_shaderData[int(input.type)] = compiledShader;
+        ShaderCompileDesc desc;
+        desc.filePath = input.filePath;
+        desc.entryPoint = input.entyPoint;
+        desc.target = input.target;
+        desc.defines = { { "HLSL5", "1" }, { "DISABLE_WAVE_INTRINSICS", "1" } };
 
-        //m_blob = compiledShader;
-
-        //else
-        //{
-        //    // Compress the shader
-        //    D3D_SHADER_DATA shaderData;
-        //    shaderData.pBytecode = compiledShader->GetBufferPointer();
-        //    shaderData.BytecodeLength = compiledShader->GetBufferSize();
-        //    ID3DBlobPtr compressedShader;
-        //    DXCall(D3DCompressShaders(1, &shaderData, D3D_COMPRESS_SHADER_KEEP_ALL_PARTS, &compressedShader));
+        std::vector<uint8_t> bytecode;
+        std::string errors;
+        if (!getShaderCache().get(desc, bytecode, errors))
+        {
+            MessageBoxA(nullptr, errors.c_str(), "Shader Compilation Error", MB_RETRYCANCEL);
+            return false;
+        }
 
-        //    // Create the cache directory if it doesn't exist
-        //    if (DirectoryExists(baseCacheDir.c_str()) == false)
-        //        Win32Call(CreateDirectory(baseCacheDir.c_str(), nullptr));
+        ID3DBlob* compiledShader = nullptr;
+        getD3DErr(D3DCreateBlob(bytecode.size(), &compiledShader));
+        memcpy(compiledShader->GetBufferPointer(), bytecode.data(), bytecode.size());
 
-        //    if (DirectoryExists(cacheDir.c_str()) == false)
-        //        Win32Call(CreateDirectory(cacheDir.c_str(), nullptr));
+        m_shaderData[int(input.type)] = compiledShader;
+        m_inputs.push_back(input);
 
-        //    File cacheFile(cacheName.c_str(), File::OpenWrite);
+        return true;
+    }
+#endif
 
-        //    // Write the compiled shader to disk
-        //    uint64 shaderSize = compressedShader->GetBufferSize();
-        //    cacheFile.Write(shaderSize, compressedShader->GetBufferPointer());
+    std::vector<std::filesystem::path> ShaderProgram::getSourceFiles() const
+    {
+        std::vector<std::filesystem::path> files;
 
-        //    return true;
-        //}
+        for (const auto& input : m_inputs)
+        {
+            for (const auto& path : collectIncludes(input.filePath))
+            {
+                if (std::find(files.begin(), files.end(), path) == files.end())
+                {
+                    files.push_back(path);
+                }
+            }
+        }
 
-        return true;
+        return files;
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     bool ShaderProgram::create()
     {        
         for (int i = 0; i < 6; ++i)
@@ -728,6 +940,13 @@ namespace EProject
                 case ShaderType::Vertex:
                 {
                     getD3DErr(getDevice()->getDX11Device()->CreateVertexShader(blobPtr, blobSize, nullptr, (ID3D11VertexShader**)tmp));
+
+                    ComPtr<ID3D10Blob> signature;
+                    getD3DErr(D3DGetInputSignatureBlob(blobPtr, blobSize, &signature));
+                    m_signature = m_device->getInputLayouts()->addSignature(signature->GetBufferPointer(), signature->GetBufferSize());
+                    m_inputLayout = nullptr;
+                    m_inputVertices = nullptr;
+                    m_inputInstances = nullptr;
                 } break;
                 case ShaderType::Hull:
                 {
@@ -821,30 +1040,22 @@ namespace EProject
             }
             
             const Layout* l = res_desc.Type == D3D_SIT_CBUFFER ? autoReflectCB(ref->GetConstantBufferByName(res_desc.Name)) : nullptr;
-            ShaderSlot& slot = m_slots[obtainSlotIdx(kind, std::string(res_desc.Name), l)];
+            const int slot_idx = obtainSlotIdx(kind, std::string(res_desc.Name), l);
+            ShaderSlot& slot = m_slots[slot_idx];
             slot.bindPoints[int(st)] = res_desc.BindPoint;
 
             if (slot.name == "Globals") 
             {
                 m_ub[int(st)] = std::make_shared<UniformBuffer>(m_device);
                 m_ub[int(st)]->setState(slot.layout, 1);
-                slot.buffer = m_ub[int(st)]->getHandle();
+                m_globalsSlot[int(st)] = slot_idx;
             }
         }
     }
 
     void ShaderProgram::activateProgram()
     {
-        if (m_globals_dirty)
-        {
-            for (int i = 0; i < 6; i++)
-            {
-                if (m_ub[i])
-                {
-                    m_ub[i]->validateDynamicData();
-                }
-            }
-        }
+        uploadGlobals();
 
         if (!isProgramActive()) 
         {
@@ -852,7 +1063,14 @@ namespace EProject
             
             for (const auto& slot : m_slots)
             {
-                slot.select(m_device->getDX11DeviceContext());
+                if (slot.numConstants)
+                {
+                    slot.selectRange(m_device->m_context1.Get());
+                }
+                else
+                {
+                    slot.select(m_device->getDX11DeviceContext());
+                }
             }
                         
             selectInputBuffers();
@@ -873,6 +1091,76 @@ namespace EProject
         }
     }
 
+    void ShaderProgram::uploadGlobals()
+    {
+        const GlobalsRange range = prepareGlobals();
+        if (range.stages)
+        {
+            m_device->getConstantRing()->flush();
+            bindGlobals(range);
+        }
+    }
+
+    ShaderProgram::GlobalsRange ShaderProgram::prepareGlobals()
+    {
+        ConstantRing* ring = m_device->getConstantRing();
+        GlobalsRange range;
+
+        // Ring space of older frames gets reused, the first draw of a frame writes everything again
+        const bool stale = m_globalsFrame != ring->getFrame();
+        if (!m_globals_dirty && !stale)
+        {
+            return range;
+        }
+
+        m_globals_dirty = false;
+        m_globalsFrame = ring->getFrame();
+
+        for (int i = 0; i < 6; i++)
+        {
+            if (!m_ub[i] || !(m_ub[i]->m_dirty || stale))
+            {
+                continue;
+            }
+
+            m_ub[i]->m_dirty = false;
+
+            const auto& data = m_ub[i]->m_data;
+            ConstantRing::Allocation a = ring->allocate(int(data.size()));
+            memcpy(a.data, data.data(), data.size());
+
+            // A later allocation may grow the ring into a new buffer, this one stays where it is
+            range.buffers[i] = ring->getHandle();
+            range.firstConstant[i] = UINT(a.offset / 16);
+            range.numConstants[i] = UINT(a.size / 16);
+            range.stages |= 1u << i;
+        }
+
+        return range;
+    }
+
+    void ShaderProgram::bindGlobals(const GlobalsRange& range)
+    {
+        for (int i = 0; i < 6; i++)
+        {
+            if (!(range.stages & (1u << i)))
+            {
+                continue;
+            }
+
+            ShaderSlot& slot = m_slots[m_globalsSlot[i]];
+            slot.buffer = range.buffers[i];
+            slot.firstConstant = range.firstConstant[i];
+            slot.numConstants = range.numConstants[i];
+
+            // Otherwise activateProgram binds every slot anyway
+            if (isProgramActive())
+            {
+                slot.selectRange(m_device->m_context1.Get());
+            }
+        }
+    }
+
     void ShaderProgram::setInputBuffers(const VertexBufferPtr& vbo, const IndexBufferPtr& ibo, const VertexBufferPtr& instances, int instanceStepRate)
     {
         m_selectedVBO = vbo;
@@ -887,10 +1175,34 @@ namespace EProject
 
     void ShaderProgram::drawIndexed(PrimTopology pt, const DrawIndexedCmd& cmd)
     {
+        drawIndexed(pt, int(cmd.startIndex), int(cmd.indexCount), int(cmd.instanceCount), cmd.baseVertex, int(cmd.baseInstance));
     }
 
     void ShaderProgram::drawIndexed(PrimTopology pt, const std::vector<DrawIndexedCmd>& cmd_buf)
     {
+        if (cmd_buf.empty())
+        {
+            return;
+        }
+
+        activateProgram();
+        selectTopology(pt);
+
+        m_device->getStates()->validateStates();
+
+        // No multi draw without indirect buffers in D3D11, bindings and states are validated once for the list
+        ID3D11DeviceContext* context = m_device->getDX11DeviceContext();
+        for (const auto& cmd : cmd_buf)
+        {
+            if (cmd.instanceCount)
+            {
+                context->DrawIndexedInstanced(cmd.indexCount, cmd.instanceCount, cmd.startIndex, cmd.baseVertex, cmd.baseInstance);
+            }
+            else
+            {
+                context->DrawIndexed(cmd.indexCount, cmd.startIndex, cmd.baseVertex);
+            }
+        }
     }
 
     void ShaderProgram::drawIndexed(PrimTopology pt, int index_start, int index_count, int instance_count, int base_vertex, int base_instance)
@@ -936,93 +1248,121 @@ namespace EProject
         }
     }
 
+#endif
+
     void ShaderProgram::setValue(const char* name, float v)
     {
-        for (int i = 0; i < 6; i++)
-        {
-            if (m_ub[i])
-            {
-                m_ub[i]->setValue(name, v);
-            }
-        }
-
-        m_globals_dirty = true;
+        ShaderValueHandle h;
+        resolveValue(name, sizeof(v), h);
+        writeValue(h, &v, sizeof(v));
     }
 
     void ShaderProgram::setValue(const char* name, int i)
     {
-        for (int i = 0; i < 6; i++)
-        {
-            if (m_ub[i])
-            {
-                m_ub[i]->setValue(name, i);
-            }
-        }
-
-        m_globals_dirty = true;
+        ShaderValueHandle h;
+        resolveValue(name, sizeof(i), h);
+        writeValue(h, &i, sizeof(i));
     }
 
     void ShaderProgram::setValue(const char* name, const glm::vec2& v)
     {
-        for (int i = 0; i < 6; i++)
-        {
-            if (m_ub[i])
-            {
-                m_ub[i]->setValue(name, v);
-            }
-        }
-
-        m_globals_dirty = true;
+        ShaderValueHandle h;
+        resolveValue(name, sizeof(v), h);
+        writeValue(h, &v, sizeof(v));
     }
 
     void ShaderProgram::setValue(const char* name, const glm::vec3& v)
     {
-        for (int i = 0; i < 6; i++)
-        {
-            if (m_ub[i])
-            {
-                m_ub[i]->setValue(name, v);
-            }
-        }
-
-        m_globals_dirty = true;
+        ShaderValueHandle h;
+        resolveValue(name, sizeof(v), h);
+        writeValue(h, &v, sizeof(v));
     }
 
     void ShaderProgram::setValue(const char* name, const glm::vec4& v)
+    {
+        ShaderValueHandle h;
+        resolveValue(name, sizeof(v), h);
+        writeValue(h, &v, sizeof(v));
+    }
+
+    void ShaderProgram::setValue(const char* name, const glm::mat4& m)
+    {
+        ShaderValueHandle h;
+        resolveValue(name, sizeof(m), h);
+        writeValue(h, &m, sizeof(m));
+    }
+
+    void ShaderProgram::setResource(const char* name, const UniformBufferPtr& ubo)
+    {
+        setResource(findResource(name), ubo);
+    }
+
+    void ShaderProgram::setResource(const char* name, const StructuredBufferPtr& sbo)
+    {
+        setResource(findResource(name), sbo);
+    }
+
+    void ShaderProgram::setResource(const char* name, const GPUTexture2DPtr& tex, bool as_array, bool as_cubemap)
+    {
+        setResource(findResource(name), tex, as_array, as_cubemap);
+    }
+
+    void ShaderProgram::setResource(const char* name, const Sampler& s)
+    {
+        setResource(findResource(name), s);
+    }
+
+#ifdef EPROJECT_GAPI_D3D11
+    void ShaderProgram::resolveValue(const char* name, int size, ShaderValueHandle& h)
     {
         for (int i = 0; i < 6; i++)
         {
-            if (m_ub[i])
+            if (!m_ub[i])
             {
-                m_ub[i]->setValue(name, v);
+                continue;
+            }
+
+            for (const auto& f : m_ub[i]->m_layout->fields)
+            {
+                if (f.name == name)
+                {
+                    assert(size <= f.getSize());
+                    h.offsets[i] = f.offset;
+                    h.size = f.getSize();
+                    h.stageMask |= 1u << i;
+                    break;
+                }
             }
         }
-
-        m_globals_dirty = true;
     }
 
-    void ShaderProgram::setValue(const char* name, const glm::mat4& m)
+    void ShaderProgram::writeValue(const ShaderValueHandle& h, const void* data, int size)
     {
+        assert(size <= h.size || !h.stageMask);
         for (int i = 0; i < 6; i++)
         {
-            if (m_ub[i])
+            if (h.stageMask & (1u << i))
             {
-                m_ub[i]->setValue(name, m);
+                m_ub[i]->setValue(&m_ub[i]->m_data[h.offsets[i]], data, size);
             }
         }
 
         m_globals_dirty = true;
     }
 
-    void ShaderProgram::setResource(const char* name, const UniformBufferPtr& ubo)
+    ShaderResource ShaderProgram::findResource(const char* name)
+    {
+        return ShaderResource{ findSlot(name) };
+    }
+
+    void ShaderProgram::setResource(const ShaderResource& h, const UniformBufferPtr& ubo)
     {
-        int idx = findSlot(name);
-        if (idx < 0)
+        if (!h.isValid())
         {
             return;
         }
         
-        ShaderSlot& slot = m_slots[idx];
+        ShaderSlot& slot = m_slots[h.slot];
         if ((slot.buffer ? slot.buffer.Get() : nullptr) != (ubo ? ubo->m_handle.Get() : nullptr)) {
             slot.buffer = ubo ? ubo->m_handle : nullptr;
             if (isProgramActive())
@@ -1032,15 +1372,14 @@ namespace EProject
         }
     }
 
-    void ShaderProgram::setResource(const char* name, const StructuredBufferPtr& sbo)
+    void ShaderProgram::setResource(const ShaderResource& h, const StructuredBufferPtr& sbo)
     {
-        int idx = findSlot(name);
-        if (idx < 0)
+        if (!h.isValid())
         {
             return;
         }
         
-        ShaderSlot& slot = m_slots[idx];
+        ShaderSlot& slot = m_slots[h.slot];
         ComPtr<ID3D11ShaderResourceView> srv = sbo ? sbo->getShaderResource() : nullptr;
         
         if ((slot.view ? slot.view.Get() : nullptr) != srv.Get())
@@ -1053,15 +1392,14 @@ namespace EProject
         }
     }
 
-    void ShaderProgram::setResource(const char* name, const GPUTexture2DPtr& tex, bool as_array, bool as_cubemap)
+    void ShaderProgram::setResource(const ShaderResource& h, const GPUTexture2DPtr& tex, bool as_array, bool as_cubemap)
     {
-        int idx = findSlot(name);
-        if (idx < 0)
+        if (!h.isValid())
         {
             return;
         }
         
-        ShaderSlot& slot = m_slots[idx];
+        ShaderSlot& slot = m_slots[h.slot];
         ComPtr<ID3D11ShaderResourceView> srv = tex ? tex->getShaderResource(as_array, as_cubemap) : nullptr;
         if ((slot.view ? slot.view.Get() : nullptr) != srv.Get())
         {
@@ -1073,16 +1411,14 @@ namespace EProject
         }
     }
 
-    void ShaderProgram::setResource(const char* name, const Sampler& s)
+    void ShaderProgram::setResource(const ShaderResource& h, const Sampler& s)
     {
-        int idx = findSlot(name);
-
-        if (idx < 0)
+        if (!h.isValid())
         {
             return;
         }
 
-        ShaderSlot& slot = m_slots[idx];
+        ShaderSlot& slot = m_slots[h.slot];
         ID3D11SamplerState* new_sampler = m_device->obtainSampler(s);
 
         if (slot.sampler != new_sampler) 
@@ -1112,7 +1448,14 @@ namespace EProject
 
         const Layout* vl = m_selectedVBO ? m_selectedVBO->getLayout() : nullptr;
         const Layout* il = m_selectedInstances ? m_selectedInstances->getLayout() : nullptr;
-        m_device->getDX11DeviceContext()->IASetInputLayout(getLayout(vl, il, m_selectedInstanceStep));
+        if (vl != m_inputVertices || il != m_inputInstances || m_selectedInstanceStep != m_inputStepRate || !m_inputLayout)
+        {
+            m_inputLayout = m_device->getInputLayouts()->get(m_signature, vl, il, m_selectedInstanceStep);
+            m_inputVertices = vl;
+            m_inputInstances = il;
+            m_inputStepRate = m_selectedInstanceStep;
+        }
+        m_device->getDX11DeviceContext()->IASetInputLayout(m_inputLayout);
     }
 
     void ShaderProgram::selectTopology(PrimTopology pt)
@@ -1135,27 +1478,6 @@ namespace EProject
         return  m_device->m_activeProgram == this;
     }
 
-    ID3D11InputLayout* ShaderProgram::getLayout(const Layout* vertices, const Layout* instances, int step_rate)
-    {
-        for (const auto& l : m_layouts)
-        {
-            if ((l.vertices == vertices) && (l.instances == instances) && (l.step_rate == step_rate))
-            {
-                return l.m_dx_layout.Get();
-            }
-        }
-        
-        InputLayoutData new_l;
-        new_l.vertices = vertices;
-        new_l.instances = instances;
-        new_l.step_rate = step_rate;        
-        new_l.rebuildLayout(m_device->getDX11Device(), m_shaderCode[int(ShaderType::Vertex)]);
-        
-        m_layouts.push_back(new_l);
-
-        return new_l.m_dx_layout.Get();
-    }
-
     int ShaderProgram::obtainSlotIdx(SlotKind kind, const std::string& name, const Layout* layout)
     {
         if (name != "Globals")
@@ -1180,7 +1502,7 @@ namespace EProject
         return static_cast<int>(m_slots.size() - 1);
     }
 
-    int ShaderProgram::findSlot(const char* name)
+    int ShaderProgram::findSlot(const char* name) const
     {
         for (size_t i = 0; i < m_slots.size(); i++)
         {
@@ -1192,6 +1514,7 @@ namespace EProject
 
         return -1;
     }
+#endif
 
     DeviceHolder::DeviceHolder(const GDevicePtr& device) : m_device(device)
     {
@@ -1203,6 +1526,7 @@ namespace EProject
         return m_device;
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     VertexBuffer::VertexBuffer(const GDevicePtr& device) : DeviceHolder(device)
     {
         m_vertCount = 0;
@@ -1254,6 +1578,7 @@ namespace EProject
         box.back = 1;
         m_device->getDX11DeviceContext()->UpdateSubresource(m_handle.Get(), 0, &box, data, 0, 0);
     }
+#endif
 
     int VertexBuffer::getVertexCount() const
     {
@@ -1265,6 +1590,7 @@ namespace EProject
         return m_layout;
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     IndexBuffer::IndexBuffer(const GDevicePtr& device) : DeviceHolder(device)
     {
         m_indCount = 0;
@@ -1309,6 +1635,7 @@ namespace EProject
         box.back = 1;
         m_device->getDX11DeviceContext()->UpdateSubresource(m_handle.Get(), 0, &box, data, 0, 0);
     }
+#endif
 
     int IndexBuffer::getIndexCount() const
     {
@@ -1376,19 +1703,367 @@ namespace EProject
         return n;
     }
 
-    LayoutSelectorInstance globalLS;
+    const Layout* internLayout(const Layout& layout)
+    {
+        struct LayoutHash
+        {
+            std::size_t operator()(const Layout& l) const
+            {
+                return l.hash();
+            }
+        };
+
+        static std::mutex mutex;
+        static std::unordered_map<Layout, std::unique_ptr<Layout>, LayoutHash> layouts;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& interned = layouts[layout];
+        if (!interned)
+        {
+            interned = std::make_unique<Layout>(layout);
+        }
+
+        return interned.get();
+    }
+
     LayoutSelector* getLayoutSelector()
     {
-        return globalLS.reset();
+        thread_local LayoutSelectorInstance selector;
+        return selector.reset();
+    }
+
+    namespace
+    {
+        constexpr uint32_t cInputLayoutsMagic = 0x434C4945;   // 'EILC'
+        constexpr uint32_t cInputLayoutsVersion = 1;
+
+        // Smallest serialized signature, entry and layout field
+        constexpr size_t cMinSignatureSize = sizeof(uint64_t) + sizeof(uint32_t);
+        constexpr size_t cMinEntrySize = sizeof(uint64_t) + 2 * sizeof(uint8_t) + sizeof(int32_t);
+        constexpr size_t cMinFieldSize = sizeof(uint32_t) + 4 * sizeof(int32_t) + sizeof(uint8_t);
+
+        class CacheWriter
+        {
+        public:
+            void bytes(const void* data, size_t size)
+            {
+                const auto ptr = static_cast<const uint8_t*>(data);
+                m_data.insert(m_data.end(), ptr, ptr + size);
+            }
+
+            template<typename T>
+            void pod(const T& value)
+            {
+                bytes(&value, sizeof(T));
+            }
+
+            void string(const std::string& str)
+            {
+                pod(uint32_t(str.size()));
+                bytes(str.data(), str.size());
+            }
+
+            void layout(const Layout* l)
+            {
+                pod(uint8_t(l ? 1 : 0));
+                if (!l)
+                {
+                    return;
+                }
+
+                pod(int32_t(l->stride));
+                pod(uint32_t(l->fields.size()));
+                for (const auto& f : l->fields)
+                {
+                    string(f.name);
+                    pod(int32_t(f.type));
+                    pod(int32_t(f.num_fields));
+                    pod(uint8_t(f.do_norm));
+                    pod(int32_t(f.offset));
+                    pod(int32_t(f.array_size));
+                }
+            }
+
+            const std::vector<uint8_t>& data() const { return m_data; }
+
+        private:
+            std::vector<uint8_t> m_data;
+        };
+
+        class CacheReader
+        {
+        public:
+            explicit CacheReader(const std::vector<uint8_t>& data) : m_data(data) {}
+
+            const uint8_t* bytes(size_t size)
+            {
+                if (size > m_data.size() - m_pos)
+                {
+                    throw std::runtime_error("InputLayoutCache: Unexpected end of data");
+                }
+
+                const uint8_t* ptr = m_data.data() + m_pos;
+                m_pos += size;
+                return ptr;
+            }
+
+            template<typename T>
+            T pod()
+            {
+                T value;
+                memcpy(&value, bytes(sizeof(T)), sizeof(T));
+                return value;
+            }
+
+            // Element count, checked against the bytes left so a corrupt one doesn't allocate
+            size_t count(size_t minElementSize)
+            {
+                const size_t n = pod<uint32_t>();
+                if (n > (m_data.size() - m_pos) / minElementSize)
+                {
+                    throw std::runtime_error("InputLayoutCache: Unexpected end of data");
+                }
+
+                return n;
+            }
+
+            std::string string()
+            {
+                const auto size = pod<uint32_t>();
+                const auto ptr = reinterpret_cast<const char*>(bytes(size));
+                return std::string(ptr, ptr + size);
+            }
+
+            const Layout* layout()
+            {
+                if (!pod<uint8_t>())
+                {
+                    return nullptr;
+                }
+
+                Layout l;
+                l.stride = pod<int32_t>();
+                l.fields.resize(count(cMinFieldSize));
+                for (auto& f : l.fields)
+                {
+                    f.name = string();
+                    f.type = LayoutType(pod<int32_t>());
+                    f.num_fields = pod<int32_t>();
+                    f.do_norm = pod<uint8_t>() != 0;
+                    f.offset = pod<int32_t>();
+                    f.array_size = pod<int32_t>();
+
+                    if (f.type < LayoutType::Byte || f.type > LayoutType::Float || f.num_fields < 1 || f.num_fields > 4)
+                    {
+                        throw std::runtime_error("InputLayoutCache: Bad layout field");
+                    }
+                }
+
+                return internLayout(l);
+            }
+
+        private:
+            const std::vector<uint8_t>& m_data;
+            size_t m_pos = 0;
+        };
+    }
+
+    InputLayoutCache::InputLayoutCache(GDevice* device) : m_device(device)
+    {
+    }
+
+    bool InputLayoutCache::Key::operator==(const Key& k) const
+    {
+        return signature == k.signature && vertices == k.vertices && instances == k.instances && step_rate == k.step_rate;
+    }
+
+    std::size_t InputLayoutCache::KeyHash::operator()(const Key& k) const
+    {
+        std::size_t h = std::hash<uint64_t>()(k.signature);
+        h = h * 31 + std::hash<const Layout*>()(k.vertices);
+        h = h * 31 + std::hash<const Layout*>()(k.instances);
+        return h * 31 + std::hash<int>()(k.step_rate);
+    }
+
+    uint64_t InputLayoutCache::addSignature(const void* data, size_t size)
+    {
+        const auto p = static_cast<const uint8_t*>(data);
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++)
+        {
+            h = (h ^ p[i]) * 1099511628211ull;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto& bytes = m_signatures[h];
+        if (bytes.empty())
+        {
+            bytes.assign(reinterpret_cast<const char*>(data), size);
+        }
+
+        return h;
+    }
+
+    InputLayoutCache::Handle InputLayoutCache::get(uint64_t signature, const Layout* vertices, const Layout* instances, int step_rate)
+    {
+        if (!vertices && !instances)
+        {
+            return nullptr;
+        }
+
+        // The step rate only matters with per instance data
+        const Key key = { signature, vertices, instances, instances ? step_rate : 0 };
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entries.find(key);
+        if (it != m_entries.end())
+        {
+            m_stats.hits++;
+            return getHandle(it->second);
+        }
+
+        Entry entry;
+        if (!create(key, entry))
+        {
+            throw std::runtime_error("InputLayoutCache: Layout doesn't match the input signature");
+        }
+        m_stats.created++;
+
+        return getHandle(m_entries.emplace(key, std::move(entry)).first->second);
+    }
+
+    bool InputLayoutCache::save(const std::filesystem::path& path) const
+    {
+        CacheWriter w;
+        w.pod(cInputLayoutsMagic);
+        w.pod(cInputLayoutsVersion);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            w.pod(uint32_t(m_signatures.size()));
+            for (const auto& [hash, bytes] : m_signatures)
+            {
+                w.pod(hash);
+                w.string(bytes);
+            }
+
+            w.pod(uint32_t(m_entries.size()));
+            for (const auto& entry : m_entries)
+            {
+                w.pod(entry.first.signature);
+                w.layout(entry.first.vertices);
+                w.layout(entry.first.instances);
+                w.pod(int32_t(entry.first.step_rate));
+            }
+        }
+
+        // A run that dies halfway through leaves the previous file in place
+        std::error_code ec;
+        if (path.has_parent_path())
+        {
+            std::filesystem::create_directories(path.parent_path(), ec);
+        }
+
+        auto tmp = path;
+        tmp += ".tmp";
+        {
+            std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(w.data().data()), std::streamsize(w.data().size()));
+            if (!file)
+            {
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tmp, path, ec);
+        return !ec;
+    }
+
+    bool InputLayoutCache::load(const std::filesystem::path& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file)
+        {
+            return false;
+        }
+
+        const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        // Parsed in full before anything is merged, a corrupt file leaves the cache as it was
+        std::vector<std::pair<uint64_t, std::string>> signatures;
+        std::vector<Key> keys;
+
+        try
+        {
+            CacheReader r(data);
+            if (r.pod<uint32_t>() != cInputLayoutsMagic || r.pod<uint32_t>() != cInputLayoutsVersion)
+            {
+                return false;
+            }
+
+            signatures.resize(r.count(cMinSignatureSize));
+            for (auto& [hash, bytes] : signatures)
+            {
+                hash = r.pod<uint64_t>();
+                bytes = r.string();
+            }
+
+            keys.resize(r.count(cMinEntrySize));
+            for (auto& key : keys)
+            {
+                key.signature = r.pod<uint64_t>();
+                key.vertices = r.layout();
+                key.instances = r.layout();
+                key.step_rate = r.pod<int32_t>();
+            }
+        }
+        catch (const std::exception&)
+        {
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (auto& [hash, bytes] : signatures)
+        {
+            m_signatures.emplace(hash, std::move(bytes));
+        }
+
+        for (const auto& key : keys)
+        {
+            if (m_entries.count(key) || !m_signatures.count(key.signature))
+            {
+                continue;
+            }
+
+            // A layout the device rejects (stale driver or shader) is created on use again, or not at all
+            Entry entry;
+            if (!create(key, entry))
+            {
+                continue;
+            }
+
+            m_entries.emplace(key, std::move(entry));
+            m_stats.loaded++;
+        }
+
+        return true;
+    }
+
+    size_t InputLayoutCache::size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
     }
 
-    ShaderProgram::InputLayoutData::InputLayoutData()
+    InputLayoutCache::Stats InputLayoutCache::getStats() const
     {
-        vertices = nullptr;
-        instances = nullptr;
-        step_rate = 1;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     DXGI_FORMAT ConvertToDX(const LayoutField& l)
     {
         assert((l.num_fields > 0) && (l.num_fields < 5));
@@ -1438,12 +2113,12 @@ namespace EProject
         }
     }
 
-    void ShaderProgram::InputLayoutData::rebuildLayout(ID3D11Device* device, const std::string& shader_code)
+    bool InputLayoutCache::create(const Key& key, Entry& entry)
     {
         std::vector<D3D11_INPUT_ELEMENT_DESC> descs = {};
-        if (vertices)
+        if (key.vertices)
         {
-            for (const auto& f : vertices->fields)
+            for (const auto& f : key.vertices->fields)
             {
                 D3D11_INPUT_ELEMENT_DESC d = {};
                 d.SemanticName = f.name.c_str();
@@ -1456,9 +2131,9 @@ namespace EProject
                 descs.push_back(d);
             }
         }
-        if (instances) 
+        if (key.instances) 
         {
-            for (const auto& f : instances->fields)
+            for (const auto& f : key.instances->fields)
             {
                 D3D11_INPUT_ELEMENT_DESC d = {};
                 d.SemanticName = f.name.c_str();
@@ -1467,18 +2142,19 @@ namespace EProject
                 d.InputSlot = 1;
                 d.AlignedByteOffset = f.offset;
                 d.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
-                d.InstanceDataStepRate = step_rate;
+                d.InstanceDataStepRate = key.step_rate;
                 descs.push_back(d);
             }
         }
-        if (descs.size())
-        {
-            getD3DErr(device->CreateInputLayout(descs.data(), UINT(descs.size()), shader_code.data(), shader_code.size(), &m_dx_layout));
-        }
-        else 
-        {
-            m_dx_layout = nullptr;
-        }
+
+        // Validated against the input signature alone, any vertex shader with it can use the layout
+        const std::string& signature = m_signatures.at(key.signature);
+        return SUCCEEDED(m_device->getDX11Device()->CreateInputLayout(descs.data(), UINT(descs.size()), signature.data(), signature.size(), &entry.layout));
+    }
+
+    InputLayoutCache::Handle InputLayoutCache::getHandle(const Entry& entry)
+    {
+        return entry.layout.Get();
     }
 
     void ShaderProgram::ShaderSlot::select(ID3D11DeviceContext* dev) const
@@ -1553,6 +2229,19 @@ namespace EProject
         }
     }
 
+    void ShaderProgram::ShaderSlot::selectRange(ID3D11DeviceContext1* dev) const
+    {
+        ID3D11Buffer* b = buffer.Get();
+
+        if (bindPoints[int(ShaderType::Vertex)] >= 0) dev->VSSetConstantBuffers1(bindPoints[int(ShaderType::Vertex)], 1, &b, &firstConstant, &numConstants);
+        if (bindPoints[int(ShaderType::Hull)] >= 0) dev->HSSetConstantBuffers1(bindPoints[int(ShaderType::Hull)], 1, &b, &firstConstant, &numConstants);
+        if (bindPoints[int(ShaderType::Domain)] >= 0) dev->DSSetConstantBuffers1(bindPoints[int(ShaderType::Domain)], 1, &b, &firstConstant, &numConstants);
+        if (bindPoints[int(ShaderType::Geometry)] >= 0) dev->GSSetConstantBuffers1(bindPoints[int(ShaderType::Geometry)], 1, &b, &firstConstant, &numConstants);
+        if (bindPoints[int(ShaderType::Pixel)] >= 0) dev->PSSetConstantBuffers1(bindPoints[int(ShaderType::Pixel)], 1, &b, &firstConstant, &numConstants);
+        if (bindPoints[int(ShaderType::Compute)] >= 0) dev->CSSetConstantBuffers1(bindPoints[int(ShaderType::Compute)], 1, &b, &firstConstant, &numConstants);
+    }
+#endif
+
     UniformBuffer::UniformBuffer(const GDevicePtr& device) : DeviceHolder(device)
     {
         m_elements_count = 0;
@@ -1580,6 +2269,7 @@ namespace EProject
         return nullptr;
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     void UniformBuffer::setState(const Layout* layout, int elemets_count, const void* data)
     {
         m_layout = layout;
@@ -1614,6 +2304,7 @@ namespace EProject
         
         m_dirty = false;
     }
+#endif
 
     void UniformBuffer::setSubData(int start_element, int num_elements, const void* data)
     {
@@ -1675,6 +2366,7 @@ namespace EProject
         }
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     void UniformBuffer::validateDynamicData()
     {
         if (!m_dirty)
@@ -1689,12 +2381,119 @@ namespace EProject
         memcpy(map_res.pData, m_data.data(), m_data.size());
         m_device->getDX11DeviceContext()->Unmap(m_handle.Get(), 0);
     }
+#endif
 
     const Layout* UniformBuffer::getLayout() const
     {
         return nullptr;
     }
 
+    ConstantRing::ConstantRing(GDevice* device, int capacity) : m_device(device)
+    {
+        m_shadow.resize(capacity);
+        createBuffer();
+    }
+
+    ConstantRing::Allocation ConstantRing::allocate(int size)
+    {
+        const int aligned = (size + cAlignment - 1) / cAlignment * cAlignment;
+
+        // Allocations never straddle the end, the tail that doesn't fit is charged to this frame
+        bool wrap = m_head + aligned > getCapacity();
+        int skipped = wrap ? getCapacity() - m_head : 0;
+        if (m_used + skipped + aligned > getCapacity())
+        {
+            grow(aligned);
+            wrap = false;
+            skipped = 0;
+        }
+
+        if (wrap)
+        {
+            flush();
+            m_head = 0;
+            m_flushed = 0;
+        }
+
+        Allocation a;
+        a.offset = m_head;
+        a.size = aligned;
+        a.data = &m_shadow[m_head];
+
+        m_head += aligned;
+        m_used += skipped + aligned;
+        m_frameBytes[m_frame % cFramesInFlight] += skipped + aligned;
+        return a;
+    }
+
+    void ConstantRing::beginFrame()
+    {
+        m_frame++;
+        int& retired = m_frameBytes[m_frame % cFramesInFlight];
+        m_used -= retired;
+        retired = 0;
+    }
+
+    uint64_t ConstantRing::getFrame() const
+    {
+        return m_frame;
+    }
+
+    int ConstantRing::getCapacity() const
+    {
+        return int(m_shadow.size());
+    }
+
+    void ConstantRing::grow(int min_free)
+    {
+        // Whatever is in flight stays in the old buffer, bindings keep it alive
+        flush();
+
+        const int capacity = glm::max(getCapacity() * 2, getCapacity() + min_free);
+
+        m_shadow.assign(capacity, 0);
+        m_head = 0;
+        m_flushed = 0;
+        m_used = 0;
+        m_frameBytes.fill(0);
+        createBuffer();
+    }
+
+#ifdef EPROJECT_GAPI_D3D11
+    void ConstantRing::createBuffer()
+    {
+        D3D11_BUFFER_DESC desc = {};
+        desc.ByteWidth = UINT(m_shadow.size());
+        desc.Usage = D3D11_USAGE_DYNAMIC;
+        desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+        desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+        m_handle = nullptr;
+        getD3DErr(m_device->getDX11Device()->CreateBuffer(&desc, nullptr, &m_handle));
+        m_discard = true;
+    }
+
+    void ConstantRing::flush()
+    {
+        if (m_flushed == m_head)
+        {
+            return;
+        }
+
+        // No overwrite lets the GPU keep reading what earlier draws were bound to
+        D3D11_MAPPED_SUBRESOURCE map_res = {};
+        getD3DErr(m_device->getDX11DeviceContext()->Map(m_handle.Get(), 0, m_discard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE, 0, &map_res));
+        memcpy(static_cast<uint8_t*>(map_res.pData) + m_flushed, &m_shadow[m_flushed], size_t(m_head) - m_flushed);
+        m_device->getDX11DeviceContext()->Unmap(m_handle.Get(), 0);
+
+        m_discard = false;
+        m_flushed = m_head;
+    }
+
+    ID3D11Buffer* ConstantRing::getHandle() const
+    {
+        return m_handle.Get();
+    }
+
     ComPtr<ID3D11Buffer> UniformBuffer::getHandle()
     {
         return m_handle;
@@ -1781,6 +2580,7 @@ namespace EProject
         memcpy(data, map.pData, m_vert_count * m_stride);
         m_device->getDX11DeviceContext()->Unmap(tmp_buf.Get(), 0);
     }
+#endif
 
     int StructuredBuffer::getStride() const
     {
@@ -1792,6 +2592,7 @@ namespace EProject
         return m_vert_count;
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     ComPtr<ID3D11ShaderResourceView> StructuredBuffer::getShaderResource()
     {
         if (!m_vert_count)
@@ -1829,6 +2630,7 @@ namespace EProject
 
         return m_uav;
     }
+#endif
 
     GPUTexture2D::GPUTexture2D(const GDevicePtr& device) : DeviceHolder(device)
     {
@@ -1858,6 +2660,7 @@ namespace EProject
         return m_mips_count;
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     void GPUTexture2D::setState(TextureFmt fmt, int mip_levels)
     {
         m_fmt = fmt;
@@ -1918,17 +2721,23 @@ namespace EProject
             desc.MiscFlags |= D3D11_RESOURCE_MISC_GENERATE_MIPS;
         }
 
-        if (data)
+        // Initial data must cover every subresource, with mips only the top level is given
+        if (data && m_mips_count == 1)
         {
             D3D11_SUBRESOURCE_DATA d3ddata = {};
             d3ddata.pSysMem = data;
-            d3ddata.SysMemPitch = getPixelsSize(m_fmt) * m_size.x;
-            d3ddata.SysMemSlicePitch = d3ddata.SysMemPitch * m_size.y;
+            d3ddata.SysMemPitch = getRowPitch(m_fmt, m_size.x);
+            d3ddata.SysMemSlicePitch = getSlicePitch(m_fmt, m_size);
             getD3DErr(m_device->getDX11Device()->CreateTexture2D(&desc, &d3ddata, &m_handle));
         }
         else 
         {
             getD3DErr(m_device->getDX11Device()->CreateTexture2D(&desc, nullptr, &m_handle));
+
+            if (data)
+            {
+                setSubData(glm::ivec2(0), m_size, 0, 0, data);
+            }
         }
 
         clearResViews();
@@ -1949,7 +2758,7 @@ namespace EProject
         box.front = 0;
         box.back = 1;
 
-        m_device->getDX11DeviceContext()->UpdateSubresource(m_handle.Get(), res_idx, &box, data, getPixelsSize(m_fmt) * size.x, getPixelsSize(m_fmt) * size.x * size.y);
+        m_device->getDX11DeviceContext()->UpdateSubresource(m_handle.Get(), res_idx, &box, data, getRowPitch(m_fmt, size.x), getSlicePitch(m_fmt, size));
     }
 
     void GPUTexture2D::generateMips()
@@ -2152,6 +2961,7 @@ namespace EProject
             m_depth_view = nullptr;
         }
     }
+#endif
 
     GPUTexture2DPtr Framebuffer::getColorSlot(int slot) const
     {
@@ -2163,6 +2973,7 @@ namespace EProject
         return m_depth;
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     void Framebuffer::clearUAV(int slot, uint32_t v)
     {
         UINT clear_value[4] = { v,v,v,v };
@@ -2248,12 +3059,14 @@ namespace EProject
             }
         }
     }
+#endif
 
     glm::ivec2 Framebuffer::getSize() const
     {
         return m_size;
     }
 
+#ifdef EPROJECT_GAPI_D3D11
     void Framebuffer::prepareSlots()
     {
         if (m_colors_to_bind.size() == 0)
@@ -2321,6 +3134,7 @@ namespace EProject
             m_depth_view = m_depth->buildDepthStencil(m_depth_params.mip, m_depth_params.slice_start, m_depth_params.slice_count, m_depth_params.read_only);
         }
     }
+#endif
 
     Framebuffer::Tex2DParams::Tex2DParams()
     {
@@ -1,4 +1,8 @@
 #include "egraphics.h"
+#include "graphics/etexconvert.h"
+
+#include <algorithm>
+#include <iostream>
 
 namespace EProject
 {
@@ -21,6 +25,103 @@ namespace EProject
         return vertexIndexDataQuadArrayTex[index];
     }
 
+    void ShaderHotReload::watch(const ShaderProgramPtr& program, AssetManager& mng)
+    {
+        m_program = program;
+        m_mng = &mng;
+
+        addDependencies();
+
+        m_mng->addReloadListener([this](const std::filesystem::path& path, const std::shared_ptr<IAsset>&)
+        {
+            const auto& inputs = m_program->getInputs();
+
+            const bool used = std::any_of(inputs.begin(), inputs.end(), [&path](const ShaderInput& input)
+            {
+                return std::filesystem::path(input.filePath).lexically_normal() == path;
+            });
+
+            if (!used)
+            {
+                return;
+            }
+
+            // Saved again while compiling, build once more when that one is done
+            if (m_pending.valid())
+            {
+                m_queued = true;
+                return;
+            }
+
+            recompile();
+        });
+    }
+
+    void ShaderHotReload::addDependencies()
+    {
+        const auto files = m_program->getSourceFiles();
+
+        for (const auto& input : m_program->getInputs())
+        {
+            for (const auto& file : files)
+            {
+                m_mng->addDependency(input.filePath, file);
+            }
+        }
+    }
+
+    void ShaderHotReload::recompile()
+    {
+        auto program = m_program->getDevice()->createShaderProgram();
+
+        m_pending = getJobSystem()->submit([program, inputs = m_program->getInputs()]() -> ShaderProgramPtr
+        {
+            for (const auto& input : inputs)
+            {
+                if (!program->compileFromFile(input))
+                {
+                    return nullptr;
+                }
+            }
+
+            return program;
+        });
+    }
+
+    ShaderProgramPtr ShaderHotReload::update()
+    {
+        if (!m_pending.valid() || m_pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            return nullptr;
+        }
+
+        auto program = m_pending.get();
+
+        if (program)
+        {
+            // Device objects are made on the main thread, only the compile runs on the workers
+            program->create();
+            m_program = program;
+
+            // Includes may have changed as well
+            addDependencies();
+
+            std::cout << "ShaderHotReload: Reloaded " << std::filesystem::path(m_program->getInputs().front().filePath).u8string() << "\n";
+        }
+        else
+        {
+            std::cout << "ShaderHotReload: Compile failed, keeping the old program\n";
+        }
+
+        if (m_queued)
+        {
+            m_queued = false;
+            recompile();
+        }
+
+        return program;
+    }
+
     Render2D::Render2D(const GDevicePtr& _dev) :
         DeviceHolder(_dev)
     {
@@ -64,14 +165,28 @@ namespace EProject
         m_mng = mng;
 
         createBaseShader();
+        m_triangleReload.watch(m_triangle, *mng);
 
         const auto texDir = PathHandler::getTexturesDir();
        
         PathKey grassKey(texDir / "grass.png");        
         Asset<Texture2D> grassTex = mng->getAsset<Texture2D>(grassKey.path);
 
-        auto texGrass = m_device->createTexture2D();
-        texGrass->setState(grassTex->getFormat(), grassTex->getSize(), 0, 1, grassTex->getData());
+        m_spritePath = grassKey.path;
+        m_spriteTex = createSpriteTexture(grassTex);
+
+        mng->addReloadListener([this](const std::filesystem::path& path, const std::shared_ptr<IAsset>&)
+        {
+            if (path != m_spritePath.lexically_normal())
+            {
+                return;
+            }
+
+            static const char* albedoTexture = "albedoTex";
+
+            m_spriteTex = createSpriteTexture(m_mng->getAsset<Texture2D>(m_spritePath));
+            m_triangle->setResource(albedoTexture, m_spriteTex);
+        });
 
         m_posColorLayout = getLayoutSelector()->add("POS", LayoutType::Float, 3)
                                               ->add("COL", LayoutType::Float, 3)
@@ -136,11 +251,24 @@ namespace EProject
         static const char* albedoTexture = "albedoTex";
 
         m_triangle->setValue(projectionMatrix, m_cameraPtr->getProj());
-        m_triangle->setResource(albedoTexture, texGrass);
+        m_triangle->setResource(albedoTexture, m_spriteTex);
        
         isInited = true;
     }
 
+    void Render2D::updateShaders()
+    {
+        if (auto program = m_triangleReload.update())
+        {
+            static const char* projectionMatrix = "projection";
+            static const char* albedoTexture = "albedoTex";
+
+            m_triangle = program;
+            m_triangle->setValue(projectionMatrix, m_cameraPtr->getProj());
+            m_triangle->setResource(albedoTexture, m_spriteTex);
+        }
+    }
+
     void Render2D::setTextureLayer(int index)
     {
         static const char* albedoTexture = "albedoTex";
@@ -150,10 +278,31 @@ namespace EProject
         PathKey treeKey(texDir / "tree.png");
         Asset<Texture2D> treeTex = m_mng->getAsset<Texture2D>(treeKey.path);
 
-        auto texTree = m_device->createTexture2D();
-        texTree->setState(treeTex->getFormat(), treeTex->getSize(), 0, 1, treeTex->getData());
+        m_spritePath = treeKey.path;
+        m_spriteTex = createSpriteTexture(treeTex);
 
-        m_triangle->setResource(albedoTexture, texTree);
+        m_triangle->setResource(albedoTexture, m_spriteTex);
+    }
+
+    GPUTexture2DPtr Render2D::createSpriteTexture(const Asset<Texture2D>& tex)
+    {
+        auto gpuTex = m_device->createTexture2D();
+
+        if (tex->getFormat() != TextureFmt::RGBA8)
+        {
+            gpuTex->setState(tex->getFormat(), tex->getSize(), 0, 1, tex->getData());
+            return gpuTex;
+        }
+
+        // Sprites blend premultiplied, so filtering doesn't bleed the colour of transparent texels
+        const size_t pixels = static_cast<size_t>(tex->getSize().x) * tex->getSize().y;
+        const auto* data = static_cast<const uint8_t*>(tex->getData());
+
+        std::vector<uint8_t> rgba(data, data + pixels * 4);
+        TextureConvert::premultiplyAlpha(rgba.data(), pixels);
+
+        gpuTex->setState(TextureFmt::RGBA8, tex->getSize(), 0, 1, rgba.data());
+        return gpuTex;
     }
 
     void Render2D::markDirty()
@@ -182,6 +331,8 @@ namespace EProject
         glm::vec2 qUv3 = glm::vec2(PrimitiveFactory::getVertexUVPrimitive(4), PrimitiveFactory::getVertexUVPrimitive(5));
         glm::vec2 qUv4 = glm::vec2(PrimitiveFactory::getVertexUVPrimitive(6), PrimitiveFactory::getVertexUVPrimitive(7));
 
+        m_quadOrder.push_back({ SortKey::depth(pos.z), uint32_t(m_quadOrder.size()) });
+
         m_vertexQuadBatch.emplace_back(qVert1.xyz(), qUv1);
         m_vertexQuadBatch.emplace_back(qVert2.xyz(), qUv2);
         m_vertexQuadBatch.emplace_back(qVert3.xyz(), qUv3);
@@ -205,6 +356,8 @@ namespace EProject
         glm::vec4 qVert3 = transform * glm::vec4(PrimitiveFactory::getVertexPrimitive(4), PrimitiveFactory::getVertexPrimitive(5), _pos.z, 1.0f);
         glm::vec4 qVert4 = transform * glm::vec4(PrimitiveFactory::getVertexPrimitive(6), PrimitiveFactory::getVertexPrimitive(7), _pos.z, 1.0f);
 
+        m_quadOrder.push_back({ SortKey::depth(_pos.z), uint32_t(m_quadOrder.size()) });
+
         m_vertexQuadBatch.emplace_back(qVert1.xyz(), _color);
         m_vertexQuadBatch.emplace_back(qVert2.xyz(), _color);
         m_vertexQuadBatch.emplace_back(qVert3.xyz(), _color);
@@ -245,8 +398,17 @@ namespace EProject
         {
             static const char* projectionMatrix = "projection";            
             m_triangle->setValue(projectionMatrix, m_cameraPtr->getProj());
+
+            // Farther quads (lower z) first
+            radixSort(m_quadOrder, m_sortScratch, m_sortHistograms);
+
+            m_sortedQuads.resize(m_vertexQuadBatch.size());
+            for (size_t i = 0; i < m_quadOrder.size(); i++)
+            {
+                std::copy_n(&m_vertexQuadBatch[size_t(m_quadOrder[i].index) * 4], 4, &m_sortedQuads[i * 4]);
+            }
             
-            m_vb->setSubData(0, static_cast<int>(m_vertexQuadBatch.size()), m_vertexQuadBatch.data());
+            m_vb->setSubData(0, static_cast<int>(m_sortedQuads.size()), m_sortedQuads.data());
             isDirty = false;
         }
     }
@@ -255,12 +417,14 @@ namespace EProject
     {
         m_triangle->setInputBuffers(m_vb, m_ib, {}, 0);
 
-        m_device->getStates()->setBlend(true, Blend::Src_Alpha, Blend::Inv_Src_Alpha);
-        //m_device->getStates()->setCull(CullMode::None);
+        States* states = m_device->getStates();
+        states->push();
+        states->setBlend(true, Blend::One, Blend::Inv_Src_Alpha);
+        //states->setCull(CullMode::None);
 
         m_triangle->drawIndexed(PrimTopology::Triangle, 0, m_ib->getIndexCount());
 
-        m_device->getStates()->setBlend(false, Blend::Src_Alpha, Blend::Inv_Src_Alpha);
+        states->pop();
     }
 
     Render3D::Render3D(const GDevicePtr& _dev) : DeviceHolder(_dev)
@@ -277,45 +441,298 @@ namespace EProject
     {
         m_mng = mng;
 
-        createShaderSemantics();
         createPBRShader(); 
+        createShaderSemantics();
+
+        RenderQueue::PassStates opaque;
+        opaque.depthEnable = true;
+        m_queue.setPassStates(cOpaquePass, opaque);
+
+        m_pbrReload.watch(m_pbr, *mng);
+    }
+
+    void Render3D::updateShaders()
+    {
+        if (auto program = m_pbrReload.update())
+        {
+            m_pbr = program;
+            createShaderSemantics();
+        }
     }
 
     void Render3D::setGeometryPass(const DirectLightComponent& dirLight)
     {
+        // Groups queued so far keep the light they were drawn with
+        flushInstances();
+
         m_dirLight = dirLight;
     }
 
     void Render3D::drawMeshModel(const StaticMeshComponent& mshPtr, const TransformComponent& trs)
     {
-        const auto& mdl = mshPtr.m_model;        
-        
+        const StaticMeshRenderable* mdl = mshPtr.m_model.get();
+
         glm::mat4 mdlMatrix = glm::mat4(1.0f);
 
         // RightHanded Matrix Order Mul. transpose... Keep in my mind VULKAN!!!
         mdlMatrix = glm::translate(mdlMatrix, trs.mPos) * glm::toMat4(trs.mRot) * glm::scale(mdlMatrix, trs.mScale);
-        mdlMatrix = glm::transpose(mdlMatrix);
 
-        const glm::mat4 inverseMdl = glm::inverse(mdlMatrix);
+        const glm::vec3 scale = glm::abs(trs.mScale);
 
-        m_pbr->setResource(m_shaderSemanticsc.at("samplerDefault"), cSampler_Linear);
+        InstanceEntry inst;
+        inst.model = mdlMatrix;
+        inst.maxScale = glm::max(scale.x, glm::max(scale.y, scale.z));
+        inst.uniformScale = glm::abs(scale.x - scale.y) < 1e-4f && glm::abs(scale.x - scale.z) < 1e-4f;
 
-        m_pbr->setResource(m_shaderSemanticsc.at("albedoTexture"), mdl->getAlbedoTexturePtr());
-        m_pbr->setResource(m_shaderSemanticsc.at("normalTexture"), mdl->getNormalTexturePtr());
-        m_pbr->setResource(m_shaderSemanticsc.at("metallRoghnessTexture"), mdl->getMetallRoughnessTexturePtr());
+        auto it = m_groupIds.find(mdl);
+        if (it == m_groupIds.end())
+        {
+            it = m_groupIds.emplace(mdl, static_cast<uint32_t>(m_groups.size())).first;
+            m_groups.push_back({ mdl, {} });
+        }
 
-        m_pbr->setValue(m_shaderSemanticsc.at("modelMatrix"), mdlMatrix);
-        m_pbr->setValue(m_shaderSemanticsc.at("invModelMatrix"), inverseMdl);
+        m_groups[it->second].instances.push_back(inst);
+    }
 
-        m_pbr->setValue(m_shaderSemanticsc.at("cameraPos"), m_cam3DPtr->getPosition());
-        m_pbr->setValue(m_shaderSemanticsc.at("viewProjectionMatrix"),  m_cam3DPtr->getViewProj());
+    void Render3D::flushInstances()
+    {
+        m_cullTasks.clear();
 
-        m_pbr->setValue(m_shaderSemanticsc.at("lightPositions"), m_dirLight.mPos);
-        m_pbr->setValue(m_shaderSemanticsc.at("lightColours"), m_dirLight.mColor);
+        for (uint32_t g = 0; g < m_groups.size(); g++)
+        {
+            const size_t count = m_groups[g].instances.size();
+            for (size_t first = 0; first < count; first += cInstancesPerTask)
+            {
+                m_cullTasks.push_back({ g, first, std::min(cInstancesPerTask, count - first) });
+            }
+        }
+
+        if (m_cullResults.size() < m_cullTasks.size())
+        {
+            m_cullResults.resize(m_cullTasks.size());
+        }
+
+        CullView view;
+        view.viewProj = glm::transpose(m_cam3DPtr->getViewProj());
+        view.frustum = Frustum::fromMatrix(view.viewProj);
+        view.camPos = m_cam3DPtr->getPosition();
+
+        getJobSystem()->parallelFor(m_cullTasks.size(), [this, &view](size_t i)
+        {
+            cull(m_cullTasks[i], view, m_cullResults[i]);
+        });
+
+        // Queued in task order, the packets don't depend on how the jobs ran
+        for (size_t t = 0; t < m_cullTasks.size();)
+        {
+            const InstanceGroup& group = m_groups[m_cullTasks[t].group];
+
+            size_t end = t + 1;
+            while (end < m_cullTasks.size() && m_cullTasks[end].group == m_cullTasks[t].group)
+            {
+                ++end;
+            }
+
+            // A lone entity keeps per cluster culling, shared renderables are culled per instance
+            if (group.instances.size() == 1)
+            {
+                queueClusters(*group.renderable, m_cullResults[t]);
+            }
+            else
+            {
+                queueInstances(*group.renderable, t, end);
+            }
+
+            t = end;
+        }
+
+        m_groups.clear();
+        m_groupIds.clear();
+    }
+
+    void Render3D::cull(const CullTask& task, const CullView& view, CullResult& out) const
+    {
+        const InstanceGroup& group = m_groups[task.group];
+
+        out.instances.clear();
+        out.drawCmds.clear();
+        out.drawBatches.clear();
+        out.depth = std::numeric_limits<float>::max();
+
+        if (group.instances.size() == 1)
+        {
+            // Cull clusters in model space, backface cones are only valid for uniform scale
+            const InstanceEntry& inst = group.instances.front();
+
+            ClusterCuller culler;
+            culler.setView(view.viewProj, inst.model, view.camPos, inst.uniformScale);
+
+            const auto& meshData = group.renderable->getMeshInstancePtr()->getMeshData();
+
+            for (const auto& draw : group.renderable->getDrawList())
+            {
+                const size_t first = out.drawCmds.size();
+                culler.cull(meshData[draw.meshData], out.drawCmds);
+
+                if (out.drawCmds.size() > first)
+                {
+                    out.drawBatches.push_back({ draw.material, first, out.drawCmds.size() - first });
+                }
+            }
+
+            if (!out.drawBatches.empty())
+            {
+                out.instances.push_back(glm::transpose(inst.model));
+                out.depth = glm::distance(view.camPos, glm::vec3(inst.model[3]));
+            }
+
+            return;
+        }
+
+        const AABB& bounds = group.renderable->getMeshInstancePtr()->getAABB();
+        const glm::vec3 center = bounds.getCenter();
+        const float radius = glm::length(bounds.getSize()) * 0.5f;
+
+        for (size_t i = task.first; i < task.first + task.count; i++)
+        {
+            const InstanceEntry& inst = group.instances[i];
+
+            const glm::vec3 worldCenter = glm::vec3(inst.model * glm::vec4(center, 1.0f));
+            if (!view.frustum.intersects(worldCenter, radius * inst.maxScale))
+            {
+                continue;
+            }
+
+            out.instances.push_back(glm::transpose(inst.model));
+            out.depth = glm::min(out.depth, glm::distance(view.camPos, worldCenter));
+        }
+    }
+
+    void Render3D::queueClusters(const StaticMeshRenderable& mdl, const CullResult& result)
+    {
+        if (result.drawBatches.empty())
+        {
+            return;
+        }
 
-        m_pbr->setInputBuffers(mdl->getVertexBufferPtr(), mdl->getIndexBufferPtr(), {}, 0);
+        const uint32_t program = m_queue.getProgramId(m_pbr.get());
+        const uint32_t geometry = m_queue.addGeometry(mdl.getVertexBufferPtr(), mdl.getIndexBufferPtr());
 
-        m_pbr->drawIndexed(PrimTopology::Triangle, 0, mdl->getIndexBufferPtr()->getIndexCount());
+        const uint32_t constants = addInstanceConstants(static_cast<uint32_t>(m_instanceData.size()));
+        m_instanceData.push_back(result.instances.front());
+
+        for (const auto& batch : result.drawBatches)
+        {
+            const uint32_t material = addMaterial(mdl, batch.material);
+            const uint64_t key = SortKey::opaque(0, cOpaquePass, program, material, result.depth);
+
+            RenderQueue::DrawPacket packet;
+            packet.program = m_pbr.get();
+            packet.material = material;
+            packet.geometry = geometry;
+            packet.constants = constants;
+
+            for (size_t i = batch.first; i < batch.first + batch.count; ++i)
+            {
+                const auto& cmd = result.drawCmds[i];
+                packet.first = cmd.startIndex;
+                packet.count = cmd.indexCount;
+                packet.baseVertex = cmd.baseVertex;
+                m_queue.push(key, packet);
+            }
+        }
+    }
+
+    void Render3D::queueInstances(const StaticMeshRenderable& mdl, size_t firstResult, size_t lastResult)
+    {
+        // The group's ranges join into one instanced draw per draw list entry
+        const size_t instanceBase = m_instanceData.size();
+        float depth = std::numeric_limits<float>::max();
+
+        for (size_t r = firstResult; r < lastResult; r++)
+        {
+            const CullResult& result = m_cullResults[r];
+            m_instanceData.insert(m_instanceData.end(), result.instances.begin(), result.instances.end());
+            depth = glm::min(depth, result.depth);
+        }
+
+        const uint32_t visible = static_cast<uint32_t>(m_instanceData.size() - instanceBase);
+        if (visible == 0)
+        {
+            return;
+        }
+
+        const uint32_t program = m_queue.getProgramId(m_pbr.get());
+        const uint32_t geometry = m_queue.addGeometry(mdl.getVertexBufferPtr(), mdl.getIndexBufferPtr());
+        const uint32_t constants = addInstanceConstants(static_cast<uint32_t>(instanceBase));
+
+        for (const auto& draw : mdl.getDrawList())
+        {
+            const uint32_t material = addMaterial(mdl, draw.material);
+
+            RenderQueue::DrawPacket packet;
+            packet.program = m_pbr.get();
+            packet.material = material;
+            packet.geometry = geometry;
+            packet.constants = constants;
+            packet.first = draw.startIndex;
+            packet.count = draw.indexCount;
+            packet.baseVertex = draw.baseVertex;
+            packet.instanceCount = visible;
+
+            m_queue.push(SortKey::opaque(0, cOpaquePass, program, material, depth), packet);
+        }
+    }
+
+    uint32_t Render3D::addInstanceConstants(uint32_t instanceBase)
+    {
+        const uint32_t constants = m_queue.beginConstants();
+        m_queue.setValue(m_pbrParams.instanceBase, instanceBase);
+        m_queue.setValue(m_pbrParams.lightPositions, m_dirLight.mPos);
+        m_queue.setValue(m_pbrParams.lightColours, m_dirLight.mColor);
+        m_queue.endConstants();
+
+        return constants;
+    }
+
+    uint32_t Render3D::addMaterial(const StaticMeshRenderable& mdl, uint32_t materialId)
+    {
+        const auto& mat = mdl.getMaterials()[materialId];
+        const ShaderResource materialSlots[] = { m_pbrParams.albedoTexture, m_pbrParams.normalTexture, m_pbrParams.metallRoghnessTexture };
+        const GPUTexture2DPtr textures[] = { mat.albedoTex, mat.normalTex, mat.metallRoghnessTex };
+
+        return m_queue.addMaterial(&mat, materialSlots, textures, 3);
+    }
+
+    void Render3D::submit()
+    {
+        flushInstances();
+
+        if (!m_instanceData.empty())
+        {
+            const int count = static_cast<int>(m_instanceData.size());
+
+            if (!m_instanceBuffer)
+            {
+                m_instanceBuffer = m_device->createStructuredBuffer();
+            }
+
+            if (m_instanceBuffer->getVertexCount() < count)
+            {
+                m_instanceBuffer->setState(sizeof(glm::mat4), glm::max(count, m_instanceBuffer->getVertexCount() * 2));
+            }
+
+            m_instanceBuffer->setSubData(0, count, m_instanceData.data());
+            m_pbr->setResource(m_pbrParams.instances, m_instanceBuffer);
+            m_instanceData.clear();
+        }
+
+        m_pbr->setResource(m_pbrParams.samplerDefault, cSampler_Linear);
+        m_pbr->setValue(m_pbrParams.cameraPos, m_cam3DPtr->getPosition());
+        m_pbr->setValue(m_pbrParams.viewProjectionMatrix, m_cam3DPtr->getViewProj());
+
+        m_queue.submit(*m_device);
+        m_frameStats = m_queue.getStats();
     }
 
     void Render3D::drawMeshModel(const SkinnedMeshComponent& mshPtr, const TransformComponent& trs)
@@ -330,16 +747,16 @@ namespace EProject
 
         const glm::mat4 inverseMdl = glm::inverse(mdlMatrix);
 
-       /* m_pbr->setResource(m_shaderSemanticsc.at("samplerDefault"), cSampler_Linear);
+       /* m_pbr->setResource(m_pbrParams.samplerDefault, cSampler_Linear);
 
-        m_pbr->setResource(m_shaderSemanticsc.at("albedoTexture"), mdl->getGPUAlbedoTexture());
-        m_pbr->setResource(m_shaderSemanticsc.at("normalTexture"), mdl->getGPUNormalTexture());
+        m_pbr->setResource(m_pbrParams.albedoTexture, mdl->getGPUAlbedoTexture());
+        m_pbr->setResource(m_pbrParams.normalTexture, mdl->getGPUNormalTexture());
 
-        m_pbr->setValue(m_shaderSemanticsc.at("modelMatrix"), mdlMatrix);
-        m_pbr->setValue(m_shaderSemanticsc.at("invModelMatrix"), inverseMdl);
+        m_pbr->setValue(m_pbrParams.modelMatrix, mdlMatrix);
+        m_pbr->setValue(m_pbrParams.invModelMatrix, inverseMdl);
 
-        m_pbr->setValue(m_shaderSemanticsc.at("cameraPos"), m_cam3DPtr->getPosition());
-        m_pbr->setValue(m_shaderSemanticsc.at("viewProjectionMatrix"), m_cam3DPtr->getViewProj());
+        m_pbr->setValue(m_pbrParams.cameraPos, m_cam3DPtr->getPosition());
+        m_pbr->setValue(m_pbrParams.viewProjectionMatrix, m_cam3DPtr->getViewProj());
 
         m_pbr->setInputBuffers(mdl->getVertexBufferPtr(), mdl->getIndexBufferPtr(), {}, 0);*/
 
@@ -348,18 +765,18 @@ namespace EProject
 
     void Render3D::createShaderSemantics()
     {
-        m_shaderSemanticsc["viewProjectionMatrix"] = "vp";
-        m_shaderSemanticsc["modelMatrix"] = "model";
-        m_shaderSemanticsc["invModelMatrix"] = "invModel";
-        m_shaderSemanticsc["cameraPos"] = "camPos";
-
-        m_shaderSemanticsc["albedoTexture"] = "albedoTex";
-        m_shaderSemanticsc["normalTexture"] = "normalTex";
-        m_shaderSemanticsc["metallRoghnessTexture"] = "metallRoghnessTex";
-        m_shaderSemanticsc["samplerDefault"] = "samplerDefault";
-
-        m_shaderSemanticsc["lightPositions"] = "lightPositions";
-        m_shaderSemanticsc["lightColours"] = "lightColours";
+        m_pbrParams.viewProjectionMatrix = m_pbr->findValue<glm::mat4>("vp");
+        m_pbrParams.instanceBase = m_pbr->findValue<uint32_t>("instanceBase");
+        m_pbrParams.cameraPos = m_pbr->findValue<glm::vec3>("camPos");
+
+        m_pbrParams.albedoTexture = m_pbr->findResource("albedoTex");
+        m_pbrParams.normalTexture = m_pbr->findResource("normalTex");
+        m_pbrParams.metallRoghnessTexture = m_pbr->findResource("metallRoghnessTex");
+        m_pbrParams.samplerDefault = m_pbr->findResource("samplerDefault");
+        m_pbrParams.instances = m_pbr->findResource("instances");
+
+        m_pbrParams.lightPositions = m_pbr->findValue<glm::vec3>("lightPositions");
+        m_pbrParams.lightColours = m_pbr->findValue<glm::vec3>("lightColours");
     }
 
     void Render3D::createPBRShader()
@@ -0,0 +1,1086 @@
+#include "egapi.h"
+
+#ifdef EPROJECT_GAPI_NULL
+
+#include <algorithm>
+#include <cassert>
+
+namespace EProject
+{
+    namespace
+    {
+        int calcMipLevelsCount(int w, int h)
+        {
+            int min_size = glm::min(w, h);
+            int max_mip = 0;
+            while (min_size > 0)
+            {
+                min_size >>= 1;
+                max_mip++;
+            }
+            return max_mip;
+        }
+
+        glm::ivec2 mipSize(const glm::ivec2& size, int mip)
+        {
+            return glm::max(glm::ivec2(size.x >> mip, size.y >> mip), glm::ivec2(1));
+        }
+    }
+
+    bool States::StateData::operator==(const StateData& s) const
+    {
+        if (wireframe != s.wireframe || cull != s.cull || depthEnable != s.depthEnable || depthWrite != s.depthWrite || depthFunc != s.depthFunc)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < 8; i++)
+        {
+            if (!(blend[i] == s.blend[i]))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    std::size_t States::StateData::hash() const
+    {
+        std::size_t n = std::hash<bool>()(wireframe) ^
+                        std::hash<int>()(int(cull)) << 1 ^
+                        std::hash<bool>()(depthEnable) << 4 ^
+                        std::hash<bool>()(depthWrite) << 5 ^
+                        std::hash<int>()(int(depthFunc)) << 6;
+
+        for (int i = 0; i < 8; i++)
+        {
+            const BlendTarget& b = blend[i];
+            n = n * 31 + (std::hash<bool>()(b.enable) ^ std::hash<int>()(int(b.src)) << 1 ^ std::hash<int>()(int(b.dst)) << 5 ^
+                          std::hash<int>()(int(b.func)) << 9 ^ std::hash<int>()(int(b.srcAlpha)) << 12 ^
+                          std::hash<int>()(int(b.dstAlpha)) << 16 ^ std::hash<int>()(int(b.funcAlpha)) << 20 ^
+                          std::hash<bool>()(b.colorWrite) << 23);
+        }
+
+        return n;
+    }
+
+    void States::setDefaultStates()
+    {
+        m_state = StateData();
+        m_edit = true;
+        m_changed = true;
+        resolve();
+    }
+
+    void States::resolve()
+    {
+        if (!m_edit)
+        {
+            return;
+        }
+
+        auto it = m_blockIds.find(m_state);
+        if (it == m_blockIds.end())
+        {
+            it = m_blockIds.emplace(m_state, uint32_t(m_blocks.size())).first;
+            m_blocks.push_back(m_state);
+            ++m_frameStats.created;
+        }
+
+        m_current = it->second;
+        m_edit = false;
+    }
+
+    void States::push()
+    {
+        resolve();
+        m_states.push_back(m_current);
+    }
+
+    void States::pop()
+    {
+        m_current = m_states.back();
+        m_states.pop_back();
+
+        m_state = m_blocks[m_current];
+        m_edit = false;
+        m_changed = true;
+    }
+
+    void States::setWireframe(bool wire)
+    {
+        if (m_state.wireframe != wire)
+        {
+            m_state.wireframe = wire;
+            m_edit = m_changed = true;
+        }
+    }
+
+    void States::setCull(CullMode cm)
+    {
+        if (m_state.cull != cm)
+        {
+            m_state.cull = cm;
+            m_edit = m_changed = true;
+        }
+    }
+
+    void States::setDepthEnable(bool enable)
+    {
+        if (m_state.depthEnable != enable)
+        {
+            m_state.depthEnable = enable;
+            m_edit = m_changed = true;
+        }
+    }
+
+    void States::setDepthWrite(bool enable)
+    {
+        if (m_state.depthWrite != enable)
+        {
+            m_state.depthWrite = enable;
+            m_edit = m_changed = true;
+        }
+    }
+
+    void States::setDepthFunc(Compare cmp)
+    {
+        if (m_state.depthFunc != cmp)
+        {
+            m_state.depthFunc = cmp;
+            m_edit = m_changed = true;
+        }
+    }
+
+    void States::setBlend(bool enable, Blend src, Blend dst, int rt_index, BlendFunc bf)
+    {
+        setBlendSeparateAlpha(enable, src, dst, bf, src, dst, bf, rt_index);
+    }
+
+    void States::setBlendSeparateAlpha(bool enable, Blend src_color, Blend dst_color, BlendFunc bf_color, Blend src_alpha, Blend dst_alpha, BlendFunc bf_alpha, int rt_index)
+    {
+        const int n = (rt_index < 0) ? 0 : rt_index;
+
+        BlendTarget target = m_state.blend[n];
+        target.enable = enable;
+        target.src = enable ? src_color : Blend::One;
+        target.dst = enable ? dst_color : Blend::One;
+        target.func = enable ? bf_color : BlendFunc::Add;
+        target.srcAlpha = enable ? src_alpha : Blend::One;
+        target.dstAlpha = enable ? dst_alpha : Blend::One;
+        target.funcAlpha = enable ? bf_alpha : BlendFunc::Add;
+
+        const int last = (rt_index < 0) ? 8 : n + 1;
+        for (int i = n; i < last; i++)
+        {
+            if (!(m_state.blend[i] == target))
+            {
+                m_state.blend[i] = target;
+                m_edit = m_changed = true;
+            }
+        }
+    }
+
+    void States::setColorWrite(bool enable, int rt_index)
+    {
+        const int n = (rt_index < 0) ? 0 : rt_index;
+        const int last = (rt_index < 0) ? 8 : n + 1;
+        for (int i = n; i < last; i++)
+        {
+            if (m_state.blend[i].colorWrite != enable)
+            {
+                m_state.blend[i].colorWrite = enable;
+                m_edit = m_changed = true;
+            }
+        }
+    }
+
+    void States::validateStates()
+    {
+        if (!m_changed)
+        {
+            return;
+        }
+
+        m_changed = false;
+        resolve();
+
+        if (m_current == m_bound)
+        {
+            ++m_frameStats.filtered;
+            return;
+        }
+
+        m_bound = m_current;
+        ++m_frameStats.binds;
+        m_device->m_counters.stateChanges++;
+        m_device->record(GpuCommandType::SetStates, this);
+    }
+
+    States::States(GDevice* device)
+    {
+        m_device = device;
+        setDefaultStates();
+    }
+
+    GDevice::GDevice(const glm::ivec2& size, bool sRGB)
+    {
+        m_isSrgb = sRGB;
+        m_lastWndSize = size;
+        m_states = std::make_unique<States>(this);
+        m_constants = std::make_unique<ConstantRing>(this, 4 << 20);
+        m_inputLayouts = std::make_unique<InputLayoutCache>(this);
+    }
+
+    GDevice::~GDevice()
+    {
+    }
+
+    FrameBufferPtr GDevice::setFrameBuffer(const FrameBufferPtr& fbo, bool update_viewport)
+    {
+        FrameBufferPtr currentFbo = m_activeFbo.lock();
+
+        if (m_activeFboPtr != fbo.get())
+        {
+            m_activeFbo = fbo;
+            m_activeFboPtr = fbo.get();
+
+            if (m_activeFboPtr)
+            {
+                m_activeFboPtr->prepareSlots();
+                if (GpuCommand* cmd = record(GpuCommandType::SetFrameBuffer, m_activeFboPtr))
+                {
+                    cmd->count = m_activeFboPtr->m_rtv_count;
+                }
+            }
+            else
+            {
+                setDefaultFramebuffer();
+            }
+        }
+        if (update_viewport)
+        {
+            setViewport(currentFrameBufferSize());
+        }
+
+        return currentFbo;
+    }
+
+    glm::ivec2 GDevice::currentFrameBufferSize() const
+    {
+        return m_lastWndSize;
+    }
+
+    void GDevice::beginFrame()
+    {
+        record(GpuCommandType::BeginFrame, this);
+        m_states->beginFrame();
+        m_constants->beginFrame();
+
+        setDefaultFramebuffer();
+        setViewport(m_lastWndSize);
+
+        record(GpuCommandType::Clear, nullptr);
+    }
+
+    void GDevice::endFrame()
+    {
+        record(GpuCommandType::EndFrame, this);
+    }
+
+    void GDevice::setWindowSize(const glm::ivec2& size)
+    {
+        m_lastWndSize = size;
+    }
+
+    void GDevice::setRecording(bool enable)
+    {
+        m_recording = enable;
+    }
+
+    const std::vector<GpuCommand>& GDevice::getCommandLog() const
+    {
+        return m_log;
+    }
+
+    void GDevice::clearCommandLog()
+    {
+        m_log.clear();
+    }
+
+    const GpuCounters& GDevice::getCounters() const
+    {
+        return m_counters;
+    }
+
+    void GDevice::resetCounters()
+    {
+        m_counters = GpuCounters();
+    }
+
+    void GDevice::setDefaultFramebuffer()
+    {
+        record(GpuCommandType::SetFrameBuffer, nullptr);
+    }
+
+    void GDevice::setViewport(const glm::vec2& /*size*/)
+    {
+    }
+
+    GpuCommand* GDevice::record(GpuCommandType type, const void* object)
+    {
+        if (!m_recording)
+        {
+            return nullptr;
+        }
+
+        GpuCommand& cmd = m_log.emplace_back();
+        cmd.type = type;
+        cmd.object = object;
+        return &cmd;
+    }
+
+    ShaderProgram::ShaderProgram(const GDevicePtr& device) : DeviceHolder(device)
+    {
+        m_selectedInstanceStep = 0;
+    }
+
+    ShaderProgram::~ShaderProgram()
+    {
+        if (m_device->m_activeProgram == this) m_device->m_activeProgram = nullptr;
+    }
+
+    bool ShaderProgram::compileFromFile(const ShaderInput& input)
+    {
+        if (!std::filesystem::exists(input.filePath))
+        {
+            return false;
+        }
+
+        m_inputs.push_back(input);
+        return true;
+    }
+
+    bool ShaderProgram::create()
+    {
+        // Without bytecode the vertex entry point stands in for its input signature
+        for (const auto& input : m_inputs)
+        {
+            if (input.type == ShaderType::Vertex)
+            {
+                const std::string signature = input.filePath.generic_string() + ":" + input.entyPoint;
+                m_signature = m_device->getInputLayouts()->addSignature(signature.data(), signature.size());
+                m_inputLayout = nullptr;
+                m_inputVertices = nullptr;
+                m_inputInstances = nullptr;
+            }
+        }
+
+        return true;
+    }
+
+    void ShaderProgram::activateProgram()
+    {
+        uploadGlobals();
+
+        if (!isProgramActive())
+        {
+            m_device->m_activeProgram = this;
+            m_device->m_counters.programChanges++;
+            m_device->record(GpuCommandType::SetProgram, this);
+
+            selectInputBuffers();
+        }
+    }
+
+    void ShaderProgram::uploadGlobals()
+    {
+        const GlobalsRange range = prepareGlobals();
+        if (range.stages)
+        {
+            m_device->getConstantRing()->flush();
+            bindGlobals(range);
+        }
+    }
+
+    ShaderProgram::GlobalsRange ShaderProgram::prepareGlobals()
+    {
+        ConstantRing* ring = m_device->getConstantRing();
+        GlobalsRange range;
+
+        const bool stale = m_globalsFrame != ring->getFrame();
+        if (m_globals.empty() || (!m_globals_dirty && !stale))
+        {
+            return range;
+        }
+
+        m_globals_dirty = false;
+        m_globalsFrame = ring->getFrame();
+
+        ConstantRing::Allocation a = ring->allocate(int(m_globals.size()));
+        memcpy(a.data, m_globals.data(), m_globals.size());
+        range.stages = 1;
+        return range;
+    }
+
+    void ShaderProgram::bindGlobals(const GlobalsRange& /*range*/)
+    {
+        // Nothing is bound by range here, the counters only see the flush
+    }
+
+    void ShaderProgram::setInputBuffers(const VertexBufferPtr& vbo, const IndexBufferPtr& ibo, const VertexBufferPtr& instances, int instanceStepRate)
+    {
+        m_selectedVBO = vbo;
+        m_selectedIBO = ibo;
+        m_selectedInstances = instances;
+        m_selectedInstanceStep = instanceStepRate;
+        if (isProgramActive())
+        {
+            selectInputBuffers();
+        }
+    }
+
+    void ShaderProgram::drawIndexed(PrimTopology pt, const DrawIndexedCmd& cmd)
+    {
+        drawIndexed(pt, int(cmd.startIndex), int(cmd.indexCount), int(cmd.instanceCount), cmd.baseVertex, int(cmd.baseInstance));
+    }
+
+    void ShaderProgram::drawIndexed(PrimTopology pt, const std::vector<DrawIndexedCmd>& cmd_buf)
+    {
+        if (cmd_buf.empty())
+        {
+            return;
+        }
+
+        activateProgram();
+        selectTopology(pt);
+
+        m_device->getStates()->validateStates();
+
+        GpuCounters& counters = m_device->m_counters;
+        for (const auto& cmd : cmd_buf)
+        {
+            counters.drawCalls++;
+            counters.drawnIndices += uint64_t(cmd.indexCount) * glm::max(cmd.instanceCount, 1u);
+
+            if (GpuCommand* rec = m_device->record(GpuCommandType::DrawIndexed, this))
+            {
+                rec->first = int(cmd.startIndex);
+                rec->count = int(cmd.indexCount);
+                rec->instances = int(cmd.instanceCount);
+                rec->baseVertex = cmd.baseVertex;
+                rec->topology = pt;
+            }
+        }
+    }
+
+    void ShaderProgram::drawIndexed(PrimTopology pt, int index_start, int index_count, int instance_count, int base_vertex, int /*base_instance*/)
+    {
+        activateProgram();
+        selectTopology(pt);
+
+        m_device->getStates()->validateStates();
+
+        if (index_count < 0) index_count = m_selectedIBO->getIndexCount();
+        if (instance_count < 0) instance_count = 0;
+
+        GpuCounters& counters = m_device->m_counters;
+        counters.drawCalls++;
+        counters.drawnIndices += uint64_t(index_count) * glm::max(instance_count, 1);
+
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::DrawIndexed, this))
+        {
+            cmd->first = index_start;
+            cmd->count = index_count;
+            cmd->instances = instance_count;
+            cmd->baseVertex = base_vertex;
+            cmd->topology = pt;
+        }
+    }
+
+    void ShaderProgram::draw(PrimTopology pt, int vert_start, int vert_count, int instance_count, int /*base_instance*/)
+    {
+        activateProgram();
+        selectTopology(pt);
+
+        m_device->getStates()->validateStates();
+
+        if (vert_count < 0) vert_count = m_selectedVBO->getVertexCount();
+        if (instance_count < 0) instance_count = 0;
+
+        GpuCounters& counters = m_device->m_counters;
+        counters.drawCalls++;
+        counters.drawnVertices += uint64_t(vert_count) * glm::max(instance_count, 1);
+
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::Draw, this))
+        {
+            cmd->first = vert_start;
+            cmd->count = vert_count;
+            cmd->instances = instance_count;
+            cmd->topology = pt;
+        }
+    }
+
+    void ShaderProgram::resolveValue(const char* name, int size, ShaderValueHandle& h)
+    {
+        // No reflection, every name is a value of the vertex stage
+        auto it = std::find_if(m_values.begin(), m_values.end(), [name](const ValueData& v) { return v.name == name; });
+        if (it == m_values.end())
+        {
+            m_values.push_back({ name, int(m_globals.size()), size });
+            m_globals.resize(m_globals.size() + size);
+            it = m_values.end() - 1;
+        }
+
+        assert(size <= it->size);
+        h.offsets[0] = it->offset;
+        h.size = it->size;
+        h.stageMask = 1;
+    }
+
+    void ShaderProgram::writeValue(const ShaderValueHandle& h, const void* data, int size)
+    {
+        if (!h.isValid())
+        {
+            return;
+        }
+
+        assert(size <= h.size);
+        memcpy(&m_globals[h.offsets[0]], data, size);
+        m_globals_dirty = true;
+
+        m_device->m_counters.valueSets++;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::SetValue, this))
+        {
+            auto it = std::find_if(m_values.begin(), m_values.end(), [&h](const ValueData& v) { return v.offset == h.offsets[0]; });
+            cmd->name = it->name;
+            cmd->bytes = size;
+        }
+    }
+
+    ShaderResource ShaderProgram::findResource(const char* name)
+    {
+        auto it = std::find_if(m_slots.begin(), m_slots.end(), [name](const ShaderSlot& slot) { return slot.name == name; });
+        if (it == m_slots.end())
+        {
+            ShaderSlot newSlot;
+            newSlot.kind = SlotKind::Uniform;
+            newSlot.name = name;
+            m_slots.push_back(newSlot);
+            it = m_slots.end() - 1;
+        }
+
+        return ShaderResource{ int(it - m_slots.begin()) };
+    }
+
+    void ShaderProgram::setResource(const ShaderResource& h, const UniformBufferPtr& ubo)
+    {
+        bindResource(SlotKind::Uniform, h, ubo.get());
+    }
+
+    void ShaderProgram::setResource(const ShaderResource& h, const StructuredBufferPtr& sbo)
+    {
+        bindResource(SlotKind::Buffer, h, sbo.get());
+    }
+
+    void ShaderProgram::setResource(const ShaderResource& h, const GPUTexture2DPtr& tex, bool /*as_array*/, bool /*as_cubemap*/)
+    {
+        bindResource(SlotKind::Texture, h, tex.get());
+    }
+
+    void ShaderProgram::setResource(const ShaderResource& h, const Sampler& s)
+    {
+        bindResource(SlotKind::Sampler, h, nullptr, &s);
+    }
+
+    void ShaderProgram::selectInputBuffers()
+    {
+        const Layout* vl = m_selectedVBO ? m_selectedVBO->getLayout() : nullptr;
+        const Layout* il = m_selectedInstances ? m_selectedInstances->getLayout() : nullptr;
+        if (vl != m_inputVertices || il != m_inputInstances || m_selectedInstanceStep != m_inputStepRate || !m_inputLayout)
+        {
+            m_inputLayout = m_device->getInputLayouts()->get(m_signature, vl, il, m_selectedInstanceStep);
+            m_inputVertices = vl;
+            m_inputInstances = il;
+            m_inputStepRate = m_selectedInstanceStep;
+        }
+
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::SetInputBuffers, this))
+        {
+            cmd->count = m_selectedVBO ? m_selectedVBO->getVertexCount() : 0;
+            cmd->instances = m_selectedInstances ? m_selectedInstances->getVertexCount() : 0;
+        }
+    }
+
+    void ShaderProgram::selectTopology(PrimTopology /*pt*/)
+    {
+    }
+
+    bool ShaderProgram::isProgramActive() const
+    {
+        return m_device->m_activeProgram == this;
+    }
+
+    void ShaderProgram::bindResource(SlotKind kind, const ShaderResource& h, const void* resource, const Sampler* sampler)
+    {
+        if (!h.isValid())
+        {
+            return;
+        }
+
+        ShaderSlot& slot = m_slots[h.slot];
+        if ((slot.kind == kind) && (slot.resource == resource) && (!sampler || (slot.sampler == *sampler)))
+        {
+            return;
+        }
+
+        slot.kind = kind;
+        slot.resource = resource;
+        if (sampler)
+        {
+            slot.sampler = *sampler;
+        }
+
+        m_device->m_counters.resourceBinds++;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::SetResource, this))
+        {
+            cmd->name = slot.name;
+            cmd->first = h.slot;
+        }
+    }
+
+    VertexBuffer::VertexBuffer(const GDevicePtr& device) : DeviceHolder(device)
+    {
+        m_vertCount = 0;
+        m_layout = nullptr;
+    }
+
+    void VertexBuffer::setState(const Layout* layout, int vertex_count, const void* data)
+    {
+        m_layout = layout;
+        m_vertCount = vertex_count;
+
+        if (!m_vertCount)
+        {
+            m_data.clear();
+            return;
+        }
+
+        m_data.assign(size_t(vertex_count) * m_layout->stride, 0);
+        m_device->m_counters.createdResources++;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::CreateBuffer, this))
+        {
+            cmd->count = vertex_count;
+            cmd->bytes = m_data.size();
+        }
+
+        if (data)
+        {
+            setSubData(0, vertex_count, data);
+        }
+    }
+
+    void VertexBuffer::setSubData(int start_vertex, int num_vertices, const void* data)
+    {
+        assert(!m_data.empty());
+        const size_t offset = size_t(start_vertex) * m_layout->stride;
+        const size_t size = size_t(num_vertices) * m_layout->stride;
+        assert(offset + size <= m_data.size());
+        memcpy(m_data.data() + offset, data, size);
+
+        m_device->m_counters.uploads++;
+        m_device->m_counters.uploadedBytes += size;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::UploadBuffer, this))
+        {
+            cmd->first = start_vertex;
+            cmd->count = num_vertices;
+            cmd->bytes = size;
+        }
+    }
+
+    IndexBuffer::IndexBuffer(const GDevicePtr& device) : DeviceHolder(device)
+    {
+        m_indCount = 0;
+    }
+
+    void IndexBuffer::setState(int ind_count, const void* data)
+    {
+        m_indCount = ind_count;
+        m_data.assign(size_t(m_indCount) * 4, 0);
+
+        m_device->m_counters.createdResources++;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::CreateBuffer, this))
+        {
+            cmd->count = ind_count;
+            cmd->bytes = m_data.size();
+        }
+
+        if (data)
+        {
+            setSubData(0, ind_count, data);
+        }
+    }
+
+    void IndexBuffer::setSubData(int start_idx, int num_indices, const void* data)
+    {
+        if (num_indices <= 0) return;
+        assert(size_t(start_idx + num_indices) * 4 <= m_data.size());
+        memcpy(m_data.data() + size_t(start_idx) * 4, data, size_t(num_indices) * 4);
+
+        m_device->m_counters.uploads++;
+        m_device->m_counters.uploadedBytes += size_t(num_indices) * 4;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::UploadBuffer, this))
+        {
+            cmd->first = start_idx;
+            cmd->count = num_indices;
+            cmd->bytes = size_t(num_indices) * 4;
+        }
+    }
+
+    void UniformBuffer::setState(const Layout* layout, int elemets_count, const void* data)
+    {
+        m_layout = layout;
+        m_elements_count = elemets_count;
+        m_data.resize(static_cast<size_t>(layout->stride) * elemets_count);
+        assert(m_data.size());
+        if (data)
+        {
+            memcpy(m_data.data(), data, m_data.size());
+        }
+
+        m_device->m_counters.createdResources++;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::CreateBuffer, this))
+        {
+            cmd->count = elemets_count;
+            cmd->bytes = m_data.size();
+        }
+
+        m_dirty = false;
+    }
+
+    void UniformBuffer::validateDynamicData()
+    {
+        if (!m_dirty)
+        {
+            return;
+        }
+
+        m_dirty = false;
+
+        m_device->m_counters.maps++;
+        m_device->m_counters.uploads++;
+        m_device->m_counters.uploadedBytes += m_data.size();
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::UploadBuffer, this))
+        {
+            cmd->count = m_elements_count;
+            cmd->bytes = m_data.size();
+        }
+    }
+
+    bool InputLayoutCache::create(const Key& key, Entry& entry)
+    {
+        m_device->m_counters.createdResources++;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::CreateInputLayout, &entry))
+        {
+            cmd->count = int((key.vertices ? key.vertices->fields.size() : 0) + (key.instances ? key.instances->fields.size() : 0));
+        }
+
+        return true;
+    }
+
+    InputLayoutCache::Handle InputLayoutCache::getHandle(const Entry& entry)
+    {
+        return &entry;
+    }
+
+    void ConstantRing::createBuffer()
+    {
+        m_device->m_counters.createdResources++;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::CreateBuffer, this))
+        {
+            cmd->bytes = m_shadow.size();
+        }
+    }
+
+    void ConstantRing::flush()
+    {
+        if (m_flushed == m_head)
+        {
+            return;
+        }
+
+        const int size = m_head - m_flushed;
+        m_device->m_counters.maps++;
+        m_device->m_counters.uploads++;
+        m_device->m_counters.uploadedBytes += size;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::UploadBuffer, this))
+        {
+            cmd->first = m_flushed;
+            cmd->bytes = size;
+        }
+
+        m_flushed = m_head;
+    }
+
+    StructuredBuffer::StructuredBuffer(const GDevicePtr& device) : DeviceHolder(device)
+    {
+    }
+
+    void StructuredBuffer::setState(int stride, int vertex_count, bool UAV, bool UAV_with_counter, const void* data)
+    {
+        m_stride = stride;
+        m_vert_count = vertex_count;
+        m_UAV_access = UAV;
+        m_UAV_with_counter = UAV_with_counter;
+
+        m_data.assign(size_t(glm::max(vertex_count, 1)) * m_stride, 0);
+        m_device->m_counters.createdResources++;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::CreateBuffer, this))
+        {
+            cmd->count = vertex_count;
+            cmd->bytes = m_data.size();
+        }
+
+        if (data)
+        {
+            setSubData(0, vertex_count, data);
+        }
+    }
+
+    void StructuredBuffer::setSubData(int start_vertex, int num_vertices, const void* data)
+    {
+        if (num_vertices <= 0)
+        {
+            return;
+        }
+
+        const size_t offset = size_t(start_vertex) * m_stride;
+        const size_t size = size_t(num_vertices) * m_stride;
+        assert(offset + size <= m_data.size());
+        memcpy(m_data.data() + offset, data, size);
+
+        m_device->m_counters.uploads++;
+        m_device->m_counters.uploadedBytes += size;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::UploadBuffer, this))
+        {
+            cmd->first = start_vertex;
+            cmd->count = num_vertices;
+            cmd->bytes = size;
+        }
+    }
+
+    void StructuredBuffer::readBack(void* data)
+    {
+        memcpy(data, m_data.data(), size_t(m_vert_count) * m_stride);
+    }
+
+    void GPUTexture2D::setState(TextureFmt fmt, int mip_levels)
+    {
+        m_fmt = fmt;
+        m_size = glm::ivec2(0, 0);
+        m_slices = 0;
+        m_mips_count = mip_levels;
+        m_levels.clear();
+    }
+
+    void GPUTexture2D::setState(TextureFmt fmt, glm::ivec2 size, int mip_levels, int slices, const void* data)
+    {
+        m_fmt = fmt;
+        m_size = size;
+        m_slices = slices;
+        m_mips_count = glm::clamp(mip_levels, 1, calcMipLevelsCount(size.x, size.y));
+
+        uint64_t bytes = 0;
+        m_levels.resize(size_t(m_slices) * m_mips_count);
+        for (int slice = 0; slice < m_slices; slice++)
+        {
+            for (int mip = 0; mip < m_mips_count; mip++)
+            {
+                auto& level = m_levels[size_t(slice) * m_mips_count + mip];
+                level.assign(getSlicePitch(m_fmt, mipSize(m_size, mip)), 0);
+                bytes += level.size();
+            }
+        }
+
+        m_device->m_counters.createdResources++;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::CreateTexture, this))
+        {
+            cmd->count = m_slices * m_mips_count;
+            cmd->bytes = bytes;
+        }
+
+        if (data)
+        {
+            setSubData(glm::ivec2(0), m_size, 0, 0, data);
+        }
+    }
+
+    void GPUTexture2D::setSubData(const glm::ivec2& offset, const glm::ivec2& size, int slice, int mip, const void* data)
+    {
+        assert(!m_levels.empty());
+        auto& level = m_levels[size_t(slice) * m_mips_count + mip];
+
+        // Compressed formats are copied in rows of 4x4 blocks
+        const int rowSize = getBlockSize(m_fmt) ? 4 : 1;
+        const int dstPitch = getRowPitch(m_fmt, mipSize(m_size, mip).x);
+        const int srcPitch = getRowPitch(m_fmt, size.x);
+        const int rowOffset = getRowPitch(m_fmt, offset.x);
+        const int firstRow = offset.y / rowSize;
+        const int rows = (size.y + rowSize - 1) / rowSize;
+
+        const uint8_t* src = static_cast<const uint8_t*>(data);
+        for (int row = 0; row < rows; row++)
+        {
+            const size_t dst = size_t(firstRow + row) * dstPitch + rowOffset;
+            assert(dst + srcPitch <= level.size());
+            memcpy(level.data() + dst, src + size_t(row) * srcPitch, srcPitch);
+        }
+
+        const uint64_t bytes = uint64_t(srcPitch) * rows;
+        m_device->m_counters.uploads++;
+        m_device->m_counters.uploadedBytes += bytes;
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::UploadTexture, this))
+        {
+            cmd->first = slice * m_mips_count + mip;
+            cmd->count = 1;
+            cmd->bytes = bytes;
+        }
+    }
+
+    void GPUTexture2D::generateMips()
+    {
+    }
+
+    void GPUTexture2D::readBack(void* data, int mip, int array_slice)
+    {
+        const auto& level = m_levels[size_t(array_slice) * m_mips_count + mip];
+        memcpy(data, level.data(), level.size());
+    }
+
+    Framebuffer::Framebuffer(const GDevicePtr& device) : DeviceHolder(device)
+    {
+    }
+
+    Framebuffer::~Framebuffer()
+    {
+        if (m_device->m_activeFboPtr == this)
+        {
+            m_device->setFrameBuffer(nullptr);
+        }
+    }
+
+    void Framebuffer::clearColorSlot(int slot, const glm::vec4& /*color*/)
+    {
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::Clear, this))
+        {
+            cmd->first = slot;
+        }
+    }
+
+    void Framebuffer::clearDS(float /*depth*/, bool /*clear_depth*/, char /*stencil*/, bool /*clear_stencil*/)
+    {
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::Clear, this))
+        {
+            cmd->first = -1;
+        }
+    }
+
+    void Framebuffer::setColorSlot(int slot, const GPUTexture2DPtr& tex, int mip, int slice_start, int slice_count)
+    {
+        m_tex[slot] = tex;
+        m_tex_params[slot] = Tex2DParams(mip, slice_start, slice_count, false, false);
+    }
+
+    void Framebuffer::setDS(const GPUTexture2DPtr& tex, int mip, int slice_start, int slice_count, bool readonly)
+    {
+        m_depth = tex;
+        m_depth_params = Tex2DParams(mip, slice_start, slice_count, readonly, false);
+    }
+
+    void Framebuffer::clearUAV(int slot, uint32_t /*v*/)
+    {
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::Clear, this))
+        {
+            cmd->first = cColorSlots + slot;
+        }
+    }
+
+    void Framebuffer::setUAV(int slot, const GPUTexture2DPtr& tex, int mip, int slice_start, int slice_count, bool as_array)
+    {
+        m_uav_to_bind_count = -1;
+        m_uav[slot] = UAVSlot(tex, mip, slice_start, slice_count, as_array);
+    }
+
+    void Framebuffer::setUAV(int slot, const StructuredBufferPtr& buf, int initial_counter)
+    {
+        m_uav_to_bind_count = -1;
+        m_uav[slot] = UAVSlot(buf, initial_counter);
+    }
+
+    void Framebuffer::blitToDefaultFBO(int from_slot)
+    {
+        if (!m_tex[from_slot])
+        {
+            return;
+        }
+
+        if (GpuCommand* cmd = m_device->record(GpuCommandType::Blit, this))
+        {
+            cmd->first = from_slot;
+        }
+    }
+
+    void Framebuffer::setSizeFromWindow()
+    {
+        setSize(m_device->m_lastWndSize);
+    }
+
+    void Framebuffer::setSize(const glm::ivec2& xy)
+    {
+        m_size = xy;
+
+        for (int i = 0; i < cColorSlots; i++)
+        {
+            if (!m_tex[i]) continue;
+            if (m_tex[i]->size() != xy)
+            {
+                m_tex[i]->setState(m_tex[i]->format(), xy, m_tex[i]->mipsCount(), 1);
+            }
+        }
+
+        if (m_depth)
+        {
+            if (m_depth->size() != xy)
+            {
+                m_depth->setState(m_depth->format(), xy, m_depth->mipsCount(), 1);
+            }
+        }
+    }
+
+    void Framebuffer::prepareSlots()
+    {
+        m_rtv_count = 0;
+        for (int i = 0; i < cColorSlots; i++)
+        {
+            if (m_tex[i])
+            {
+                m_rtv_count = i + 1;
+            }
+        }
+
+        if (m_uav_to_bind_count < 0)
+        {
+            m_uav_to_bind_count = 0;
+            for (int i = m_rtv_count; i < cUAVSlots; i++)
+            {
+                if (m_uav[i].kind != UAV_slot_kind::empty)
+                {
+                    m_uav_to_bind_count++;
+                }
+            }
+        }
+    }
+}
+
+#endif
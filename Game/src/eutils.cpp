@@ -1,11 +1,58 @@
 #include "eutils.h"
 
-#define STBI_WINDOWS_UTF8
-#define STB_IMAGE_IMPLEMENTATION
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+
+#include "graphics/eimage.h"
+#include "graphics/etexconvert.h"
+#include "utils/ehash.h"
 #include "stb_image.h"
 
 namespace EProject
 {
+    static uint64_t nowMcS()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    QPC::QPC()
+    {
+        m_freq = 1000000;
+        m_start = nowMcS();
+        m_paused_time = 0;
+    }
+
+    uint64_t QPC::TimeMcS() const
+    {
+        return (m_paused ? m_paused_time : nowMcS()) - m_start;
+    }
+
+    uint64_t QPC::Time() const
+    {
+        return TimeMcS() * 1000 / m_freq;
+    }
+
+    void QPC::Pause()
+    {
+        if (!m_paused)
+        {
+            m_paused_time = nowMcS();
+            m_paused = true;
+        }
+    }
+
+    void QPC::Unpause()
+    {
+        if (m_paused)
+        {
+            m_start += nowMcS() - m_paused_time;
+            m_paused = false;
+        }
+    }
 
     CameraBase::CameraBase(const GDevicePtr& device)
     {
@@ -124,6 +171,12 @@ namespace EProject
         return currentPath.parent_path() / "Data";
     }
 
+    std::filesystem::path PathHandler::getDataArchive()
+    {
+        auto currentPath = std::filesystem::current_path();
+        return currentPath.parent_path() / "Data.pak";
+    }
+
     std::filesystem::path PathHandler::getShadersDir()
     {
         return getDataDir() / "Shaders";
@@ -139,6 +192,12 @@ namespace EProject
         return getDataDir() / "Models";
     }
 
+    std::filesystem::path PathHandler::getCacheDir()
+    {
+        auto currentPath = std::filesystem::current_path();
+        return currentPath.parent_path() / "Cache";
+    }
+
     std::size_t PathKey::operator()(const PathKey& k) const
     {
         return std::filesystem::hash_value(k.path);
@@ -153,6 +212,7 @@ namespace EProject
     {
         m_fmt = _rhs.m_fmt;
         m_size = _rhs.m_size;
+        m_byteSize = _rhs.m_byteSize;
         
         memcpy((char*)m_data, _rhs.m_data, sizeof(_rhs.m_data));
     }
@@ -175,34 +235,53 @@ namespace EProject
 
     }
 
+    bool Texture2D::read()
+    {
+        if (!getFileSystem()->open(m_path, m_file))
+        {
+            return false;
+        }
+
+        m_contentHash = EHash::hash64(m_file.getData(), m_file.getSize());
+        return true;
+    }
+
     bool Texture2D::load(const GDevicePtr& _ptr)
     {
-        //stbi_is_hdr - check for floating point format
-        //stbi_is_16_bit - check for 16 bif formats?
-        //stbi_loadf - load floating point format
-        //stbi_failure_reason - get error information
+        // Synchronous loads skip the IO stage
+        if (m_file.isOpen() || read())
+        {
+            const ImageSource src = { m_file.getData(), m_file.getSize() };
+
+            glm::ivec2 size;
+            int channels = 0;
+
+            // Single channel 16 bit images (height maps) stay R16, everything else is expanded to RGBA
+            const bool gray16 = ImageDecoder::is16Bit(src) && ImageDecoder::getInfo(src, size, channels) && channels == 1;
 
-        stbi_set_flip_vertically_on_load(0);
+            auto image = ImageDecoder::decodeNative(src, gray16 ? 1 : 4);
+            m_file.close();
+
+            setImage(std::move(image));
+        }
 
-        int comp;
-        int targetformat = STBI_rgb_alpha;
-        m_data = stbi_load(m_path.u8string().c_str(), &m_size.x, &m_size.y, &comp, targetformat);
         if (!m_data)
         {
             throw std::runtime_error("Texture2D: Load failed: " + m_path.u8string());
         }
 
-        m_fmt = TextureFmt::RGBA8;
-        m_valid = true;
-
         return true;
     }
 
     bool Texture2D::unload()
     {
+        m_file.close();
+
         if (m_data)
         {
             stbi_image_free(m_data);
+            m_data = nullptr;
+            m_valid = false;
 
             return true;
         }
@@ -210,6 +289,64 @@ namespace EProject
         return false;
     }
 
+    bool Texture2D::setImage(DecodedImage&& image)
+    {
+        if (!image.pixels)
+        {
+            return false;
+        }
+
+        TextureFmt fmt = TextureFmt::None;
+
+        if (image.type == PixelType::UInt8 && image.channels == 4)
+        {
+            fmt = TextureFmt::RGBA8;
+        }
+        else if (image.type == PixelType::UInt16 && image.channels == 1)
+        {
+            fmt = TextureFmt::R16;
+        }
+        else if (image.type == PixelType::UInt16 && image.channels == 4)
+        {
+            fmt = TextureFmt::RGBA16;
+        }
+        else if (image.type == PixelType::Float && image.channels == 4)
+        {
+            // Half floats are enough for HDR colour and take half the memory
+            const size_t count = static_cast<size_t>(image.size.x) * image.size.y * 4;
+
+            PixelBuffer half(static_cast<uint8_t*>(getPixelBufferPool()->allocate(count * sizeof(uint16_t))));
+            TextureConvert::floatToHalf(reinterpret_cast<const float*>(image.pixels.get()), count, reinterpret_cast<uint16_t*>(half.get()));
+
+            image.pixels = std::move(half);
+            image.type = PixelType::UInt16;
+
+            fmt = TextureFmt::RGBA16f;
+        }
+        else
+        {
+            return false;
+        }
+
+        if (m_data)
+        {
+            stbi_image_free(m_data);
+        }
+
+        m_size = image.size;
+        m_byteSize = image.getByteSize();
+        m_data = image.pixels.release();
+        m_fmt = fmt;
+        m_valid = true;
+
+        return true;
+    }
+
+    size_t Texture2D::getMemoryUsage() const
+    {
+        return (m_data ? m_byteSize : 0) + m_file.getMemoryUsage();
+    }
+
     const void* Texture2D::getData() const
     {
         return (const void*)m_data;
@@ -217,12 +354,1241 @@ namespace EProject
 
     IAsset::IAsset(const std::filesystem::path& p) : m_path(p)
     {
-        assert(std::filesystem::exists(m_path));
+        assert(getFileSystem()->exists(m_path));
+    }
+
+    namespace
+    {
+        // Reader slots a thread claimed, handed back when it exits if their cache is still alive
+        class ReaderClaims final
+        {
+        public:
+            struct Claim
+            {
+                uint64_t cache = 0;
+                void* reader = nullptr;
+                std::atomic<bool>* claimed = nullptr;
+            };
+
+            ~ReaderClaims()
+            {
+                std::lock_guard<std::mutex> lock(getMutex());
+
+                for (const auto& claim : m_claims)
+                {
+                    if (claim.reader && getLiveCaches().count(claim.cache))
+                    {
+                        claim.claimed->store(false);
+                    }
+                }
+            }
+
+            const Claim* find(uint64_t cache) const
+            {
+                for (const auto& claim : m_claims)
+                {
+                    if (claim.cache == cache)
+                    {
+                        return &claim;
+                    }
+                }
+
+                return nullptr;
+            }
+
+            void add(uint64_t cache, void* reader, std::atomic<bool>* claimed)
+            {
+                std::lock_guard<std::mutex> lock(getMutex());
+
+                const auto& live = getLiveCaches();
+                m_claims.erase(std::remove_if(m_claims.begin(), m_claims.end(), [&live](const Claim& claim)
+                {
+                    return !live.count(claim.cache);
+                }), m_claims.end());
+
+                m_claims.push_back({ cache, reader, claimed });
+            }
+
+            static std::mutex& getMutex()
+            {
+                static std::mutex mutex;
+                return mutex;
+            }
+
+            static std::unordered_set<uint64_t>& getLiveCaches()
+            {
+                static std::unordered_set<uint64_t> caches;
+                return caches;
+            }
+
+        private:
+            std::vector<Claim> m_claims;
+        };
+
+        thread_local ReaderClaims readerClaims;
+
+        uint64_t registerCache()
+        {
+            static std::atomic<uint64_t> nextId = 1;
+            const uint64_t id = nextId++;
+
+            std::lock_guard<std::mutex> lock(ReaderClaims::getMutex());
+            ReaderClaims::getLiveCaches().insert(id);
+
+            return id;
+        }
+    }
+
+    AssetCache::AssetCache() : m_id(registerCache())
+    {
+    }
+
+    AssetCache::~AssetCache()
+    {
+        {
+            std::lock_guard<std::mutex> lock(ReaderClaims::getMutex());
+            ReaderClaims::getLiveCaches().erase(m_id);
+        }
+
+        for (auto& shard : m_shards)
+        {
+            delete shard.assets.load();
+
+            for (const auto& retired : shard.retired)
+            {
+                delete retired.map;
+            }
+        }
+    }
+
+    AssetCache::Shard& AssetCache::getShard(const PathKey& key) const
+    {
+        return m_shards[PathKey{}(key) % cShardsCount];
+    }
+
+    AssetCache::Reader* AssetCache::getReader() const
+    {
+        if (const auto* claim = readerClaims.find(m_id))
+        {
+            return static_cast<Reader*>(claim->reader);
+        }
+
+        Reader* reader = nullptr;
+
+        for (auto& slot : m_readers)
+        {
+            bool expected = false;
+            if (slot.claimed.compare_exchange_strong(expected, true))
+            {
+                reader = &slot;
+                break;
+            }
+        }
+
+        // Out of slots, this thread reads under the shard mutex from now on
+        readerClaims.add(m_id, reader, reader ? &reader->claimed : nullptr);
+
+        return reader;
+    }
+
+    std::shared_ptr<IAsset> AssetCache::lookup(Shard& shard, const PathKey& key, bool hit) const
+    {
+        Reader* reader = getReader();
+
+        if (!reader)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            const Map* map = shard.assets.load();
+            if (!map)
+            {
+                return nullptr;
+            }
+
+            auto it = map->find(key);
+            if (it == map->end())
+            {
+                return nullptr;
+            }
+
+            if (hit)
+            {
+                m_lockedHits.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            return it->second;
+        }
+
+        // The epoch goes up after each publish. A reader that announced it before loading the
+        // snapshot keeps every snapshot retired at or after that epoch alive, see reclaim()
+        reader->epoch.store(m_epoch.load(std::memory_order_acquire));
+
+        std::shared_ptr<IAsset> asset;
+
+        if (const Map* map = shard.assets.load())
+        {
+            auto it = map->find(key);
+            if (it != map->end())
+            {
+                asset = it->second;
+            }
+        }
+
+        reader->epoch.store(0);
+
+        if (asset && hit)
+        {
+            reader->hits.store(reader->hits.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        return asset;
+    }
+
+    void AssetCache::publish(Shard& shard, const Map* map) const
+    {
+        if (const Map* old = shard.assets.exchange(map))
+        {
+            shard.retired.push_back({ old, m_epoch.fetch_add(1) });
+        }
+
+        reclaim(shard);
+    }
+
+    void AssetCache::reclaim(Shard& shard) const
+    {
+        if (shard.retired.empty())
+        {
+            return;
+        }
+
+        uint64_t oldest = std::numeric_limits<uint64_t>::max();
+
+        for (const auto& reader : m_readers)
+        {
+            const uint64_t epoch = reader.epoch.load();
+            if (epoch != 0)
+            {
+                oldest = std::min(oldest, epoch);
+            }
+        }
+
+        // Readers that announced a later epoch loaded the snapshot after it was replaced
+        auto keep = std::remove_if(shard.retired.begin(), shard.retired.end(), [oldest](const Retired& retired)
+        {
+            if (retired.epoch < oldest)
+            {
+                delete retired.map;
+                return true;
+            }
+
+            return false;
+        });
+
+        shard.retired.erase(keep, shard.retired.end());
+    }
+
+    std::shared_ptr<IAsset> AssetCache::find(const PathKey& key) const
+    {
+        return lookup(getShard(key), key, false);
+    }
+
+    std::shared_ptr<IAsset> AssetCache::insert(const PathKey& key, const std::shared_ptr<IAsset>& asset)
+    {
+        Shard& shard = getShard(key);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        const Map* current = shard.assets.load();
+        if (current)
+        {
+            auto it = current->find(key);
+            if (it != current->end())
+            {
+                return it->second;
+            }
+        }
+
+        auto map = current ? std::make_unique<Map>(*current) : std::make_unique<Map>();
+        map->insert({ key, asset });
+        publish(shard, map.release());
+
+        return asset;
+    }
+
+    std::shared_ptr<IAsset> AssetCache::getOrLoad(const PathKey& key, const std::function<std::shared_ptr<IAsset>()>& loader)
+    {
+        Shard& shard = getShard(key);
+
+        if (auto cached = lookup(shard, key, true))
+        {
+            return cached;
+        }
+
+        InFlight inFlight;
+
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            if (const Map* map = shard.assets.load())
+            {
+                auto it = map->find(key);
+                if (it != map->end())
+                {
+                    m_lockedHits.fetch_add(1, std::memory_order_relaxed);
+                    return it->second;
+                }
+            }
+
+            auto it = shard.inFlight.find(key);
+            if (it != shard.inFlight.end())
+            {
+                inFlight = it->second.result;
+            }
+            else
+            {
+                Loading loading;
+                loading.result = loading.promise.get_future().share();
+
+                shard.inFlight.insert({ key, std::move(loading) });
+            }
+        }
+
+        if (inFlight.valid())
+        {
+            ++m_joins;
+            return inFlight.get();
+        }
+
+        ++m_misses;
+
+        std::shared_ptr<IAsset> asset;
+
+        try
+        {
+            asset = loader();
+        }
+        catch (...)
+        {
+            finishLoad(key, nullptr, std::current_exception());
+            throw;
+        }
+
+        return finishLoad(key, asset, nullptr);
+    }
+
+    bool AssetCache::beginLoad(const PathKey& key)
+    {
+        Shard& shard = getShard(key);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        const Map* map = shard.assets.load();
+        if ((map && map->count(key)) || shard.inFlight.count(key))
+        {
+            return false;
+        }
+
+        Loading loading;
+        loading.result = loading.promise.get_future().share();
+
+        shard.inFlight.insert({ key, std::move(loading) });
+        ++m_misses;
+
+        return true;
+    }
+
+    std::shared_ptr<IAsset> AssetCache::endLoad(const PathKey& key, const std::shared_ptr<IAsset>& asset)
+    {
+        return finishLoad(key, asset, nullptr);
+    }
+
+    void AssetCache::failLoad(const PathKey& key, std::exception_ptr error)
+    {
+        finishLoad(key, nullptr, error);
+    }
+
+    std::shared_ptr<IAsset> AssetCache::finishLoad(const PathKey& key, std::shared_ptr<IAsset> asset, std::exception_ptr error)
+    {
+        if (asset && !error)
+        {
+            asset = insert(key, asset);
+        }
+
+        Shard& shard = getShard(key);
+
+        std::promise<std::shared_ptr<IAsset>> promise;
+        bool pending = false;
+
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            auto it = shard.inFlight.find(key);
+            if (it != shard.inFlight.end())
+            {
+                promise = std::move(it->second.promise);
+                shard.inFlight.erase(it);
+                pending = true;
+            }
+        }
+
+        if (pending)
+        {
+            if (error)
+            {
+                promise.set_exception(error);
+            }
+            else
+            {
+                promise.set_value(asset);
+            }
+        }
+
+        return asset;
+    }
+
+    bool AssetCache::erase(const PathKey& key, const std::shared_ptr<IAsset>& asset)
+    {
+        Shard& shard = getShard(key);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        const Map* current = shard.assets.load();
+        if (!current)
+        {
+            return false;
+        }
+
+        auto it = current->find(key);
+        if (it == current->end() || it->second != asset)
+        {
+            return false;
+        }
+
+        auto map = std::make_unique<Map>(*current);
+        map->erase(key);
+        publish(shard, map.release());
+
+        return true;
+    }
+
+    void AssetCache::replace(const PathKey& key, const std::shared_ptr<IAsset>& asset)
+    {
+        Shard& shard = getShard(key);
+
+        std::lock_guard<std::mutex> lock(shard.mutex);
+
+        const Map* current = shard.assets.load();
+
+        auto map = current ? std::make_unique<Map>(*current) : std::make_unique<Map>();
+        (*map)[key] = asset;
+        publish(shard, map.release());
     }
 
-    AssetManager::AssetManager(const GDevicePtr& _ptr) : m_ptr(_ptr)
+    void AssetCache::forEach(const std::function<void(const PathKey&, const std::shared_ptr<IAsset>&)>& func) const
     {
+        for (auto& shard : m_shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            reclaim(shard);
+
+            if (const Map* map = shard.assets.load())
+            {
+                for (const auto& [key, asset] : *map)
+                {
+                    func(key, asset);
+                }
+            }
+        }
     }
 
+    size_t AssetCache::size() const
+    {
+        size_t count = 0;
 
+        for (auto& shard : m_shards)
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            if (const Map* map = shard.assets.load())
+            {
+                count += map->size();
+            }
+        }
+
+        return count;
+    }
+
+    AssetCache::Stats AssetCache::getStats() const
+    {
+        Stats stats = {};
+
+        for (const auto& reader : m_readers)
+        {
+            stats.hits += reader.hits.load(std::memory_order_relaxed);
+        }
+
+        stats.hits += m_lockedHits.load(std::memory_order_relaxed);
+        stats.misses = m_misses.load();
+        stats.joins = m_joins.load();
+
+        return stats;
+    }
+
+    AssetManager::AssetManager(const GDevicePtr& _ptr) : m_ptr(_ptr), m_completed(std::make_shared<CompletionQueue>())
+    {
+        m_ioThread = std::thread(&AssetManager::ioLoop, this);
+    }
+
+    AssetManager::~AssetManager()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_ioMutex);
+            m_ioStop = true;
+        }
+
+        m_ioCv.notify_all();
+        m_ioThread.join();
+    }
+
+    AssetRequestPtr AssetManager::queueRequest(const std::filesystem::path& path, float priority, std::function<void(const std::shared_ptr<IAsset>&)>&& callback, const AssetFactory& factory)
+    {
+        auto request = std::make_shared<AssetRequest>();
+        request->key = PathKey(path);
+
+        if (auto cached = m_cache.find(request->key))
+        {
+            cached->touch(m_frame.load(std::memory_order_relaxed));
+
+            request->asset = cached;
+            request->state = AssetState::Ready;
+
+            if (callback)
+            {
+                callback(request->asset);
+            }
+
+            return request;
+        }
+
+        // Attach to the load that is already queued
+        if (auto it = m_pending.find(request->key); it != m_pending.end())
+        {
+            if (callback)
+            {
+                it->second->callbacks.emplace_back(std::move(callback));
+            }
+
+            return it->second;
+        }
+
+        request->priority = priority;
+        request->order = m_requestCounter++;
+        request->asset = factory(path);
+
+        registerFactory(typeid(*request->asset), factory);
+
+        if (callback)
+        {
+            request->callbacks.emplace_back(std::move(callback));
+        }
+
+        m_pending.insert({ request->key, request });
+
+        pushRequest(request);
+
+        return request;
+    }
+
+    void AssetManager::pushRequest(const AssetRequestPtr& request)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_ioMutex);
+            m_ioQueue.push(request);
+        }
+
+        m_ioCv.notify_one();
+    }
+
+    void AssetManager::ioLoop()
+    {
+        while (true)
+        {
+            AssetRequestPtr request;
+
+            {
+                std::unique_lock<std::mutex> lock(m_ioMutex);
+                m_ioCv.wait(lock, [this]() { return m_ioStop || !m_ioQueue.empty(); });
+
+                if (m_ioStop)
+                {
+                    return;
+                }
+
+                request = m_ioQueue.top();
+                m_ioQueue.pop();
+            }
+
+            request->state = AssetState::Loading;
+
+            // Disk reads stay ordered on this thread, decoding goes wide
+            bool ok = false;
+            try
+            {
+                ok = request->asset->read();
+            }
+            catch (const std::exception& e)
+            {
+                request->error = e.what();
+            }
+            catch (...)
+            {
+                request->error = "unknown exception";
+            }
+
+            auto completed = m_completed;
+
+            if (ok)
+            {
+                const auto& asset = *request->asset;
+                if (auto shared = findByContent(request->key, asset.getContentHash(), typeid(asset)))
+                {
+                    request->asset = shared;
+                    request->shared = true;
+
+                    std::lock_guard<std::mutex> lock(completed->mutex);
+                    completed->requests.push_back(std::move(request));
+                    continue;
+                }
+            }
+            else
+            {
+                if (request->error.empty())
+                {
+                    request->error = "read failed";
+                }
+
+                std::lock_guard<std::mutex> lock(completed->mutex);
+                completed->requests.push_back(std::move(request));
+                continue;
+            }
+
+            getJobSystem()->submit([request, completed, dev = m_ptr]()
+            {
+                try
+                {
+                    // CPU side setup (bounds, meshlets) belongs to the decode as well, the frame only picks it up
+                    if (request->asset->load(dev))
+                    {
+                        request->asset->init();
+                    }
+                    else
+                    {
+                        request->error = "load failed";
+                    }
+                }
+                catch (const std::exception& e)
+                {
+                    request->error = e.what();
+                }
+                catch (...)
+                {
+                    request->error = "unknown exception";
+                }
+
+                std::lock_guard<std::mutex> lock(completed->mutex);
+                completed->requests.push_back(request);
+            });
+        }
+    }
+
+    void AssetManager::update()
+    {
+        static constexpr uint64_t cGarbageInterval = 60;
+
+        const uint64_t frame = m_frame.fetch_add(1, std::memory_order_relaxed) + 1;
+        if (frame % cGarbageInterval == 0)
+        {
+            collectGarbage();
+        }
+
+        if (m_watcher)
+        {
+            reloadChanged();
+        }
+
+        std::vector<AssetRequestPtr> done;
+
+        {
+            std::lock_guard<std::mutex> lock(m_completed->mutex);
+            done.swap(m_completed->requests);
+        }
+
+        for (auto& request : done)
+        {
+            if (request->reload)
+            {
+                if (!request->error.empty())
+                {
+                    std::cout << "AssetManager: Reload failed, keeping the old asset: " << request->key.path.u8string() << " (" << request->error << ")\n";
+                    continue;
+                }
+
+                if (!request->shared)
+                {
+                    request->asset = registerContent(request->key, request->asset);
+                }
+
+                m_cache.replace(request->key, request->asset);
+                request->asset->touch(frame);
+
+                std::cout << "AssetManager: Reloaded " << request->key.path.u8string() << "\n";
+
+                notifyReload(request->key.path, request->asset);
+                continue;
+            }
+
+            m_pending.erase(request->key);
+
+            if (!request->error.empty())
+            {
+                std::cout << "AssetManager: Load failed: " << request->key.path.u8string() << " (" << request->error << ")\n";
+
+                request->asset = nullptr;
+                request->state = AssetState::Failed;
+            }
+            else
+            {
+                if (!request->shared)
+                {
+                    request->asset = registerContent(request->key, request->asset);
+                }
+
+                // A sync getAsset may have loaded it in the meantime, keep a single instance
+                request->asset = m_cache.insert(request->key, request->asset);
+                request->asset->touch(m_frame.load(std::memory_order_relaxed));
+
+                request->state = AssetState::Ready;
+            }
+
+            // A throwing callback fails its own request, the others still finish this frame
+            for (auto& callback : request->callbacks)
+            {
+                try
+                {
+                    callback(request->asset);
+                }
+                catch (const std::exception& e)
+                {
+                    request->error = e.what();
+                }
+                catch (...)
+                {
+                    request->error = "unknown exception";
+                }
+            }
+
+            if (request->state == AssetState::Ready && !request->error.empty())
+            {
+                std::cout << "AssetManager: Load callback failed: " << request->key.path.u8string() << " (" << request->error << ")\n";
+                request->state = AssetState::Failed;
+            }
+
+            request->callbacks.clear();
+        }
+    }
+
+    std::vector<Asset<Texture2D>> AssetManager::getTextures(const std::vector<std::filesystem::path>& paths)
+    {
+        const uint64_t frame = m_frame.load(std::memory_order_relaxed);
+
+        std::vector<Asset<Texture2D>> result(paths.size());
+        std::vector<size_t> missing;
+        std::vector<size_t> loadingElsewhere;
+
+        // Claimed keys make concurrent getAsset calls wait for this batch instead of decoding again
+        for (size_t i = 0; i < paths.size(); ++i)
+        {
+            const PathKey key(paths[i]);
+
+            if (auto asset = m_cache.find(key))
+            {
+                asset->touch(frame);
+                result[i] = std::static_pointer_cast<Texture2D>(asset);
+            }
+            else if (m_cache.beginLoad(key))
+            {
+                missing.push_back(i);
+            }
+            else
+            {
+                loadingElsewhere.push_back(i);
+            }
+        }
+
+        if (!missing.empty())
+        {
+            try
+            {
+                loadTextures(paths, missing, result);
+            }
+            catch (...)
+            {
+                for (const size_t i : missing)
+                {
+                    if (!result[i])
+                    {
+                        m_cache.failLoad(PathKey(paths[i]), std::current_exception());
+                    }
+                }
+
+                throw;
+            }
+        }
+
+        // Loading on another thread or listed twice, only waited for once the own claims are done
+        for (const size_t i : loadingElsewhere)
+        {
+            result[i] = getAsset<Texture2D>(paths[i]);
+        }
+
+        return result;
+    }
+
+    void AssetManager::loadTextures(const std::vector<std::filesystem::path>& paths, const std::vector<size_t>& missing, std::vector<Asset<Texture2D>>& result)
+    {
+        const uint64_t frame = m_frame.load(std::memory_order_relaxed);
+
+        registerFactory(typeid(Texture2D), [](const std::filesystem::path& p) { return std::make_shared<Texture2D>(p); });
+
+        std::vector<FileView> files(missing.size());
+        std::vector<uint64_t> hashes(missing.size());
+
+        getJobSystem()->parallelFor(missing.size(), [&](size_t i)
+        {
+            if (!getFileSystem()->open(paths[missing[i]], files[i]))
+            {
+                throw std::runtime_error("Texture2D: Load failed: " + paths[missing[i]].u8string());
+            }
+
+            hashes[i] = EHash::hash64(files[i].getData(), files[i].getSize());
+        });
+
+        // Byte identical files are decoded once, either earlier or by the first of them in this batch
+        std::unordered_map<uint64_t, size_t> firstInBatch;
+        std::vector<size_t> decoded;
+        std::vector<ImageSource> sources;
+
+        for (size_t i = 0; i < missing.size(); ++i)
+        {
+            const PathKey key(paths[missing[i]]);
+
+            if (auto shared = findByContent(key, hashes[i], typeid(Texture2D)))
+            {
+                auto asset = m_cache.endLoad(key, shared);
+                asset->touch(frame);
+
+                result[missing[i]] = std::static_pointer_cast<Texture2D>(asset);
+            }
+            else if (firstInBatch.insert({ hashes[i], i }).second)
+            {
+                decoded.push_back(i);
+                sources.push_back({ files[i].getData(), files[i].getSize() });
+            }
+        }
+
+        auto images = ImageDecoder::decodeBatch(sources, 4);
+
+        for (size_t d = 0; d < decoded.size(); ++d)
+        {
+            const size_t i = decoded[d];
+            const auto& path = paths[missing[i]];
+
+            auto texture = std::make_shared<Texture2D>(path);
+            if (!texture->setImage(std::move(images[d])))
+            {
+                throw std::runtime_error("Texture2D: Load failed: " + path.u8string() + " (" + images[d].error + ")");
+            }
+
+            texture->setContentHash(hashes[i]);
+            texture->init();
+
+            auto asset = m_cache.endLoad(PathKey(path), registerContent(PathKey(path), texture));
+            asset->touch(frame);
+
+            result[missing[i]] = std::static_pointer_cast<Texture2D>(asset);
+        }
+
+        // The rest are copies of a file decoded above
+        for (size_t i = 0; i < missing.size(); ++i)
+        {
+            if (result[missing[i]])
+            {
+                continue;
+            }
+
+            const PathKey key(paths[missing[i]]);
+
+            // Registers the path as an alias of the shared content
+            std::shared_ptr<IAsset> asset = findByContent(key, hashes[i], typeid(Texture2D));
+            if (!asset)
+            {
+                asset = result[missing[firstInBatch[hashes[i]]]];
+            }
+
+            result[missing[i]] = std::static_pointer_cast<Texture2D>(m_cache.endLoad(key, asset));
+        }
+    }
+
+    void AssetManager::watch(const std::filesystem::path& dir)
+    {
+        m_watcher = std::make_unique<FileWatcher>(dir);
+
+        if (!m_watcher->isWatching())
+        {
+            std::cout << "AssetManager: Can't watch " << dir.u8string() << ", hot reload is off\n";
+            m_watcher = nullptr;
+            return;
+        }
+
+        std::cout << "AssetManager: Watching " << dir.u8string() << " for changes\n";
+    }
+
+    void AssetManager::addDependency(const std::filesystem::path& dependent, const std::filesystem::path& dependency)
+    {
+        auto& dependents = m_dependents[PathKey(dependency.lexically_normal())];
+
+        const PathKey key(dependent.lexically_normal());
+        if (std::find(dependents.begin(), dependents.end(), key) == dependents.end())
+        {
+            dependents.push_back(key);
+        }
+    }
+
+    void AssetManager::addReloadListener(ReloadListener listener)
+    {
+        m_reloadListeners.push_back(std::move(listener));
+    }
+
+    void AssetManager::registerFactory(const std::type_index& type, const AssetFactory& factory)
+    {
+        std::lock_guard<std::mutex> lock(m_factoryMutex);
+        m_factories.insert({ type, factory });
+    }
+
+    void AssetManager::reloadChanged()
+    {
+        const auto changed = m_watcher->poll();
+        if (changed.empty())
+        {
+            return;
+        }
+
+        std::vector<PathKey> affected;
+        for (const auto& path : changed)
+        {
+            affected.emplace_back(path.lexically_normal());
+        }
+
+        // The list grows while it's walked, so dependents of dependents get in too
+        for (size_t i = 0; i < affected.size(); ++i)
+        {
+            auto it = m_dependents.find(affected[i]);
+            if (it == m_dependents.end())
+            {
+                continue;
+            }
+
+            for (const auto& dependent : it->second)
+            {
+                if (std::find(affected.begin(), affected.end(), dependent) == affected.end())
+                {
+                    affected.push_back(dependent);
+                }
+            }
+        }
+
+        // Cache keys are the paths as requested, not normalized
+        std::unordered_map<PathKey, std::vector<PathKey>, PathKey> cached;
+        m_cache.forEach([&cached](const PathKey& key, const std::shared_ptr<IAsset>&)
+        {
+            cached[PathKey(key.path.lexically_normal())].push_back(key);
+        });
+
+        for (const auto& path : affected)
+        {
+            getFileSystem()->overrideLoose(path.path);
+
+            auto it = cached.find(path);
+            if (it == cached.end())
+            {
+                notifyReload(path.path, nullptr);
+                continue;
+            }
+
+            for (const auto& key : it->second)
+            {
+                auto asset = m_cache.find(key);
+
+                AssetFactory factory;
+                if (asset)
+                {
+                    std::lock_guard<std::mutex> lock(m_factoryMutex);
+
+                    auto factoryIt = m_factories.find(typeid(*asset));
+                    if (factoryIt != m_factories.end())
+                    {
+                        factory = factoryIt->second;
+                    }
+                }
+
+                if (!factory)
+                {
+                    notifyReload(key.path, nullptr);
+                    continue;
+                }
+
+                // Goes through the IO thread and the decode jobs like any other load, ahead of streaming
+                auto request = std::make_shared<AssetRequest>();
+                request->key = key;
+                request->priority = std::numeric_limits<float>::max();
+                request->order = m_requestCounter++;
+                request->reload = true;
+                request->asset = factory(key.path);
+
+                pushRequest(request);
+            }
+        }
+    }
+
+    void AssetManager::notifyReload(const std::filesystem::path& path, const std::shared_ptr<IAsset>& asset)
+    {
+        for (const auto& listener : m_reloadListeners)
+        {
+            listener(path, asset);
+        }
+    }
+
+    std::shared_ptr<IAsset> AssetManager::findByContent(const PathKey& key, uint64_t hash, const std::type_index& type)
+    {
+        if (!hash)
+        {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(m_contentMutex);
+
+        auto it = m_content.find(hash);
+        if (it == m_content.end())
+        {
+            return nullptr;
+        }
+
+        auto& entry = it->second;
+
+        auto asset = entry.asset.lock();
+        if (!asset || std::type_index(typeid(*asset)) != type || entry.owner == key)
+        {
+            return nullptr;
+        }
+
+        if (std::find(entry.aliases.begin(), entry.aliases.end(), key) == entry.aliases.end())
+        {
+            entry.aliases.push_back(key);
+        }
+
+        return asset;
+    }
+
+    std::shared_ptr<IAsset> AssetManager::registerContent(const PathKey& key, const std::shared_ptr<IAsset>& asset)
+    {
+        if (auto shared = findByContent(key, asset->getContentHash(), typeid(*asset)))
+        {
+            return shared;
+        }
+
+        if (asset->getContentHash())
+        {
+            std::lock_guard<std::mutex> lock(m_contentMutex);
+
+            // An expired owner was evicted, its aliases load again as well
+            auto& entry = m_content[asset->getContentHash()];
+            if (entry.asset.expired() || entry.owner == key)
+            {
+                entry = { asset, key, {} };
+            }
+        }
+
+        return asset;
+    }
+
+    std::vector<AssetManager::SharedContent> AssetManager::getSharedContent() const
+    {
+        std::vector<SharedContent> result;
+
+        std::lock_guard<std::mutex> lock(m_contentMutex);
+
+        for (const auto& [hash, entry] : m_content)
+        {
+            auto asset = entry.asset.lock();
+            if (!asset || entry.aliases.empty())
+            {
+                continue;
+            }
+
+            result.push_back({ entry.owner, entry.aliases, asset->getMemoryUsage() * entry.aliases.size() });
+        }
+
+        return result;
+    }
+
+    void AssetManager::printSharedContent(std::ostream& out) const
+    {
+        struct SceneStats
+        {
+            size_t aliases = 0;
+            size_t bytes = 0;
+        };
+
+        std::map<std::filesystem::path, SceneStats> scenes;
+
+        for (const auto& content : getSharedContent())
+        {
+            for (const auto& alias : content.aliases)
+            {
+                auto& scene = scenes[alias.path.parent_path().lexically_relative(PathHandler::getDataDir())];
+                scene.aliases += 1;
+                scene.bytes += content.reclaimedBytes / content.aliases.size();
+            }
+        }
+
+        size_t total = 0;
+
+        for (const auto& [scene, stats] : scenes)
+        {
+            out << "AssetManager: " << scene.u8string() << ": " << stats.aliases << " duplicate assets shared, " << stats.bytes / 1024 << " KB reclaimed\n";
+            total += stats.bytes;
+        }
+
+        out << "AssetManager: " << total / 1024 << " KB reclaimed by content sharing\n";
+    }
+
+    size_t AssetManager::collectGarbage()
+    {
+        struct Entry
+        {
+            std::vector<PathKey> keys;
+            std::shared_ptr<IAsset> asset;
+            size_t bytes;
+        };
+
+        std::unordered_map<std::type_index, size_t> budgets;
+        {
+            std::lock_guard<std::mutex> lock(m_budgetMutex);
+            budgets = m_budgets;
+        }
+
+        // Shared content sits in the cache once per alias
+        std::unordered_map<const IAsset*, std::vector<PathKey>> keys;
+
+        m_cache.forEach([&](const PathKey& key, const std::shared_ptr<IAsset>& asset)
+        {
+            keys[asset.get()].push_back(key);
+        });
+
+        std::unordered_map<std::type_index, size_t> usage;
+        std::unordered_map<std::type_index, std::vector<Entry>> candidates;
+
+        m_cache.forEach([&](const PathKey& key, const std::shared_ptr<IAsset>& asset)
+        {
+            const auto& assetKeys = keys[asset.get()];
+            if (assetKeys.empty() || !(assetKeys.front() == key))
+            {
+                return;
+            }
+
+            const std::type_index type(typeid(*asset));
+            const size_t bytes = asset->getMemoryUsage();
+
+            usage[type] += bytes;
+
+            // Only the cache holds it
+            if (asset.use_count() == static_cast<long>(assetKeys.size()))
+            {
+                candidates[type].push_back({ assetKeys, asset, bytes });
+            }
+        });
+
+        size_t freed = 0;
+        size_t evicted = 0;
+
+        for (auto& [type, list] : candidates)
+        {
+            auto budget = budgets.find(type);
+            if (budget == budgets.end() || budget->second == 0 || usage[type] <= budget->second)
+            {
+                continue;
+            }
+
+            std::sort(list.begin(), list.end(), [](const Entry& a, const Entry& b)
+            {
+                return a.asset->getLastUsed() < b.asset->getLastUsed();
+            });
+
+            for (auto& entry : list)
+            {
+                if (usage[type] <= budget->second)
+                {
+                    break;
+                }
+
+                bool erased = false;
+                for (const auto& key : entry.keys)
+                {
+                    erased |= m_cache.erase(key, entry.asset);
+                }
+
+                if (!erased)
+                {
+                    continue;
+                }
+
+                // findByContent hands out shared content under m_contentMutex, with the lock held a
+                // sole owner stays the only one. Its content entry goes too, nothing can reach it then
+                bool unused = false;
+                {
+                    std::lock_guard<std::mutex> lock(m_contentMutex);
+
+                    unused = entry.asset.use_count() == 1;
+                    if (unused)
+                    {
+                        auto it = m_content.find(entry.asset->getContentHash());
+                        if (it != m_content.end() && !it->second.asset.owner_before(entry.asset) && !entry.asset.owner_before(it->second.asset))
+                        {
+                            m_content.erase(it);
+                        }
+                    }
+                }
+
+                if (unused)
+                {
+                    entry.asset->unload();
+                }
+
+                usage[type] -= entry.bytes;
+                freed += entry.bytes;
+                ++evicted;
+            }
+        }
+
+        // Pixels of evicted textures went back to the pool
+        getPixelBufferPool()->trim();
+
+        if (evicted)
+        {
+            std::cout << "AssetManager: Evicted " << evicted << " assets, " << freed / (1024 * 1024) << " MB freed\n";
+        }
+
+        return freed;
+    }
 };
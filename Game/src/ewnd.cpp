@@ -257,9 +257,22 @@ namespace EProject
         m_camera3d(nullptr),
         m_render3d(nullptr, m_camera3d)
     {                       
+        QPC startupTimer;
+
+        // Packed data takes precedence over the loose files when it was built
+        auto vfs = getFileSystem();
+        vfs->setRoot(PathHandler::getDataDir());
+        vfs->mount(PathHandler::getDataArchive());
+
         m_device = std::make_shared<GDevice>(getHandle(), false);
+        m_device->getInputLayouts()->load(PathHandler::getCacheDir() / "inputlayouts.bin");
         
         m_manager = std::make_shared<AssetManager>(m_device);
+        m_manager->setBudget<Texture2D>(512ull * 1024 * 1024);
+        m_manager->setBudget<MeshInstance>(256ull * 1024 * 1024);
+
+        // Edits under Data/ show up in the running game
+        m_manager->watch(PathHandler::getDataDir());
 
         m_camera2d = std::make_shared<Camera2D>(m_device);
         m_camera2d->updateScreen(m_zoom);
@@ -277,6 +290,8 @@ namespace EProject
 
         m_world.init(m_manager, m_device);
 
+        std::cout << "GameWindow: Startup took " << startupTimer.TimeMcS() / 1000.0 << " ms reading " << (vfs->getMountCount() ? "packed" : "loose") << " data\n";
+
         // Timer...
         m_current = std::chrono::high_resolution_clock::now();
         m_last = std::chrono::high_resolution_clock::now();
@@ -285,6 +300,7 @@ namespace EProject
 
     GameWindow::~GameWindow()
     {
+        m_device->getInputLayouts()->save(PathHandler::getCacheDir() / "inputlayouts.bin");
     }
 
     void GameWindow::mouseMove(const glm::ivec2& crd, const ShiftState& ss)
@@ -371,6 +387,10 @@ namespace EProject
         m_current = std::chrono::high_resolution_clock::now();
         m_deltaTime = m_current - m_last;
 
+        m_manager->update();
+        m_canvas.updateShaders();
+        m_render3d.updateShaders();
+
         fixedUpdate(m_deltaTime.count());
         update(m_deltaTime.count());
 
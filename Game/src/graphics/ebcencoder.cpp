@@ -0,0 +1,989 @@
+#include "graphics/ebcencoder.h"
+#include "utils/ejobsystem.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define EPROJECT_BC_SSE
+#endif
+
+namespace EProject
+{
+    namespace
+    {
+        // One 4x4 block as floats, a row per channel so four pixels load at once
+        struct Pixels
+        {
+            alignas(16) float ch[4][16];
+
+            glm::vec4 get(int i) const { return glm::vec4(ch[0][i], ch[1][i], ch[2][i], ch[3][i]); }
+        };
+
+        const glm::vec4 cRGBWeights(1.0f, 1.0f, 1.0f, 0.0f);
+        const glm::vec4 cRGBAWeights(1.0f);
+
+        const float cBC1Weights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+        const int cBC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        struct BitWriter
+        {
+            uint8_t* data;
+            int pos = 0;
+
+            void write(uint32_t value, int bits)
+            {
+                for (int i = 0; i < bits; ++i, ++pos)
+                {
+                    if ((value >> i) & 1)
+                    {
+                        data[pos >> 3] |= static_cast<uint8_t>(1 << (pos & 7));
+                    }
+                }
+            }
+        };
+
+        struct BitReader
+        {
+            const uint8_t* data;
+            int pos = 0;
+
+            uint32_t read(int bits)
+            {
+                uint32_t value = 0;
+                for (int i = 0; i < bits; ++i, ++pos)
+                {
+                    value |= static_cast<uint32_t>((data[pos >> 3] >> (pos & 7)) & 1) << i;
+                }
+
+                return value;
+            }
+        };
+
+        void loadBlock(const uint8_t* rgba, glm::ivec2 size, int bx, int by, Pixels& px)
+        {
+            for (int y = 0; y < 4; ++y)
+            {
+                const int sy = std::min(by * 4 + y, size.y - 1);
+
+                for (int x = 0; x < 4; ++x)
+                {
+                    const int sx = std::min(bx * 4 + x, size.x - 1);
+                    const uint8_t* src = rgba + (static_cast<size_t>(sy) * size.x + sx) * 4;
+
+                    for (int c = 0; c < 4; ++c)
+                    {
+                        px.ch[c][y * 4 + x] = src[c];
+                    }
+                }
+            }
+        }
+
+        void storeBlock(const uint8_t block[16][4], glm::ivec2 size, int bx, int by, uint8_t* rgba)
+        {
+            for (int y = 0; y < 4 && by * 4 + y < size.y; ++y)
+            {
+                for (int x = 0; x < 4 && bx * 4 + x < size.x; ++x)
+                {
+                    uint8_t* dst = rgba + (static_cast<size_t>(by * 4 + y) * size.x + bx * 4 + x) * 4;
+                    std::copy(block[y * 4 + x], block[y * 4 + x] + 4, dst);
+                }
+            }
+        }
+
+        // Picks the nearest palette entry for every pixel, returns the summed weighted squared error
+        float fitIndices(const Pixels& px, const glm::vec4* palette, int count, const glm::vec4& weights, uint8_t indices[16])
+        {
+            float total = 0.0f;
+
+#ifdef EPROJECT_BC_SSE
+            const __m128 wr = _mm_set1_ps(weights.x);
+            const __m128 wg = _mm_set1_ps(weights.y);
+            const __m128 wb = _mm_set1_ps(weights.z);
+            const __m128 wa = _mm_set1_ps(weights.w);
+
+            for (int i = 0; i < 16; i += 4)
+            {
+                const __m128 r = _mm_load_ps(&px.ch[0][i]);
+                const __m128 g = _mm_load_ps(&px.ch[1][i]);
+                const __m128 b = _mm_load_ps(&px.ch[2][i]);
+                const __m128 a = _mm_load_ps(&px.ch[3][i]);
+
+                __m128 best = _mm_set1_ps(FLT_MAX);
+                __m128 bestIndex = _mm_setzero_ps();
+
+                for (int p = 0; p < count; ++p)
+                {
+                    const __m128 dr = _mm_sub_ps(r, _mm_set1_ps(palette[p].x));
+                    const __m128 dg = _mm_sub_ps(g, _mm_set1_ps(palette[p].y));
+                    const __m128 db = _mm_sub_ps(b, _mm_set1_ps(palette[p].z));
+                    const __m128 da = _mm_sub_ps(a, _mm_set1_ps(palette[p].w));
+
+                    __m128 d = _mm_mul_ps(_mm_mul_ps(dr, dr), wr);
+                    d = _mm_add_ps(d, _mm_mul_ps(_mm_mul_ps(dg, dg), wg));
+                    d = _mm_add_ps(d, _mm_mul_ps(_mm_mul_ps(db, db), wb));
+                    d = _mm_add_ps(d, _mm_mul_ps(_mm_mul_ps(da, da), wa));
+
+                    const __m128 less = _mm_cmplt_ps(d, best);
+                    best = _mm_min_ps(d, best);
+                    bestIndex = _mm_or_ps(_mm_and_ps(less, _mm_set1_ps(static_cast<float>(p))), _mm_andnot_ps(less, bestIndex));
+                }
+
+                alignas(16) float error[4];
+                alignas(16) float index[4];
+                _mm_store_ps(error, best);
+                _mm_store_ps(index, bestIndex);
+
+                for (int j = 0; j < 4; ++j)
+                {
+                    indices[i + j] = static_cast<uint8_t>(index[j]);
+                    total += error[j];
+                }
+            }
+#else
+            for (int i = 0; i < 16; ++i)
+            {
+                const glm::vec4 v = px.get(i);
+
+                float best = FLT_MAX;
+                for (int p = 0; p < count; ++p)
+                {
+                    const glm::vec4 d = v - palette[p];
+                    const float error = glm::dot(d * d, weights);
+
+                    if (error < best)
+                    {
+                        best = error;
+                        indices[i] = static_cast<uint8_t>(p);
+                    }
+                }
+
+                total += best;
+            }
+#endif
+            return total;
+        }
+
+        void findEndpoints(const Pixels& px, const glm::vec4& mask, BCQuality quality, glm::vec4& e0, glm::vec4& e1)
+        {
+            glm::vec4 lo(255.0f);
+            glm::vec4 hi(0.0f);
+            glm::vec4 mean(0.0f);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const glm::vec4 v = px.get(i);
+                lo = glm::min(lo, v);
+                hi = glm::max(hi, v);
+                mean += v;
+            }
+
+            mean /= 16.0f;
+
+            if (quality == BCQuality::Fast)
+            {
+                e0 = lo;
+                e1 = hi;
+                return;
+            }
+
+            // Principal axis of the block by power iteration on the covariance
+            glm::mat4 cov(0.0f);
+            for (int i = 0; i < 16; ++i)
+            {
+                const glm::vec4 d = (px.get(i) - mean) * mask;
+                cov += glm::outerProduct(d, d);
+            }
+
+            glm::vec4 axis = (hi - lo) * mask;
+            for (int it = 0; it < 8; ++it)
+            {
+                axis = cov * axis;
+
+                const float len = glm::max(glm::max(glm::abs(axis.x), glm::abs(axis.y)), glm::max(glm::abs(axis.z), glm::abs(axis.w)));
+                if (len < 1e-6f)
+                {
+                    break;
+                }
+
+                axis /= len;
+            }
+
+            if (glm::dot(axis, axis) < 1e-12f)
+            {
+                e0 = mean;
+                e1 = mean;
+                return;
+            }
+
+            axis = glm::normalize(axis);
+
+            float tmin = FLT_MAX;
+            float tmax = -FLT_MAX;
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const float t = glm::dot(px.get(i) - mean, axis);
+                tmin = glm::min(tmin, t);
+                tmax = glm::max(tmax, t);
+            }
+
+            e0 = glm::clamp(mean + axis * tmin, 0.0f, 255.0f);
+            e1 = glm::clamp(mean + axis * tmax, 0.0f, 255.0f);
+        }
+
+        // Least squares endpoints that reproduce the pixels best for fixed indices
+        bool refineEndpoints(const Pixels& px, const uint8_t indices[16], const float* weights, glm::vec4& e0, glm::vec4& e1)
+        {
+            float aa = 0.0f;
+            float bb = 0.0f;
+            float ab = 0.0f;
+            glm::vec4 ax(0.0f);
+            glm::vec4 bx(0.0f);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const float b = weights[indices[i]];
+                const float a = 1.0f - b;
+                const glm::vec4 v = px.get(i);
+
+                aa += a * a;
+                bb += b * b;
+                ab += a * b;
+                ax += a * v;
+                bx += b * v;
+            }
+
+            const float det = aa * bb - ab * ab;
+            if (glm::abs(det) < 1e-6f)
+            {
+                return false;
+            }
+
+            e0 = glm::clamp((ax * bb - bx * ab) / det, 0.0f, 255.0f);
+            e1 = glm::clamp((bx * aa - ax * ab) / det, 0.0f, 255.0f);
+
+            return true;
+        }
+
+        // BC1 colour block, also the colour half of BC3
+
+        uint16_t packRGB565(const glm::vec4& c)
+        {
+            const int r = glm::clamp(static_cast<int>(c.x * 31.0f / 255.0f + 0.5f), 0, 31);
+            const int g = glm::clamp(static_cast<int>(c.y * 63.0f / 255.0f + 0.5f), 0, 63);
+            const int b = glm::clamp(static_cast<int>(c.z * 31.0f / 255.0f + 0.5f), 0, 31);
+
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        glm::vec4 unpackRGB565(uint16_t v)
+        {
+            const int r = (v >> 11) & 31;
+            const int g = (v >> 5) & 63;
+            const int b = v & 31;
+
+            return glm::vec4((r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2), 255.0f);
+        }
+
+        void getBC1Palette(uint16_t c0, uint16_t c1, bool fourColors, glm::vec4 palette[4])
+        {
+            palette[0] = unpackRGB565(c0);
+            palette[1] = unpackRGB565(c1);
+
+            if (fourColors)
+            {
+                palette[2] = glm::floor((2.0f * palette[0] + palette[1] + 1.0f) / 3.0f);
+                palette[3] = glm::floor((palette[0] + 2.0f * palette[1] + 1.0f) / 3.0f);
+            }
+            else
+            {
+                palette[2] = glm::floor((palette[0] + palette[1]) / 2.0f);
+                palette[3] = glm::vec4(0.0f);
+            }
+        }
+
+        struct BC1Fit
+        {
+            uint16_t c0 = 0;
+            uint16_t c1 = 0;
+            uint8_t indices[16] = {};
+            float error = FLT_MAX;
+        };
+
+        void fitBC1(const Pixels& px, const glm::vec4& e0, const glm::vec4& e1, BC1Fit& fit)
+        {
+            glm::vec4 palette[4];
+
+            fit.c0 = packRGB565(e0);
+            fit.c1 = packRGB565(e1);
+            getBC1Palette(fit.c0, fit.c1, true, palette);
+
+            fit.error = fitIndices(px, palette, 4, cRGBWeights, fit.indices);
+        }
+
+        void encodeBC1Color(const Pixels& px, BCQuality quality, uint8_t* out)
+        {
+            glm::vec4 e0;
+            glm::vec4 e1;
+            findEndpoints(px, cRGBWeights, quality, e0, e1);
+
+            // The extremes are rarely hit after quantization, pull them in a little
+            const glm::vec4 inset = (e1 - e0) / 16.0f;
+
+            BC1Fit best;
+            fitBC1(px, e0 + inset, e1 - inset, best);
+
+            if (quality == BCQuality::High)
+            {
+                for (int it = 0; it < 2; ++it)
+                {
+                    BC1Fit fit;
+                    if (!refineEndpoints(px, best.indices, cBC1Weights, e0, e1))
+                    {
+                        break;
+                    }
+
+                    fitBC1(px, e0, e1, fit);
+                    if (fit.error >= best.error)
+                    {
+                        break;
+                    }
+
+                    best = fit;
+                }
+            }
+
+            uint16_t c0 = best.c0;
+            uint16_t c1 = best.c1;
+            uint32_t bits = 0;
+
+            // Four colour mode needs c0 > c1, swapping the endpoints maps index 0<->1 and 2<->3
+            if (c0 != c1)
+            {
+                const uint32_t flip = c0 < c1 ? 1 : 0;
+                if (flip)
+                {
+                    std::swap(c0, c1);
+                }
+
+                for (int i = 0; i < 16; ++i)
+                {
+                    bits |= (best.indices[i] ^ flip) << (i * 2);
+                }
+            }
+
+            out[0] = static_cast<uint8_t>(c0);
+            out[1] = static_cast<uint8_t>(c0 >> 8);
+            out[2] = static_cast<uint8_t>(c1);
+            out[3] = static_cast<uint8_t>(c1 >> 8);
+
+            for (int i = 0; i < 4; ++i)
+            {
+                out[4 + i] = static_cast<uint8_t>(bits >> (i * 8));
+            }
+        }
+
+        void decodeBC1Color(const uint8_t* in, bool forceFourColors, uint8_t out[16][4])
+        {
+            const uint16_t c0 = static_cast<uint16_t>(in[0] | (in[1] << 8));
+            const uint16_t c1 = static_cast<uint16_t>(in[2] | (in[3] << 8));
+            const uint32_t bits = in[4] | (in[5] << 8) | (in[6] << 16) | (static_cast<uint32_t>(in[7]) << 24);
+
+            const bool fourColors = forceFourColors || c0 > c1;
+
+            glm::vec4 palette[4];
+            getBC1Palette(c0, c1, fourColors, palette);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const uint32_t index = (bits >> (i * 2)) & 3;
+
+                for (int c = 0; c < 3; ++c)
+                {
+                    out[i][c] = static_cast<uint8_t>(palette[index][c]);
+                }
+
+                out[i][3] = (!fourColors && index == 3) ? 0 : 255;
+            }
+        }
+
+        // BC4 single channel block, also alpha of BC3 and both halves of BC5
+
+        void getBC4Palette(int a0, int a1, float palette[8])
+        {
+            palette[0] = static_cast<float>(a0);
+            palette[1] = static_cast<float>(a1);
+
+            if (a0 > a1)
+            {
+                for (int i = 2; i < 8; ++i)
+                {
+                    palette[i] = static_cast<float>(((8 - i) * a0 + (i - 1) * a1 + 3) / 7);
+                }
+            }
+            else
+            {
+                for (int i = 2; i < 6; ++i)
+                {
+                    palette[i] = static_cast<float>(((6 - i) * a0 + (i - 1) * a1 + 2) / 5);
+                }
+
+                palette[6] = 0.0f;
+                palette[7] = 255.0f;
+            }
+        }
+
+        struct BC4Fit
+        {
+            int a0 = 0;
+            int a1 = 0;
+            uint8_t indices[16] = {};
+            float error = FLT_MAX;
+        };
+
+        void fitBC4(const Pixels& px, int channel, int a0, int a1, BC4Fit& fit)
+        {
+            float values[8];
+            getBC4Palette(a0, a1, values);
+
+            glm::vec4 palette[8];
+            for (int i = 0; i < 8; ++i)
+            {
+                palette[i] = glm::vec4(0.0f);
+                palette[i][channel] = values[i];
+            }
+
+            glm::vec4 weights(0.0f);
+            weights[channel] = 1.0f;
+
+            fit.a0 = a0;
+            fit.a1 = a1;
+            fit.error = fitIndices(px, palette, 8, weights, fit.indices);
+        }
+
+        void encodeBC4(const Pixels& px, int channel, BCQuality quality, uint8_t* out)
+        {
+            int lo = 255;
+            int hi = 0;
+
+            // Range without the exact 0 and 255 the six value mode gets for free
+            int innerLo = 255;
+            int innerHi = 0;
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const int v = static_cast<int>(px.ch[channel][i]);
+                lo = std::min(lo, v);
+                hi = std::max(hi, v);
+
+                if (v != 0 && v != 255)
+                {
+                    innerLo = std::min(innerLo, v);
+                    innerHi = std::max(innerHi, v);
+                }
+            }
+
+            BC4Fit best;
+
+            if (lo == hi)
+            {
+                best.a0 = hi;
+                best.a1 = hi;
+            }
+            else
+            {
+                fitBC4(px, channel, hi, lo, best);
+
+                if (quality != BCQuality::Fast && (lo == 0 || hi == 255))
+                {
+                    BC4Fit fit;
+                    fitBC4(px, channel, std::min(innerLo, innerHi), std::max(innerLo, innerHi), fit);
+
+                    if (fit.error < best.error)
+                    {
+                        best = fit;
+                    }
+                }
+
+                if (quality == BCQuality::High)
+                {
+                    const int step = std::max(1, (hi - lo) / 32);
+
+                    for (int i = 0; i < 4; ++i)
+                    {
+                        for (int j = 0; j < 4; ++j)
+                        {
+                            const int a0 = hi - i * step;
+                            const int a1 = lo + j * step;
+
+                            if ((i || j) && a0 > a1)
+                            {
+                                BC4Fit fit;
+                                fitBC4(px, channel, a0, a1, fit);
+
+                                if (fit.error < best.error)
+                                {
+                                    best = fit;
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            uint64_t bits = 0;
+            for (int i = 0; i < 16; ++i)
+            {
+                bits |= static_cast<uint64_t>(best.indices[i]) << (i * 3);
+            }
+
+            out[0] = static_cast<uint8_t>(best.a0);
+            out[1] = static_cast<uint8_t>(best.a1);
+
+            for (int i = 0; i < 6; ++i)
+            {
+                out[2 + i] = static_cast<uint8_t>(bits >> (i * 8));
+            }
+        }
+
+        void decodeBC4(const uint8_t* in, int channel, uint8_t out[16][4])
+        {
+            float palette[8];
+            getBC4Palette(in[0], in[1], palette);
+
+            uint64_t bits = 0;
+            for (int i = 0; i < 6; ++i)
+            {
+                bits |= static_cast<uint64_t>(in[2 + i]) << (i * 8);
+            }
+
+            for (int i = 0; i < 16; ++i)
+            {
+                out[i][channel] = static_cast<uint8_t>(palette[(bits >> (i * 3)) & 7]);
+            }
+        }
+
+        // BC7 mode 6: RGBA 7.7.7.7 endpoints with one p-bit each and 4 bit indices
+
+        struct BC7Fit
+        {
+            int q0[4] = {};
+            int q1[4] = {};
+            int p0 = 0;
+            int p1 = 0;
+            uint8_t indices[16] = {};
+            float error = FLT_MAX;
+        };
+
+        void quantizeBC7(const glm::vec4& e, int p, int q[4])
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                q[c] = glm::clamp(static_cast<int>(std::round((e[c] - p) / 2.0f)), 0, 127);
+            }
+        }
+
+        glm::vec4 expandBC7(const int q[4], int p)
+        {
+            return glm::vec4((q[0] << 1) | p, (q[1] << 1) | p, (q[2] << 1) | p, (q[3] << 1) | p);
+        }
+
+        void getBC7Palette(const glm::vec4& v0, const glm::vec4& v1, glm::vec4 palette[16])
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                const float w = static_cast<float>(cBC7Weights[i]);
+                palette[i] = glm::floor(((64.0f - w) * v0 + w * v1 + 32.0f) / 64.0f);
+            }
+        }
+
+        // The p-bit that keeps the endpoint closest after quantization
+        int chooseBC7PBit(const glm::vec4& e)
+        {
+            int q[4];
+            float errors[2];
+
+            for (int p = 0; p < 2; ++p)
+            {
+                quantizeBC7(e, p, q);
+
+                const glm::vec4 d = expandBC7(q, p) - e;
+                errors[p] = glm::dot(d, d);
+            }
+
+            return errors[1] < errors[0] ? 1 : 0;
+        }
+
+        void fitBC7(const Pixels& px, const glm::vec4& e0, const glm::vec4& e1, int p0, int p1, BC7Fit& fit)
+        {
+            quantizeBC7(e0, p0, fit.q0);
+            quantizeBC7(e1, p1, fit.q1);
+            fit.p0 = p0;
+            fit.p1 = p1;
+
+            glm::vec4 palette[16];
+            getBC7Palette(expandBC7(fit.q0, p0), expandBC7(fit.q1, p1), palette);
+
+            fit.error = fitIndices(px, palette, 16, cRGBAWeights, fit.indices);
+        }
+
+        void fitBC7Best(const Pixels& px, const glm::vec4& e0, const glm::vec4& e1, BCQuality quality, BC7Fit& best)
+        {
+            if (quality != BCQuality::High)
+            {
+                fitBC7(px, e0, e1, chooseBC7PBit(e0), chooseBC7PBit(e1), best);
+                return;
+            }
+
+            for (int p = 0; p < 4; ++p)
+            {
+                BC7Fit fit;
+                fitBC7(px, e0, e1, p & 1, p >> 1, fit);
+
+                if (fit.error < best.error)
+                {
+                    best = fit;
+                }
+            }
+        }
+
+        void encodeBC7(const Pixels& px, BCQuality quality, uint8_t* out)
+        {
+            glm::vec4 e0;
+            glm::vec4 e1;
+            findEndpoints(px, cRGBAWeights, quality, e0, e1);
+
+            BC7Fit best;
+            fitBC7Best(px, e0, e1, quality, best);
+
+            if (quality == BCQuality::High)
+            {
+                float weights[16];
+                for (int i = 0; i < 16; ++i)
+                {
+                    weights[i] = cBC7Weights[i] / 64.0f;
+                }
+
+                for (int it = 0; it < 2; ++it)
+                {
+                    if (!refineEndpoints(px, best.indices, weights, e0, e1))
+                    {
+                        break;
+                    }
+
+                    BC7Fit fit;
+                    fitBC7Best(px, e0, e1, quality, fit);
+
+                    if (fit.error >= best.error)
+                    {
+                        break;
+                    }
+
+                    best = fit;
+                }
+            }
+
+            // The anchor index is stored without its top bit, swap the endpoints if it is set
+            if (best.indices[0] >= 8)
+            {
+                std::swap(best.q0, best.q1);
+                std::swap(best.p0, best.p1);
+
+                for (auto& index : best.indices)
+                {
+                    index = static_cast<uint8_t>(15 - index);
+                }
+            }
+
+            std::fill(out, out + 16, uint8_t(0));
+
+            BitWriter writer{ out };
+            writer.write(1 << 6, 7);
+
+            for (int c = 0; c < 4; ++c)
+            {
+                writer.write(best.q0[c], 7);
+                writer.write(best.q1[c], 7);
+            }
+
+            writer.write(best.p0, 1);
+            writer.write(best.p1, 1);
+
+            writer.write(best.indices[0], 3);
+            for (int i = 1; i < 16; ++i)
+            {
+                writer.write(best.indices[i], 4);
+            }
+        }
+
+        void decodeBC7(const uint8_t* in, uint8_t out[16][4])
+        {
+            BitReader reader{ in };
+
+            if (reader.read(7) != (1 << 6))
+            {
+                throw std::runtime_error("BCEncoder: Only BC7 mode 6 blocks can be decoded");
+            }
+
+            int q0[4];
+            int q1[4];
+
+            for (int c = 0; c < 4; ++c)
+            {
+                q0[c] = static_cast<int>(reader.read(7));
+                q1[c] = static_cast<int>(reader.read(7));
+            }
+
+            const int p0 = static_cast<int>(reader.read(1));
+            const int p1 = static_cast<int>(reader.read(1));
+
+            glm::vec4 palette[16];
+            getBC7Palette(expandBC7(q0, p0), expandBC7(q1, p1), palette);
+
+            for (int i = 0; i < 16; ++i)
+            {
+                const uint32_t index = reader.read(i == 0 ? 3 : 4);
+
+                for (int c = 0; c < 4; ++c)
+                {
+                    out[i][c] = static_cast<uint8_t>(palette[index][c]);
+                }
+            }
+        }
+
+        void encodeBlock(const Pixels& px, TextureFmt fmt, BCQuality quality, uint8_t* out)
+        {
+            switch (fmt)
+            {
+            case TextureFmt::BC1:
+            case TextureFmt::BC1_SRGB:
+                encodeBC1Color(px, quality, out);
+                break;
+            case TextureFmt::BC3:
+            case TextureFmt::BC3_SRGB:
+                encodeBC4(px, 3, quality, out);
+                encodeBC1Color(px, quality, out + 8);
+                break;
+            case TextureFmt::BC4:
+                encodeBC4(px, 0, quality, out);
+                break;
+            case TextureFmt::BC5:
+                encodeBC4(px, 0, quality, out);
+                encodeBC4(px, 1, quality, out + 8);
+                break;
+            case TextureFmt::BC7:
+            case TextureFmt::BC7_SRGB:
+                encodeBC7(px, quality, out);
+                break;
+            default:
+                break;
+            }
+        }
+
+        void decodeBlock(const uint8_t* in, TextureFmt fmt, uint8_t out[16][4])
+        {
+            for (int i = 0; i < 16; ++i)
+            {
+                out[i][0] = out[i][1] = out[i][2] = 0;
+                out[i][3] = 255;
+            }
+
+            switch (fmt)
+            {
+            case TextureFmt::BC1:
+            case TextureFmt::BC1_SRGB:
+                decodeBC1Color(in, false, out);
+                break;
+            case TextureFmt::BC3:
+            case TextureFmt::BC3_SRGB:
+                decodeBC1Color(in + 8, true, out);
+                decodeBC4(in, 3, out);
+                break;
+            case TextureFmt::BC4:
+                decodeBC4(in, 0, out);
+                break;
+            case TextureFmt::BC5:
+                decodeBC4(in, 0, out);
+                decodeBC4(in + 8, 1, out);
+                break;
+            case TextureFmt::BC7:
+            case TextureFmt::BC7_SRGB:
+                decodeBC7(in, out);
+                break;
+            default:
+                break;
+            }
+        }
+
+        int getStoredChannels(TextureFmt fmt)
+        {
+            switch (fmt)
+            {
+            case TextureFmt::BC1:
+            case TextureFmt::BC1_SRGB:
+                return 3;
+            case TextureFmt::BC4:
+                return 1;
+            case TextureFmt::BC5:
+                return 2;
+            default:
+                return 4;
+            }
+        }
+    }
+
+    bool BCEncoder::isSupported(TextureFmt fmt)
+    {
+        return getBlockBytes(fmt) != 0;
+    }
+
+    size_t BCEncoder::getBlockBytes(TextureFmt fmt)
+    {
+        switch (fmt)
+        {
+        case TextureFmt::BC1:
+        case TextureFmt::BC1_SRGB:
+        case TextureFmt::BC4:
+            return 8;
+        case TextureFmt::BC3:
+        case TextureFmt::BC3_SRGB:
+        case TextureFmt::BC5:
+        case TextureFmt::BC7:
+        case TextureFmt::BC7_SRGB:
+            return 16;
+        default:
+            return 0;
+        }
+    }
+
+    size_t BCEncoder::getEncodedSize(TextureFmt fmt, glm::ivec2 size)
+    {
+        return static_cast<size_t>((size.x + 3) / 4) * ((size.y + 3) / 4) * getBlockBytes(fmt);
+    }
+
+    TextureFmt BCEncoder::chooseFormat(const uint8_t* rgba, glm::ivec2 size, bool srgb)
+    {
+        const size_t pixels = static_cast<size_t>(size.x) * size.y;
+
+        bool grey = true;
+        bool alpha = false;
+        size_t normals = 0;
+
+        for (size_t i = 0; i < pixels; ++i)
+        {
+            const uint8_t* p = rgba + i * 4;
+
+            grey = grey && std::abs(p[0] - p[1]) <= 2 && std::abs(p[1] - p[2]) <= 2;
+            alpha = alpha || p[3] != 255;
+
+            const glm::vec3 n = glm::vec3(p[0], p[1], p[2]) / 127.5f - 1.0f;
+            const float len = glm::length(n);
+
+            if (n.z > 0.0f && len > 0.85f && len < 1.15f)
+            {
+                ++normals;
+            }
+        }
+
+        if (alpha)
+        {
+            return srgb ? TextureFmt::BC3_SRGB : TextureFmt::BC3;
+        }
+
+        if (!srgb && grey)
+        {
+            return TextureFmt::BC4;
+        }
+
+        // Almost every texel a unit vector pointing out of the surface
+        if (!srgb && !grey && normals >= pixels * 95 / 100)
+        {
+            return TextureFmt::BC5;
+        }
+
+        return srgb ? TextureFmt::BC1_SRGB : TextureFmt::BC1;
+    }
+
+    std::vector<uint8_t> BCEncoder::encode(const uint8_t* rgba, glm::ivec2 size, TextureFmt fmt, BCQuality quality)
+    {
+        if (!isSupported(fmt))
+        {
+            throw std::runtime_error("BCEncoder: Unsupported format " + std::to_string(static_cast<int>(fmt)));
+        }
+
+        const int blocksX = (size.x + 3) / 4;
+        const int blocksY = (size.y + 3) / 4;
+        const size_t blockBytes = getBlockBytes(fmt);
+
+        std::vector<uint8_t> out(getEncodedSize(fmt, size));
+
+        getJobSystem()->parallelFor(static_cast<size_t>(blocksY), [&](size_t by)
+        {
+            Pixels px;
+
+            for (int bx = 0; bx < blocksX; ++bx)
+            {
+                loadBlock(rgba, size, bx, static_cast<int>(by), px);
+                encodeBlock(px, fmt, quality, out.data() + (by * blocksX + bx) * blockBytes);
+            }
+        });
+
+        return out;
+    }
+
+    std::vector<uint8_t> BCEncoder::decode(const uint8_t* blocks, glm::ivec2 size, TextureFmt fmt)
+    {
+        if (!isSupported(fmt))
+        {
+            throw std::runtime_error("BCEncoder: Unsupported format " + std::to_string(static_cast<int>(fmt)));
+        }
+
+        const int blocksX = (size.x + 3) / 4;
+        const int blocksY = (size.y + 3) / 4;
+        const size_t blockBytes = getBlockBytes(fmt);
+
+        std::vector<uint8_t> out(static_cast<size_t>(size.x) * size.y * 4);
+
+        getJobSystem()->parallelFor(static_cast<size_t>(blocksY), [&](size_t by)
+        {
+            uint8_t block[16][4];
+
+            for (int bx = 0; bx < blocksX; ++bx)
+            {
+                decodeBlock(blocks + (by * blocksX + bx) * blockBytes, fmt, block);
+                storeBlock(block, size, bx, static_cast<int>(by), out.data());
+            }
+        });
+
+        return out;
+    }
+
+    double BCEncoder::computePSNR(const uint8_t* a, const uint8_t* b, glm::ivec2 size, TextureFmt fmt)
+    {
+        const int channels = getStoredChannels(fmt);
+        const size_t pixels = static_cast<size_t>(size.x) * size.y;
+
+        double sum = 0.0;
+        for (size_t i = 0; i < pixels; ++i)
+        {
+            for (int c = 0; c < channels; ++c)
+            {
+                const double d = static_cast<double>(a[i * 4 + c]) - b[i * 4 + c];
+                sum += d * d;
+            }
+        }
+
+        if (sum == 0.0)
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+
+        const double mse = sum / (static_cast<double>(pixels) * channels);
+        return 10.0 * std::log10(255.0 * 255.0 / mse);
+    }
+}
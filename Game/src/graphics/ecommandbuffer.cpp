@@ -0,0 +1,374 @@
+#include "graphics/ecommandbuffer.h"
+#include "utils/ejobsystem.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+namespace EProject
+{
+    namespace
+    {
+        constexpr uint32_t cNoObject = ~0u;
+
+        struct SetProgramCmd
+        {
+            ShaderProgram* program;
+        };
+
+        struct SetValueCmd
+        {
+            ShaderValueHandle handle;
+            int size;
+        };
+
+        struct SetTextureCmd
+        {
+            ShaderResource slot;
+            uint32_t texture;
+        };
+
+        struct SetSamplerCmd
+        {
+            ShaderResource slot;
+            Sampler sampler;
+        };
+
+        struct SetInputBuffersCmd
+        {
+            uint32_t vbo;
+            uint32_t ibo;
+            uint32_t instances;
+            int instanceStepRate;
+        };
+
+        struct UploadCmd
+        {
+            uint32_t buffer;
+            int start;
+            int count;
+            int bytes;
+        };
+
+        struct DrawCmd
+        {
+            PrimTopology topology;
+            int first;
+            int count;
+            int instances;
+            int baseVertex;
+            int baseInstance;
+        };
+
+        template<typename T>
+        T read(const uint8_t* p)
+        {
+            T cmd;
+            memcpy(&cmd, p, sizeof(T));
+            return cmd;
+        }
+
+        size_t align8(size_t size)
+        {
+            return (size + 7) & ~size_t(7);
+        }
+    }
+
+    template<typename T>
+    void CommandBuffer::push(CommandType type, const T& cmd, const void* extra, size_t extraSize)
+    {
+        const size_t size = align8(sizeof(CommandHeader) + sizeof(T) + extraSize);
+        const size_t offset = m_data.size();
+        m_data.resize(offset + size);
+
+        CommandHeader header = { type, uint32_t(size) };
+        uint8_t* p = &m_data[offset];
+        memcpy(p, &header, sizeof(header));
+        memcpy(p + sizeof(header), &cmd, sizeof(T));
+        if (extraSize)
+        {
+            memcpy(p + sizeof(header) + sizeof(T), extra, extraSize);
+        }
+
+        m_count++;
+    }
+
+    template<typename T>
+    uint32_t CommandBuffer::hold(std::vector<T>& table, const T& object)
+    {
+        if (!object)
+        {
+            return cNoObject;
+        }
+
+        // Binds tend to repeat the last object
+        if (table.empty() || table.back() != object)
+        {
+            table.push_back(object);
+        }
+
+        return uint32_t(table.size() - 1);
+    }
+
+    void CommandBuffer::setProgram(ShaderProgram* program)
+    {
+        push(CommandType::SetProgram, SetProgramCmd{ program });
+    }
+
+    void CommandBuffer::setStates(const RenderStates& states)
+    {
+        push(CommandType::SetStates, states);
+    }
+
+    void CommandBuffer::writeValue(const ShaderValueHandle& h, const void* data, int size)
+    {
+        push(CommandType::SetValue, SetValueCmd{ h, size }, data, size);
+    }
+
+    void CommandBuffer::setResource(const ShaderResource& h, const GPUTexture2DPtr& tex)
+    {
+        push(CommandType::SetTexture, SetTextureCmd{ h, hold(m_textures, tex) });
+    }
+
+    void CommandBuffer::setResource(const ShaderResource& h, const Sampler& s)
+    {
+        push(CommandType::SetSampler, SetSamplerCmd{ h, s });
+    }
+
+    void CommandBuffer::setInputBuffers(const VertexBufferPtr& vbo, const IndexBufferPtr& ibo, const VertexBufferPtr& instances, int instanceStepRate)
+    {
+        SetInputBuffersCmd cmd;
+        cmd.vbo = hold(m_vertexBuffers, vbo);
+        cmd.ibo = hold(m_indexBuffers, ibo);
+        cmd.instances = hold(m_vertexBuffers, instances);
+        cmd.instanceStepRate = instanceStepRate;
+        push(CommandType::SetInputBuffers, cmd);
+    }
+
+    void CommandBuffer::uploadVertices(const VertexBufferPtr& vbo, int start_vertex, int num_vertices, const void* data)
+    {
+        const int bytes = num_vertices * vbo->getLayout()->stride;
+        push(CommandType::UploadVertices, UploadCmd{ hold(m_vertexBuffers, vbo), start_vertex, num_vertices, bytes }, data, bytes);
+    }
+
+    void CommandBuffer::uploadUniforms(const UniformBufferPtr& ubo, int start_element, int num_elements, const void* data)
+    {
+        const int bytes = num_elements * ubo->getLayout()->stride;
+        push(CommandType::UploadUniforms, UploadCmd{ hold(m_uniformBuffers, ubo), start_element, num_elements, bytes }, data, bytes);
+    }
+
+    void CommandBuffer::draw(PrimTopology pt, int vert_start, int vert_count, int instance_count, int base_instance)
+    {
+        push(CommandType::Draw, DrawCmd{ pt, vert_start, vert_count, instance_count, 0, base_instance });
+    }
+
+    void CommandBuffer::drawIndexed(PrimTopology pt, int index_start, int index_count, int instance_count, int base_vertex, int base_instance)
+    {
+        push(CommandType::DrawIndexed, DrawCmd{ pt, index_start, index_count, instance_count, base_vertex, base_instance });
+    }
+
+    void CommandBuffer::submit(GDevice& device) const
+    {
+        submit(device, this, 1);
+    }
+
+    void CommandBuffer::submit(GDevice& device, const CommandBuffer* buffers, size_t count)
+    {
+        // Values only feed the globals, so they are all written and copied into the constant ring
+        // first. One flush then covers every draw, the replay just binds each draw's copy.
+        std::vector<ShaderProgram::GlobalsRange> globals;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            buffers[i].prepareGlobals(globals);
+        }
+
+        device.getConstantRing()->flush();
+
+        size_t draw = 0;
+
+        for (size_t i = 0; i < count; i++)
+        {
+            buffers[i].replay(device, globals, draw);
+        }
+    }
+
+    void CommandBuffer::prepareGlobals(std::vector<ShaderProgram::GlobalsRange>& globals) const
+    {
+        ShaderProgram* program = nullptr;
+
+        for (const uint8_t* p = m_data.data(); p < m_data.data() + m_data.size();)
+        {
+            const CommandHeader header = read<CommandHeader>(p);
+            const uint8_t* payload = p + sizeof(CommandHeader);
+
+            switch (header.type)
+            {
+            case CommandType::SetProgram:
+            {
+                program = read<SetProgramCmd>(payload).program;
+                break;
+            }
+            case CommandType::SetValue:
+            {
+                const SetValueCmd cmd = read<SetValueCmd>(payload);
+                program->writeValue(cmd.handle, payload + sizeof(SetValueCmd), cmd.size);
+                break;
+            }
+            case CommandType::Draw:
+            case CommandType::DrawIndexed:
+            {
+                globals.push_back(program->prepareGlobals());
+                break;
+            }
+            default:
+                break;
+            }
+
+            p += header.size;
+        }
+    }
+
+    void CommandBuffer::replay(GDevice& device, const std::vector<ShaderProgram::GlobalsRange>& globals, size_t& draw) const
+    {
+        States* states = device.getStates();
+        states->push();
+
+        ShaderProgram* program = nullptr;
+
+        const uint8_t* p = m_data.data();
+        const uint8_t* end = p + m_data.size();
+        while (p < end)
+        {
+            const CommandHeader header = read<CommandHeader>(p);
+            const uint8_t* payload = p + sizeof(CommandHeader);
+
+            assert(program || header.type == CommandType::SetProgram || header.type == CommandType::SetStates ||
+                   header.type == CommandType::UploadVertices || header.type == CommandType::UploadUniforms);
+
+            switch (header.type)
+            {
+            case CommandType::SetProgram:
+            {
+                program = read<SetProgramCmd>(payload).program;
+                break;
+            }
+            case CommandType::SetStates:
+            {
+                const RenderStates rs = read<RenderStates>(payload);
+                states->setDepthEnable(rs.depthEnable);
+                states->setDepthWrite(rs.depthWrite);
+                states->setCull(rs.cull);
+                states->setBlend(rs.blend, rs.src, rs.dst);
+                break;
+            }
+            case CommandType::SetValue:
+            {
+                // Written in the first pass
+                break;
+            }
+            case CommandType::SetTexture:
+            {
+                const SetTextureCmd cmd = read<SetTextureCmd>(payload);
+                program->setResource(cmd.slot, cmd.texture == cNoObject ? GPUTexture2DPtr() : m_textures[cmd.texture]);
+                break;
+            }
+            case CommandType::SetSampler:
+            {
+                const SetSamplerCmd cmd = read<SetSamplerCmd>(payload);
+                program->setResource(cmd.slot, cmd.sampler);
+                break;
+            }
+            case CommandType::SetInputBuffers:
+            {
+                const SetInputBuffersCmd cmd = read<SetInputBuffersCmd>(payload);
+                program->setInputBuffers(cmd.vbo == cNoObject ? VertexBufferPtr() : m_vertexBuffers[cmd.vbo],
+                                         cmd.ibo == cNoObject ? IndexBufferPtr() : m_indexBuffers[cmd.ibo],
+                                         cmd.instances == cNoObject ? VertexBufferPtr() : m_vertexBuffers[cmd.instances],
+                                         cmd.instanceStepRate);
+                break;
+            }
+            case CommandType::UploadVertices:
+            {
+                const UploadCmd cmd = read<UploadCmd>(payload);
+                m_vertexBuffers[cmd.buffer]->setSubData(cmd.start, cmd.count, payload + sizeof(UploadCmd));
+                break;
+            }
+            case CommandType::UploadUniforms:
+            {
+                const UploadCmd cmd = read<UploadCmd>(payload);
+                m_uniformBuffers[cmd.buffer]->setSubData(cmd.start, cmd.count, payload + sizeof(UploadCmd));
+                break;
+            }
+            case CommandType::Draw:
+            {
+                const DrawCmd cmd = read<DrawCmd>(payload);
+                program->bindGlobals(globals[draw++]);
+                program->draw(cmd.topology, cmd.first, cmd.count, cmd.instances, cmd.baseInstance);
+                break;
+            }
+            case CommandType::DrawIndexed:
+            {
+                const DrawCmd cmd = read<DrawCmd>(payload);
+                program->bindGlobals(globals[draw++]);
+                program->drawIndexed(cmd.topology, cmd.first, cmd.count, cmd.instances, cmd.baseVertex, cmd.baseInstance);
+                break;
+            }
+            }
+
+            p += header.size;
+        }
+
+        states->pop();
+    }
+
+    void CommandBuffer::reset()
+    {
+        m_data.clear();
+        m_count = 0;
+
+        m_textures.clear();
+        m_vertexBuffers.clear();
+        m_indexBuffers.clear();
+        m_uniformBuffers.clear();
+    }
+
+    ParallelRecorder::ParallelRecorder(JobSystem* jobs) : m_jobs(jobs ? jobs : getJobSystem())
+    {
+    }
+
+    void ParallelRecorder::record(size_t count, size_t chunkSize, const std::function<void(size_t first, size_t last, CommandBuffer& cb)>& func)
+    {
+        assert(chunkSize > 0);
+
+        m_used = (count + chunkSize - 1) / chunkSize;
+        if (m_buffers.size() < m_used)
+        {
+            m_buffers.resize(m_used);
+        }
+
+        m_jobs->parallelFor(m_used, [&](size_t chunk)
+        {
+            CommandBuffer& cb = m_buffers[chunk];
+            cb.reset();
+
+            const size_t first = chunk * chunkSize;
+            func(first, std::min(first + chunkSize, count), cb);
+        });
+    }
+
+    void ParallelRecorder::submit(GDevice& device) const
+    {
+        CommandBuffer::submit(device, m_buffers.data(), m_used);
+    }
+
+    void ParallelRecorder::reset()
+    {
+        for (size_t i = 0; i < m_used; i++)
+        {
+            m_buffers[i].reset();
+        }
+
+        m_used = 0;
+    }
+}
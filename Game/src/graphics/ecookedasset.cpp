@@ -0,0 +1,283 @@
+#include "graphics/ecookedasset.h"
+
+#include <cstring>
+#include <stdexcept>
+
+namespace EProject
+{
+    namespace CookedAsset
+    {
+        namespace
+        {
+            class Writer
+            {
+            public:
+                explicit Writer(std::vector<uint8_t>& out) : m_out(out) {}
+
+                void bytes(const void* data, size_t size)
+                {
+                    const auto ptr = static_cast<const uint8_t*>(data);
+                    m_out.insert(m_out.end(), ptr, ptr + size);
+                }
+
+                template<typename T>
+                void pod(const T& value)
+                {
+                    static_assert(std::is_trivially_copyable<T>::value, "CookedAsset: Not a POD value");
+                    bytes(&value, sizeof(T));
+                }
+
+                void string(const std::string& str)
+                {
+                    pod(static_cast<uint32_t>(str.size()));
+                    bytes(str.data(), str.size());
+                }
+
+                void path(const std::filesystem::path& p)
+                {
+                    string(p.generic_u8string());
+                }
+
+                template<typename T>
+                void array(const T* data, size_t count)
+                {
+                    pod(static_cast<uint64_t>(count));
+                    bytes(data, count * sizeof(T));
+                }
+
+            private:
+                std::vector<uint8_t>& m_out;
+            };
+
+            class Reader
+            {
+            public:
+                Reader(const uint8_t* data, size_t size) : m_data(data), m_size(size) {}
+
+                const uint8_t* bytes(size_t size)
+                {
+                    if (size > m_size - m_pos)
+                    {
+                        throw std::runtime_error("CookedAsset: Unexpected end of data");
+                    }
+
+                    const uint8_t* ptr = m_data + m_pos;
+                    m_pos += size;
+                    return ptr;
+                }
+
+                template<typename T>
+                T pod()
+                {
+                    T value;
+                    std::memcpy(&value, bytes(sizeof(T)), sizeof(T));
+                    return value;
+                }
+
+                std::string string()
+                {
+                    const auto size = pod<uint32_t>();
+                    const auto ptr = reinterpret_cast<const char*>(bytes(size));
+                    return std::string(ptr, ptr + size);
+                }
+
+                std::filesystem::path path()
+                {
+                    return std::filesystem::u8path(string());
+                }
+
+                template<typename T>
+                std::vector<T> array()
+                {
+                    const auto count = pod<uint64_t>();
+                    if (count > (m_size - m_pos) / sizeof(T))
+                    {
+                        throw std::runtime_error("CookedAsset: Unexpected end of data");
+                    }
+
+                    std::vector<T> res(static_cast<size_t>(count));
+                    std::memcpy(res.data(), bytes(res.size() * sizeof(T)), res.size() * sizeof(T));
+                    return res;
+                }
+
+            private:
+                const uint8_t* m_data = nullptr;
+                size_t m_size = 0;
+                size_t m_pos = 0;
+            };
+
+            void writeHeader(Writer& w, Kind kind, size_t count)
+            {
+                Header header = {};
+                header.kind = kind;
+                header.count = static_cast<uint32_t>(count);
+                w.pod(header);
+            }
+
+            bool readHeader(Reader& r, Kind kind, Header& header)
+            {
+                header = r.pod<Header>();
+                return header.magic == cMagic && header.version == cVersion && header.kind == kind;
+            }
+
+            void writeMaterial(Writer& w, const Material& mat)
+            {
+                w.pod(mat.albedo);
+                w.pod(mat.emission);
+                w.pod(mat.emission_strength);
+                w.pod(mat.metallic);
+                w.pod(mat.roughness);
+                w.path(mat.albedo_map);
+                w.path(mat.metallic_map);
+                w.path(mat.roughness_map);
+                w.path(mat.emission_map);
+                w.path(mat.normal_map);
+            }
+
+            Material readMaterial(Reader& r)
+            {
+                Material mat = {};
+                mat.albedo = r.pod<glm::vec4>();
+                mat.emission = r.pod<glm::vec4>();
+                mat.emission_strength = r.pod<float>();
+                mat.metallic = r.pod<float>();
+                mat.roughness = r.pod<float>();
+                mat.albedo_map = r.path();
+                mat.metallic_map = r.path();
+                mat.roughness_map = r.path();
+                mat.emission_map = r.path();
+                mat.normal_map = r.path();
+                return mat;
+            }
+        }
+
+        void writeMeshes(const std::vector<MeshData>& meshes, std::vector<uint8_t>& out)
+        {
+            Writer w(out);
+            writeHeader(w, Kind::Mesh, meshes.size());
+            w.pod(static_cast<uint32_t>(sizeof(MeshVertex)));
+
+            for (const auto& mesh : meshes)
+            {
+                w.string(mesh.getName());
+                w.pod(mesh.startVertex);
+                w.pod(mesh.startIndex);
+                w.pod(mesh.indexCount);
+                w.pod(mesh.materialId);
+
+                const bool hasMaterial = mesh.getMaterialsCount() > 0;
+                w.pod(static_cast<uint8_t>(hasMaterial));
+                if (hasMaterial)
+                {
+                    writeMaterial(w, mesh.getMaterial());
+                }
+
+                w.array(mesh.getVertexData(), mesh.getVertexCount());
+                w.array(mesh.getIndexData(), mesh.getIndicesCount());
+            }
+        }
+
+        bool readMeshes(const uint8_t* data, size_t size, std::vector<MeshData>& out)
+        {
+            Reader r(data, size);
+
+            Header header;
+            if (!readHeader(r, Kind::Mesh, header) || r.pod<uint32_t>() != sizeof(MeshVertex))
+            {
+                return false;
+            }
+
+            std::vector<MeshData> result(header.count);
+
+            for (auto& mesh : result)
+            {
+                mesh.setName(r.string());
+                mesh.startVertex = r.pod<uint32_t>();
+                mesh.startIndex = r.pod<uint32_t>();
+                mesh.indexCount = r.pod<uint32_t>();
+                mesh.materialId = r.pod<uint32_t>();
+
+                if (r.pod<uint8_t>())
+                {
+                    mesh.addMaterial(readMaterial(r));
+                }
+
+                mesh.setVertices(r.array<MeshVertex>());
+                mesh.setIndices(r.array<int32_t>());
+            }
+
+            out = std::move(result);
+
+            return true;
+        }
+
+        void writeTexture(const Texture& texture, std::vector<uint8_t>& out)
+        {
+            Writer w(out);
+            writeHeader(w, Kind::Texture, 1);
+            w.pod(texture.width);
+            w.pod(texture.height);
+            w.pod(texture.mipCount);
+            w.pod(static_cast<uint32_t>(texture.format));
+            w.array(texture.data.data(), texture.data.size());
+        }
+
+        bool readTexture(const uint8_t* data, size_t size, Texture& out)
+        {
+            Reader r(data, size);
+
+            Header header;
+            if (!readHeader(r, Kind::Texture, header))
+            {
+                return false;
+            }
+
+            out.width = r.pod<uint32_t>();
+            out.height = r.pod<uint32_t>();
+            out.mipCount = r.pod<uint32_t>();
+            out.format = static_cast<TextureFmt>(r.pod<uint32_t>());
+            out.data = r.array<uint8_t>();
+
+            return true;
+        }
+
+        void writeShader(const std::vector<ShaderStage>& stages, std::vector<uint8_t>& out)
+        {
+            Writer w(out);
+            writeHeader(w, Kind::Shader, stages.size());
+
+            for (const auto& stage : stages)
+            {
+                w.pod(static_cast<uint32_t>(stage.type));
+                w.string(stage.entryPoint);
+                w.string(stage.target);
+                w.array(stage.bytecode.data(), stage.bytecode.size());
+            }
+        }
+
+        bool readShader(const uint8_t* data, size_t size, std::vector<ShaderStage>& out)
+        {
+            Reader r(data, size);
+
+            Header header;
+            if (!readHeader(r, Kind::Shader, header))
+            {
+                return false;
+            }
+
+            std::vector<ShaderStage> result(header.count);
+
+            for (auto& stage : result)
+            {
+                stage.type = static_cast<ShaderType>(r.pod<uint32_t>());
+                stage.entryPoint = r.string();
+                stage.target = r.string();
+                stage.bytecode = r.array<uint8_t>();
+            }
+
+            out = std::move(result);
+
+            return true;
+        }
+    }
+}
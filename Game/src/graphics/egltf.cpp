@@ -0,0 +1,571 @@
+#include "graphics/egltf.h"
+
+#include "utils/efileutils.h"
+#include "utils/ejobsystem.h"
+#include "utils/ejson.h"
+#include "utils/evfs.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace EProject
+{
+    namespace
+    {
+        enum ComponentType
+        {
+            Byte = 5120,
+            UByte = 5121,
+            Short = 5122,
+            UShort = 5123,
+            UInt = 5125,
+            Float = 5126
+        };
+
+        static constexpr int cModeTriangles = 4;
+
+        struct AccessorView
+        {
+            const uint8_t* data = nullptr;
+            size_t count = 0;
+            size_t stride = 0;
+            int componentType = 0;
+            int components = 0;
+            bool normalized = false;
+
+            bool isValid() const { return data != nullptr; }
+        };
+
+        size_t componentSize(int type)
+        {
+            switch (type)
+            {
+            case Byte:
+            case UByte:
+                return 1;
+            case Short:
+            case UShort:
+                return 2;
+            case UInt:
+            case Float:
+                return 4;
+            default:
+                return 0;
+            }
+        }
+
+        int componentsCount(const std::string& type)
+        {
+            if (type == "SCALAR") return 1;
+            if (type == "VEC2") return 2;
+            if (type == "VEC3") return 3;
+            if (type == "VEC4") return 4;
+            if (type == "MAT2") return 4;
+            if (type == "MAT3") return 9;
+            if (type == "MAT4") return 16;
+            return 0;
+        }
+
+        float readComponent(const uint8_t* p, int type, bool normalized)
+        {
+            switch (type)
+            {
+            case Float:
+            {
+                float v;
+                std::memcpy(&v, p, sizeof(v));
+                return v;
+            }
+            case UByte:
+                return normalized ? p[0] / 255.0f : static_cast<float>(p[0]);
+            case Byte:
+            {
+                const int8_t v = static_cast<int8_t>(p[0]);
+                return normalized ? glm::max(v / 127.0f, -1.0f) : static_cast<float>(v);
+            }
+            case UShort:
+            {
+                uint16_t v;
+                std::memcpy(&v, p, sizeof(v));
+                return normalized ? v / 65535.0f : static_cast<float>(v);
+            }
+            case Short:
+            {
+                int16_t v;
+                std::memcpy(&v, p, sizeof(v));
+                return normalized ? glm::max(v / 32767.0f, -1.0f) : static_cast<float>(v);
+            }
+            case UInt:
+            {
+                uint32_t v;
+                std::memcpy(&v, p, sizeof(v));
+                return static_cast<float>(v);
+            }
+            default:
+                return 0.0f;
+            }
+        }
+
+        template<int N>
+        glm::vec<N, float> readVec(const AccessorView& view, size_t idx)
+        {
+            glm::vec<N, float> res(0.0f);
+
+            const uint8_t* p = view.data + view.stride * idx;
+
+            if (view.componentType == Float && view.components >= N)
+            {
+                std::memcpy(&res[0], p, sizeof(float) * N);
+                return res;
+            }
+
+            const size_t size = componentSize(view.componentType);
+            for (int c = 0; c < glm::min(N, view.components); ++c)
+            {
+                res[c] = readComponent(p + c * size, view.componentType, view.normalized);
+            }
+
+            return res;
+        }
+
+        uint32_t readIndex(const AccessorView& view, size_t idx)
+        {
+            const uint8_t* p = view.data + view.stride * idx;
+
+            switch (view.componentType)
+            {
+            case UByte:
+                return p[0];
+            case UShort:
+            {
+                uint16_t v;
+                std::memcpy(&v, p, sizeof(v));
+                return v;
+            }
+            case UInt:
+            {
+                uint32_t v;
+                std::memcpy(&v, p, sizeof(v));
+                return v;
+            }
+            default:
+                throw std::runtime_error("GLTFLoader: Invalid index component type");
+            }
+        }
+
+        struct GLTFDocument
+        {
+            JsonValue json;
+            std::vector<FileView> buffers;
+
+            AccessorView getAccessor(int idx) const
+            {
+                const auto& acc = json["accessors"][idx];
+                if (idx < 0 || !acc.isObject())
+                {
+                    throw std::runtime_error("GLTFLoader: Invalid accessor index " + std::to_string(idx));
+                }
+
+                const auto& bv = json["bufferViews"][acc["bufferView"].asInt(-1)];
+                if (!bv.isObject())
+                {
+                    throw std::runtime_error("GLTFLoader: Accessor without buffer view");
+                }
+
+                const size_t bufferIdx = bv["buffer"].asSize(buffers.size());
+                if (bufferIdx >= buffers.size())
+                {
+                    throw std::runtime_error("GLTFLoader: Invalid buffer index");
+                }
+
+                AccessorView view = {};
+                view.count = acc["count"].asSize();
+                view.componentType = acc["componentType"].asInt();
+                view.components = componentsCount(acc["type"].asString());
+                view.normalized = acc["normalized"].asBool();
+
+                const size_t elemSize = componentSize(view.componentType) * view.components;
+                view.stride = bv["byteStride"].asSize(elemSize);
+
+                const size_t viewOffset = bv["byteOffset"].asSize();
+                const size_t viewLength = bv["byteLength"].asSize();
+                const size_t accOffset = acc["byteOffset"].asSize();
+
+                const FileView& buffer = buffers[bufferIdx];
+
+                if (elemSize == 0 || viewOffset + viewLength > buffer.getSize() ||
+                    (view.count > 0 && accOffset + view.stride * (view.count - 1) + elemSize > viewLength))
+                {
+                    throw std::runtime_error("GLTFLoader: Accessor " + std::to_string(idx) + " is out of buffer bounds");
+                }
+
+                view.data = buffer.getData() + viewOffset + accOffset;
+
+                return view;
+            }
+
+            AccessorView getAttribute(const JsonValue& prim, const char* name) const
+            {
+                const auto& attributes = prim["attributes"];
+                return attributes.has(name) ? getAccessor(attributes[name].asInt(-1)) : AccessorView();
+            }
+        };
+
+        Material readMaterial(const JsonValue& json, const JsonValue& mat)
+        {
+            auto texturePath = [&json](const JsonValue& texInfo) -> std::filesystem::path
+            {
+                if (!texInfo.isObject())
+                {
+                    return {};
+                }
+
+                const auto& tex = json["textures"][texInfo["index"].asInt(-1)];
+                const auto& image = json["images"][tex["source"].asInt(-1)];
+
+                const auto& uri = image["uri"].asString();
+                if (uri.empty() || isDataUri(uri))
+                {
+                    return {};
+                }
+
+                return std::filesystem::u8path(decodeUri(uri));
+            };
+
+            Material res = {};
+
+            const auto& pbr = mat["pbrMetallicRoughness"];
+            const auto& baseColor = pbr["baseColorFactor"];
+            const auto& emissive = mat["emissiveFactor"];
+
+            res.albedo = { baseColor[0].asFloat(1.0f), baseColor[1].asFloat(1.0f), baseColor[2].asFloat(1.0f), baseColor[3].asFloat(1.0f) };
+            res.emission = { emissive[0].asFloat(), emissive[1].asFloat(), emissive[2].asFloat(), 1.0f };
+            res.metallic = pbr["metallicFactor"].asFloat(1.0f);
+            res.roughness = pbr["roughnessFactor"].asFloat(1.0f);
+
+            // Same slots the Assimp importer fills: occlusion comes as lightmap,
+            // packed metallic roughness as diffuse roughness
+            res.albedo_map = texturePath(pbr["baseColorTexture"]);
+            res.roughness_map = texturePath(pbr["metallicRoughnessTexture"]);
+            res.metallic_map = texturePath(mat["occlusionTexture"]);
+            res.emission_map = texturePath(mat["emissiveTexture"]);
+            res.normal_map = texturePath(mat["normalTexture"]);
+
+            return res;
+        }
+
+        void computeNormals(std::vector<MeshVertex>& vertices, const std::vector<int32_t>& indices)
+        {
+            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                auto& v0 = vertices[indices[i + 0]];
+                auto& v1 = vertices[indices[i + 1]];
+                auto& v2 = vertices[indices[i + 2]];
+
+                // Area weighted
+                const glm::vec3 n = glm::cross(v1.pos - v0.pos, v2.pos - v0.pos);
+                v0.normal += n;
+                v1.normal += n;
+                v2.normal += n;
+            }
+
+            for (auto& v : vertices)
+            {
+                const float len = glm::length(v.normal);
+                v.normal = len > 0.0f ? v.normal / len : glm::vec3(0.0f, 1.0f, 0.0f);
+            }
+        }
+
+        // Tangents follow the glTF convention: bitangent = cross(normal, tangent) * w
+        void computeTangents(std::vector<MeshVertex>& vertices, const std::vector<int32_t>& indices)
+        {
+            std::vector<glm::vec3> vdir(vertices.size(), glm::vec3(0.0f));
+
+            for (size_t i = 0; i + 2 < indices.size(); i += 3)
+            {
+                auto& v0 = vertices[indices[i + 0]];
+                auto& v1 = vertices[indices[i + 1]];
+                auto& v2 = vertices[indices[i + 2]];
+
+                const glm::vec3 e1 = v1.pos - v0.pos;
+                const glm::vec3 e2 = v2.pos - v0.pos;
+                const glm::vec2 d1 = v1.uv - v0.uv;
+                const glm::vec2 d2 = v2.uv - v0.uv;
+
+                const float det = d1.x * d2.y - d2.x * d1.y;
+                if (glm::abs(det) <= std::numeric_limits<float>::epsilon())
+                {
+                    continue;
+                }
+
+                const float r = 1.0f / det;
+                const glm::vec3 udir = (e1 * d2.y - e2 * d1.y) * r;
+                const glm::vec3 dv = (e2 * d1.x - e1 * d2.x) * r;
+
+                v0.tangent += udir;
+                v1.tangent += udir;
+                v2.tangent += udir;
+
+                vdir[indices[i + 0]] += dv;
+                vdir[indices[i + 1]] += dv;
+                vdir[indices[i + 2]] += dv;
+            }
+
+            for (size_t i = 0; i < vertices.size(); ++i)
+            {
+                auto& v = vertices[i];
+
+                glm::vec3 t = v.tangent - v.normal * glm::dot(v.normal, v.tangent);
+                if (glm::length(t) <= std::numeric_limits<float>::epsilon())
+                {
+                    t = glm::cross(v.normal, glm::abs(v.normal.y) < 0.99f ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0));
+                }
+
+                v.tangent = glm::normalize(t);
+
+                // glTF texture space has v pointing down, the bitangent points towards decreasing v
+                const float w = glm::dot(glm::cross(v.normal, v.tangent), vdir[i]) > 0.0f ? -1.0f : 1.0f;
+                v.bitangent = glm::cross(v.normal, v.tangent) * w;
+            }
+        }
+
+        void convertPrimitive(const GLTFDocument& doc, const JsonValue& prim, MeshData& meshData)
+        {
+            const AccessorView positions = doc.getAttribute(prim, "POSITION");
+            const AccessorView normals = doc.getAttribute(prim, "NORMAL");
+            const AccessorView tangents = doc.getAttribute(prim, "TANGENT");
+            const AccessorView uvs = doc.getAttribute(prim, "TEXCOORD_0");
+
+            const size_t vertexCount = positions.count;
+
+            for (const auto* view : { &normals, &tangents, &uvs })
+            {
+                if (view->isValid() && view->count != vertexCount)
+                {
+                    throw std::runtime_error("GLTFLoader: Attribute count mismatch in " + meshData.getName());
+                }
+            }
+
+            std::vector<MeshVertex> vertices(vertexCount);
+
+            for (size_t v = 0; v < vertexCount; ++v)
+            {
+                auto& vert = vertices[v];
+
+                vert.pos = readVec<3>(positions, v);
+
+                if (normals.isValid())
+                {
+                    vert.normal = readVec<3>(normals, v);
+                }
+
+                if (uvs.isValid())
+                {
+                    vert.uv = readVec<2>(uvs, v);
+                }
+
+                if (tangents.isValid())
+                {
+                    const glm::vec4 t = readVec<4>(tangents, v);
+                    vert.tangent = glm::vec3(t.x, t.y, t.z);
+                    vert.bitangent = glm::cross(vert.normal, vert.tangent) * (t.w < 0.0f ? -1.0f : 1.0f);
+                }
+            }
+
+            std::vector<int32_t> indices;
+
+            if (prim.has("indices"))
+            {
+                const AccessorView indexView = doc.getAccessor(prim["indices"].asInt(-1));
+                indices.resize(indexView.count);
+
+                for (size_t i = 0; i < indexView.count; ++i)
+                {
+                    const uint32_t idx = readIndex(indexView, i);
+                    if (idx >= vertexCount)
+                    {
+                        throw std::runtime_error("GLTFLoader: Index out of range in " + meshData.getName());
+                    }
+
+                    indices[i] = static_cast<int32_t>(idx);
+                }
+            }
+            else
+            {
+                indices.resize(vertexCount);
+                for (size_t i = 0; i < vertexCount; ++i)
+                {
+                    indices[i] = static_cast<int32_t>(i);
+                }
+            }
+
+            indices.resize(indices.size() - indices.size() % 3);
+
+            if (!normals.isValid())
+            {
+                computeNormals(vertices, indices);
+            }
+
+            if (!tangents.isValid())
+            {
+                computeTangents(vertices, indices);
+            }
+
+            // Same as aiProcess_ConvertToLeftHanded: mirror z and flip the winding
+            for (auto& vert : vertices)
+            {
+                vert.pos.z = -vert.pos.z;
+                vert.normal.z = -vert.normal.z;
+                vert.tangent.z = -vert.tangent.z;
+                vert.bitangent.z = -vert.bitangent.z;
+            }
+
+            for (size_t i = 0; i < indices.size(); i += 3)
+            {
+                std::swap(indices[i], indices[i + 2]);
+            }
+
+            meshData.setVertices(std::move(vertices));
+            meshData.setIndices(std::move(indices));
+        }
+
+        bool isDocumentSupported(const JsonValue& json)
+        {
+            if (json["extensionsRequired"].size() > 0)
+            {
+                return false;
+            }
+
+            const auto& buffers = json["buffers"];
+            for (size_t i = 0; i < buffers.size(); ++i)
+            {
+                const auto& uri = buffers[i]["uri"].asString();
+                if (uri.empty() || isDataUri(uri))
+                {
+                    return false;
+                }
+            }
+
+            const auto& accessors = json["accessors"];
+            for (size_t i = 0; i < accessors.size(); ++i)
+            {
+                if (accessors[i].has("sparse") || !accessors[i].has("bufferView"))
+                {
+                    return false;
+                }
+            }
+
+            const auto& meshes = json["meshes"];
+            for (size_t m = 0; m < meshes.size(); ++m)
+            {
+                const auto& primitives = meshes[m]["primitives"];
+                for (size_t p = 0; p < primitives.size(); ++p)
+                {
+                    const auto& prim = primitives[p];
+                    if (prim["mode"].asInt(cModeTriangles) != cModeTriangles || !prim["attributes"].has("POSITION"))
+                    {
+                        return false;
+                    }
+                }
+            }
+
+            return true;
+        }
+    }
+
+    bool GLTFLoader::isSupported(const std::filesystem::path& path)
+    {
+        auto ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(::tolower(c)); });
+
+        return ext == ".gltf";
+    }
+
+    bool GLTFLoader::load(const std::filesystem::path& path, std::vector<MeshData>& out)
+    {
+        FileView file;
+        if (!getFileSystem()->open(path, file))
+        {
+            throw std::runtime_error("GLTFLoader: Load failed: " + path.u8string());
+        }
+
+        GLTFDocument doc;
+        doc.json = JsonValue::parse(reinterpret_cast<const char*>(file.getData()), file.getSize());
+
+        const auto& json = doc.json;
+
+        if (!isDocumentSupported(json))
+        {
+            return false;
+        }
+
+        const auto& buffers = json["buffers"];
+        doc.buffers.reserve(buffers.size());
+
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            const auto bufferPath = path.parent_path() / std::filesystem::u8path(decodeUri(buffers[i]["uri"].asString()));
+
+            doc.buffers.emplace_back();
+            if (!getFileSystem()->open(bufferPath, doc.buffers.back()) || doc.buffers.back().getSize() < buffers[i]["byteLength"].asSize())
+            {
+                throw std::runtime_error("GLTFLoader: Can't read buffer: " + bufferPath.u8string());
+            }
+        }
+
+        // Materials without index get a default one at the end, like Assimp does
+        const auto& materials = json["materials"];
+        std::vector<Material> mats(materials.size() + 1);
+
+        for (size_t i = 0; i < materials.size(); ++i)
+        {
+            mats[i] = readMaterial(json, materials[i]);
+        }
+
+        mats.back().albedo = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+        std::vector<const JsonValue*> primitives;
+        std::vector<MeshData> result;
+
+        uint32_t vertexCount = 0;
+        uint32_t indexCount = 0;
+
+        const auto& meshes = json["meshes"];
+        for (size_t m = 0; m < meshes.size(); ++m)
+        {
+            const auto& prims = meshes[m]["primitives"];
+            for (size_t p = 0; p < prims.size(); ++p)
+            {
+                const auto& prim = prims[p];
+
+                const size_t numVertices = doc.getAccessor(prim["attributes"]["POSITION"].asInt(-1)).count;
+                const size_t numIndices = prim.has("indices") ? doc.getAccessor(prim["indices"].asInt(-1)).count : numVertices;
+
+                MeshData meshData = {};
+                meshData.setName(meshes[m]["name"].asString());
+
+                meshData.startVertex = vertexCount;
+                meshData.startIndex = indexCount;
+                meshData.indexCount = static_cast<uint32_t>(numIndices - numIndices % 3);
+                meshData.materialId = static_cast<uint32_t>(glm::min(prim["material"].asSize(materials.size()), materials.size()));
+
+                meshData.addMaterial(mats[meshData.materialId]);
+
+                vertexCount += static_cast<uint32_t>(numVertices);
+                indexCount += meshData.indexCount;
+
+                primitives.push_back(&prim);
+                result.emplace_back(std::move(meshData));
+            }
+        }
+
+        getJobSystem()->parallelFor(primitives.size(), [&doc, &primitives, &result](size_t i)
+        {
+            convertPrimitive(doc, *primitives[i], result[i]);
+        });
+
+        out = std::move(result);
+
+        return true;
+    }
+}
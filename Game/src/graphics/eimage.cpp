@@ -0,0 +1,320 @@
+#include "graphics/eimage.h"
+#include "utils/ejobsystem.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#define STBI_MALLOC(sz) EProject::getPixelBufferPool()->allocate(sz)
+#define STBI_REALLOC(p, newsz) EProject::getPixelBufferPool()->reallocate(p, newsz)
+#define STBI_FREE(p) EProject::getPixelBufferPool()->release(p)
+
+#define STBI_WINDOWS_UTF8
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+namespace EProject
+{
+    namespace
+    {
+        // Keeps the block size in front of the user pointer, 16 bytes to keep alignment
+        struct BlockHeader
+        {
+            size_t sizeClass;
+            size_t pooled;
+        };
+
+        static_assert(sizeof(BlockHeader) == 16, "PixelBufferPool: Header must keep 16 byte alignment");
+
+        BlockHeader* getHeader(void* ptr)
+        {
+            return static_cast<BlockHeader*>(ptr) - 1;
+        }
+    }
+
+    PixelBufferPool::~PixelBufferPool()
+    {
+        trim();
+    }
+
+    size_t PixelBufferPool::getSizeClass(size_t size)
+    {
+        if (size <= cMinPooledSize)
+        {
+            return size;
+        }
+
+        // Round up to a quarter of the power of two below, wastes at most 25%
+        size_t pow = cMinPooledSize;
+        while (pow * 2 < size)
+        {
+            pow *= 2;
+        }
+
+        const size_t step = pow / 4;
+        return (size + step - 1) / step * step;
+    }
+
+    void* PixelBufferPool::allocateBlock(size_t sizeClass)
+    {
+        auto header = static_cast<BlockHeader*>(std::malloc(sizeof(BlockHeader) + sizeClass));
+        if (!header)
+        {
+            return nullptr;
+        }
+
+        header->sizeClass = sizeClass;
+        header->pooled = sizeClass > cMinPooledSize;
+
+        return header + 1;
+    }
+
+    void* PixelBufferPool::allocate(size_t size)
+    {
+        const size_t sizeClass = getSizeClass(size);
+
+        if (sizeClass > cMinPooledSize)
+        {
+            std::lock_guard lock(m_mutex);
+
+            ++m_stats.allocations;
+
+            auto it = m_free.find(sizeClass);
+            if (it != m_free.end() && !it->second.empty())
+            {
+                void* ptr = it->second.back();
+                it->second.pop_back();
+
+                ++m_stats.reused;
+                m_stats.cachedBytes -= sizeClass;
+
+                return ptr;
+            }
+        }
+
+        return allocateBlock(sizeClass);
+    }
+
+    void* PixelBufferPool::reallocate(void* ptr, size_t size)
+    {
+        if (!ptr)
+        {
+            return allocate(size);
+        }
+
+        const size_t capacity = getHeader(ptr)->sizeClass;
+        if (size <= capacity)
+        {
+            return ptr;
+        }
+
+        void* res = allocate(size);
+        if (res)
+        {
+            std::memcpy(res, ptr, capacity);
+            release(ptr);
+        }
+
+        return res;
+    }
+
+    void PixelBufferPool::release(void* ptr)
+    {
+        if (!ptr)
+        {
+            return;
+        }
+
+        auto header = getHeader(ptr);
+
+        if (header->pooled)
+        {
+            std::lock_guard lock(m_mutex);
+
+            if (m_stats.cachedBytes + header->sizeClass <= m_maxCachedBytes)
+            {
+                m_free[header->sizeClass].push_back(ptr);
+                m_stats.cachedBytes += header->sizeClass;
+                return;
+            }
+        }
+
+        std::free(header);
+    }
+
+    void PixelBufferPool::reserve(const std::vector<size_t>& sizes)
+    {
+        size_t room = 0;
+        {
+            std::lock_guard lock(m_mutex);
+            room = m_maxCachedBytes > m_stats.cachedBytes ? m_maxCachedBytes - m_stats.cachedBytes : 0;
+        }
+
+        std::vector<void*> blocks;
+        blocks.reserve(sizes.size());
+
+        // Allocate all first so equal sizes get separate blocks. Anything past the limit
+        // would only be freed again on release.
+        for (const size_t size : sizes)
+        {
+            const size_t sizeClass = getSizeClass(size);
+            if (sizeClass <= cMinPooledSize || sizeClass > room)
+            {
+                continue;
+            }
+
+            room -= sizeClass;
+            blocks.push_back(allocate(size));
+        }
+
+        for (void* ptr : blocks)
+        {
+            release(ptr);
+        }
+    }
+
+    void PixelBufferPool::trim()
+    {
+        std::lock_guard lock(m_mutex);
+
+        for (auto& [sizeClass, blocks] : m_free)
+        {
+            for (void* ptr : blocks)
+            {
+                std::free(getHeader(ptr));
+            }
+        }
+
+        m_free.clear();
+        m_stats.cachedBytes = 0;
+    }
+
+    void PixelBufferPool::setMaxCachedBytes(size_t bytes)
+    {
+        std::lock_guard lock(m_mutex);
+        m_maxCachedBytes = bytes;
+    }
+
+    PixelBufferPool::Stats PixelBufferPool::getStats() const
+    {
+        std::lock_guard lock(m_mutex);
+        return m_stats;
+    }
+
+    PixelBufferPool* getPixelBufferPool()
+    {
+        // Never destroyed: textures may still release pixels during static destruction
+        static PixelBufferPool* instance = new PixelBufferPool();
+        return instance;
+    }
+
+    void PixelDeleter::operator()(uint8_t* ptr) const
+    {
+        getPixelBufferPool()->release(ptr);
+    }
+
+    bool ImageDecoder::getInfo(const ImageSource& src, glm::ivec2& size, int& channels)
+    {
+        return stbi_info_from_memory(src.data, static_cast<int>(src.size), &size.x, &size.y, &channels) != 0;
+    }
+
+    DecodedImage ImageDecoder::decode(const ImageSource& src, int channels, bool flipY)
+    {
+        DecodedImage res;
+
+        // The global flip flag is shared by every thread, use the thread local one
+        stbi_set_flip_vertically_on_load_thread(flipY);
+
+        int fileChannels = 0;
+        res.pixels.reset(stbi_load_from_memory(src.data, static_cast<int>(src.size), &res.size.x, &res.size.y, &fileChannels, channels));
+
+        if (!res.pixels)
+        {
+            res.size = glm::ivec2(0);
+            res.error = stbi_failure_reason() ? stbi_failure_reason() : "unknown error";
+            return res;
+        }
+
+        res.channels = channels ? channels : fileChannels;
+
+        return res;
+    }
+
+    bool ImageDecoder::isHDR(const ImageSource& src)
+    {
+        return stbi_is_hdr_from_memory(src.data, static_cast<int>(src.size)) != 0;
+    }
+
+    bool ImageDecoder::is16Bit(const ImageSource& src)
+    {
+        return stbi_is_16_bit_from_memory(src.data, static_cast<int>(src.size)) != 0;
+    }
+
+    DecodedImage ImageDecoder::decodeNative(const ImageSource& src, int channels, bool flipY)
+    {
+        DecodedImage res;
+
+        const bool hdr = isHDR(src);
+        const bool wide = !hdr && is16Bit(src);
+
+        if (!hdr && !wide)
+        {
+            return decode(src, channels, flipY);
+        }
+
+        stbi_set_flip_vertically_on_load_thread(flipY);
+
+        int fileChannels = 0;
+        void* pixels = nullptr;
+
+        if (hdr)
+        {
+            pixels = stbi_loadf_from_memory(src.data, static_cast<int>(src.size), &res.size.x, &res.size.y, &fileChannels, channels);
+            res.type = PixelType::Float;
+        }
+        else
+        {
+            pixels = stbi_load_16_from_memory(src.data, static_cast<int>(src.size), &res.size.x, &res.size.y, &fileChannels, channels);
+            res.type = PixelType::UInt16;
+        }
+
+        res.pixels.reset(static_cast<uint8_t*>(pixels));
+
+        if (!res.pixels)
+        {
+            res.size = glm::ivec2(0);
+            res.error = stbi_failure_reason() ? stbi_failure_reason() : "unknown error";
+            return res;
+        }
+
+        res.channels = channels ? channels : fileChannels;
+
+        return res;
+    }
+
+    std::vector<DecodedImage> ImageDecoder::decodeBatch(const std::vector<ImageSource>& sources, int channels, bool flipY)
+    {
+        std::vector<size_t> outputSizes(sources.size());
+
+        getJobSystem()->parallelFor(sources.size(), [&](size_t i)
+        {
+            glm::ivec2 size;
+            int fileChannels = 0;
+
+            if (getInfo(sources[i], size, fileChannels))
+            {
+                outputSizes[i] = static_cast<size_t>(size.x) * size.y * (channels ? channels : fileChannels);
+            }
+        });
+
+        getPixelBufferPool()->reserve(outputSizes);
+
+        std::vector<DecodedImage> result(sources.size());
+
+        getJobSystem()->parallelFor(sources.size(), [&](size_t i)
+        {
+            result[i] = decode(sources[i], channels, flipY);
+        });
+
+        return result;
+    }
+}
@@ -1,12 +1,25 @@
 #include "graphics/emesh.h"
-
+#include "graphics/egltf.h"
+#include "graphics/emipgen.h"
+#include "graphics/etexconvert.h"
+#include "utils/ehash.h"
+#include "utils/ejobsystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <tuple>
+
+#ifndef EPROJECT_NO_ASSIMP
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>     
 #include <assimp/postprocess.h>
 #include <assimp/cimport.h>
+#endif
 
 namespace EProject
 {
+#ifndef EPROJECT_NO_ASSIMP
     static constexpr uint32_t meshLoadFlags =
         aiProcess_CalcTangentSpace |        // Create binormals/tangents just in case
         aiProcess_Triangulate |             // Make sure we're triangles
@@ -16,6 +29,9 @@ namespace EProject
         aiProcess_OptimizeMeshes |          // Batch draws where possible
         aiProcess_ValidateDataStructure |
         aiProcess_ConvertToLeftHanded | aiProcess_FixInfacingNormals;    // Validation
+#endif
+
+    static std::atomic<bool> useNativeGLTF = true;
 
     const Layout* MeshVertex::getLayout()
     {
@@ -41,90 +57,73 @@ namespace EProject
             ->end(sizeof(SkinnedMeshVertex));
     }
 
-    size_t Mesh::getIndicesCount() const
-    {
-        return indices.size();
-    }
-    
-    size_t Mesh::getMaterialsCount() const
+    MeshInstance::~MeshInstance()
     {
-        return materials.size();
-    }
 
-    void Mesh::addIndex(int32_t index)
-    {
-        indices.push_back(index);
     }
 
-    void Mesh::addMaterial(const Material& mat)
+    MeshInstance::MeshInstance(const std::filesystem::path& _path) : IAsset(_path)
     {
-        materials.push_back(mat);
-    }
 
-    void Mesh::setName(const std::string& mshName)
-    {
-        name = mshName;
     }
     
-    const std::string& Mesh::getName() const
+    MeshInstance::MeshInstance(const MeshInstance& r)
     {
-        return name;
-    }
 
-    const AABB& Mesh::getAABB() const
-    {
-        return bbox;
     }
 
-    size_t MeshData::getVertexCount() const
+    void MeshInstance::init()
     {
-        return vertices.size();
-    }
+        calculateAABB();
 
-    void MeshData::addVertex(const MeshVertex& mshVertex)
-    {
-        vertices.push_back(mshVertex);
-    }
-    
-    const AABB& MeshData::calculateAABB()
-    {
-        for (const auto& vert : vertices)
+        for (auto& md : m_data)
         {
-            bbox += vert.pos;
-        }  
-
-        return bbox;
+            md.buildMeshlets();
+        }
     }
 
-    const Material& MeshData::getMaterial() const
+    void MeshInstance::setNativeGLTF(bool enabled)
     {
-        assert(materialId != -1);
-
-        return materials[materialId];
+        useNativeGLTF = enabled;
     }
 
-    MeshInstance::~MeshInstance()
+    bool MeshInstance::load(const GDevicePtr& _ptr)
     {
+        const bool native = useNativeGLTF && GLTFLoader::isSupported(m_path) && GLTFLoader::load(m_path, m_data);
+        if (!native)
+        {
+            loadAssimp();
+        }
 
-    }
+        // Geometry and materials, the same model saved under two names is kept once
+        EHash::Hasher64 hasher;
 
-    MeshInstance::MeshInstance(const std::filesystem::path& _path) : IAsset(_path)
-    {
+        for (const auto& md : m_data)
+        {
+            hasher.update(md.getVertexData(), md.getVertexCount() * sizeof(MeshVertex));
+            hasher.update(md.getIndexData(), md.getIndicesCount() * sizeof(int32_t));
 
-    }
-    
-    MeshInstance::MeshInstance(const MeshInstance& r)
-    {
+            const auto& mat = md.getMaterial();
+            const float factors[] = { mat.albedo.x, mat.albedo.y, mat.albedo.z, mat.albedo.w, mat.emission.x, mat.emission.y, mat.emission.z, mat.emission_strength, mat.metallic, mat.roughness };
 
-    }
+            hasher.update(factors, sizeof(factors));
 
-    void MeshInstance::init()
-    {
-        calculateAABB();
+            for (const auto* file : { &mat.albedo_map, &mat.normal_map, &mat.roughness_map, &mat.metallic_map, &mat.emission_map })
+            {
+                hasher.update(file->u8string());
+            }
+        }
+
+        m_contentHash = hasher.finish();
+
+        return true;
     }
 
-    bool MeshInstance::load(const GDevicePtr& _ptr)
+    bool MeshInstance::loadAssimp()
     {
+#ifdef EPROJECT_NO_ASSIMP
+        throw std::runtime_error("MeshInstance: Built without Assimp, can't load " + m_path.u8string());
+#else
         Assimp::Importer importer;
         
         const aiScene* scene = importer.ReadFile(m_path.string(), meshLoadFlags);
@@ -135,27 +134,35 @@ namespace EProject
             return false;
         }
 
+        // Offsets are known up front, so every submesh can be converted independently
+        m_data.resize(scene->mNumMeshes);
+
         uint32_t vertexCount = 0;
         uint32_t indexCount = 0;
 
-        m_data.reserve(scene->mNumMeshes);
-
-        for (uint32_t i = 0; i < scene->mNumMeshes; ++i) 
+        for (uint32_t i = 0; i < scene->mNumMeshes; ++i)
         {
-            auto& mesh = scene->mMeshes[i];
-            const auto& mat = scene->mMaterials[mesh->mMaterialIndex];
-
-            MeshData meshData = {};
+            const auto& mesh = scene->mMeshes[i];
+            auto& meshData = m_data[i];
 
             meshData.startVertex = vertexCount;
             meshData.startIndex = indexCount;
             meshData.indexCount = mesh->mNumFaces * 3;
             meshData.materialId = mesh->mMaterialIndex;
 
-            meshData.setName(mesh->mName.C_Str());
-
             vertexCount += mesh->mNumVertices;
             indexCount += meshData.indexCount;
+        }
+
+        getJobSystem()->parallelFor(scene->mNumMeshes, [this, scene](size_t i)
+        {
+            const auto& mesh = scene->mMeshes[i];
+            const auto& mat = scene->mMaterials[mesh->mMaterialIndex];
+
+            auto& meshData = m_data[i];
+
+            meshData.setName(mesh->mName.C_Str());
+            meshData.reserve(mesh->mNumVertices, meshData.indexCount);
 
             for (uint32_t v = 0; v < mesh->mNumVertices; v++)
             {
@@ -237,18 +244,32 @@ namespace EProject
             }
 
             meshData.addMaterial(mshMat);
+        });
 
-            m_data.emplace_back(std::move(meshData));
-        }
-    
         return true;
+#endif
     }
 
     bool MeshInstance::unload()
     {
+        m_data = {};
+        bbox = {};
+
         return true;
     }
 
+    size_t MeshInstance::getMemoryUsage() const
+    {
+        size_t bytes = m_data.capacity() * sizeof(MeshData);
+
+        for (const auto& md : m_data)
+        {
+            bytes += md.getMemoryUsage();
+        }
+
+        return bytes;
+    }
+
     void MeshInstance::calculateAABB()
     {
         for (auto& md : m_data)
@@ -294,13 +315,264 @@ namespace EProject
         return count;
     }
 
-    GPUTexture2DPtr StaticMeshRenderable::setupTexture(const GDevicePtr& dev, AssetManagerPtr& mng, const PathKey& key)
+    PathKey StaticMeshRenderable::getTextureKey(const std::filesystem::path& file, const std::filesystem::path& occlusion) const
+    {
+        auto path = PathHandler::getModelsDir() / m_modelName / file;
+
+        // Packed textures get their own key, the same file can also be used unpacked
+        if (!occlusion.empty() && occlusion != file)
+        {
+            path += "|" + occlusion.u8string();
+        }
+
+        return PathKey(path);
+    }
+
+    GPUTexture2DPtr StaticMeshRenderable::findTexture(const PathKey& key) const
+    {
+        auto it = m_textures.find(key);
+        return it != m_textures.end() ? it->second : nullptr;
+    }
+
+    StaticMeshRenderable::MaterialGPU StaticMeshRenderable::getMaterialGPU(const Material& mat) const
+    {
+        MaterialGPU gpuMat = {};
+        gpuMat.albedoTex = findTexture(getTextureKey(mat.albedo_map));
+        gpuMat.normalTex = findTexture(getTextureKey(mat.normal_map));
+        gpuMat.metallRoghnessTex = findTexture(getTextureKey(mat.roughness_map, mat.metallic_map));
+
+        return gpuMat;
+    }
+
+    void StaticMeshRenderable::uploadTextures(const MeshInstancePtr& mshInst, const GDevicePtr& dev, AssetManagerPtr& mng)
+    {
+        struct Upload
+        {
+            PathKey key;
+            size_t texture = 0;
+            size_t occlusion = 0;   // index + 1 of the image packed into red, 0 for none
+            bool writeRed = false;  // red is sampled as occlusion but the file doesn't hold it
+            MipSettings settings;
+        };
+
+        std::vector<std::filesystem::path> files;
+        std::vector<Upload> uploads;
+
+        const auto addFile = [&](const std::filesystem::path& file)
+        {
+            // Materials share textures, decode each file once
+            const auto path = PathHandler::getModelsDir() / m_modelName / file;
+
+            const auto it = std::find(files.begin(), files.end(), path);
+            if (it != files.end())
+            {
+                return static_cast<size_t>(it - files.begin());
+            }
+
+            files.push_back(path);
+            return files.size() - 1;
+        };
+
+        const auto addUpload = [&](const std::filesystem::path& file, const std::filesystem::path& occlusion, const MipSettings& fileSettings, bool occlusionInRed)
+        {
+            if (file.empty())
+            {
+                return;
+            }
+
+            const auto key = getTextureKey(file, occlusion);
+            if (m_textures.count(key) || std::any_of(uploads.begin(), uploads.end(), [&](const Upload& u) { return u.key == key; }))
+            {
+                return;
+            }
+
+            Upload upload;
+            upload.key = key;
+            upload.texture = addFile(file);
+            upload.occlusion = !occlusion.empty() && occlusion != file ? addFile(occlusion) + 1 : 0;
+            upload.writeRed = occlusionInRed && occlusion != file;
+            upload.settings = fileSettings;
+
+            uploads.push_back(upload);
+        };
+
+        MipSettings albedo;
+        albedo.srgb = true;
+        albedo.alphaCutoff = 0.5f;
+
+        MipSettings normal;
+        normal.normalMap = true;
+
+        for (const auto& data : mshInst->getMeshData())
+        {
+            const auto& mat = data.getMaterial();
+
+            addUpload(mat.albedo_map, {}, albedo, false);
+            addUpload(mat.normal_map, {}, normal, false);
+
+            // Occlusion goes into the red channel of metallic-roughness, which glTF leaves unused
+            addUpload(mat.roughness_map, mat.metallic_map, MipSettings(), true);
+        }
+
+        // Decodes whatever isn't cached yet in one parallel batch
+        const auto textures = mng->getTextures(files);
+
+        // Paths with byte identical files resolve to one Texture2D, such uploads share a GPU texture
+        std::map<std::tuple<const Texture2D*, const Texture2D*, bool, bool>, size_t> uniqueUploads;
+        std::vector<size_t> sharedWith(uploads.size(), SIZE_MAX);
+
+        for (size_t i = 0; i < uploads.size(); ++i)
+        {
+            const auto& upload = uploads[i];
+            const auto* occlusion = upload.occlusion ? textures[upload.occlusion - 1].get() : nullptr;
+
+            const auto key = std::make_tuple(textures[upload.texture].get(), occlusion, upload.settings.srgb, upload.settings.normalMap);
+
+            const auto it = uniqueUploads.insert({ key, i }).first;
+            if (it->second != i)
+            {
+                sharedWith[i] = it->second;
+            }
+        }
+
+        std::vector<std::vector<uint8_t>> packed(uploads.size());
+
+        std::vector<MipSource> sources;
+        std::vector<size_t> sourceUploads;
+
+        for (size_t i = 0; i < uploads.size(); ++i)
+        {
+            const auto& upload = uploads[i];
+            const auto& tex = textures[upload.texture];
+
+            if (sharedWith[i] != SIZE_MAX)
+            {
+                continue;
+            }
+
+            // Only 8 bit colour gets a CPU mip chain, wider formats are uploaded as they are
+            if (tex->getFormat() != TextureFmt::RGBA8)
+            {
+                continue;
+            }
+
+            MipSource src;
+            src.rgba = static_cast<const uint8_t*>(tex->getData());
+            src.size = tex->getSize();
+            src.settings = upload.settings;
+
+            const Asset<Texture2D> occlusion = upload.occlusion ? textures[upload.occlusion - 1] : nullptr;
+            const bool packOcclusion = occlusion && occlusion->getFormat() == TextureFmt::RGBA8 && occlusion->getSize() == tex->getSize();
+
+            // Without a matching occlusion image red is set to unoccluded, glTF leaves its content undefined
+            if (upload.writeRed)
+            {
+                const size_t pixels = static_cast<size_t>(src.size.x) * src.size.y;
+                packed[i].resize(pixels * 4);
+
+                const TextureConvert::ChannelSource channels[4] = {
+                    packOcclusion ? TextureConvert::ChannelSource{ static_cast<const uint8_t*>(occlusion->getData()), 0 } : TextureConvert::ChannelSource{ nullptr, 0, 255 },
+                    { src.rgba, 1 },
+                    { src.rgba, 2 },
+                    { nullptr, 0, 255 }
+                };
+
+                TextureConvert::packChannels(channels, pixels, packed[i].data());
+                src.rgba = packed[i].data();
+            }
+
+            sources.push_back(src);
+            sourceUploads.push_back(i);
+        }
+
+        const auto chains = MipGenerator::generateBatch(sources);
+
+        for (size_t i = 0; i < chains.size(); ++i)
+        {
+            const auto& chain = chains[i];
+            const auto& upload = uploads[sourceUploads[i]];
+
+            auto gpuTex = dev->createTexture2D();
+            gpuTex->setState(TextureFmt::RGBA8, chain.sizes[0], chain.getLevelCount(), 1, nullptr);
+
+            for (int level = 0; level < chain.getLevelCount(); ++level)
+            {
+                gpuTex->setSubData(glm::ivec2(0), chain.sizes[level], 0, level, chain.getLevel(level));
+            }
+
+            m_textures.insert({ upload.key, gpuTex });
+        }
+
+        for (size_t i = 0; i < uploads.size(); ++i)
+        {
+            const auto& tex = textures[uploads[i].texture];
+            if (tex->getFormat() == TextureFmt::RGBA8 || sharedWith[i] != SIZE_MAX)
+            {
+                continue;
+            }
+
+            auto gpuTex = dev->createTexture2D();
+            gpuTex->setState(tex->getFormat(), tex->getSize(), 1, 1, tex->getData());
+
+            m_textures.insert({ uploads[i].key, gpuTex });
+        }
+
+        for (size_t i = 0; i < uploads.size(); ++i)
+        {
+            if (sharedWith[i] != SIZE_MAX)
+            {
+                m_textures.insert({ uploads[i].key, m_textures.at(uploads[sharedWith[i]].key) });
+            }
+        }
+    }
+
+    std::vector<std::filesystem::path> StaticMeshRenderable::getTextureFiles(const MeshInstancePtr& mshInst) const
     {
-        Asset<Texture2D> meshTex = mng->getAsset<Texture2D>(key.path);
+        std::vector<std::filesystem::path> files;
+
+        for (const auto& data : mshInst->getMeshData())
+        {
+            const auto& mat = data.getMaterial();
+            for (const auto* file : { &mat.albedo_map, &mat.normal_map, &mat.roughness_map, &mat.metallic_map })
+            {
+                if (!file->empty())
+                {
+                    const auto path = PathHandler::getModelsDir() / m_modelName / *file;
+                    if (std::find(files.begin(), files.end(), path) == files.end())
+                    {
+                        files.push_back(path);
+                    }
+                }
+            }
+        }
+
+        return files;
+    }
+
+    void StaticMeshRenderable::loadTexturesAsync(const MeshInstancePtr& mshInst, AssetManagerPtr& mng, std::function<void()> onReady)
+    {
+        assert(!m_modelName.empty());
+
+        const auto files = getTextureFiles(mshInst);
+
+        if (files.empty())
+        {
+            onReady();
+            return;
+        }
 
-        auto mshTexRend = dev->createTexture2D();
-        mshTexRend->setState(meshTex->getFormat(), meshTex->getSize(), 0, 1, meshTex->getData());
-        return mshTexRend;
+        auto remaining = std::make_shared<size_t>(files.size());
+
+        for (const auto& file : files)
+        {
+            mng->loadAsync<Texture2D>(file, 0.0f, [remaining, onReady](const Asset<Texture2D>&)
+            {
+                if (--*remaining == 0)
+                {
+                    onReady();
+                }
+            });
+        }
     }
 
     void StaticMeshRenderable::createOnGPU(const MeshInstancePtr& mshInst, const GDevicePtr& dev, AssetManagerPtr& mng)
@@ -309,19 +581,44 @@ namespace EProject
 
         m_meshPtr = mshInst;
 
-        // create mesh gpu textures
+        // create material table and draw list
 
-        const auto modelsDir = PathHandler::getModelsDir();
         const auto& mshData = m_meshPtr->getMeshData();
-        
-        for (const auto& data : mshData)
+
+        uploadTextures(mshInst, dev, mng);
+
+        std::unordered_map<uint32_t, uint32_t> materialSlots;
+
+        m_materials.clear();
+        m_drawList.clear();
+        m_drawList.reserve(mshData.size());
+
+        for (size_t i = 0; i < mshData.size(); ++i)
         {
-            const auto& mat = data.getMaterial();
-            m_albedoTex = setupTexture(dev, mng, PathKey(modelsDir / m_modelName / mat.albedo_map));
-            m_normalTex = setupTexture(dev, mng, PathKey(modelsDir / m_modelName / mat.normal_map));
-            m_metallRoghnessTex = setupTexture(dev, mng, PathKey(modelsDir / m_modelName / mat.roughness_map));
+            const auto& data = mshData[i];
+
+            auto slot = materialSlots.find(data.materialId);
+            if (slot == materialSlots.end())
+            {
+                slot = materialSlots.insert({ data.materialId, static_cast<uint32_t>(m_materials.size()) }).first;
+                m_materials.push_back(getMaterialGPU(data.getMaterial()));
+            }
+
+            SubmeshDraw draw = {};
+            draw.material = slot->second;
+            draw.meshData = static_cast<uint32_t>(i);
+            draw.startIndex = data.startIndex;
+            draw.indexCount = static_cast<uint32_t>(data.getIndicesCount());
+            draw.baseVertex = static_cast<int32_t>(data.startVertex);
+
+            m_drawList.push_back(draw);
         }
 
+        std::stable_sort(m_drawList.begin(), m_drawList.end(), [](const SubmeshDraw& a, const SubmeshDraw& b)
+        {
+            return a.material < b.material;
+        });
+
         // create gpu buffers
 
         const auto* layout = MeshVertex::getLayout();
@@ -349,4 +646,70 @@ namespace EProject
             startIndex += numIndices;
         }
     }
+
+    bool StaticMeshRenderable::reloadFile(const std::filesystem::path& file, const std::shared_ptr<IAsset>& asset, const GDevicePtr& dev, AssetManagerPtr& mng)
+    {
+        if (!m_meshPtr)
+        {
+            return false;
+        }
+
+        const auto changed = file.lexically_normal();
+
+        if (m_meshPtr->getPath().lexically_normal() == changed)
+        {
+            auto mesh = std::dynamic_pointer_cast<MeshInstance>(asset);
+            if (!mesh)
+            {
+                return false;
+            }
+
+            // Materials may point at other files now
+            m_textures.clear();
+            createOnGPU(mesh, dev, mng);
+            return true;
+        }
+
+        const auto uses = [&](const std::filesystem::path& map)
+        {
+            return !map.empty() && (PathHandler::getModelsDir() / m_modelName / map).lexically_normal() == changed;
+        };
+
+        bool used = false;
+
+        for (const auto& data : m_meshPtr->getMeshData())
+        {
+            const auto& mat = data.getMaterial();
+
+            for (const auto* map : { &mat.albedo_map, &mat.normal_map })
+            {
+                if (uses(*map))
+                {
+                    m_textures.erase(getTextureKey(*map));
+                    used = true;
+                }
+            }
+
+            if (uses(mat.roughness_map) || uses(mat.metallic_map))
+            {
+                m_textures.erase(getTextureKey(mat.roughness_map, mat.metallic_map));
+                used = true;
+            }
+        }
+
+        if (!used)
+        {
+            return false;
+        }
+
+        // Everything still in m_textures is skipped, the cache hands out the reloaded file
+        uploadTextures(m_meshPtr, dev, mng);
+
+        for (auto& draw : m_drawList)
+        {
+            m_materials[draw.material] = getMaterialGPU(m_meshPtr->getMeshData()[draw.meshData].getMaterial());
+        }
+
+        return true;
+    }
 }
@@ -0,0 +1,93 @@
+#include "graphics/emesh.h"
+
+namespace EProject
+{
+    size_t Mesh::getIndicesCount() const
+    {
+        return indices.size();
+    }
+    
+    size_t Mesh::getMaterialsCount() const
+    {
+        return materials.size();
+    }
+
+    void Mesh::addIndex(int32_t index)
+    {
+        indices.push_back(index);
+    }
+
+    void Mesh::addMaterial(const Material& mat)
+    {
+        materials.push_back(mat);
+    }
+
+    void Mesh::setIndices(std::vector<int32_t>&& mshIndices)
+    {
+        indices = std::move(mshIndices);
+    }
+
+    void Mesh::setName(const std::string& mshName)
+    {
+        name = mshName;
+    }
+    
+    const std::string& Mesh::getName() const
+    {
+        return name;
+    }
+
+    const AABB& Mesh::getAABB() const
+    {
+        return bbox;
+    }
+
+    size_t MeshData::getVertexCount() const
+    {
+        return vertices.size();
+    }
+
+    void MeshData::addVertex(const MeshVertex& mshVertex)
+    {
+        vertices.push_back(mshVertex);
+    }
+
+    void MeshData::setVertices(std::vector<MeshVertex>&& mshVertices)
+    {
+        vertices = std::move(mshVertices);
+    }
+
+    void MeshData::reserve(size_t numVertices, size_t numIndices)
+    {
+        vertices.reserve(numVertices);
+        indices.reserve(numIndices);
+    }
+    
+    const AABB& MeshData::calculateAABB()
+    {
+        for (const auto& vert : vertices)
+        {
+            bbox += vert.pos;
+        }  
+
+        return bbox;
+    }
+
+    size_t MeshData::getMemoryUsage() const
+    {
+        return vertices.capacity() * sizeof(MeshVertex) + indices.capacity() * sizeof(int32_t) + meshlets.capacity() * sizeof(Meshlet);
+    }
+
+    void MeshData::buildMeshlets()
+    {
+        meshlets = MeshletBuilder::build(*this);
+    }
+
+    const Material& MeshData::getMaterial() const
+    {
+        // Each submesh keeps a copy of its own material, materialId is the index in the source file
+        assert(materialId != static_cast<uint32_t>(-1) && !materials.empty());
+
+        return materials.front();
+    }
+}
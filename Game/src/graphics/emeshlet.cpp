@@ -0,0 +1,365 @@
+#include "graphics/emeshlet.h"
+#include "graphics/emesh.h"
+
+namespace EProject
+{
+    std::vector<Meshlet> MeshletBuilder::build(MeshData& msh, size_t maxVertices, size_t maxTriangles)
+    {
+        assert(maxVertices >= 3 && maxTriangles >= 1);
+
+        constexpr uint32_t cNoTriangle = ~0u;
+
+        std::vector<Meshlet> result;
+
+        const int32_t* indices = msh.getIndexData();
+        const MeshVertex* vertices = msh.getVertexData();
+        const size_t indexCount = msh.getIndicesCount() - msh.getIndicesCount() % 3;
+        const size_t triangleCount = indexCount / 3;
+        const size_t vertexCount = msh.getVertexCount();
+
+        if (triangleCount == 0)
+        {
+            return result;
+        }
+
+        // Triangles around every vertex
+        std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            adjacencyOffsets[indices[i] + 1]++;
+        }
+
+        for (size_t v = 0; v < vertexCount; ++v)
+        {
+            adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+        }
+
+        std::vector<uint32_t> adjacency(indexCount);
+        std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+        for (size_t i = 0; i < indexCount; ++i)
+        {
+            adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<glm::vec3> centroids(triangleCount);
+        for (size_t t = 0; t < triangleCount; ++t)
+        {
+            centroids[t] = (vertices[indices[t * 3]].pos + vertices[indices[t * 3 + 1]].pos + vertices[indices[t * 3 + 2]].pos) / 3.0f;
+        }
+
+        result.reserve(triangleCount / maxTriangles + 1);
+
+        std::vector<int32_t> ordered;
+        ordered.reserve(msh.getIndicesCount());
+
+        std::vector<uint8_t> emitted(triangleCount, 0);
+        std::vector<uint8_t> used(vertexCount, 0);
+        std::vector<int32_t> local;
+        local.reserve(maxVertices);
+
+        // Unemitted triangles sharing a vertex with the current meshlet, stamped to be listed once
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> stamps(triangleCount, 0);
+        uint32_t stamp = 1;
+
+        Meshlet current = {};
+        glm::vec3 centroidSum = { 0, 0, 0 };
+        size_t seedCursor = 0;
+
+        auto newVertices = [&](uint32_t t)
+        {
+            const int32_t a = indices[t * 3 + 0];
+            const int32_t b = indices[t * 3 + 1];
+            const int32_t c = indices[t * 3 + 2];
+
+            return size_t((used[a] ? 0 : 1) + ((used[b] || b == a) ? 0 : 1) + ((used[c] || c == a || c == b) ? 0 : 1));
+        };
+
+        auto center = [&]()
+        {
+            return current.indexCount ? centroidSum / float(current.indexCount / 3) : centroidSum;
+        };
+
+        // The candidate that fits and adds the fewest vertices, ties go to the one nearest around
+        auto pick = [&](const glm::vec3& around)
+        {
+            uint32_t best = cNoTriangle;
+            size_t bestNew = maxVertices + 1;
+            float bestDist = std::numeric_limits<float>::max();
+
+            size_t kept = 0;
+            for (uint32_t t : candidates)
+            {
+                if (emitted[t])
+                {
+                    continue;
+                }
+
+                candidates[kept++] = t;
+
+                const size_t n = newVertices(t);
+                if (local.size() + n > maxVertices)
+                {
+                    continue;
+                }
+
+                const glm::vec3 d = centroids[t] - around;
+                const float dist = glm::dot(d, d);
+
+                if (n < bestNew || (n == bestNew && dist < bestDist))
+                {
+                    best = t;
+                    bestNew = n;
+                    bestDist = dist;
+                }
+            }
+
+            candidates.resize(kept);
+
+            return best;
+        };
+
+        auto flush = [&]()
+        {
+            if (current.indexCount == 0)
+            {
+                return;
+            }
+
+            current.vertexCount = static_cast<uint32_t>(local.size());
+            result.push_back(current);
+
+            for (int32_t v : local)
+            {
+                used[v] = 0;
+            }
+
+            local.clear();
+            current = {};
+            centroidSum = { 0, 0, 0 };
+        };
+
+        for (size_t taken = 0; taken < triangleCount; ++taken)
+        {
+            uint32_t next = current.indexCount / 3 < maxTriangles ? pick(center()) : cNoTriangle;
+
+            if (next == cNoTriangle)
+            {
+                // The next meshlet starts on the frontier of the full one, next to its center. A
+                // frontier with nothing left goes on with the first triangle not taken yet.
+                const glm::vec3 last = center();
+                flush();
+
+                next = pick(last);
+                candidates.clear();
+                ++stamp;
+
+                if (next == cNoTriangle)
+                {
+                    while (emitted[seedCursor])
+                    {
+                        ++seedCursor;
+                    }
+
+                    next = static_cast<uint32_t>(seedCursor);
+                }
+            }
+
+            emitted[next] = 1;
+
+            if (current.indexCount == 0)
+            {
+                current.startIndex = static_cast<uint32_t>(ordered.size());
+            }
+
+            for (size_t k = 0; k < 3; ++k)
+            {
+                const int32_t v = indices[next * 3 + k];
+                ordered.push_back(v);
+
+                if (used[v])
+                {
+                    continue;
+                }
+
+                used[v] = 1;
+                local.push_back(v);
+
+                for (uint32_t a = adjacencyOffsets[v]; a < adjacencyOffsets[v + 1]; ++a)
+                {
+                    const uint32_t t = adjacency[a];
+                    if (!emitted[t] && stamps[t] != stamp)
+                    {
+                        stamps[t] = stamp;
+                        candidates.push_back(t);
+                    }
+                }
+            }
+
+            current.indexCount += 3;
+            centroidSum += centroids[next];
+        }
+
+        flush();
+
+        // A trailing partial triangle stays where it was
+        ordered.insert(ordered.end(), indices + indexCount, indices + msh.getIndicesCount());
+        msh.setIndices(std::move(ordered));
+
+        for (auto& meshlet : result)
+        {
+            computeBounds(msh, meshlet);
+        }
+
+        return result;
+    }
+
+    void MeshletBuilder::computeBounds(const MeshData& msh, Meshlet& meshlet)
+    {
+        const MeshVertex* vertices = msh.getVertexData();
+        const int32_t* indices = msh.getIndexData() + meshlet.startIndex;
+
+        AABB box = {};
+        for (uint32_t i = 0; i < meshlet.indexCount; ++i)
+        {
+            box += vertices[indices[i]].pos;
+        }
+
+        meshlet.center = box.getCenter();
+        meshlet.radius = 0.0f;
+
+        for (uint32_t i = 0; i < meshlet.indexCount; ++i)
+        {
+            meshlet.radius = glm::max(meshlet.radius, glm::distance(meshlet.center, vertices[indices[i]].pos));
+        }
+
+        // Face normals are oriented by the vertex normals, so the cone does not depend on the winding convention
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.indexCount / 3);
+
+        glm::vec3 axis = { 0, 0, 0 };
+
+        for (uint32_t i = 0; i < meshlet.indexCount; i += 3)
+        {
+            const MeshVertex& v0 = vertices[indices[i + 0]];
+            const MeshVertex& v1 = vertices[indices[i + 1]];
+            const MeshVertex& v2 = vertices[indices[i + 2]];
+
+            glm::vec3 n = glm::cross(v1.pos - v0.pos, v2.pos - v0.pos);
+            const float len = glm::length(n);
+
+            if (len <= std::numeric_limits<float>::epsilon())
+            {
+                continue;
+            }
+
+            n /= len;
+
+            if (glm::dot(n, v0.normal + v1.normal + v2.normal) < 0.0f)
+            {
+                n = -n;
+            }
+
+            normals.push_back(n);
+            axis += n;
+        }
+
+        meshlet.coneAxis = { 0, 0, 1 };
+        meshlet.coneCutoff = 1.0f;
+
+        const float axisLen = glm::length(axis);
+        if (normals.empty() || axisLen <= std::numeric_limits<float>::epsilon())
+        {
+            return;
+        }
+
+        axis /= axisLen;
+
+        float minDot = 1.0f;
+        for (const auto& n : normals)
+        {
+            minDot = glm::min(minDot, glm::dot(axis, n));
+        }
+
+        meshlet.coneAxis = axis;
+
+        // Cones wider than ~85 degrees are never culled, keep cutoff at 1
+        if (minDot > 0.1f)
+        {
+            meshlet.coneCutoff = glm::sqrt(1.0f - minDot * minDot);
+        }
+    }
+
+    void ClusterCuller::setView(const glm::mat4& viewProj, const glm::mat4& model, const glm::vec3& camPos, bool coneCulling)
+    {
+        m_frustum = Frustum::fromMatrix(viewProj * model);
+        m_camPos = glm::vec3(glm::inverse(model) * glm::vec4(camPos, 1.0f));
+        m_coneCulling = coneCulling;
+    }
+
+    void ClusterCuller::cull(const MeshData& msh, std::vector<DrawIndexedCmd>& out)
+    {
+        const auto& meshlets = msh.getMeshlets();
+        const int32_t baseVertex = static_cast<int32_t>(msh.startVertex);
+
+        if (meshlets.empty())
+        {
+            emitRange(msh.startIndex, static_cast<uint32_t>(msh.getIndicesCount()), baseVertex, out);
+            return;
+        }
+
+        m_stats.meshlets += meshlets.size();
+
+        for (const auto& meshlet : meshlets)
+        {
+            if (!m_frustum.intersects(meshlet.center, meshlet.radius))
+            {
+                ++m_stats.frustumCulled;
+                continue;
+            }
+
+            if (m_coneCulling && isBackfacing(meshlet))
+            {
+                ++m_stats.coneCulled;
+                continue;
+            }
+
+            ++m_stats.visible;
+            emitRange(msh.startIndex + meshlet.startIndex, meshlet.indexCount, baseVertex, out);
+        }
+    }
+
+    bool ClusterCuller::isBackfacing(const Meshlet& meshlet) const
+    {
+        const glm::vec3 toCenter = meshlet.center - m_camPos;
+        return glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius;
+    }
+
+    void ClusterCuller::emitRange(uint32_t startIndex, uint32_t indexCount, int32_t baseVertex, std::vector<DrawIndexedCmd>& out)
+    {
+        if (indexCount == 0)
+        {
+            return;
+        }
+
+        if (!out.empty())
+        {
+            auto& last = out.back();
+            if (last.baseVertex == baseVertex && last.startIndex + last.indexCount == startIndex)
+            {
+                last.indexCount += indexCount;
+                return;
+            }
+        }
+
+        DrawIndexedCmd cmd = {};
+        cmd.indexCount = indexCount;
+        cmd.instanceCount = 0;
+        cmd.startIndex = startIndex;
+        cmd.baseVertex = baseVertex;
+        cmd.baseInstance = 0;
+
+        out.push_back(cmd);
+        ++m_stats.ranges;
+    }
+}
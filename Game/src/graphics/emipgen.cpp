@@ -0,0 +1,416 @@
+#include "graphics/emipgen.h"
+#include "utils/ejobsystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define EPROJECT_MIP_SSE
+#endif
+
+namespace EProject
+{
+    namespace
+    {
+        constexpr float cPi = 3.14159265358979f;
+
+        struct FloatImage
+        {
+            glm::ivec2 size = glm::ivec2(0);
+            std::vector<glm::vec4> pixels;
+        };
+
+        struct Tap
+        {
+            int index;
+            float weight;
+        };
+
+        // Taps of every output column (or row) of one pass
+        struct FilterTable
+        {
+            std::vector<size_t> offsets;
+            std::vector<Tap> taps;
+        };
+
+        struct ColorTables
+        {
+            static constexpr int cLinearSteps = 16384;
+
+            float toLinear[256];
+            uint8_t toSrgb[cLinearSteps + 1];
+
+            ColorTables()
+            {
+                for (int i = 0; i < 256; ++i)
+                {
+                    const float c = i / 255.0f;
+                    toLinear[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+                }
+
+                for (int i = 0; i <= cLinearSteps; ++i)
+                {
+                    const float l = static_cast<float>(i) / cLinearSteps;
+                    const float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                    toSrgb[i] = static_cast<uint8_t>(glm::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+                }
+            }
+        };
+
+        const ColorTables& getColorTables()
+        {
+            static const ColorTables tables;
+            return tables;
+        }
+
+        float sinc(float x)
+        {
+            if (std::abs(x) < 1e-5f)
+            {
+                return 1.0f;
+            }
+
+            x *= cPi;
+            return std::sin(x) / x;
+        }
+
+        // Zeroth order modified Bessel function of the first kind
+        float bessel0(float x)
+        {
+            const float q = x * x * 0.25f;
+
+            float sum = 1.0f;
+            float term = 1.0f;
+
+            for (int k = 1; k < 32 && term > sum * 1e-7f; ++k)
+            {
+                term *= q / static_cast<float>(k * k);
+                sum += term;
+            }
+
+            return sum;
+        }
+
+        float getRadius(MipFilter filter)
+        {
+            switch (filter)
+            {
+            case MipFilter::Box: return 0.5f;
+            default: return 3.0f;
+            }
+        }
+
+        float evalKernel(MipFilter filter, float x)
+        {
+            switch (filter)
+            {
+            case MipFilter::Box:
+                return (x >= -0.5f && x < 0.5f) ? 1.0f : 0.0f;
+            case MipFilter::Kaiser:
+            {
+                // Windowed sinc, width 3 and alpha 4
+                const float t = x / 3.0f;
+                return t * t < 1.0f ? sinc(x) * bessel0(4.0f * std::sqrt(1.0f - t * t)) / bessel0(4.0f) : 0.0f;
+            }
+            case MipFilter::Lanczos:
+                return std::abs(x) < 3.0f ? sinc(x) * sinc(x / 3.0f) : 0.0f;
+            }
+
+            return 0.0f;
+        }
+
+        FilterTable buildTable(int srcSize, int dstSize, const MipSettings& settings)
+        {
+            FilterTable table;
+            table.offsets.reserve(dstSize + 1);
+
+            const float scale = static_cast<float>(srcSize) / dstSize;
+            const float radius = getRadius(settings.filter) * scale;
+
+            for (int x = 0; x < dstSize; ++x)
+            {
+                table.offsets.push_back(table.taps.size());
+
+                const float center = (x + 0.5f) * scale;
+                const int first = static_cast<int>(std::floor(center - radius));
+                const int last = static_cast<int>(std::ceil(center + radius));
+
+                float sum = 0.0f;
+
+                for (int i = first; i <= last; ++i)
+                {
+                    const float w = evalKernel(settings.filter, (i + 0.5f - center) / scale);
+                    if (w == 0.0f)
+                    {
+                        continue;
+                    }
+
+                    int index = i;
+                    if (settings.wrap)
+                    {
+                        index = ((i % srcSize) + srcSize) % srcSize;
+                    }
+                    else
+                    {
+                        index = glm::clamp(i, 0, srcSize - 1);
+                    }
+
+                    table.taps.push_back({ index, w });
+                    sum += w;
+                }
+
+                for (size_t t = table.offsets.back(); t < table.taps.size(); ++t)
+                {
+                    table.taps[t].weight /= sum;
+                }
+            }
+
+            table.offsets.push_back(table.taps.size());
+
+            return table;
+        }
+
+        // acc += v * w on all four channels
+        inline void madd(glm::vec4& acc, const glm::vec4& v, float w)
+        {
+#ifdef EPROJECT_MIP_SSE
+            _mm_storeu_ps(&acc.x, _mm_add_ps(_mm_loadu_ps(&acc.x), _mm_mul_ps(_mm_loadu_ps(&v.x), _mm_set1_ps(w))));
+#else
+            acc += v * w;
+#endif
+        }
+
+        void downsample(const FloatImage& src, FloatImage& dst, const MipSettings& settings)
+        {
+            dst.size = glm::max(src.size / 2, glm::ivec2(1));
+            dst.pixels.resize(static_cast<size_t>(dst.size.x) * dst.size.y);
+
+            const auto hTable = buildTable(src.size.x, dst.size.x, settings);
+            const auto vTable = buildTable(src.size.y, dst.size.y, settings);
+
+            // Horizontal pass, every source row shrinks to the target width
+            std::vector<glm::vec4> tmp(static_cast<size_t>(dst.size.x) * src.size.y);
+
+            getJobSystem()->parallelFor(static_cast<size_t>(src.size.y), [&](size_t y)
+            {
+                const glm::vec4* in = &src.pixels[y * src.size.x];
+                glm::vec4* out = &tmp[y * dst.size.x];
+
+                for (int x = 0; x < dst.size.x; ++x)
+                {
+                    glm::vec4 acc(0.0f);
+
+                    for (size_t t = hTable.offsets[x]; t < hTable.offsets[x + 1]; ++t)
+                    {
+                        madd(acc, in[hTable.taps[t].index], hTable.taps[t].weight);
+                    }
+
+                    out[x] = acc;
+                }
+            });
+
+            // Vertical pass adds whole weighted rows, so memory is read in order
+            getJobSystem()->parallelFor(static_cast<size_t>(dst.size.y), [&](size_t y)
+            {
+                glm::vec4* out = &dst.pixels[y * dst.size.x];
+                std::fill(out, out + dst.size.x, glm::vec4(0.0f));
+
+                for (size_t t = vTable.offsets[y]; t < vTable.offsets[y + 1]; ++t)
+                {
+                    const glm::vec4* in = &tmp[static_cast<size_t>(vTable.taps[t].index) * dst.size.x];
+                    const float w = vTable.taps[t].weight;
+
+                    for (int x = 0; x < dst.size.x; ++x)
+                    {
+                        madd(out[x], in[x], w);
+                    }
+                }
+            });
+        }
+
+        void toFloat(const uint8_t* rgba, glm::ivec2 size, bool srgb, FloatImage& out)
+        {
+            const auto& tables = getColorTables();
+
+            out.size = size;
+            out.pixels.resize(static_cast<size_t>(size.x) * size.y);
+
+            getJobSystem()->parallelFor(static_cast<size_t>(size.y), [&](size_t y)
+            {
+                const uint8_t* in = rgba + y * size.x * 4;
+                glm::vec4* px = &out.pixels[y * size.x];
+
+                for (int x = 0; x < size.x; ++x, in += 4)
+                {
+                    if (srgb)
+                    {
+                        px[x] = glm::vec4(tables.toLinear[in[0]], tables.toLinear[in[1]], tables.toLinear[in[2]], in[3] / 255.0f);
+                    }
+                    else
+                    {
+                        px[x] = glm::vec4(in[0], in[1], in[2], in[3]) / 255.0f;
+                    }
+                }
+            });
+        }
+
+        void toBytes(const FloatImage& img, bool srgb, float alphaScale, uint8_t* rgba)
+        {
+            const auto& tables = getColorTables();
+
+            getJobSystem()->parallelFor(static_cast<size_t>(img.size.y), [&](size_t y)
+            {
+                const glm::vec4* px = &img.pixels[y * img.size.x];
+                uint8_t* out = rgba + y * img.size.x * 4;
+
+                for (int x = 0; x < img.size.x; ++x, out += 4)
+                {
+                    const glm::vec4 v = glm::clamp(px[x] * glm::vec4(1.0f, 1.0f, 1.0f, alphaScale), 0.0f, 1.0f);
+
+                    for (int c = 0; c < 3; ++c)
+                    {
+                        out[c] = srgb ? tables.toSrgb[static_cast<int>(v[c] * ColorTables::cLinearSteps + 0.5f)] : static_cast<uint8_t>(v[c] * 255.0f + 0.5f);
+                    }
+
+                    out[3] = static_cast<uint8_t>(v.w * 255.0f + 0.5f);
+                }
+            });
+        }
+
+        void renormalize(FloatImage& img)
+        {
+            getJobSystem()->parallelFor(static_cast<size_t>(img.size.y), [&](size_t y)
+            {
+                glm::vec4* px = &img.pixels[y * img.size.x];
+
+                for (int x = 0; x < img.size.x; ++x)
+                {
+                    glm::vec3 n = glm::vec3(px[x]) * 2.0f - 1.0f;
+
+                    const float len = glm::length(n);
+                    n = len > 1e-6f ? n / len : glm::vec3(0.0f, 0.0f, 1.0f);
+
+                    px[x] = glm::vec4(n * 0.5f + 0.5f, px[x].w);
+                }
+            });
+        }
+
+        float computeCoverage(const FloatImage& img, float cutoff, float scale)
+        {
+            size_t covered = 0;
+            for (const auto& px : img.pixels)
+            {
+                covered += px.w * scale > cutoff ? 1 : 0;
+            }
+
+            return static_cast<float>(covered) / img.pixels.size();
+        }
+
+        // Coverage only grows with the scale, so bisect for the one matching the top level
+        float findAlphaScale(const FloatImage& img, float cutoff, float coverage)
+        {
+            float lo = 0.0f;
+            float hi = 4.0f;
+
+            for (int it = 0; it < 12; ++it)
+            {
+                const float mid = (lo + hi) * 0.5f;
+
+                if (computeCoverage(img, cutoff, mid) < coverage)
+                {
+                    lo = mid;
+                }
+                else
+                {
+                    hi = mid;
+                }
+            }
+
+            return (lo + hi) * 0.5f;
+        }
+    }
+
+    int MipGenerator::getLevelCount(glm::ivec2 size)
+    {
+        int levels = 1;
+        for (int s = glm::max(size.x, size.y); s > 1; s >>= 1)
+        {
+            ++levels;
+        }
+
+        return levels;
+    }
+
+    MipChain MipGenerator::generate(const MipSource& src)
+    {
+        const auto& settings = src.settings;
+
+        int levels = getLevelCount(src.size);
+        if (settings.maxLevels > 0)
+        {
+            levels = glm::min(levels, settings.maxLevels);
+        }
+
+        MipChain chain;
+
+        glm::ivec2 size = src.size;
+        size_t total = 0;
+
+        for (int level = 0; level < levels; ++level)
+        {
+            chain.sizes.push_back(size);
+            chain.offsets.push_back(total);
+
+            total += static_cast<size_t>(size.x) * size.y * 4;
+            size = glm::max(size / 2, glm::ivec2(1));
+        }
+
+        chain.data.resize(total);
+        std::memcpy(chain.data.data(), src.rgba, chain.getLevelSize(0));
+
+        if (levels == 1)
+        {
+            return chain;
+        }
+
+        // Normal maps hold vectors, not colours
+        const bool srgb = settings.srgb && !settings.normalMap;
+
+        FloatImage current;
+        toFloat(src.rgba, src.size, srgb, current);
+
+        const float coverage = settings.alphaCutoff > 0.0f ? computeCoverage(current, settings.alphaCutoff, 1.0f) : 1.0f;
+
+        for (int level = 1; level < levels; ++level)
+        {
+            FloatImage next;
+            downsample(current, next, settings);
+
+            if (settings.normalMap)
+            {
+                renormalize(next);
+            }
+
+            const float alphaScale = coverage > 0.0f && coverage < 1.0f ? findAlphaScale(next, settings.alphaCutoff, coverage) : 1.0f;
+            toBytes(next, srgb, alphaScale, chain.data.data() + chain.offsets[level]);
+
+            current = std::move(next);
+        }
+
+        return chain;
+    }
+
+    std::vector<MipChain> MipGenerator::generateBatch(const std::vector<MipSource>& sources)
+    {
+        std::vector<MipChain> result(sources.size());
+
+        getJobSystem()->parallelFor(sources.size(), [&](size_t i)
+        {
+            result[i] = generate(sources[i]);
+        });
+
+        return result;
+    }
+}
@@ -0,0 +1,331 @@
+#include "graphics/erenderqueue.h"
+
+#include <cassert>
+
+namespace EProject
+{
+    void radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch, std::vector<uint32_t>& histograms)
+    {
+        constexpr int cBits = 11;
+        constexpr uint32_t cBuckets = 1u << cBits;
+        constexpr uint64_t cMask = cBuckets - 1;
+        constexpr int cPasses = (64 + cBits - 1) / cBits;
+        static_assert(cPasses == 6, "histograms below are unrolled for 6 passes");
+
+        const size_t count = items.size();
+        if (count < 2)
+        {
+            return;
+        }
+
+        histograms.assign(cPasses * cBuckets, 0);
+        uint32_t* h = histograms.data();
+
+        const uint64_t first = items[0].key;
+        uint64_t varying = 0;
+
+        for (const SortItem& item : items)
+        {
+            const uint64_t k = item.key;
+            varying |= k ^ first;
+
+            h[k & cMask]++;
+            h[cBuckets + ((k >> 11) & cMask)]++;
+            h[cBuckets * 2 + ((k >> 22) & cMask)]++;
+            h[cBuckets * 3 + ((k >> 33) & cMask)]++;
+            h[cBuckets * 4 + ((k >> 44) & cMask)]++;
+            h[cBuckets * 5 + (k >> 55)]++;
+        }
+
+        scratch.resize(count);
+        SortItem* src = items.data();
+        SortItem* dst = scratch.data();
+
+        for (int p = 0; p < cPasses; p++)
+        {
+            const int shift = p * cBits;
+            if (((varying >> shift) & cMask) == 0)
+            {
+                continue;
+            }
+
+            uint32_t* histogram = &histograms[p * cBuckets];
+            uint32_t sum = 0;
+            for (uint32_t b = 0; b < cBuckets; b++)
+            {
+                const uint32_t n = histogram[b];
+                histogram[b] = sum;
+                sum += n;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                const SortItem item = src[i];
+                dst[histogram[(item.key >> shift) & cMask]++] = item;
+            }
+
+            std::swap(src, dst);
+        }
+
+        if (src != items.data())
+        {
+            items.swap(scratch);
+        }
+    }
+
+    uint32_t SortKey::depth(float d)
+    {
+        uint32_t bits;
+        memcpy(&bits, &d, sizeof(bits));
+        return (bits & 0x80000000u) ? ~bits : bits | 0x80000000u;
+    }
+
+    uint64_t SortKey::opaque(uint32_t layer, uint32_t pass, uint32_t program, uint32_t material, float d)
+    {
+        assert(layer < cLayers && pass < cPasses);
+        return (uint64_t(layer) << 60) | (uint64_t(pass) << 56) |
+               (uint64_t(program & 0x7FF) << 44) | (uint64_t(material & 0x3FFFFF) << 22) |
+               (depth(d) >> 10);
+    }
+
+    uint64_t SortKey::blended(uint32_t layer, uint32_t pass, float d, uint32_t program, uint32_t material)
+    {
+        assert(layer < cLayers && pass < cPasses);
+        return (uint64_t(layer) << 60) | (uint64_t(pass) << 56) |
+               (uint64_t(~depth(d)) << 23) |
+               (uint64_t(program & 0x7FF) << 12) | uint64_t(material & 0xFFF);
+    }
+
+    RenderQueue::RenderQueue(JobSystem* jobs) : m_recorder(jobs)
+    {
+    }
+
+    void RenderQueue::setPassStates(uint32_t pass, const PassStates& states)
+    {
+        assert(pass < SortKey::cPasses);
+        m_passStates[pass] = states;
+    }
+
+    uint32_t RenderQueue::getProgramId(const ShaderProgram* program)
+    {
+        auto it = m_programIds.find(program);
+        if (it == m_programIds.end())
+        {
+            // Ids go into 11 bits of the opaque keys
+            assert(m_programIds.size() < 0x800);
+            it = m_programIds.emplace(program, uint32_t(m_programIds.size())).first;
+        }
+
+        return it->second;
+    }
+
+    uint32_t RenderQueue::addMaterial(const void* key, const ShaderResource* slots, const GPUTexture2DPtr* textures, int count)
+    {
+        assert(count <= cMaterialTextures);
+
+        auto it = m_materialIds.find(key);
+        if (it != m_materialIds.end())
+        {
+            return it->second;
+        }
+
+        MaterialData& mat = m_materials.emplace_back();
+        for (int i = 0; i < count; i++)
+        {
+            mat.slots[i] = slots[i];
+            mat.textures[i] = textures[i];
+        }
+        mat.count = count;
+
+        const uint32_t id = uint32_t(m_materials.size() - 1);
+        m_materialIds.emplace(key, id);
+        return id;
+    }
+
+    uint32_t RenderQueue::addGeometry(const VertexBufferPtr& vbo, const IndexBufferPtr& ibo)
+    {
+        auto it = m_geometryIds.find(vbo.get());
+        if (it != m_geometryIds.end() && m_geometry[it->second].ibo == ibo)
+        {
+            return it->second;
+        }
+
+        m_geometry.push_back({ vbo, ibo });
+
+        const uint32_t id = uint32_t(m_geometry.size() - 1);
+        m_geometryIds[vbo.get()] = id;
+        return id;
+    }
+
+    uint32_t RenderQueue::beginConstants()
+    {
+        m_constants.push_back({ uint32_t(m_values.size()), 0 });
+        return uint32_t(m_constants.size() - 1);
+    }
+
+    void RenderQueue::addValue(const ShaderValueHandle& h, const void* data, int size)
+    {
+        assert(!m_constants.empty());
+
+        m_values.push_back({ h, uint32_t(m_valueBytes.size()), size });
+
+        const auto* bytes = static_cast<const uint8_t*>(data);
+        m_valueBytes.insert(m_valueBytes.end(), bytes, bytes + size);
+    }
+
+    void RenderQueue::endConstants()
+    {
+        ConstantsData& block = m_constants.back();
+        block.count = uint32_t(m_values.size()) - block.first;
+    }
+
+    void RenderQueue::push(uint64_t key, const DrawPacket& packet)
+    {
+        assert(packet.program);
+
+        // Packets pushed back to back with one key (cluster draws of a mesh) sort as one item
+        if (!m_items.empty() && m_items.back().key == key)
+        {
+            m_runs.back().count++;
+        }
+        else
+        {
+            m_items.push_back({ key, uint32_t(m_runs.size()) });
+            m_runs.push_back({ uint32_t(m_packets.size()), 1 });
+        }
+
+        m_packets.push_back(packet);
+    }
+
+    void RenderQueue::submit(GDevice& device)
+    {
+        radixSort(m_items, m_scratch, m_histograms);
+
+        m_chunkStats.assign((m_items.size() + cItemsPerChunk - 1) / cItemsPerChunk, Stats());
+        m_recorder.record(m_items.size(), cItemsPerChunk, [this](size_t first, size_t last, CommandBuffer& cb)
+        {
+            recordItems(first, last, cb, m_chunkStats[first / cItemsPerChunk]);
+        });
+
+        m_stats = {};
+        m_stats.packets = uint32_t(m_packets.size());
+        m_stats.sortItems = uint32_t(m_items.size());
+
+        for (const Stats& chunk : m_chunkStats)
+        {
+            m_stats.drawCalls += chunk.drawCalls;
+            m_stats.instances += chunk.instances;
+            m_stats.programBinds += chunk.programBinds;
+            m_stats.materialBinds += chunk.materialBinds;
+            m_stats.geometryBinds += chunk.geometryBinds;
+            m_stats.constantBinds += chunk.constantBinds;
+            m_stats.stateChanges += chunk.stateChanges;
+        }
+
+        m_recorder.submit(device);
+        m_recorder.reset();
+        clear();
+    }
+
+    void RenderQueue::recordItems(size_t first, size_t last, CommandBuffer& cb, Stats& stats) const
+    {
+        ShaderProgram* program = nullptr;
+        uint32_t pass = cNone;
+        uint32_t material = cNone;
+        uint32_t geometry = cNone;
+        uint32_t constants = cNone;
+
+        for (size_t it = first; it < last; it++)
+        {
+            const SortItem& item = m_items[it];
+
+            const uint32_t itemPass = SortKey::pass(item.key);
+            if (itemPass != pass)
+            {
+                cb.setStates(m_passStates[itemPass]);
+                pass = itemPass;
+                ++stats.stateChanges;
+            }
+
+            const Run& run = m_runs[item.index];
+            for (uint32_t r = run.first; r < run.first + run.count; r++)
+            {
+                const DrawPacket& packet = m_packets[r];
+
+                // Bindings belong to the program, a new one starts from scratch
+                if (packet.program != program)
+                {
+                    program = packet.program;
+                    cb.setProgram(program);
+                    material = cNone;
+                    geometry = cNone;
+                    constants = cNone;
+                    ++stats.programBinds;
+                }
+
+                if (packet.material != material && packet.material != cNone)
+                {
+                    const MaterialData& mat = m_materials[packet.material];
+                    for (int i = 0; i < mat.count; i++)
+                    {
+                        cb.setResource(mat.slots[i], mat.textures[i]);
+                    }
+
+                    material = packet.material;
+                    ++stats.materialBinds;
+                }
+
+                if (packet.geometry != geometry && packet.geometry != cNone)
+                {
+                    const GeometryData& geom = m_geometry[packet.geometry];
+                    cb.setInputBuffers(geom.vbo, geom.ibo);
+
+                    geometry = packet.geometry;
+                    ++stats.geometryBinds;
+                }
+
+                if (packet.constants != constants && packet.constants != cNone)
+                {
+                    const ConstantsData& block = m_constants[packet.constants];
+                    for (uint32_t i = block.first; i < block.first + block.count; i++)
+                    {
+                        const ValueData& v = m_values[i];
+                        cb.writeValue(v.handle, &m_valueBytes[v.offset], v.size);
+                    }
+
+                    constants = packet.constants;
+                    ++stats.constantBinds;
+                }
+
+                if (packet.indexed)
+                {
+                    cb.drawIndexed(packet.topology, int(packet.first), int(packet.count), int(packet.instanceCount), packet.baseVertex);
+                }
+                else
+                {
+                    cb.draw(packet.topology, int(packet.first), int(packet.count), int(packet.instanceCount));
+                }
+
+                ++stats.drawCalls;
+                stats.instances += glm::max(packet.instanceCount, 1u);
+            }
+        }
+    }
+
+    void RenderQueue::clear()
+    {
+        m_items.clear();
+        m_runs.clear();
+        m_packets.clear();
+
+        m_programIds.clear();
+        m_materials.clear();
+        m_materialIds.clear();
+        m_geometry.clear();
+        m_geometryIds.clear();
+
+        m_values.clear();
+        m_valueBytes.clear();
+        m_constants.clear();
+    }
+}
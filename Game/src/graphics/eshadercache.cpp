@@ -0,0 +1,156 @@
+#include "graphics/eshadercache.h"
+#include "utils/efileutils.h"
+#include "utils/ehash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace EProject
+{
+    namespace fs = std::filesystem;
+
+    namespace
+    {
+        // Bump when the key or the entry layout changes
+        constexpr uint64_t cShaderCacheVersion = 1;
+
+        constexpr uint32_t cEntryMagic = 0x43425345; // "ESBC"
+
+        struct EntryHeader
+        {
+            uint32_t magic;
+            uint32_t size;
+            uint64_t key;
+            uint64_t checksum;
+        };
+    }
+
+    uint64_t computeShaderKey(const ShaderCompileDesc& desc, uint64_t compilerVersion)
+    {
+        EHash::Hasher64 hasher;
+        hasher.update(cShaderCacheVersion);
+        hasher.update(compilerVersion);
+        hasher.update(desc.entryPoint);
+        hasher.update(desc.target);
+        hasher.update(static_cast<uint64_t>(desc.flags));
+
+        hasher.update(static_cast<uint64_t>(desc.defines.size()));
+        for (const auto& [name, value] : desc.defines)
+        {
+            hasher.update(name).update(value);
+        }
+
+        const auto files = collectIncludes(desc.filePath);
+        const auto root = files.front().parent_path();
+
+        std::string text;
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (!readFile(files[i], text))
+            {
+                if (i == 0)
+                {
+                    return 0;
+                }
+
+                // A missing include fails the compile, but creating it has to change the key
+                hasher.update(~0ull);
+                continue;
+            }
+
+            // Relative names, moving the whole tree keeps the key
+            hasher.update(files[i].lexically_relative(root).generic_u8string());
+            hasher.update(text);
+        }
+
+        return hasher.finish();
+    }
+
+    ShaderCache::ShaderCache(const fs::path& root, uint64_t compilerVersion, CompileFunc compile) :
+        m_cache(root),
+        m_compilerVersion(compilerVersion),
+        m_compile(std::move(compile))
+    {
+    }
+
+    uint64_t ShaderCache::computeKey(const ShaderCompileDesc& desc) const
+    {
+        return computeShaderKey(desc, m_compilerVersion);
+    }
+
+    bool ShaderCache::get(const ShaderCompileDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors)
+    {
+        const uint64_t key = computeKey(desc);
+        if (key && read(key, bytecode))
+        {
+            m_hits++;
+            return true;
+        }
+
+        bytecode.clear();
+        if (!m_compile(desc, bytecode, errors))
+        {
+            m_failed++;
+            return false;
+        }
+
+        m_compiled++;
+        if (key)
+        {
+            write(key, bytecode);
+        }
+
+        return true;
+    }
+
+    ShaderCache::Stats ShaderCache::getStats() const
+    {
+        Stats s;
+        s.hits = m_hits;
+        s.compiled = m_compiled;
+        s.corrupt = m_corrupt;
+        s.failed = m_failed;
+        return s;
+    }
+
+    bool ShaderCache::read(uint64_t key, std::vector<uint8_t>& bytecode)
+    {
+        std::vector<uint8_t> data;
+        if (!m_cache.load(key, data))
+        {
+            return false;
+        }
+
+        EntryHeader header = {};
+        if (data.size() >= sizeof(header))
+        {
+            memcpy(&header, data.data(), sizeof(header));
+        }
+
+        const uint8_t* payload = data.data() + sizeof(header);
+        if (data.size() < sizeof(header) || header.magic != cEntryMagic || header.key != key || header.size != data.size() - sizeof(header) ||
+            header.checksum != EHash::hash64(payload, header.size))
+        {
+            m_corrupt++;
+            return false;
+        }
+
+        bytecode.assign(payload, payload + header.size);
+        return true;
+    }
+
+    void ShaderCache::write(uint64_t key, const std::vector<uint8_t>& bytecode) const
+    {
+        EntryHeader header = {};
+        header.magic = cEntryMagic;
+        header.size = static_cast<uint32_t>(bytecode.size());
+        header.key = key;
+        header.checksum = EHash::hash64(bytecode.data(), bytecode.size());
+
+        std::vector<uint8_t> data(sizeof(header) + bytecode.size());
+        memcpy(data.data(), &header, sizeof(header));
+        std::copy(bytecode.begin(), bytecode.end(), data.begin() + sizeof(header));
+
+        m_cache.store(key, data.data(), data.size());
+    }
+}
@@ -0,0 +1,197 @@
+#include "graphics/etexconvert.h"
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define EPROJECT_CONVERT_SSE
+#endif
+
+namespace EProject
+{
+    namespace
+    {
+        uint8_t mulUnorm8(uint32_t a, uint32_t b)
+        {
+            const uint32_t t = a * b + 128;
+            return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+        }
+
+        // Same steps as the SSE2 path below, one value at a time
+        uint16_t toHalf(float value)
+        {
+            uint32_t f = 0;
+            std::memcpy(&f, &value, sizeof(f));
+
+            const uint32_t sign = (f >> 16) & 0x8000;
+            f &= 0x7fffffff;
+
+            uint32_t h = 0;
+
+            if (f >= ((127 + 16) << 23))
+            {
+                h = f > 0x7f800000 ? 0x7e00 : 0x7c00;
+            }
+            else if (f < ((127 - 14) << 23))
+            {
+                // Subnormal, let the float adder do the rounding
+                const uint32_t magicBits = ((127 - 15) + (23 - 10) + 1) << 23;
+
+                float magic = 0.0f;
+                float abs = 0.0f;
+                std::memcpy(&magic, &magicBits, sizeof(magic));
+                std::memcpy(&abs, &f, sizeof(abs));
+
+                abs += magic;
+
+                std::memcpy(&h, &abs, sizeof(h));
+                h -= magicBits;
+            }
+            else
+            {
+                const uint32_t mantOdd = (f >> 13) & 1;
+                h = (f + (0xfff - ((127 - 15) << 23)) + mantOdd) >> 13;
+            }
+
+            return static_cast<uint16_t>(h | sign);
+        }
+    }
+
+    void TextureConvert::packChannels(const ChannelSource (&sources)[4], size_t pixels, uint8_t* out)
+    {
+        size_t i = 0;
+
+#ifdef EPROJECT_CONVERT_SSE
+        const __m128i mask = _mm_set1_epi32(0xff);
+
+        for (; i + 4 <= pixels; i += 4)
+        {
+            __m128i res = _mm_setzero_si128();
+
+            for (int c = 0; c < 4; ++c)
+            {
+                const auto& src = sources[c];
+
+                __m128i v;
+                if (src.rgba)
+                {
+                    v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src.rgba + i * 4));
+                    v = _mm_and_si128(_mm_srl_epi32(v, _mm_cvtsi32_si128(src.channel * 8)), mask);
+                }
+                else
+                {
+                    v = _mm_set1_epi32(src.fill);
+                }
+
+                res = _mm_or_si128(res, _mm_sll_epi32(v, _mm_cvtsi32_si128(c * 8)));
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), res);
+        }
+#endif
+        for (; i < pixels; ++i)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                const auto& src = sources[c];
+                out[i * 4 + c] = src.rgba ? src.rgba[i * 4 + src.channel] : src.fill;
+            }
+        }
+    }
+
+    void TextureConvert::premultiplyAlpha(uint8_t* rgba, size_t pixels)
+    {
+        size_t i = 0;
+
+#ifdef EPROJECT_CONVERT_SSE
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i bias = _mm_set1_epi16(128);
+
+        // Alpha lanes multiply by 255 and so keep their value
+        const __m128i keepAlpha = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+        const __m128i colorLanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+
+        const auto mul = [&](__m128i px)
+        {
+            __m128i a = _mm_shufflelo_epi16(px, _MM_SHUFFLE(3, 3, 3, 3));
+            a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+            a = _mm_or_si128(_mm_and_si128(a, colorLanes), keepAlpha);
+
+            const __m128i t = _mm_add_epi16(_mm_mullo_epi16(px, a), bias);
+            return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+        };
+
+        for (; i + 4 <= pixels; i += 4)
+        {
+            __m128i* ptr = reinterpret_cast<__m128i*>(rgba + i * 4);
+            const __m128i px = _mm_loadu_si128(ptr);
+
+            const __m128i lo = mul(_mm_unpacklo_epi8(px, zero));
+            const __m128i hi = mul(_mm_unpackhi_epi8(px, zero));
+
+            _mm_storeu_si128(ptr, _mm_packus_epi16(lo, hi));
+        }
+#endif
+        for (; i < pixels; ++i)
+        {
+            uint8_t* px = rgba + i * 4;
+
+            for (int c = 0; c < 3; ++c)
+            {
+                px[c] = mulUnorm8(px[c], px[3]);
+            }
+        }
+    }
+
+    void TextureConvert::floatToHalf(const float* in, size_t count, uint16_t* out)
+    {
+        size_t i = 0;
+
+#ifdef EPROJECT_CONVERT_SSE
+        const __m128i signMask = _mm_set1_epi32(0x80000000u);
+        const __m128i f16Max = _mm_set1_epi32((127 + 16) << 23);
+        const __m128i nanBit = _mm_set1_epi32(0x200);
+        const __m128i infinity = _mm_set1_epi32(0x7c00);
+        const __m128i minNormal = _mm_set1_epi32((127 - 14) << 23);
+        const __m128i subnormMagic = _mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23);
+        const __m128i normalBias = _mm_set1_epi32(0xfff - ((127 - 15) << 23));
+
+        for (; i + 8 <= count; i += 8)
+        {
+            __m128i halves[2];
+
+            for (int j = 0; j < 2; ++j)
+            {
+                const __m128 f = _mm_loadu_ps(in + i + j * 4);
+
+                const __m128 sign = _mm_and_ps(_mm_castsi128_ps(signMask), f);
+                const __m128 absF = _mm_xor_ps(f, sign);
+                const __m128i absI = _mm_castps_si128(absF);
+
+                const __m128i isNan = _mm_castps_si128(_mm_cmpunord_ps(absF, absF));
+                const __m128i isRegular = _mm_cmpgt_epi32(f16Max, absI);
+                const __m128i special = _mm_or_si128(_mm_and_si128(isNan, nanBit), infinity);
+
+                const __m128i isSubnormal = _mm_cmpgt_epi32(minNormal, absI);
+                const __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(absF, _mm_castsi128_ps(subnormMagic))), subnormMagic);
+
+                // Adding the odd mantissa bit makes ties round to even
+                const __m128i mantOdd = _mm_srai_epi32(_mm_slli_epi32(absI, 31 - 13), 31);
+                const __m128i normal = _mm_srli_epi32(_mm_sub_epi32(_mm_add_epi32(absI, normalBias), mantOdd), 13);
+
+                const __m128i finite = _mm_or_si128(_mm_and_si128(isSubnormal, subnormal), _mm_andnot_si128(isSubnormal, normal));
+                const __m128i joined = _mm_or_si128(_mm_and_si128(isRegular, finite), _mm_andnot_si128(isRegular, special));
+
+                // The sign lands in bit 15 and above, so the signed pack below keeps every value exact
+                halves[j] = _mm_or_si128(joined, _mm_srai_epi32(_mm_castps_si128(sign), 16));
+            }
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packs_epi32(halves[0], halves[1]));
+        }
+#endif
+        for (; i < count; ++i)
+        {
+            out[i] = toHalf(in[i]);
+        }
+    }
+}
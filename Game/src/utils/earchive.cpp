@@ -0,0 +1,326 @@
+#include "utils/earchive.h"
+#include "utils/ehash.h"
+#include "utils/ejobsystem.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <lz4.h>
+#include <lz4hc.h>
+
+namespace EProject
+{
+    namespace
+    {
+        std::string toLower(std::string str)
+        {
+            std::transform(str.begin(), str.end(), str.begin(), [](char c) { return static_cast<char>(::tolower(static_cast<unsigned char>(c))); });
+            return str;
+        }
+
+        uint64_t alignUp(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    bool Archive::open(const std::filesystem::path& path)
+    {
+        if (!m_file.open(path))
+        {
+            return false;
+        }
+
+        m_path = path;
+
+        const uint8_t* data = m_file.getData();
+        const size_t size = m_file.getSize();
+
+        Header header;
+        if (size < sizeof(Header))
+        {
+            throw std::runtime_error("Archive: Truncated file: " + path.u8string());
+        }
+
+        std::memcpy(&header, data, sizeof(Header));
+
+        if (header.magic != cMagic || header.version != cVersion)
+        {
+            throw std::runtime_error("Archive: Unsupported file: " + path.u8string());
+        }
+
+        if (header.tocOffset % alignof(Entry) != 0 || header.tocOffset + uint64_t(header.entryCount) * sizeof(Entry) > size ||
+            header.namesOffset + header.namesSize > size)
+        {
+            throw std::runtime_error("Archive: Broken table of contents: " + path.u8string());
+        }
+
+        m_toc = reinterpret_cast<const Entry*>(data + header.tocOffset);
+        m_entryCount = header.entryCount;
+        m_names = reinterpret_cast<const char*>(data + header.namesOffset);
+
+        for (size_t i = 0; i < m_entryCount; ++i)
+        {
+            const auto& entry = m_toc[i];
+            if (entry.offset + entry.storedSize > size || uint64_t(entry.nameOffset) + entry.nameSize > header.namesSize)
+            {
+                throw std::runtime_error("Archive: Broken entry in: " + path.u8string());
+            }
+        }
+
+        return true;
+    }
+
+    std::string Archive::getName(const Entry& entry) const
+    {
+        return std::string(m_names + entry.nameOffset, entry.nameSize);
+    }
+
+    const Archive::Entry* Archive::find(const std::string& name) const
+    {
+        const auto lowerName = toLower(name);
+        const uint64_t hash = hashName(lowerName);
+
+        auto it = std::lower_bound(m_toc, m_toc + m_entryCount, hash, [](const Entry& e, uint64_t h) { return e.hash < h; });
+
+        for (; it != m_toc + m_entryCount && it->hash == hash; ++it)
+        {
+            if (toLower(getName(*it)) == lowerName)
+            {
+                return it;
+            }
+        }
+
+        return nullptr;
+    }
+
+    const uint8_t* Archive::getView(const Entry& entry) const
+    {
+        return entry.blockSize == 0 ? m_file.getData() + entry.offset : nullptr;
+    }
+
+    bool Archive::read(const Entry& entry, std::vector<uint8_t>& out) const
+    {
+        const uint64_t fileSize = m_file.getSize();
+        if (entry.offset > fileSize || entry.storedSize > fileSize - entry.offset)
+        {
+            return false;
+        }
+
+        const uint8_t* stored = m_file.getData() + entry.offset;
+
+        if (entry.blockSize == 0)
+        {
+            if (entry.storedSize != entry.size)
+            {
+                return false;
+            }
+
+            out.resize(static_cast<size_t>(entry.size));
+            std::memcpy(out.data(), stored, out.size());
+            return true;
+        }
+
+        // The blocks have to add up to exactly the entry size
+        if (entry.blockSize > static_cast<uint32_t>(LZ4_MAX_INPUT_SIZE) || entry.blockCount != (entry.size + entry.blockSize - 1) / entry.blockSize ||
+            uint64_t(entry.blockCount) * sizeof(uint32_t) > entry.storedSize)
+        {
+            return false;
+        }
+
+        out.resize(static_cast<size_t>(entry.size));
+
+        // Block table: compressed size of every block, then the blocks back to back
+        std::vector<uint64_t> offsets(entry.blockCount + 1);
+        std::vector<uint8_t> raw(entry.blockCount);
+        offsets[0] = uint64_t(entry.blockCount) * sizeof(uint32_t);
+
+        for (uint32_t i = 0; i < entry.blockCount; ++i)
+        {
+            uint32_t blockSize;
+            std::memcpy(&blockSize, stored + i * sizeof(uint32_t), sizeof(uint32_t));
+            offsets[i + 1] = offsets[i] + (blockSize & ~cRawBlockFlag);
+            raw[i] = (blockSize & cRawBlockFlag) != 0;
+        }
+
+        if (offsets.back() > entry.storedSize)
+        {
+            return false;
+        }
+
+        std::atomic<bool> ok = true;
+
+        getJobSystem()->parallelFor(entry.blockCount, [&](size_t i)
+        {
+            const size_t dstOffset = i * entry.blockSize;
+            const int dstSize = static_cast<int>(std::min<uint64_t>(entry.blockSize, entry.size - dstOffset));
+            const int srcSize = static_cast<int>(offsets[i + 1] - offsets[i]);
+
+            const char* src = reinterpret_cast<const char*>(stored + offsets[i]);
+            char* dst = reinterpret_cast<char*>(out.data() + dstOffset);
+
+            if (raw[i])
+            {
+                if (srcSize != dstSize)
+                {
+                    ok = false;
+                    return;
+                }
+
+                std::memcpy(dst, src, dstSize);
+            }
+            else if (LZ4_decompress_safe(src, dst, srcSize, dstSize) != dstSize)
+            {
+                ok = false;
+            }
+        });
+
+        return ok;
+    }
+
+    uint64_t Archive::hashName(const std::string& name)
+    {
+        const auto lowerName = toLower(name);
+        return EHash::hash64(lowerName.data(), lowerName.size());
+    }
+
+    void ArchiveWriter::add(const std::string& name, std::vector<uint8_t>&& data, bool compress)
+    {
+        m_items.push_back({ name, std::move(data), compress });
+    }
+
+    void ArchiveWriter::write(const std::filesystem::path& path, const Options& options) const
+    {
+        struct Stored
+        {
+            std::vector<uint8_t> data;
+            uint32_t blockSize = 0;
+            uint32_t blockCount = 0;
+        };
+
+        std::vector<Stored> stored(m_items.size());
+
+        getJobSystem()->parallelFor(m_items.size(), [&](size_t idx)
+        {
+            const auto& item = m_items[idx];
+            if (!item.compress || item.data.empty())
+            {
+                return;
+            }
+
+            const size_t blockCount = (item.data.size() + options.blockSize - 1) / options.blockSize;
+
+            std::vector<uint8_t> res(blockCount * sizeof(uint32_t));
+            std::vector<char> block(LZ4_compressBound(static_cast<int>(options.blockSize)));
+
+            for (size_t i = 0; i < blockCount; ++i)
+            {
+                const size_t srcOffset = i * options.blockSize;
+                const int srcSize = static_cast<int>(std::min<size_t>(options.blockSize, item.data.size() - srcOffset));
+                const char* src = reinterpret_cast<const char*>(item.data.data() + srcOffset);
+
+                int size = LZ4_compress_HC(src, block.data(), srcSize, static_cast<int>(block.size()), LZ4HC_CLEVEL_DEFAULT);
+
+                uint32_t blockHeader = static_cast<uint32_t>(size);
+                if (size <= 0 || size >= srcSize)
+                {
+                    size = srcSize;
+                    blockHeader = static_cast<uint32_t>(srcSize) | Archive::cRawBlockFlag;
+                    std::memcpy(block.data(), src, srcSize);
+                }
+
+                std::memcpy(res.data() + i * sizeof(uint32_t), &blockHeader, sizeof(uint32_t));
+                res.insert(res.end(), block.data(), block.data() + size);
+            }
+
+            // Not worth a decode pass, keep it mappable
+            if (res.size() > item.data.size() * 9 / 10)
+            {
+                return;
+            }
+
+            stored[idx].data = std::move(res);
+            stored[idx].blockSize = options.blockSize;
+            stored[idx].blockCount = static_cast<uint32_t>(blockCount);
+        });
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            throw std::runtime_error("ArchiveWriter: Can't create file: " + path.u8string());
+        }
+
+        Archive::Header header;
+        header.entryCount = static_cast<uint32_t>(m_items.size());
+
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        uint64_t offset = sizeof(header);
+
+        auto pad = [&file, &offset](uint64_t alignment)
+        {
+            static const char zeros[4096] = {};
+
+            const uint64_t aligned = alignUp(offset, alignment);
+            for (uint64_t left = aligned - offset; left > 0;)
+            {
+                const auto chunk = std::min<uint64_t>(left, sizeof(zeros));
+                file.write(zeros, chunk);
+                left -= chunk;
+            }
+
+            offset = aligned;
+        };
+
+        std::vector<Archive::Entry> toc(m_items.size());
+        std::string names;
+
+        for (size_t i = 0; i < m_items.size(); ++i)
+        {
+            const auto& item = m_items[i];
+            const bool compressed = stored[i].blockCount > 0;
+            const auto& data = compressed ? stored[i].data : item.data;
+
+            pad(options.alignment);
+
+            auto& entry = toc[i];
+            entry.hash = Archive::hashName(item.name);
+            entry.offset = offset;
+            entry.storedSize = data.size();
+            entry.size = item.data.size();
+            entry.nameOffset = static_cast<uint32_t>(names.size());
+            entry.nameSize = static_cast<uint32_t>(item.name.size());
+            entry.blockSize = stored[i].blockSize;
+            entry.blockCount = stored[i].blockCount;
+
+            names += item.name;
+
+            file.write(reinterpret_cast<const char*>(data.data()), data.size());
+            offset += data.size();
+        }
+
+        std::stable_sort(toc.begin(), toc.end(), [](const Archive::Entry& a, const Archive::Entry& b) { return a.hash < b.hash; });
+
+        pad(alignof(Archive::Entry));
+        header.tocOffset = offset;
+
+        file.write(reinterpret_cast<const char*>(toc.data()), toc.size() * sizeof(Archive::Entry));
+        offset += toc.size() * sizeof(Archive::Entry);
+
+        header.namesOffset = offset;
+        header.namesSize = names.size();
+
+        file.write(names.data(), names.size());
+
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        if (!file.good())
+        {
+            throw std::runtime_error("ArchiveWriter: Write failed: " + path.u8string());
+        }
+    }
+}
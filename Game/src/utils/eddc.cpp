@@ -0,0 +1,196 @@
+#include "utils/eddc.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace EProject
+{
+    DerivedDataCache::DerivedDataCache(const std::filesystem::path& root) : m_root(root)
+    {
+        std::error_code ec;
+        std::filesystem::create_directories(m_root, ec);
+
+        if (!std::filesystem::is_directory(m_root))
+        {
+            throw std::runtime_error("DerivedDataCache: Can't create cache directory: " + m_root.u8string());
+        }
+    }
+
+    std::filesystem::path DerivedDataCache::getPath(uint64_t key) const
+    {
+        const auto name = keyToString(key);
+        return m_root / name.substr(0, 2) / name;
+    }
+
+    bool DerivedDataCache::has(uint64_t key) const
+    {
+        std::error_code ec;
+        return std::filesystem::is_regular_file(getPath(key), ec);
+    }
+
+    bool DerivedDataCache::load(uint64_t key, std::vector<uint8_t>& out) const
+    {
+        std::ifstream file(getPath(key), std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        const auto size = static_cast<size_t>(file.tellg());
+        file.seekg(0, std::ios::beg);
+
+        out.resize(size);
+        file.read(reinterpret_cast<char*>(out.data()), size);
+
+        return file.good();
+    }
+
+    void DerivedDataCache::store(uint64_t key, const void* data, size_t size) const
+    {
+        static std::atomic<uint32_t> tempCounter = 0;
+
+        const auto path = getPath(key);
+
+        std::error_code ec;
+        std::filesystem::create_directories(path.parent_path(), ec);
+
+        auto tempPath = path;
+        tempPath += ".tmp" + std::to_string(tempCounter++);
+
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            file.write(static_cast<const char*>(data), size);
+
+            if (!file.good())
+            {
+                file.close();
+                std::filesystem::remove(tempPath, ec);
+                throw std::runtime_error("DerivedDataCache: Write failed: " + tempPath.u8string());
+            }
+        }
+
+        // Same key means same content, losing the race to another writer is fine
+        std::filesystem::rename(tempPath, path, ec);
+        if (ec)
+        {
+            std::filesystem::remove(tempPath, ec);
+        }
+
+        if (!has(key))
+        {
+            throw std::runtime_error("DerivedDataCache: Store failed: " + path.u8string());
+        }
+    }
+
+    std::string DerivedDataCache::keyToString(uint64_t key)
+    {
+        char buf[17] = {};
+        std::snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(key));
+        return buf;
+    }
+
+    bool DerivedDataCache::keyFromString(const std::string& str, uint64_t& key)
+    {
+        if (str.size() != 16)
+        {
+            return false;
+        }
+
+        key = 0;
+        for (const char c : str)
+        {
+            uint64_t digit = 0;
+            if (c >= '0' && c <= '9') digit = c - '0';
+            else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+            else return false;
+
+            key = (key << 4) | digit;
+        }
+
+        return true;
+    }
+
+    bool CookManifest::load(const std::filesystem::path& path)
+    {
+        m_entries.clear();
+
+        std::ifstream file(path);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        // key \t stamp \t source [\t dependency]...
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::vector<std::string> fields;
+
+            std::istringstream ss(line);
+            for (std::string field; std::getline(ss, field, '\t');)
+            {
+                fields.push_back(field);
+            }
+
+            Entry entry;
+            if (fields.size() < 3 || !DerivedDataCache::keyFromString(fields[0], entry.key) || !DerivedDataCache::keyFromString(fields[1], entry.stamp))
+            {
+                continue;
+            }
+
+            entry.dependencies.assign(fields.begin() + 3, fields.end());
+            m_entries[fields[2]] = std::move(entry);
+        }
+
+        return true;
+    }
+
+    void CookManifest::save(const std::filesystem::path& path) const
+    {
+        auto tempPath = path;
+        tempPath += ".tmp";
+
+        {
+            std::ofstream file(tempPath, std::ios::trunc);
+
+            for (const auto& [source, entry] : m_entries)
+            {
+                file << DerivedDataCache::keyToString(entry.key) << '\t' << DerivedDataCache::keyToString(entry.stamp) << '\t' << source;
+
+                for (const auto& dep : entry.dependencies)
+                {
+                    file << '\t' << dep;
+                }
+
+                file << '\n';
+            }
+
+            if (!file.good())
+            {
+                throw std::runtime_error("CookManifest: Write failed: " + tempPath.u8string());
+            }
+        }
+
+        std::filesystem::rename(tempPath, path);
+    }
+
+    const CookManifest::Entry* CookManifest::find(const std::string& source) const
+    {
+        auto it = m_entries.find(source);
+        return it != m_entries.end() ? &it->second : nullptr;
+    }
+
+    void CookManifest::set(const std::string& source, Entry entry)
+    {
+        m_entries[source] = std::move(entry);
+    }
+
+    void CookManifest::erase(const std::string& source)
+    {
+        m_entries.erase(source);
+    }
+}
@@ -0,0 +1,159 @@
+#include "utils/efileutils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <iterator>
+
+namespace EProject
+{
+    namespace fs = std::filesystem;
+
+    namespace
+    {
+        int hexValue(char c)
+        {
+            if (c >= '0' && c <= '9')
+            {
+                return c - '0';
+            }
+
+            c = static_cast<char>(::tolower(static_cast<unsigned char>(c)));
+            return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+        }
+
+        size_t skipSpaces(const std::string& text, size_t pos, size_t end)
+        {
+            while (pos < end && (text[pos] == ' ' || text[pos] == '\t'))
+            {
+                ++pos;
+            }
+
+            return pos;
+        }
+    }
+
+    bool readFile(const fs::path& path, std::vector<uint8_t>& data)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        data.resize(static_cast<size_t>(file.tellg()));
+        file.seekg(0, std::ios::beg);
+        file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+        return file.good();
+    }
+
+    bool readFile(const fs::path& path, std::string& text)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+        {
+            return false;
+        }
+
+        text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    std::string getLowerExt(const fs::path& path)
+    {
+        auto ext = path.extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](char c) { return static_cast<char>(::tolower(static_cast<unsigned char>(c))); });
+        return ext;
+    }
+
+    std::string decodeUri(const std::string& uri)
+    {
+        std::string res;
+        res.reserve(uri.size());
+
+        for (size_t i = 0; i < uri.size(); ++i)
+        {
+            const int hi = uri[i] == '%' && i + 2 < uri.size() ? hexValue(uri[i + 1]) : -1;
+            const int lo = hi >= 0 ? hexValue(uri[i + 2]) : -1;
+
+            if (lo >= 0)
+            {
+                res += static_cast<char>(hi * 16 + lo);
+                i += 2;
+            }
+            else
+            {
+                res += uri[i];
+            }
+        }
+
+        return res;
+    }
+
+    bool isDataUri(const std::string& uri)
+    {
+        return uri.compare(0, 5, "data:") == 0;
+    }
+
+    std::vector<std::string> scanIncludes(const std::string& text)
+    {
+        std::vector<std::string> res;
+
+        size_t lineBegin = 0;
+        while (lineBegin < text.size())
+        {
+            auto lineEnd = text.find('\n', lineBegin);
+            if (lineEnd == std::string::npos)
+            {
+                lineEnd = text.size();
+            }
+
+            // #  include "file"
+            size_t pos = skipSpaces(text, lineBegin, lineEnd);
+            if (pos < lineEnd && text[pos] == '#')
+            {
+                pos = skipSpaces(text, pos + 1, lineEnd);
+                if (text.compare(pos, 7, "include") == 0)
+                {
+                    pos = skipSpaces(text, pos + 7, lineEnd);
+
+                    const auto end = pos < lineEnd && text[pos] == '"' ? text.find('"', pos + 1) : std::string::npos;
+                    if (end < lineEnd)
+                    {
+                        res.push_back(text.substr(pos + 1, end - pos - 1));
+                    }
+                }
+            }
+
+            lineBegin = lineEnd + 1;
+        }
+
+        return res;
+    }
+
+    std::vector<fs::path> collectIncludes(const fs::path& source)
+    {
+        std::vector<fs::path> files = { source.lexically_normal() };
+        std::string text;
+
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            if (!readFile(files[i], text))
+            {
+                continue;
+            }
+
+            for (const auto& include : scanIncludes(text))
+            {
+                const auto path = (files[i].parent_path() / fs::u8path(include)).lexically_normal();
+                if (std::find(files.begin(), files.end(), path) == files.end())
+                {
+                    files.push_back(path);
+                }
+            }
+        }
+
+        return files;
+    }
+}
@@ -0,0 +1,217 @@
+#include "utils/efilewatcher.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace EProject
+{
+    FileWatcher::FileWatcher(const std::filesystem::path& root) : m_root(root)
+    {
+#ifdef _WIN32
+        HANDLE dir = CreateFileW(root.wstring().c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+            OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+
+        if (dir == INVALID_HANDLE_VALUE)
+        {
+            return;
+        }
+
+        m_dir = dir;
+        m_stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+#else
+        m_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (m_fd < 0)
+        {
+            return;
+        }
+
+        addWatch(root);
+
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(root, ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec))
+        {
+            if (it->is_directory(ec))
+            {
+                addWatch(it->path());
+            }
+        }
+#endif
+        m_watching = true;
+        m_thread = std::thread(&FileWatcher::run, this);
+    }
+
+    FileWatcher::~FileWatcher()
+    {
+        m_stop = true;
+
+#ifdef _WIN32
+        if (m_stopEvent)
+        {
+            SetEvent(m_stopEvent);
+        }
+#endif
+
+        if (m_thread.joinable())
+        {
+            m_thread.join();
+        }
+
+#ifdef _WIN32
+        if (m_dir)
+        {
+            CloseHandle(m_dir);
+        }
+
+        if (m_stopEvent)
+        {
+            CloseHandle(m_stopEvent);
+        }
+#else
+        if (m_fd >= 0)
+        {
+            close(m_fd);
+        }
+#endif
+    }
+
+    std::vector<std::filesystem::path> FileWatcher::poll(std::chrono::milliseconds settleTime)
+    {
+        std::vector<std::filesystem::path> result;
+
+        const auto now = std::chrono::steady_clock::now();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (auto it = m_changes.begin(); it != m_changes.end();)
+        {
+            if (now - it->second >= settleTime)
+            {
+                result.emplace_back(it->first);
+                it = m_changes.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        return result;
+    }
+
+    void FileWatcher::onChanged(const std::filesystem::path& path)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_changes[path.lexically_normal().native()] = std::chrono::steady_clock::now();
+    }
+
+#ifdef _WIN32
+    void FileWatcher::run()
+    {
+        alignas(DWORD) uint8_t buffer[64 * 1024];
+
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+        const HANDLE handles[] = { overlapped.hEvent, m_stopEvent };
+
+        while (!m_stop)
+        {
+            ResetEvent(overlapped.hEvent);
+
+            const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_SIZE;
+            if (!ReadDirectoryChangesW(m_dir, buffer, sizeof(buffer), TRUE, filter, nullptr, &overlapped, nullptr))
+            {
+                break;
+            }
+
+            DWORD bytes = 0;
+
+            if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) != WAIT_OBJECT_0)
+            {
+                CancelIoEx(m_dir, &overlapped);
+                GetOverlappedResult(m_dir, &overlapped, &bytes, TRUE);
+                break;
+            }
+
+            // Zero bytes means the buffer overflowed and the changes are lost
+            if (!GetOverlappedResult(m_dir, &overlapped, &bytes, FALSE) || bytes == 0)
+            {
+                continue;
+            }
+
+            for (size_t offset = 0;;)
+            {
+                const auto* info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(buffer + offset);
+
+                if (info->Action != FILE_ACTION_REMOVED && info->Action != FILE_ACTION_RENAMED_OLD_NAME)
+                {
+                    onChanged(m_root / std::wstring(info->FileName, info->FileNameLength / sizeof(WCHAR)));
+                }
+
+                if (!info->NextEntryOffset)
+                {
+                    break;
+                }
+
+                offset += info->NextEntryOffset;
+            }
+        }
+
+        CloseHandle(overlapped.hEvent);
+    }
+#else
+    void FileWatcher::addWatch(const std::filesystem::path& dir)
+    {
+        const int wd = inotify_add_watch(m_fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if (wd >= 0)
+        {
+            m_watches[wd] = dir;
+        }
+    }
+
+    void FileWatcher::run()
+    {
+        alignas(inotify_event) char buffer[16 * 1024];
+
+        while (!m_stop)
+        {
+            // Wakes up regularly to see the stop flag
+            pollfd pfd = { m_fd, POLLIN, 0 };
+            if (::poll(&pfd, 1, 100) <= 0)
+            {
+                continue;
+            }
+
+            const ssize_t size = read(m_fd, buffer, sizeof(buffer));
+
+            for (ssize_t offset = 0; offset < size;)
+            {
+                const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+                offset += sizeof(inotify_event) + event->len;
+
+                const auto it = m_watches.find(event->wd);
+                if (it == m_watches.end() || !event->len)
+                {
+                    continue;
+                }
+
+                const auto path = it->second / event->name;
+
+                if (event->mask & IN_ISDIR)
+                {
+                    addWatch(path);
+                }
+                else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                {
+                    onChanged(path);
+                }
+            }
+        }
+    }
+#endif
+}
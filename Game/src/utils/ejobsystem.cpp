@@ -0,0 +1,147 @@
+#include "utils/ejobsystem.h"
+
+namespace EProject
+{
+    JobSystem::JobSystem(size_t workersCount)
+    {
+        if (workersCount == 0)
+        {
+            const size_t hw = std::thread::hardware_concurrency();
+            workersCount = hw > 1 ? hw - 1 : 1;
+        }
+
+        m_workers.reserve(workersCount);
+        for (size_t i = 0; i < workersCount; ++i)
+        {
+            m_workers.emplace_back(&JobSystem::workerLoop, this);
+        }
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+
+        m_cv.notify_all();
+
+        for (auto& worker : m_workers)
+        {
+            worker.join();
+        }
+    }
+
+    void JobSystem::push(std::function<void()>&& job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.emplace_back(std::move(job));
+        }
+
+        m_cv.notify_one();
+    }
+
+    void JobSystem::workerLoop()
+    {
+        while (true)
+        {
+            std::function<void()> job;
+
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+
+                if (m_stop && m_jobs.empty())
+                {
+                    return;
+                }
+
+                job = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+
+            job();
+        }
+    }
+
+    void JobSystem::parallelFor(size_t count, const std::function<void(size_t)>& func)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        if (count == 1)
+        {
+            func(0);
+            return;
+        }
+
+        struct Batch
+        {
+            std::atomic<size_t> next = 0;
+            std::atomic<size_t> done = 0;
+            size_t count = 0;
+
+            std::mutex mutex;
+            std::condition_variable cv;
+            std::exception_ptr error;
+        };
+
+        // Helpers may start after all items are taken, the batch outlives the call in that case
+        auto batch = std::make_shared<Batch>();
+        batch->count = count;
+
+        auto run = [batch, &func]()
+        {
+            size_t idx;
+            while ((idx = batch->next.fetch_add(1)) < batch->count)
+            {
+                try
+                {
+                    func(idx);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(batch->mutex);
+                    if (!batch->error)
+                    {
+                        batch->error = std::current_exception();
+                    }
+                }
+
+                if (batch->done.fetch_add(1) + 1 == batch->count)
+                {
+                    std::lock_guard<std::mutex> lock(batch->mutex);
+                    batch->cv.notify_all();
+                }
+            }
+        };
+
+        const size_t helpers = std::min(count - 1, m_workers.size());
+        for (size_t i = 0; i < helpers; ++i)
+        {
+            // func is only touched while items are left, and the caller waits for all of them
+            push(run);
+        }
+
+        run();
+
+        {
+            std::unique_lock<std::mutex> lock(batch->mutex);
+            batch->cv.wait(lock, [&batch]() { return batch->done.load() == batch->count; });
+        }
+
+        if (batch->error)
+        {
+            std::rethrow_exception(batch->error);
+        }
+    }
+
+    JobSystem* getJobSystem()
+    {
+        static JobSystem instance;
+        return &instance;
+    }
+}
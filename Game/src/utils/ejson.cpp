@@ -0,0 +1,336 @@
+#include "utils/ejson.h"
+
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+
+namespace EProject
+{
+    class JsonParser
+    {
+    public:
+        JsonParser(const char* data, size_t size) : m_cur(data), m_begin(data), m_end(data + size) {}
+
+        JsonValue parseDocument()
+        {
+            JsonValue root;
+            parseValue(root, 0);
+
+            skipSpaces();
+            if (m_cur != m_end)
+            {
+                error("unexpected data after the root value");
+            }
+
+            return root;
+        }
+
+    private:
+        static constexpr int cMaxDepth = 256;
+
+        [[noreturn]] void error(const char* what) const
+        {
+            throw std::runtime_error(std::string("Json: ") + what + " at offset " + std::to_string(m_cur - m_begin));
+        }
+
+        void skipSpaces()
+        {
+            while (m_cur != m_end && (*m_cur == ' ' || *m_cur == '\n' || *m_cur == '\r' || *m_cur == '\t'))
+            {
+                ++m_cur;
+            }
+        }
+
+        bool consume(char c)
+        {
+            skipSpaces();
+            if (m_cur != m_end && *m_cur == c)
+            {
+                ++m_cur;
+                return true;
+            }
+
+            return false;
+        }
+
+        void expect(char c)
+        {
+            if (!consume(c))
+            {
+                error("unexpected character");
+            }
+        }
+
+        void expectLiteral(const char* lit)
+        {
+            const size_t len = std::strlen(lit);
+            if (static_cast<size_t>(m_end - m_cur) < len || std::memcmp(m_cur, lit, len) != 0)
+            {
+                error("invalid literal");
+            }
+
+            m_cur += len;
+        }
+
+        void parseValue(JsonValue& out, int depth)
+        {
+            if (depth > cMaxDepth)
+            {
+                error("document is nested too deep");
+            }
+
+            skipSpaces();
+            if (m_cur == m_end)
+            {
+                error("unexpected end of data");
+            }
+
+            switch (*m_cur)
+            {
+            case '{':
+                ++m_cur;
+                out.m_type = JsonValue::Type::Object;
+
+                if (consume('}'))
+                {
+                    return;
+                }
+
+                do
+                {
+                    skipSpaces();
+                    out.m_keys.emplace_back();
+                    parseString(out.m_keys.back());
+                    expect(':');
+
+                    out.m_items.emplace_back();
+                    parseValue(out.m_items.back(), depth + 1);
+                } while (consume(','));
+
+                expect('}');
+                return;
+
+            case '[':
+                ++m_cur;
+                out.m_type = JsonValue::Type::Array;
+
+                if (consume(']'))
+                {
+                    return;
+                }
+
+                do
+                {
+                    out.m_items.emplace_back();
+                    parseValue(out.m_items.back(), depth + 1);
+                } while (consume(','));
+
+                expect(']');
+                return;
+
+            case '"':
+                out.m_type = JsonValue::Type::String;
+                parseString(out.m_string);
+                return;
+
+            case 't':
+                expectLiteral("true");
+                out.m_type = JsonValue::Type::Bool;
+                out.m_bool = true;
+                return;
+
+            case 'f':
+                expectLiteral("false");
+                out.m_type = JsonValue::Type::Bool;
+                out.m_bool = false;
+                return;
+
+            case 'n':
+                expectLiteral("null");
+                out.m_type = JsonValue::Type::Null;
+                return;
+
+            default:
+                parseNumber(out);
+                return;
+            }
+        }
+
+        void parseNumber(JsonValue& out)
+        {
+            // from_chars does not accept a leading '+', which json does not allow either
+            const auto res = std::from_chars(m_cur, m_end, out.m_number);
+            if (res.ec != std::errc())
+            {
+                error("invalid number");
+            }
+
+            m_cur = res.ptr;
+            out.m_type = JsonValue::Type::Number;
+        }
+
+        static void appendUtf8(std::string& out, uint32_t cp)
+        {
+            if (cp < 0x80)
+            {
+                out += static_cast<char>(cp);
+            }
+            else if (cp < 0x800)
+            {
+                out += static_cast<char>(0xC0 | (cp >> 6));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else if (cp < 0x10000)
+            {
+                out += static_cast<char>(0xE0 | (cp >> 12));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+            else
+            {
+                out += static_cast<char>(0xF0 | (cp >> 18));
+                out += static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                out += static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out += static_cast<char>(0x80 | (cp & 0x3F));
+            }
+        }
+
+        uint32_t parseHex4()
+        {
+            if (m_end - m_cur < 4)
+            {
+                error("invalid unicode escape");
+            }
+
+            uint32_t cp = 0;
+            const auto res = std::from_chars(m_cur, m_cur + 4, cp, 16);
+            if (res.ec != std::errc() || res.ptr != m_cur + 4)
+            {
+                error("invalid unicode escape");
+            }
+
+            m_cur += 4;
+            return cp;
+        }
+
+        void parseString(std::string& out)
+        {
+            if (m_cur == m_end || *m_cur != '"')
+            {
+                error("string expected");
+            }
+
+            ++m_cur;
+
+            while (true)
+            {
+                // Copy plain runs in one go, escapes are rare in asset files
+                const char* run = m_cur;
+                while (m_cur != m_end && *m_cur != '"' && *m_cur != '\\')
+                {
+                    ++m_cur;
+                }
+
+                out.append(run, m_cur);
+
+                if (m_cur == m_end)
+                {
+                    error("unterminated string");
+                }
+
+                if (*m_cur++ == '"')
+                {
+                    return;
+                }
+
+                if (m_cur == m_end)
+                {
+                    error("unterminated string");
+                }
+
+                switch (*m_cur++)
+                {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u':
+                {
+                    uint32_t cp = parseHex4();
+                    if (cp >= 0xD800 && cp <= 0xDBFF && m_end - m_cur >= 6 && m_cur[0] == '\\' && m_cur[1] == 'u')
+                    {
+                        m_cur += 2;
+                        const uint32_t low = parseHex4();
+                        cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                    }
+
+                    appendUtf8(out, cp);
+                    break;
+                }
+                default:
+                    error("invalid escape sequence");
+                }
+            }
+        }
+
+    private:
+        const char* m_cur;
+        const char* m_begin;
+        const char* m_end;
+    };
+
+    JsonValue JsonValue::parse(const char* data, size_t size)
+    {
+        JsonParser parser(data, size);
+        return parser.parseDocument();
+    }
+
+    bool JsonValue::has(const char* key) const
+    {
+        for (const auto& k : m_keys)
+        {
+            if (k == key)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    const JsonValue& JsonValue::operator[](const char* key) const
+    {
+        static const JsonValue nullValue;
+
+        for (size_t i = 0; i < m_keys.size(); ++i)
+        {
+            if (m_keys[i] == key)
+            {
+                return m_items[i];
+            }
+        }
+
+        return nullValue;
+    }
+
+    const JsonValue& JsonValue::operator[](size_t idx) const
+    {
+        static const JsonValue nullValue;
+
+        return idx < m_items.size() ? m_items[idx] : nullValue;
+    }
+
+    bool JsonValue::asBool(bool def) const
+    {
+        return m_type == Type::Bool ? m_bool : def;
+    }
+
+    double JsonValue::asNumber(double def) const
+    {
+        return m_type == Type::Number ? m_number : def;
+    }
+}
@@ -0,0 +1,191 @@
+#include "utils/evfs.h"
+
+#include <iostream>
+#include <mutex>
+#include <utility>
+
+namespace EProject
+{
+    FileView::FileView(FileView&& r) noexcept
+    {
+        *this = std::move(r);
+    }
+
+    FileView& FileView::operator=(FileView&& r) noexcept
+    {
+        if (this != &r)
+        {
+            m_data = std::exchange(r.m_data, nullptr);
+            m_size = std::exchange(r.m_size, 0);
+            m_storage = std::move(r.m_storage);
+            m_mapping = std::move(r.m_mapping);
+            m_archive = std::move(r.m_archive);
+        }
+
+        return *this;
+    }
+
+    void FileView::close()
+    {
+        m_data = nullptr;
+        m_size = 0;
+        m_storage = {};
+        m_mapping.close();
+        m_archive = nullptr;
+    }
+
+    void VirtualFileSystem::setRoot(const std::filesystem::path& root)
+    {
+        std::unique_lock lock(m_mutex);
+        m_root = std::filesystem::absolute(root).lexically_normal();
+    }
+
+    bool VirtualFileSystem::mount(const std::filesystem::path& archivePath)
+    {
+        auto archive = std::make_shared<Archive>();
+        if (!archive->open(archivePath))
+        {
+            return false;
+        }
+
+        std::cout << "VirtualFileSystem: Mounted " << archivePath.u8string() << " (" << archive->getEntryCount() << " entries)" << std::endl;
+
+        std::unique_lock lock(m_mutex);
+        m_archives.push_back(std::move(archive));
+
+        return true;
+    }
+
+    void VirtualFileSystem::unmountAll()
+    {
+        std::unique_lock lock(m_mutex);
+        m_archives.clear();
+        m_looseOverrides.clear();
+    }
+
+    size_t VirtualFileSystem::getMountCount() const
+    {
+        std::shared_lock lock(m_mutex);
+        return m_archives.size();
+    }
+
+    bool VirtualFileSystem::exists(const std::filesystem::path& path) const
+    {
+        {
+            std::shared_lock lock(m_mutex);
+
+            const auto name = getName(path);
+            if (!name.empty())
+            {
+                for (const auto& archive : m_archives)
+                {
+                    if (archive->find(name))
+                    {
+                        return true;
+                    }
+                }
+            }
+        }
+
+        std::error_code ec;
+        return std::filesystem::is_regular_file(path, ec);
+    }
+
+    bool VirtualFileSystem::open(const std::filesystem::path& path, FileView& view) const
+    {
+        view.close();
+
+        {
+            std::shared_lock lock(m_mutex);
+
+            const auto name = getName(path);
+            if (!name.empty())
+            {
+                for (auto it = m_archives.rbegin(); it != m_archives.rend(); ++it)
+                {
+                    const auto* entry = (*it)->find(name);
+                    if (!entry)
+                    {
+                        continue;
+                    }
+
+                    view.m_size = static_cast<size_t>(entry->size);
+
+                    if (const uint8_t* data = (*it)->getView(*entry))
+                    {
+                        view.m_data = data;
+                        view.m_archive = *it;
+                        return true;
+                    }
+
+                    if (!(*it)->read(*entry, view.m_storage))
+                    {
+                        throw std::runtime_error("VirtualFileSystem: Broken archive entry: " + name);
+                    }
+
+                    view.m_data = view.m_storage.data();
+                    return true;
+                }
+            }
+        }
+
+        if (!view.m_mapping.open(path))
+        {
+            return false;
+        }
+
+        view.m_data = view.m_mapping.getData();
+        view.m_size = view.m_mapping.getSize();
+
+        return true;
+    }
+
+    void VirtualFileSystem::overrideLoose(const std::filesystem::path& path)
+    {
+        std::unique_lock lock(m_mutex);
+
+        auto name = getRelativeName(path);
+        if (!name.empty())
+        {
+            m_looseOverrides.insert(std::move(name));
+        }
+    }
+
+    std::string VirtualFileSystem::getName(const std::filesystem::path& path) const
+    {
+        if (m_archives.empty())
+        {
+            return {};
+        }
+
+        auto name = getRelativeName(path);
+        if (m_looseOverrides.count(name))
+        {
+            return {};
+        }
+
+        return name;
+    }
+
+    std::string VirtualFileSystem::getRelativeName(const std::filesystem::path& path) const
+    {
+        if (m_root.empty())
+        {
+            return {};
+        }
+
+        const auto rel = std::filesystem::absolute(path).lexically_normal().lexically_relative(m_root);
+        if (rel.empty() || *rel.begin() == "..")
+        {
+            return {};
+        }
+
+        return rel.generic_u8string();
+    }
+
+    VirtualFileSystem* getFileSystem()
+    {
+        static VirtualFileSystem instance;
+        return &instance;
+    }
+}
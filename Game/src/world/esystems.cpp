@@ -10,10 +10,7 @@ void RenderMeshSystem::update(EProject::Render3D* render3D, entt::registry& reg)
     auto gr = reg.group<TransformComponent>(entt::get<StaticMeshComponent>);
     auto directLightEnts = reg.view<DirectLightComponent>();
 
-    // Refactor
-    auto gdevice = render3D->getDevice();
-
-    gdevice->getStates()->setDepthEnable(true);
+    render3D->resetFrameStats();
 
     for (auto dirLight : directLightEnts)
     {
@@ -27,8 +24,9 @@ void RenderMeshSystem::update(EProject::Render3D* render3D, entt::registry& reg)
             render3D->drawMeshModel(mc, tr);
         }    
     }
-    
-    gdevice->getStates()->setDepthEnable(false); 
+
+    // Pass states (depth test) are set by the queue and restored after
+    render3D->submit();
 }
 
 void CanvasSystem::update(World* wrld, EProject::Render2D* render2D, entt::registry& reg)
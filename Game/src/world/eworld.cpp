@@ -57,37 +57,87 @@ void World::init(std::shared_ptr<AssetManager>& mng, const GDevicePtr& dev)
 
     const auto modelsDir = PathHandler::getModelsDir();
 
-    PathKey helmetKey(modelsDir / "Helmet" / "DamagedHelmet.gltf");
-    Asset<MeshInstance> helmetMesh = mng->getAsset<MeshInstance>(helmetKey.path);
-    
-    helmetRenderable = std::make_shared<StaticMeshRenderable>();
-    helmetRenderable->setModelName("Helmet");
-    helmetRenderable->createOnGPU(helmetMesh, dev, mng);
-    
-    PathKey SciFiHelmetKey(modelsDir / "SciFiHelmet" / "SciFiHelmet.gltf");
-    Asset<MeshInstance> SciFiHelmetMesh = mng->getAsset<MeshInstance>(SciFiHelmetKey.path);
-
-    scifihelmetRenderable = std::make_shared<StaticMeshRenderable>();
-    scifihelmetRenderable->setModelName("SciFiHelmet");
-    scifihelmetRenderable->createOnGPU(SciFiHelmetMesh, dev, mng);
-
     const auto ent2 = createObject("Ent2");
-
     addComponent<TransformComponent>(ent2, glm::vec3(5.0f, 0.0f, 0.0f), glm::quat(glm::vec3(0.0f, glm::radians(180.0f), 0.0f)));
-    addComponent<StaticMeshComponent>(ent2, helmetRenderable);
 
     const auto ent3 = createObject("Ent3");
     addComponent<TransformComponent>(ent3, glm::vec3(-5.0f, 0.0f, 0.0f));
-    addComponent<StaticMeshComponent>(ent3, scifihelmetRenderable);
+
+    const auto testMesh = createObject("mesh");
+    addComponent<TransformComponent>(testMesh, glm::vec3(0.0f, 5.0f, 0.0f));
+
+    // Meshes and their textures stream in, the entities get renderables once everything is loaded
+    std::weak_ptr<AssetManager> weakMng = mng;
+
+    mng->loadAsync<MeshInstance>(modelsDir / "Helmet" / "DamagedHelmet.gltf", 1.0f,
+        [this, weakMng, dev, ent2](const Asset<MeshInstance>& helmetMesh)
+        {
+            auto manager = weakMng.lock();
+            if (!manager || !helmetMesh)
+            {
+                return;
+            }
+
+            helmetRenderable = std::make_shared<StaticMeshRenderable>();
+            helmetRenderable->setModelName("Helmet");
+            helmetRenderable->loadTexturesAsync(helmetMesh, manager, [this, weakMng, dev, ent2, helmetMesh]()
+            {
+                if (auto manager = weakMng.lock())
+                {
+                    helmetRenderable->createOnGPU(helmetMesh, dev, manager);
+                    addComponent<StaticMeshComponent>(ent2, helmetRenderable);
+
+                    manager->printSharedContent(std::cout);
+                }
+            });
+        });
+
+    mng->loadAsync<MeshInstance>(modelsDir / "SciFiHelmet" / "SciFiHelmet.gltf", 0.0f,
+        [this, weakMng, dev, ent3, testMesh](const Asset<MeshInstance>& SciFiHelmetMesh)
+        {
+            auto manager = weakMng.lock();
+            if (!manager || !SciFiHelmetMesh)
+            {
+                return;
+            }
+
+            scifihelmetRenderable = std::make_shared<StaticMeshRenderable>();
+            scifihelmetRenderable->setModelName("SciFiHelmet");
+            scifihelmetRenderable->loadTexturesAsync(SciFiHelmetMesh, manager, [this, weakMng, dev, ent3, testMesh, SciFiHelmetMesh]()
+            {
+                if (auto manager = weakMng.lock())
+                {
+                    scifihelmetRenderable->createOnGPU(SciFiHelmetMesh, dev, manager);
+                    addComponent<StaticMeshComponent>(ent3, scifihelmetRenderable);
+                    addComponent<StaticMeshComponent>(testMesh, scifihelmetRenderable);
+
+                    manager->printSharedContent(std::cout);
+                }
+            });
+        });
+
+    // Hot reloaded meshes and textures go to the renderables using them
+    mng->addReloadListener([this, weakMng, dev](const std::filesystem::path& path, const std::shared_ptr<IAsset>& asset)
+    {
+        auto manager = weakMng.lock();
+        if (!manager)
+        {
+            return;
+        }
+
+        for (const auto& renderable : { helmetRenderable, scifihelmetRenderable })
+        {
+            if (renderable && renderable->reloadFile(path, asset, dev, manager))
+            {
+                std::cout << "World: Updated " << path.filename().u8string() << "\n";
+            }
+        }
+    });
 
     const auto lightDirect = createObject("sunLight");
     //addComponent<DirectLightComponent>(lightDirect, glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(252.0f / 255.0f, 1.0f, 181.0f / 255.0f));
     addComponent<DirectLightComponent>(lightDirect, glm::vec3(0.0f, 10.0f, 0.0f), glm::vec3(1.0f, 1.0f, 1.0f));
 
-    const auto testMesh = createObject("mesh");
-    addComponent<TransformComponent>(testMesh, glm::vec3(0.0f, 5.0f, 0.0f));
-    addComponent<StaticMeshComponent>(testMesh, scifihelmetRenderable);
-
     postInit();
 }
 
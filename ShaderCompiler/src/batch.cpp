@@ -0,0 +1,378 @@
+#include "batch.h"
+
+#include "utils/eddc.h"
+#include "utils/efileutils.h"
+#include "utils/ehash.h"
+#include "utils/ejobsystem.h"
+#include "utils/ejson.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+
+namespace EProject
+{
+    namespace fs = std::filesystem;
+
+    namespace
+    {
+        const char* cBlobExt = ".cso";
+        const char* cDepsExt = ".d";
+
+        // Temporary file first, a run that dies halfway leaves no torn outputs behind
+        void writeFile(const fs::path& path, const void* data, size_t size)
+        {
+            std::error_code ec;
+            fs::create_directories(path.parent_path(), ec);
+
+            auto tempPath = path;
+            tempPath += ".tmp";
+
+            {
+                std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+                file.write(static_cast<const char*>(data), size);
+
+                if (!file.good())
+                {
+                    throw std::runtime_error("ShaderBatch: Write failed: " + tempPath.u8string());
+                }
+            }
+
+            fs::rename(tempPath, path);
+        }
+
+        fs::path getDepsPath(const fs::path& output)
+        {
+            auto res = output;
+            res += cDepsExt;
+            return res;
+        }
+
+        struct DepsFile
+        {
+            uint64_t key = 0;
+            uint64_t stamp = 0;
+            std::vector<fs::path> dependencies;
+        };
+
+        // "# key <hex> stamp <hex>", then a make rule of the blob on its dependencies with one
+        // dependency per continued line
+        bool readDeps(const fs::path& path, DepsFile& deps)
+        {
+            std::ifstream file(path);
+            std::string line;
+            if (!std::getline(file, line))
+            {
+                return false;
+            }
+
+            std::istringstream header(line);
+            std::string hash, keyTag, key, stampTag, stamp;
+            header >> hash >> keyTag >> key >> stampTag >> stamp;
+            if (hash != "#" || keyTag != "key" || stampTag != "stamp" ||
+                !DerivedDataCache::keyFromString(key, deps.key) || !DerivedDataCache::keyFromString(stamp, deps.stamp))
+            {
+                return false;
+            }
+
+            // Target line
+            std::getline(file, line);
+
+            while (std::getline(file, line))
+            {
+                const auto begin = line.find_first_not_of(' ');
+                auto end = line.size();
+                if (end >= 2 && line.compare(end - 2, 2, " \\") == 0)
+                {
+                    end -= 2;
+                }
+
+                if (begin != std::string::npos && begin < end)
+                {
+                    deps.dependencies.push_back(fs::u8path(line.substr(begin, end - begin)));
+                }
+            }
+
+            return !deps.dependencies.empty();
+        }
+
+        void writeDeps(const fs::path& path, const std::string& name, const DepsFile& deps)
+        {
+            std::ostringstream ss;
+            ss << "# key " << DerivedDataCache::keyToString(deps.key) << " stamp " << DerivedDataCache::keyToString(deps.stamp) << '\n';
+            ss << name << ':';
+
+            for (const auto& dep : deps.dependencies)
+            {
+                ss << " \\\n " << dep.generic_u8string();
+            }
+
+            ss << '\n';
+
+            const auto text = ss.str();
+            writeFile(path, text.data(), text.size());
+        }
+
+        std::vector<std::pair<std::string, std::string>> readDefines(const JsonValue& json)
+        {
+            std::vector<std::pair<std::string, std::string>> res;
+            for (size_t i = 0; i < json.size(); ++i)
+            {
+                res.emplace_back(json.getKey(i), json[i].asString());
+            }
+
+            return res;
+        }
+    }
+
+    ShaderBatch::ShaderBatch(const fs::path& manifest, const fs::path& outDir, uint64_t compilerVersion, ShaderCache::CompileFunc compile) :
+        m_outDir(outDir),
+        m_compilerVersion(compilerVersion),
+        m_compile(std::move(compile))
+    {
+        std::vector<uint8_t> data;
+        if (!readFile(manifest, data))
+        {
+            throw std::runtime_error("ShaderBatch: Can't read manifest: " + manifest.u8string());
+        }
+
+        const auto json = JsonValue::parse(reinterpret_cast<const char*>(data.data()), data.size());
+        const auto root = fs::absolute(manifest).lexically_normal().parent_path();
+
+        const auto globalDefines = readDefines(json["defines"]);
+        const auto flags = static_cast<uint32_t>(json["flags"].asSize());
+
+        const auto& shaders = json["shaders"];
+        for (size_t i = 0; i < shaders.size(); ++i)
+        {
+            const auto& shader = shaders[i];
+            const auto file = fs::u8path(shader["file"].asString());
+
+            auto defines = globalDefines;
+            for (auto& define : readDefines(shader["defines"]))
+            {
+                defines.push_back(std::move(define));
+            }
+
+            // Cartesian product of the permutation axes, the first axis varies slowest
+            std::vector<std::vector<std::pair<std::string, std::string>>> permutations = { {} };
+
+            const auto& axes = shader["permutations"];
+            for (size_t a = 0; a < axes.size(); ++a)
+            {
+                const auto& values = axes[a];
+                if (values.size() == 0)
+                {
+                    throw std::runtime_error("ShaderBatch: Permutation " + axes.getKey(a) + " of " + file.u8string() + " has no values");
+                }
+
+                std::vector<std::vector<std::pair<std::string, std::string>>> expanded;
+                for (const auto& perm : permutations)
+                {
+                    for (size_t v = 0; v < values.size(); ++v)
+                    {
+                        expanded.push_back(perm);
+                        expanded.back().emplace_back(axes.getKey(a), values[v].asString());
+                    }
+                }
+
+                permutations = std::move(expanded);
+            }
+
+            const auto& stages = shader["stages"];
+            for (size_t s = 0; s < stages.size(); ++s)
+            {
+                for (const auto& perm : permutations)
+                {
+                    Job job;
+                    job.desc.filePath = (root / file).lexically_normal();
+                    job.desc.entryPoint = stages[s]["entry"].asString();
+                    job.desc.target = stages[s]["target"].asString();
+                    job.desc.defines = defines;
+                    job.desc.defines.insert(job.desc.defines.end(), perm.begin(), perm.end());
+                    job.desc.flags = flags;
+
+                    if (job.desc.entryPoint.empty() || job.desc.target.empty())
+                    {
+                        throw std::runtime_error("ShaderBatch: Stage without entry or target in " + file.u8string());
+                    }
+
+                    // pbr.vs_main.SHADOWS=1.cso next to where the source sits under the manifest
+                    auto name = file;
+                    name.replace_extension();
+                    name += "." + job.desc.entryPoint;
+                    for (const auto& [define, value] : perm)
+                    {
+                        name += "." + define + "=" + value;
+                    }
+                    name += cBlobExt;
+
+                    job.name = name.lexically_normal().generic_u8string();
+                    job.output = m_outDir / name;
+                    m_jobs.push_back(std::move(job));
+                }
+            }
+        }
+    }
+
+    ShaderBatch::Stats ShaderBatch::build(bool force, JobSystem* jobs)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        std::vector<Task> tasks(m_jobs.size());
+        for (size_t i = 0; i < tasks.size(); ++i)
+        {
+            tasks[i].job = &m_jobs[i];
+        }
+
+        (jobs ? jobs : getJobSystem())->parallelFor(tasks.size(), [this, &tasks, force](size_t i)
+        {
+            auto& task = tasks[i];
+
+            try
+            {
+                process(task, force);
+            }
+            catch (const std::exception& ex)
+            {
+                task.result = Result::Failed;
+                task.error = ex.what();
+            }
+        });
+
+        Stats stats;
+        stats.jobs = tasks.size();
+
+        for (const auto& task : tasks)
+        {
+            switch (task.result)
+            {
+            case Result::UpToDate: ++stats.upToDate; break;
+            case Result::Unchanged: ++stats.unchanged; break;
+            case Result::Compiled: ++stats.compiled; break;
+            case Result::Failed: ++stats.failed; break;
+            }
+
+            stats.bytesWritten += task.bytes;
+
+            if (task.result == Result::Failed)
+            {
+                std::cout << "Failed " << task.job->name << ": " << task.error << std::endl;
+            }
+        }
+
+        const auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "ShaderCompiler: " << stats.jobs << " jobs, " << stats.upToDate << " up to date, " << stats.unchanged << " unchanged, "
+            << stats.compiled << " compiled (" << stats.bytesWritten / 1024 << " KB), " << stats.failed << " failed in " << seconds << " s" << std::endl;
+
+        return stats;
+    }
+
+    void ShaderBatch::process(Task& task, bool force) const
+    {
+        const Job& job = *task.job;
+        const auto depsPath = getDepsPath(job.output);
+
+        std::error_code ec;
+        DepsFile prev;
+        const bool havePrev = !force && fs::is_regular_file(job.output, ec) && readDeps(depsPath, prev);
+
+        // Fast path: nothing in the closure was touched since the last run
+        if (havePrev && computeStamp(job, prev.dependencies) == prev.stamp)
+        {
+            task.result = Result::UpToDate;
+            return;
+        }
+
+        DepsFile deps;
+        deps.key = computeShaderKey(job.desc, m_compilerVersion);
+        if (!deps.key)
+        {
+            throw std::runtime_error("ShaderBatch: Can't read source");
+        }
+
+        deps.dependencies = collectIncludes(job.desc.filePath);
+        deps.stamp = computeStamp(job, deps.dependencies);
+
+        if (havePrev && deps.key == prev.key)
+        {
+            writeDeps(depsPath, job.name, deps);
+            task.result = Result::Unchanged;
+            return;
+        }
+
+        std::vector<uint8_t> bytecode;
+        std::string errors;
+        if (!m_compile(job.desc, bytecode, errors))
+        {
+            throw std::runtime_error(errors);
+        }
+
+        writeFile(job.output, bytecode.data(), bytecode.size());
+        writeDeps(depsPath, job.name, deps);
+
+        task.bytes = bytecode.size();
+        task.result = Result::Compiled;
+    }
+
+    uint64_t ShaderBatch::computeStamp(const Job& job, const std::vector<fs::path>& dependencies) const
+    {
+        EHash::Hasher64 hasher;
+        hasher.update(m_compilerVersion);
+        hasher.update(job.desc.entryPoint);
+        hasher.update(job.desc.target);
+        hasher.update(static_cast<uint64_t>(job.desc.flags));
+
+        for (const auto& [name, value] : job.desc.defines)
+        {
+            hasher.update(name).update(value);
+        }
+
+        for (const auto& dep : dependencies)
+        {
+            hasher.update(dep.generic_u8string());
+
+            std::error_code ec;
+            const auto size = fs::file_size(dep, ec);
+
+            if (ec)
+            {
+                hasher.update(~0ull);
+                continue;
+            }
+
+            hasher.update(static_cast<uint64_t>(size));
+            hasher.update(static_cast<uint64_t>(fs::last_write_time(dep, ec).time_since_epoch().count()));
+        }
+
+        return hasher.finish();
+    }
+
+    int runShaderBatch(const fs::path& manifest, const fs::path& outDir, uint64_t compilerVersion, ShaderCache::CompileFunc compile, bool force, size_t workers)
+    {
+        try
+        {
+            ShaderBatch batch(manifest, outDir, compilerVersion, std::move(compile));
+
+            // The calling thread takes jobs too
+            std::unique_ptr<JobSystem> jobs;
+            if (workers)
+            {
+                jobs = std::make_unique<JobSystem>(workers);
+            }
+
+            const auto stats = batch.build(force, jobs.get());
+
+            return stats.failed ? 1 : 0;
+        }
+        catch (const std::exception& ex)
+        {
+            std::cout << ex.what() << std::endl;
+            return 1;
+        }
+    }
+}
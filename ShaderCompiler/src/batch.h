@@ -0,0 +1,86 @@
+#pragma once
+
+#include "graphics/eshadercache.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace EProject
+{
+    class JobSystem;
+
+    // Compiles every stage and permutation listed in a json manifest into <out>/<dir>/<name>.cso
+    // blobs, each with a make style .d file that records its key, a stamp and the include
+    // closure. Manifest, paths relative to it:
+    //   {
+    //       "defines": { "HLSL5": "1" },                 defines of every job, optional
+    //       "flags": 0,                                  compiler flags, optional
+    //       "shaders": [ {
+    //           "file": "pbr.hlsl",
+    //           "stages": [ { "entry": "vs_main", "target": "vs_5_0" } ],
+    //           "defines": { ... },                      this shader only, optional
+    //           "permutations": { "SHADOWS": [ "0", "1" ] }  every combination, optional
+    //       } ]
+    //   }
+    // The compiler is passed in, the scheduling and the incremental checks don't depend on it.
+    class ShaderBatch
+    {
+    public:
+        struct Stats
+        {
+            size_t jobs = 0;
+            size_t upToDate = 0;    // stamps matched, sources were not read
+            size_t unchanged = 0;   // sources were touched but hash the same
+            size_t compiled = 0;
+            size_t failed = 0;
+            size_t bytesWritten = 0;
+        };
+
+        struct Job
+        {
+            ShaderCompileDesc desc;
+            std::string name;               // relative output path, generic separators
+            std::filesystem::path output;
+        };
+
+        ShaderBatch(const std::filesystem::path& manifest, const std::filesystem::path& outDir, uint64_t compilerVersion, ShaderCache::CompileFunc compile);
+
+        // force ignores the stamps and the keys and compiles everything
+        Stats build(bool force, JobSystem* jobs = nullptr);
+
+        const std::vector<Job>& getJobs() const { return m_jobs; }
+
+    private:
+        enum class Result
+        {
+            UpToDate,
+            Unchanged,
+            Compiled,
+            Failed
+        };
+
+        struct Task
+        {
+            const Job* job = nullptr;
+            Result result = Result::Failed;
+            std::string error;
+            size_t bytes = 0;
+        };
+
+        void process(Task& task, bool force) const;
+
+        uint64_t computeStamp(const Job& job, const std::vector<std::filesystem::path>& dependencies) const;
+
+    private:
+        std::filesystem::path m_outDir;
+        uint64_t m_compilerVersion;
+        ShaderCache::CompileFunc m_compile;
+        std::vector<Job> m_jobs;
+    };
+
+    // What the command line does: builds the manifest on workers threads (the shared job system
+    // for 0) and prints a summary. Returns the exit code, 1 when the manifest or any job failed.
+    int runShaderBatch(const std::filesystem::path& manifest, const std::filesystem::path& outDir, uint64_t compilerVersion,
+        ShaderCache::CompileFunc compile, bool force, size_t workers);
+}
@@ -1,28 +1,29 @@
-#include <iostream>
+#include "batch.h"
 
-#include <d3dcompiler.h>
 #include <filesystem>
-#include <fstream>
+#include <iostream>
+#include <string>
 
+#ifdef _WIN32
+#include <d3dcompiler.h>
 #include <wrl.h>
+#endif
 
+using namespace EProject;
+
+#ifdef _WIN32
 struct InternalState_D3DCompiler
 {
-	using PFN_D3DCOMPILE = decltype(&D3DCompile);
-	PFN_D3DCOMPILE D3DCompile = nullptr;
+	using PFN_D3DCOMPILEFROMFILE = decltype(&D3DCompileFromFile);
+	PFN_D3DCOMPILEFROMFILE D3DCompileFromFile = nullptr;
 
 	InternalState_D3DCompiler()
 	{
-		if (D3DCompile != nullptr)
-		{
-			return; // already initialized
-		}
-
 		HMODULE d3dcompiler = LoadLibraryA("d3dcompiler_47.dll");
 		if (d3dcompiler != nullptr)
 		{
-			D3DCompile = (PFN_D3DCOMPILE)GetProcAddress(d3dcompiler, "D3DCompile");
-			if (D3DCompile != nullptr)
+			D3DCompileFromFile = (PFN_D3DCOMPILEFROMFILE)GetProcAddress(d3dcompiler, "D3DCompileFromFile");
+			if (D3DCompileFromFile != nullptr)
 			{
 				std::cout << "Loaded d3dcompiler.dll!\n";
 			}
@@ -36,147 +37,97 @@ inline InternalState_D3DCompiler& d3d_compiler()
 	return internal_state;
 }
 
-bool ReadFile(const std::string& fileName, std::vector<uint8_t>& data)
-{
-	std::ifstream file(fileName, std::ios::binary | std::ios::ate);
-
-	if (file.is_open())
-	{
-		size_t dataSize = (size_t)file.tellg();
-		file.seekg(0, file.beg);
-		data.resize(dataSize);
-		file.read((char*)data.data(), dataSize);
-		file.close();
-		return true;
-	}
-
-	return false;
-}
-
-struct CompilerInput
-{
-	std::string shaderSource; 
-	std::string shaderSourceFilename; 
-	std::string entryPoint = "main";
-
-
-};
-
-struct CompilerOutput
-{
-	std::shared_ptr<void> internal_state;
-	inline bool IsValid() const { return internal_state.get() != nullptr; }
-
-	const uint8_t* shaderData = nullptr;
-	size_t shaderSize = 0;
-	std::vector<uint8_t> shaderHash;
-	//std::vector<std::string> dependencies;
-	std::string errorMessage = "";
-};
-
-void CompileShader();
-
-int main(int argc, char** argv)
+// Thread safe, d3dcompiler takes no global state per call
+bool compileD3D(const ShaderCompileDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors)
 {
 	using namespace Microsoft::WRL;
 
-	auto& compiler = d3d_compiler();
-	auto currentPath = std::filesystem::current_path();
-	
-	auto triangleShader = currentPath.parent_path() / + "Data" / "Shaders" / "triangle.hlsl";
-
-	std::vector<uint8_t> shaderData = {};
-	if (!ReadFile(triangleShader.string(), shaderData))
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (const auto& [name, value] : desc.defines)
 	{
-		std::cout << "Failed to read shader file!\n";
-		return -1;
+		macros.push_back({ name.c_str(), value.c_str() });
 	}
-
-	D3D_SHADER_MACRO defines[] = 
-	{
-			"HLSL5", "1",
-			"DISABLE_WAVE_INTRINSICS", "1",
-			NULL, NULL
-	};
-
-	int flags = 0;
-
-	CompilerInput input = {};
-	CompilerOutput output = {};
-	
-	input.entryPoint = "vs_main";
-	input.shaderSourceFilename = "triangle.hlsl";
-
-
-	const char* targetVS = "vs_5_0";
-	const char* targetPS = "ps_5_0";
-
-	//switch (input.stage)
-	//{
-	//default:
-	//case ShaderStage::MS:
-	//case ShaderStage::AS:
-	//case ShaderStage::LIB:
-	//	// not applicable
-	//	return;
-	//case ShaderStage::VS:
-	//	target = "vs_5_0";
-	//	break;
-	//case ShaderStage::HS:
-	//	target = "hs_5_0";
-	//	break;
-	//case ShaderStage::DS:
-	//	target = "ds_5_0";
-	//	break;
-	//case ShaderStage::GS:
-	//	target = "gs_5_0";
-	//	break;
-	//case ShaderStage::PS:
-	//	target = "ps_5_0";
-	//	break;
-	//case ShaderStage::CS:
-	//	target = "cs_5_0";
-	//	break;
-	//}
+	macros.push_back({ nullptr, nullptr });
 
 	ComPtr<ID3DBlob> code = {};
-	ComPtr<ID3DBlob> errors = {};
-
-	HRESULT hr = d3d_compiler().D3DCompile(
-		shaderData.data(),
-		shaderData.size(),
-		input.shaderSourceFilename.c_str(),
-		defines,
-		//&includehandler, //D3D_COMPILE_STANDARD_FILE_INCLUDE,
+	ComPtr<ID3DBlob> messages = {};
+
+	HRESULT hr = d3d_compiler().D3DCompileFromFile(
+		desc.filePath.wstring().c_str(),
+		macros.data(),
 		D3D_COMPILE_STANDARD_FILE_INCLUDE,
-		input.entryPoint.c_str(),
-		targetVS,
-		flags,
+		desc.entryPoint.c_str(),
+		desc.target.c_str(),
+		desc.flags,
 		0,
 		&code,
-		&errors
+		&messages
 	);
 
-	if (errors)
+	if (FAILED(hr))
 	{
-		output.errorMessage = (const char*)errors->GetBufferPointer();
+		errors = messages ? (const char*)messages->GetBufferPointer() : "unknown error";
+		return false;
 	}
 
-	if (SUCCEEDED(hr))
-	{
-		//output.dependencies.push_back(input.shaderSourceFilename);
-		output.shaderData = (const uint8_t*)code->GetBufferPointer();
-		output.shaderSize = code->GetBufferSize();
-
-		// keep the blob alive == keep shader pointer valid!
-		auto internal_state = std::make_shared<ComPtr<ID3D10Blob>>();
-		*internal_state = code;
-		output.internal_state = internal_state;
-	}
+	const uint8_t* data = (const uint8_t*)code->GetBufferPointer();
+	bytecode.assign(data, data + code->GetBufferSize());
+	return true;
+}
+#endif
 
+// ShaderCompiler [--manifest <file>] [--out <dir>] [--jobs <n>] [--force]
+// Defaults match the game layout: Data/Shaders/shaders.json and Cache/CompiledShaders next to
+// the working directory. --jobs sets the worker threads, the shared job system otherwise.
+int main(int argc, char** argv)
+{
+	const auto root = std::filesystem::current_path().parent_path();
 
+	std::filesystem::path manifestPath = root / "Data" / "Shaders" / "shaders.json";
+	std::filesystem::path outDir = root / "Cache" / "CompiledShaders";
+	size_t workers = 0;
+	bool force = false;
 
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
 
+		if (arg == "--manifest" && i + 1 < argc)
+		{
+			manifestPath = std::filesystem::u8path(argv[++i]);
+		}
+		else if (arg == "--out" && i + 1 < argc)
+		{
+			outDir = std::filesystem::u8path(argv[++i]);
+		}
+		else if (arg == "--jobs" && i + 1 < argc)
+		{
+			workers = std::stoul(argv[++i]);
+		}
+		else if (arg == "--force")
+		{
+			force = true;
+		}
+		else
+		{
+			std::cout << "Usage: ShaderCompiler [--manifest <file>] [--out <dir>] [--jobs <n>] [--force]" << std::endl;
+			return 2;
+		}
+	}
+
+#ifdef _WIN32
+	if (d3d_compiler().D3DCompileFromFile == nullptr)
+	{
+		std::cout << "Failed to load d3dcompiler_47.dll!\n";
+		return 1;
+	}
 
-    return 0;
+	return runShaderBatch(manifestPath, outDir, D3D_COMPILER_VERSION, compileD3D, force, workers);
+#else
+	return runShaderBatch(manifestPath, outDir, 0, [](const ShaderCompileDesc&, std::vector<uint8_t>&, std::string& errors)
+	{
+		errors = "ShaderCompiler: Compiling needs d3dcompiler";
+		return false;
+	}, force, workers);
+#endif
 }
@@ -0,0 +1,115 @@
+#include "testutils.h"
+
+#include "utils/earchive.h"
+
+#include <gtest/gtest.h>
+
+#include <cstddef>
+#include <cstring>
+
+namespace EProject
+{
+    namespace
+    {
+        class ArchiveTest : public ::testing::Test
+        {
+        protected:
+            ArchiveTest() : m_dir("Archive"), m_path(m_dir / "Data.pak")
+            {
+                for (size_t i = 0; i < m_raw.size(); ++i)
+                {
+                    m_raw[i] = static_cast<uint8_t>(i * 7);
+                }
+
+                for (size_t i = 0; i < m_packed.size(); ++i)
+                {
+                    m_packed[i] = static_cast<uint8_t>(i / 100);
+                }
+
+                ArchiveWriter writer;
+                writer.add("raw.bin", std::vector<uint8_t>(m_raw), false);
+                writer.add("packed.bin", std::vector<uint8_t>(m_packed), true);
+
+                ArchiveWriter::Options options;
+                options.blockSize = 16 * 1024;
+
+                writer.write(m_path, options);
+            }
+
+            // Rewrites one size field of the entry's table of contents record
+            void patchEntry(const std::string& name, size_t field, uint64_t value)
+            {
+                size_t recordOffset = 0;
+                {
+                    Archive archive;
+                    ASSERT_TRUE(archive.open(m_path));
+
+                    const auto* entry = archive.find(name);
+                    ASSERT_NE(entry, nullptr);
+
+                    Archive::Header header;
+                    std::ifstream(m_path, std::ios::binary).read(reinterpret_cast<char*>(&header), sizeof(header));
+
+                    recordOffset = static_cast<size_t>(header.tocOffset) + static_cast<size_t>(entry - &archive.getEntry(0)) * sizeof(Archive::Entry);
+                }
+
+                std::fstream file(m_path, std::ios::binary | std::ios::in | std::ios::out);
+                file.seekp(static_cast<std::streamoff>(recordOffset + field));
+                file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            }
+
+            bool read(const std::string& name, std::vector<uint8_t>& out) const
+            {
+                Archive archive;
+                if (!archive.open(m_path))
+                {
+                    return false;
+                }
+
+                const auto* entry = archive.find(name);
+                return entry && archive.read(*entry, out);
+            }
+
+            TempDir m_dir;
+            std::filesystem::path m_path;
+
+            std::vector<uint8_t> m_raw = std::vector<uint8_t>(1000);
+            std::vector<uint8_t> m_packed = std::vector<uint8_t>(100 * 1024);
+        };
+    }
+
+    TEST_F(ArchiveTest, ReadsEntries)
+    {
+        std::vector<uint8_t> data;
+
+        ASSERT_TRUE(read("raw.bin", data));
+        EXPECT_EQ(data, m_raw);
+
+        ASSERT_TRUE(read("packed.bin", data));
+        EXPECT_EQ(data, m_packed);
+    }
+
+    TEST_F(ArchiveTest, RejectsUncompressedSizeMismatch)
+    {
+        patchEntry("raw.bin", offsetof(Archive::Entry, size), m_raw.size() + 4096);
+
+        std::vector<uint8_t> data;
+        EXPECT_FALSE(read("raw.bin", data));
+    }
+
+    TEST_F(ArchiveTest, RejectsCompressedSizeMismatch)
+    {
+        // More blocks than the entry size needs, and fewer
+        patchEntry("packed.bin", offsetof(Archive::Entry, size), 16 * 1024);
+
+        std::vector<uint8_t> data;
+        EXPECT_FALSE(read("packed.bin", data));
+
+        patchEntry("packed.bin", offsetof(Archive::Entry, size), m_packed.size() + 64 * 1024);
+        EXPECT_FALSE(read("packed.bin", data));
+
+        // Same block count, but the last block decodes to a different length
+        patchEntry("packed.bin", offsetof(Archive::Entry, size), m_packed.size() - 1);
+        EXPECT_FALSE(read("packed.bin", data));
+    }
+}
@@ -0,0 +1,204 @@
+#include "testutils.h"
+
+#include "egapi.h"
+#include "eutils.h"
+#include "graphics/eimage.h"
+
+#include <gtest/gtest.h>
+
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace EProject
+{
+    namespace
+    {
+        class DummyAsset final : public IAsset
+        {
+        public:
+            void init() override {}
+            bool load(const GDevicePtr&) override { return true; }
+            bool unload() override { return true; }
+        };
+
+        // Starts getOrLoad on another thread and waits until it joined the in-flight load
+        std::future<std::shared_ptr<IAsset>> joinAsync(AssetCache& cache, const PathKey& key, std::atomic<int>& loaderCalls)
+        {
+            const uint64_t joins = cache.getStats().joins;
+
+            auto result = std::async(std::launch::async, [&cache, key, &loaderCalls]()
+            {
+                return cache.getOrLoad(key, [&loaderCalls]() -> std::shared_ptr<IAsset>
+                {
+                    ++loaderCalls;
+                    return std::make_shared<DummyAsset>();
+                });
+            });
+
+            while (cache.getStats().joins == joins)
+            {
+                std::this_thread::yield();
+            }
+
+            return result;
+        }
+    }
+
+    TEST(AssetCacheTest, ClaimedKeyMakesGetOrLoadWait)
+    {
+        AssetCache cache;
+        const PathKey key("Textures/albedo.png");
+
+        ASSERT_TRUE(cache.beginLoad(key));
+        EXPECT_FALSE(cache.beginLoad(key));
+
+        std::atomic<int> loaderCalls = 0;
+        auto waiter = joinAsync(cache, key, loaderCalls);
+
+        auto asset = std::make_shared<DummyAsset>();
+        EXPECT_EQ(cache.endLoad(key, asset), asset);
+
+        EXPECT_EQ(waiter.get(), asset);
+        EXPECT_EQ(loaderCalls, 0);
+        EXPECT_EQ(cache.find(key), asset);
+        EXPECT_FALSE(cache.beginLoad(key));
+    }
+
+    TEST(AssetCacheTest, FailedClaimWakesWaitersWithTheError)
+    {
+        AssetCache cache;
+        const PathKey key("Textures/broken.png");
+
+        ASSERT_TRUE(cache.beginLoad(key));
+
+        std::atomic<int> loaderCalls = 0;
+        auto waiter = joinAsync(cache, key, loaderCalls);
+
+        cache.failLoad(key, std::make_exception_ptr(std::runtime_error("decode failed")));
+
+        EXPECT_THROW(waiter.get(), std::runtime_error);
+        EXPECT_EQ(cache.find(key), nullptr);
+
+        // Nothing is left in flight, the next request loads again
+        EXPECT_TRUE(cache.beginLoad(key));
+        cache.endLoad(key, nullptr);
+    }
+
+    TEST(AssetCacheTest, HitsStayValidWhileEntriesChange)
+    {
+        AssetCache cache;
+
+        std::vector<PathKey> keys;
+        for (int i = 0; i < 64; ++i)
+        {
+            keys.emplace_back("Meshes/mesh_" + std::to_string(i) + ".bin");
+            cache.insert(keys.back(), std::make_shared<DummyAsset>());
+        }
+
+        std::atomic<bool> done = false;
+        std::atomic<uint64_t> found = 0;
+        std::vector<std::thread> readers;
+
+        for (int t = 0; t < 4; ++t)
+        {
+            readers.emplace_back([&]()
+            {
+                while (!done)
+                {
+                    for (const auto& key : keys)
+                    {
+                        if (auto asset = cache.find(key))
+                        {
+                            // Touch it, a freed snapshot would hand out a dangling entry here
+                            found += asset->getPath().empty() ? 1 : 0;
+                        }
+                    }
+                }
+            });
+        }
+
+        for (int round = 0; round < 200; ++round)
+        {
+            const PathKey& key = keys[round % keys.size()];
+            cache.replace(key, std::make_shared<DummyAsset>());
+            cache.erase(key, cache.find(key));
+            cache.insert(key, std::make_shared<DummyAsset>());
+        }
+
+        // On few cores the readers may not have run yet
+        while (found == 0)
+        {
+            std::this_thread::yield();
+        }
+
+        done = true;
+        for (auto& reader : readers)
+        {
+            reader.join();
+        }
+
+        EXPECT_GT(found, 0u);
+        EXPECT_EQ(cache.size(), keys.size());
+    }
+
+    TEST(AssetCacheTest, ErasedAssetIsOnlyHeldByTheCaller)
+    {
+        AssetCache cache;
+        const PathKey key("Textures/old.png");
+
+        auto asset = std::make_shared<DummyAsset>();
+        cache.insert(key, asset);
+        cache.insert(PathKey("Textures/other.png"), std::make_shared<DummyAsset>());
+
+        EXPECT_EQ(cache.find(key), asset);
+        EXPECT_EQ(asset.use_count(), 2);
+
+        // No reader is inside a lookup, so no old snapshot keeps a reference
+        ASSERT_TRUE(cache.erase(key, asset));
+        EXPECT_EQ(asset.use_count(), 1);
+        EXPECT_EQ(cache.getStats().hits, 0u);
+
+        cache.getOrLoad(PathKey("Textures/other.png"), []() -> std::shared_ptr<IAsset> { return nullptr; });
+        EXPECT_EQ(cache.getStats().hits, 1u);
+    }
+
+    TEST(AssetCacheTest, GetTexturesDecodesListedTwiceOnce)
+    {
+        TempDir dir("AssetCache");
+        AssetManager manager(std::make_shared<GDevice>());
+
+        const auto first = dir / "a.tga";
+        const auto second = dir / "b.tga";
+        writeTga(first, 16, 16, 10);
+        writeTga(second, 16, 16, 20);
+
+        const auto textures = manager.getTextures({ first, second, first });
+
+        ASSERT_EQ(textures.size(), 3u);
+        ASSERT_TRUE(textures[0] && textures[1]);
+        EXPECT_EQ(textures[0], textures[2]);
+        EXPECT_NE(textures[0], textures[1]);
+
+        const auto stats = manager.getCache().getStats();
+        EXPECT_EQ(stats.misses, 2u);
+    }
+
+    TEST(AssetCacheTest, PixelPoolStaysWithinItsLimit)
+    {
+        auto* pool = getPixelBufferPool();
+        pool->trim();
+        pool->setMaxCachedBytes(1024 * 1024);
+
+        // Four 512 KB buffers, only two fit
+        pool->reserve(std::vector<size_t>(4, 512 * 1024));
+        EXPECT_LE(pool->getStats().cachedBytes, 1024u * 1024u);
+        EXPECT_GT(pool->getStats().cachedBytes, 0u);
+
+        pool->trim();
+        EXPECT_EQ(pool->getStats().cachedBytes, 0u);
+
+        pool->setMaxCachedBytes(8 * 1024 * 1024);
+    }
+}
@@ -0,0 +1,131 @@
+#include "testutils.h"
+
+#include "egapi.h"
+#include "eutils.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+namespace EProject
+{
+    namespace
+    {
+        class AssetManagerTest : public ::testing::Test
+        {
+        protected:
+            AssetManagerTest() : m_dir("AssetManager"), m_manager(std::make_shared<GDevice>())
+            {
+                for (int i = 0; i < 4; ++i)
+                {
+                    m_paths.push_back(m_dir / ("texture" + std::to_string(i) + ".tga"));
+                    writeTga(m_paths.back(), 32, 32, static_cast<uint8_t>(i * 40));
+                }
+            }
+
+            bool isCached(int index) const
+            {
+                return m_manager.getCache().find(PathKey(m_paths[index])) != nullptr;
+            }
+
+            TempDir m_dir;
+            AssetManager m_manager;
+            std::vector<std::filesystem::path> m_paths;
+        };
+    }
+
+    TEST_F(AssetManagerTest, BudgetEvictsLeastRecentlyUsed)
+    {
+        // One texture per frame, then texture 1 is used again, so 2 and 3 are the oldest unused ones
+        auto held = m_manager.getAsset<Texture2D>(m_paths[0]);
+        ASSERT_TRUE(held);
+
+        for (int i = 1; i < 4; ++i)
+        {
+            m_manager.update();
+            ASSERT_TRUE(m_manager.getAsset<Texture2D>(m_paths[i]));
+        }
+
+        m_manager.update();
+        ASSERT_TRUE(m_manager.getAsset<Texture2D>(m_paths[1]));
+
+        const size_t textureBytes = held->getMemoryUsage();
+        ASSERT_GT(textureBytes, 0u);
+        ASSERT_EQ(m_manager.getMemoryUsage<Texture2D>(), textureBytes * 4);
+
+        // Room for two and a half textures
+        m_manager.setBudget<Texture2D>(textureBytes * 5 / 2);
+
+        EXPECT_EQ(m_manager.collectGarbage(), textureBytes * 2);
+
+        EXPECT_TRUE(isCached(0));
+        EXPECT_TRUE(isCached(1));
+        EXPECT_FALSE(isCached(2));
+        EXPECT_FALSE(isCached(3));
+        EXPECT_EQ(m_manager.getMemoryUsage<Texture2D>(), textureBytes * 2);
+    }
+
+    TEST_F(AssetManagerTest, HeldAssetsSurviveGarbageCollection)
+    {
+        std::vector<Asset<Texture2D>> held;
+        for (const auto& path : m_paths)
+        {
+            held.push_back(m_manager.getAsset<Texture2D>(path));
+            ASSERT_TRUE(held.back());
+
+            m_manager.update();
+        }
+
+        m_manager.setBudget<Texture2D>(1);
+
+        EXPECT_EQ(m_manager.collectGarbage(), 0u);
+
+        for (size_t i = 0; i < held.size(); ++i)
+        {
+            EXPECT_TRUE(isCached(static_cast<int>(i)));
+            EXPECT_TRUE(held[i]->getData() != nullptr);
+            EXPECT_EQ(m_manager.getAsset<Texture2D>(m_paths[i]), held[i]);
+        }
+
+        // Let go of the oldest, only that one goes
+        held.front().reset();
+
+        EXPECT_GT(m_manager.collectGarbage(), 0u);
+        EXPECT_FALSE(isCached(0));
+        EXPECT_TRUE(isCached(3));
+
+        // Evicted assets load again on the next request
+        EXPECT_TRUE(m_manager.getAsset<Texture2D>(m_paths[0]));
+        EXPECT_TRUE(isCached(0));
+    }
+
+    TEST_F(AssetManagerTest, ThrowingCallbackFailsOnlyItsRequest)
+    {
+        bool secondLoaded = false;
+
+        auto first = m_manager.loadAsync<Texture2D>(m_paths[0], 0.0f, [](const Asset<Texture2D>&)
+        {
+            throw std::runtime_error("callback failed");
+        });
+
+        auto second = m_manager.loadAsync<Texture2D>(m_paths[1], 0.0f, [&secondLoaded](const Asset<Texture2D>& texture)
+        {
+            secondLoaded = texture != nullptr;
+        });
+
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+        while (m_manager.getPendingCount() && std::chrono::steady_clock::now() < deadline)
+        {
+            ASSERT_NO_THROW(m_manager.update());
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        ASSERT_EQ(m_manager.getPendingCount(), 0u);
+
+        EXPECT_TRUE(first.isFailed());
+        EXPECT_TRUE(second.isReady());
+        EXPECT_TRUE(secondLoaded);
+    }
+}
@@ -0,0 +1,60 @@
+#include "testutils.h"
+
+#include "utils/efileutils.h"
+
+#include <gtest/gtest.h>
+
+namespace EProject
+{
+    TEST(FileUtilsTest, LowerExt)
+    {
+        EXPECT_EQ(getLowerExt("Models/Helmet/Albedo.PNG"), ".png");
+        EXPECT_EQ(getLowerExt("Shaders/pbr.hlsl"), ".hlsl");
+        EXPECT_EQ(getLowerExt("Makefile"), "");
+    }
+
+    TEST(FileUtilsTest, DecodeUri)
+    {
+        EXPECT_EQ(decodeUri("My%20Scene/Albedo%5fmap.png"), "My Scene/Albedo_map.png");
+        EXPECT_EQ(decodeUri("100%zz.bin"), "100%zz.bin");
+        EXPECT_EQ(decodeUri("trailing%2"), "trailing%2");
+
+        EXPECT_TRUE(isDataUri("data:application/octet-stream;base64,AAAA"));
+        EXPECT_FALSE(isDataUri("buffer.bin"));
+    }
+
+    TEST(FileUtilsTest, ScanIncludes)
+    {
+        const std::string text =
+            "#include \"Common.hlsl\"\n"
+            "  #  include   \"Lights/Point.hlsl\"\r\n"
+            "#include <system.hlsl>\n"
+            "// a comment mentioning #include \"Nope.hlsl\"\n"
+            "float4 main() : SV_TARGET { return 0; }\n"
+            "#\tinclude\t\"Last.hlsl\"";
+
+        const std::vector<std::string> expected = { "Common.hlsl", "Lights/Point.hlsl", "Last.hlsl" };
+        EXPECT_EQ(scanIncludes(text), expected);
+    }
+
+    TEST(FileUtilsTest, CollectIncludesFollowsRelativePaths)
+    {
+        TempDir dir("FileUtils");
+        writeText(dir / "Shaders/Lit.hlsl", "#include \"Lib/Common.hlsl\"\n#include \"Missing.hlsl\"\n");
+        writeText(dir / "Shaders/Lib/Common.hlsl", "#include \"../Constants.hlsl\"\n#include \"Math.hlsl\"\n");
+        writeText(dir / "Shaders/Lib/Math.hlsl", "#include \"Common.hlsl\"\n");
+        writeText(dir / "Shaders/Constants.hlsl", "");
+
+        const auto root = dir / "Shaders";
+        const std::vector<std::filesystem::path> expected = {
+            root / "Lit.hlsl", root / "Lib/Common.hlsl", root / "Missing.hlsl", root / "Constants.hlsl", root / "Lib/Math.hlsl" };
+
+        const auto files = collectIncludes(root / "Lit.hlsl");
+        ASSERT_EQ(files.size(), expected.size());
+
+        for (size_t i = 0; i < files.size(); ++i)
+        {
+            EXPECT_EQ(files[i], expected[i].lexically_normal()) << i;
+        }
+    }
+}
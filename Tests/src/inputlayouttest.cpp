@@ -0,0 +1,111 @@
+#include "testutils.h"
+
+#include "egapi.h"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <memory>
+
+namespace EProject
+{
+    namespace
+    {
+        class InputLayoutCacheTest : public ::testing::Test
+        {
+        protected:
+            InputLayoutCacheTest() : m_dir("InputLayouts"), m_path(m_dir / "inputlayouts.bin")
+            {
+                Layout layout;
+                layout.stride = 20;
+                layout.fields.push_back({ "POS", LayoutType::Float, 3, false, 0, 0 });
+                layout.fields.push_back({ "TEXCOORD", LayoutType::Float, 2, false, 12, 0 });
+
+                auto device = std::make_shared<GDevice>();
+                auto* cache = device->getInputLayouts();
+
+                const char signature[] = "vertex shader input signature";
+                cache->get(cache->addSignature(signature, sizeof(signature)), internLayout(layout), nullptr, 0);
+
+                EXPECT_TRUE(cache->save(m_path));
+                m_file = readFile();
+            }
+
+            std::vector<uint8_t> readFile() const
+            {
+                std::ifstream file(m_path, std::ios::binary);
+                return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+            }
+
+            void writeFile(const std::vector<uint8_t>& data) const
+            {
+                std::ofstream(m_path, std::ios::binary | std::ios::trunc).write(reinterpret_cast<const char*>(data.data()), data.size());
+            }
+
+            TempDir m_dir;
+            std::filesystem::path m_path;
+            std::vector<uint8_t> m_file;
+        };
+    }
+
+    TEST_F(InputLayoutCacheTest, LoadsSavedLayouts)
+    {
+        auto device = std::make_shared<GDevice>();
+        auto* cache = device->getInputLayouts();
+
+        ASSERT_TRUE(cache->load(m_path));
+        EXPECT_EQ(cache->size(), 1u);
+        EXPECT_EQ(cache->getStats().loaded, 1u);
+    }
+
+    TEST_F(InputLayoutCacheTest, TruncatedFileLeavesCacheEmpty)
+    {
+        for (size_t size = 0; size < m_file.size(); ++size)
+        {
+            writeFile(std::vector<uint8_t>(m_file.begin(), m_file.begin() + size));
+
+            auto device = std::make_shared<GDevice>();
+            auto* cache = device->getInputLayouts();
+
+            EXPECT_FALSE(cache->load(m_path)) << size;
+            EXPECT_EQ(cache->size(), 0u) << size;
+        }
+    }
+
+    TEST_F(InputLayoutCacheTest, CorruptCountDoesNotLoad)
+    {
+        // The signature count follows magic and version, a huge one must not allocate
+        auto data = m_file;
+        const uint32_t count = 0xFFFFFFF0u;
+        memcpy(&data[8], &count, sizeof(count));
+        writeFile(data);
+
+        auto device = std::make_shared<GDevice>();
+        auto* cache = device->getInputLayouts();
+
+        EXPECT_FALSE(cache->load(m_path));
+        EXPECT_EQ(cache->size(), 0u);
+    }
+
+    TEST_F(InputLayoutCacheTest, CorruptFieldTypeDoesNotLoad)
+    {
+        // From the end: step rate, absent instance layout, then array_size, offset, do_norm,
+        // num_fields and type of the last vertex field
+        auto data = m_file;
+        const size_t typeOffset = data.size() - sizeof(int32_t) - sizeof(uint8_t) - 2 * sizeof(int32_t) - sizeof(uint8_t) - 2 * sizeof(int32_t);
+
+        int32_t type = 0;
+        memcpy(&type, &data[typeOffset], sizeof(type));
+        ASSERT_EQ(type, int32_t(LayoutType::Float));
+
+        type = 42;
+        memcpy(&data[typeOffset], &type, sizeof(type));
+        writeFile(data);
+
+        auto device = std::make_shared<GDevice>();
+        auto* cache = device->getInputLayouts();
+
+        EXPECT_FALSE(cache->load(m_path));
+        EXPECT_EQ(cache->size(), 0u);
+    }
+}
@@ -0,0 +1,8 @@
+#include <gtest/gtest.h>
+
+// Engine tests, headless on the null graphics backend
+int main(int argc, char** argv)
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,144 @@
+#include "graphics/emesh.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <array>
+#include <random>
+
+namespace EProject
+{
+    namespace
+    {
+        constexpr int cGridSize = 32;
+
+        // Flat cGridSize x cGridSize quad grid facing +y, its triangles listed in random order
+        MeshData makeShuffledGrid()
+        {
+            std::vector<MeshVertex> vertices;
+            for (int z = 0; z <= cGridSize; ++z)
+            {
+                for (int x = 0; x <= cGridSize; ++x)
+                {
+                    MeshVertex v;
+                    v.pos = { float(x), 0.0f, float(z) };
+                    v.normal = { 0.0f, 1.0f, 0.0f };
+                    vertices.push_back(v);
+                }
+            }
+
+            std::vector<std::array<int32_t, 3>> triangles;
+            for (int z = 0; z < cGridSize; ++z)
+            {
+                for (int x = 0; x < cGridSize; ++x)
+                {
+                    const int32_t i = z * (cGridSize + 1) + x;
+                    triangles.push_back({ i, i + cGridSize + 1, i + 1 });
+                    triangles.push_back({ i + 1, i + cGridSize + 1, i + cGridSize + 2 });
+                }
+            }
+
+            std::mt19937 rng(7);
+            std::shuffle(triangles.begin(), triangles.end(), rng);
+
+            std::vector<int32_t> indices;
+            for (const auto& t : triangles)
+            {
+                indices.insert(indices.end(), t.begin(), t.end());
+            }
+
+            MeshData msh;
+            msh.setVertices(std::move(vertices));
+            msh.setIndices(std::move(indices));
+            msh.calculateAABB();
+
+            return msh;
+        }
+
+        std::vector<std::array<int32_t, 3>> sortedTriangles(const MeshData& msh)
+        {
+            std::vector<std::array<int32_t, 3>> triangles;
+            for (size_t i = 0; i < msh.getIndicesCount(); i += 3)
+            {
+                const int32_t* t = msh.getIndexData() + i;
+                triangles.push_back({ t[0], t[1], t[2] });
+            }
+
+            std::sort(triangles.begin(), triangles.end());
+            return triangles;
+        }
+
+        // Looking straight down or up at the grid point under camPos
+        ClusterCuller::Stats cullFrom(const MeshData& msh, const glm::vec3& camPos, std::vector<DrawIndexedCmd>& out)
+        {
+            const glm::vec3 target = { camPos.x, 0.0f, camPos.z };
+            const glm::mat4 viewProj = glm::perspectiveRH_ZO(glm::radians(45.0f), 1.0f, 0.1f, 200.0f) *
+                                       glm::lookAtRH(camPos, target, glm::vec3(0.0f, 0.0f, 1.0f));
+
+            ClusterCuller culler;
+            culler.setView(viewProj, glm::mat4(1.0f), camPos);
+            culler.cull(msh, out);
+
+            return culler.getStats();
+        }
+    }
+
+    TEST(MeshletTest, ShuffledTrianglesGrowCompactMeshlets)
+    {
+        MeshData msh = makeShuffledGrid();
+        const auto before = sortedTriangles(msh);
+
+        msh.buildMeshlets();
+        const auto& meshlets = msh.getMeshlets();
+
+        // Same triangles, reordered so meshlets stay contiguous runs of the index list
+        EXPECT_EQ(sortedTriangles(msh), before);
+
+        uint32_t next = 0;
+        float radiusSum = 0.0f;
+
+        for (const auto& meshlet : meshlets)
+        {
+            EXPECT_EQ(meshlet.startIndex, next);
+            EXPECT_LE(meshlet.vertexCount, MeshletBuilder::cMaxVertices);
+            EXPECT_LE(meshlet.indexCount / 3, MeshletBuilder::cMaxTriangles);
+
+            // Cut straight from the shuffled list a meshlet spans the whole grid, radius ~22
+            EXPECT_LT(meshlet.radius, 12.0f);
+
+            next += meshlet.indexCount;
+            radiusSum += meshlet.radius;
+        }
+
+        EXPECT_EQ(next, msh.getIndicesCount());
+        EXPECT_LT(radiusSum / float(meshlets.size()), 7.0f);
+    }
+
+    TEST(MeshletTest, CullerRejectsClustersOutOfView)
+    {
+        MeshData msh = makeShuffledGrid();
+        msh.buildMeshlets();
+        const size_t meshlets = msh.getMeshlets().size();
+
+        // Close above one corner, most of the grid is outside the view
+        std::vector<DrawIndexedCmd> out;
+        const auto corner = cullFrom(msh, glm::vec3(4.0f, 10.0f, 4.0f), out);
+
+        EXPECT_EQ(corner.meshlets, meshlets);
+        EXPECT_GT(corner.visible, 0u);
+        EXPECT_GT(corner.frustumCulled, meshlets / 2);
+        EXPECT_FALSE(out.empty());
+
+        // High above the center everything is in view and faces the camera
+        out.clear();
+        const auto above = cullFrom(msh, glm::vec3(16.0f, 60.0f, 16.0f), out);
+        EXPECT_EQ(above.visible, meshlets);
+
+        // The same view from below sees only back faces
+        out.clear();
+        const auto below = cullFrom(msh, glm::vec3(16.0f, -60.0f, 16.0f), out);
+        EXPECT_EQ(below.frustumCulled, 0u);
+        EXPECT_EQ(below.coneCulled, meshlets);
+        EXPECT_TRUE(out.empty());
+    }
+}
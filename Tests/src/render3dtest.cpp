@@ -0,0 +1,58 @@
+#include "testutils.h"
+
+#include "egraphics.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+namespace EProject
+{
+    TEST(Render3DTest, SharedRenderableDrawsOnceInstanced)
+    {
+        TempDir dir("Render3D");
+        writeCubeGltf(dir / "cube.gltf");
+
+        auto device = std::make_shared<GDevice>();
+        auto mng = std::make_shared<AssetManager>(device);
+
+        auto mesh = std::make_shared<MeshInstance>(dir / "cube.gltf");
+        ASSERT_TRUE(mesh->load(device));
+        mesh->init();
+
+        auto renderable = std::make_shared<StaticMeshRenderable>();
+        renderable->setModelName("cube");
+        renderable->createOnGPU(mesh, device, mng);
+        ASSERT_EQ(renderable->getDrawList().size(), 1u);
+
+        auto camera = std::make_shared<Camera3D>(device);
+        camera->setPosition(glm::vec3(0.0f));
+        camera->lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+        Render3D render(device, camera);
+        render.init(mng);
+
+        device->beginFrame();
+        device->resetCounters();
+
+        render.setGeometryPass(DirectLightComponent(glm::vec3(0.0f, 10.0f, 0.0f)));
+
+        // A 100 x 100 wall in front of the camera, except for the last one
+        constexpr int cSide = 100;
+        const StaticMeshComponent component(renderable);
+
+        for (int i = 0; i < cSide * cSide - 1; ++i)
+        {
+            const glm::vec3 pos((i % cSide - cSide / 2) * 0.3f, (i / cSide - cSide / 2) * 0.3f, 50.0f);
+            render.drawMeshModel(component, TransformComponent(pos));
+        }
+
+        render.drawMeshModel(component, TransformComponent(glm::vec3(0.0f, 0.0f, -20.0f)));
+        render.submit();
+
+        EXPECT_EQ(device->getCounters().drawCalls, 1u);
+        EXPECT_EQ(render.getFrameStats().drawCalls, 1u);
+        EXPECT_EQ(render.getFrameStats().instances, uint32_t(cSide * cSide - 1));
+        EXPECT_EQ(device->getCounters().drawnIndices, 36u * (cSide * cSide - 1));
+    }
+}
@@ -0,0 +1,121 @@
+#include "egapi.h"
+#include "graphics/erenderqueue.h"
+#include "utils/ejobsystem.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+namespace EProject
+{
+    TEST(RenderQueueTest, ProgramIdsLastOneFrame)
+    {
+        auto device = std::make_shared<GDevice>();
+        auto first = device->createShaderProgram();
+        auto second = device->createShaderProgram();
+
+        RenderQueue queue;
+        EXPECT_EQ(queue.getProgramId(first.get()), 0u);
+        EXPECT_EQ(queue.getProgramId(second.get()), 1u);
+        EXPECT_EQ(queue.getProgramId(first.get()), 0u);
+
+        queue.submit(*device);
+
+        // A new frame numbers from scratch, ids don't pile up over reloads
+        EXPECT_EQ(queue.getProgramId(second.get()), 0u);
+        EXPECT_EQ(queue.getProgramId(first.get()), 1u);
+    }
+
+    TEST(RenderQueueTest, ConstantsMapOncePerSubmit)
+    {
+        auto device = std::make_shared<GDevice>();
+        auto program = device->createShaderProgram();
+        const auto color = program->findValue<glm::vec4>("color");
+        const auto world = program->findValue<glm::mat4>("world");
+
+        RenderQueue queue;
+
+        const auto frameMaps = [&](uint32_t draws)
+        {
+            device->beginFrame();
+            device->resetCounters();
+
+            for (uint32_t i = 0; i < draws; ++i)
+            {
+                // Every packet brings its own values, so every draw moves the globals
+                const uint32_t constants = queue.beginConstants();
+                queue.setValue(color, glm::vec4(float(i)));
+                queue.setValue(world, glm::mat4(float(i)));
+                queue.endConstants();
+
+                RenderQueue::DrawPacket packet;
+                packet.program = program.get();
+                packet.constants = constants;
+                packet.count = 3;
+                packet.indexed = false;
+                queue.push(SortKey::opaque(0, 0, queue.getProgramId(program.get()), 0, float(i)), packet);
+            }
+
+            queue.submit(*device);
+
+            EXPECT_EQ(device->getCounters().drawCalls, draws);
+            return device->getCounters().maps;
+        };
+
+        // Grows the ring to fit the largest frame first
+        frameMaps(4096);
+
+        const uint64_t maps = frameMaps(16);
+        EXPECT_EQ(maps, 1u);
+        EXPECT_EQ(frameMaps(256), maps);
+        EXPECT_EQ(frameMaps(4096), maps);
+    }
+
+    TEST(RenderQueueTest, ParallelChunksReplayInKeyOrder)
+    {
+        auto device = std::make_shared<GDevice>();
+        auto program = device->createShaderProgram();
+        const auto color = program->findValue<glm::vec4>("color");
+
+        JobSystem jobs(3);
+        RenderQueue queue(&jobs);
+
+        // Several chunks, pushed far to near so the sort reverses them
+        const int draws = 5000;
+        for (int i = 0; i < draws; ++i)
+        {
+            const uint32_t constants = queue.beginConstants();
+            queue.setValue(color, glm::vec4(float(i)));
+            queue.endConstants();
+
+            RenderQueue::DrawPacket packet;
+            packet.program = program.get();
+            packet.constants = constants;
+            packet.first = i;
+            packet.count = 3;
+            packet.indexed = false;
+            queue.push(SortKey::opaque(0, 0, queue.getProgramId(program.get()), 0, float(draws - i)), packet);
+        }
+
+        device->clearCommandLog();
+        queue.submit(*device);
+
+        std::vector<int> order;
+        for (const GpuCommand& cmd : device->getCommandLog())
+        {
+            if (cmd.type == GpuCommandType::Draw)
+            {
+                order.push_back(cmd.first);
+            }
+        }
+
+        ASSERT_EQ(order.size(), size_t(draws));
+        for (int i = 0; i < draws; ++i)
+        {
+            EXPECT_EQ(order[i], draws - 1 - i);
+        }
+
+        EXPECT_EQ(queue.getStats().drawCalls, uint32_t(draws));
+        EXPECT_EQ(queue.getStats().constantBinds, uint32_t(draws));
+    }
+}
@@ -0,0 +1,94 @@
+#include "testutils.h"
+
+#include "batch.h"
+#include "utils/efileutils.h"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+namespace EProject
+{
+    namespace
+    {
+        // Two manifest entries compiled by a stub: the bytecode is the source text, a source
+        // containing FAIL doesn't compile
+        class ShaderBatchTest : public ::testing::Test
+        {
+        protected:
+            ShaderBatchTest() : m_dir("ShaderBatch"), m_manifest(m_dir / "Shaders/shaders.json"), m_out(m_dir / "Out")
+            {
+                writeText(m_dir / "Shaders/Common.hlsl", "static const float Scale = 1.0;\n");
+                writeText(m_dir / "Shaders/lit.hlsl", "#include \"Common.hlsl\"\nfloat4 ps_main() : SV_TARGET { return Scale; }\n");
+                writeText(m_dir / "Shaders/sky.hlsl", "float4 ps_main() : SV_TARGET { return 1.0; }\n");
+
+                writeText(m_manifest,
+                    "{ \"shaders\": [\n"
+                    "    { \"file\": \"lit.hlsl\", \"stages\": [ { \"entry\": \"ps_main\", \"target\": \"ps_5_0\" } ] },\n"
+                    "    { \"file\": \"sky.hlsl\", \"stages\": [ { \"entry\": \"ps_main\", \"target\": \"ps_5_0\" } ] }\n"
+                    "] }\n");
+            }
+
+            int run(size_t workers)
+            {
+                return runShaderBatch(m_manifest, m_out, 1, [this](const ShaderCompileDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors)
+                {
+                    ++m_compiles;
+
+                    std::string text;
+                    if (!readFile(desc.filePath, text) || text.find("FAIL") != std::string::npos)
+                    {
+                        errors = "stub: " + desc.filePath.filename().u8string() + " doesn't compile";
+                        return false;
+                    }
+
+                    bytecode.assign(text.begin(), text.end());
+                    return true;
+                }, false, workers);
+            }
+
+            TempDir m_dir;
+            std::filesystem::path m_manifest;
+            std::filesystem::path m_out;
+            std::atomic<int> m_compiles = 0;
+        };
+    }
+
+    TEST_F(ShaderBatchTest, CompilesEveryEntryInParallel)
+    {
+        ASSERT_EQ(run(2), 0);
+        EXPECT_EQ(m_compiles, 2);
+
+        std::string lit;
+        std::string sky;
+        ASSERT_TRUE(readFile(m_out / "lit.ps_main.cso", lit));
+        ASSERT_TRUE(readFile(m_out / "sky.ps_main.cso", sky));
+
+        EXPECT_NE(lit.find("#include \"Common.hlsl\""), std::string::npos);
+        EXPECT_NE(sky.find("return 1.0"), std::string::npos);
+
+        EXPECT_TRUE(std::filesystem::exists(m_out / "lit.ps_main.cso.d"));
+        EXPECT_TRUE(std::filesystem::exists(m_out / "sky.ps_main.cso.d"));
+    }
+
+    TEST_F(ShaderBatchTest, SecondRunIsUpToDate)
+    {
+        ASSERT_EQ(run(2), 0);
+        ASSERT_EQ(run(2), 0);
+
+        EXPECT_EQ(m_compiles, 2);
+    }
+
+    TEST_F(ShaderBatchTest, FailedEntryExitsNonZero)
+    {
+        ASSERT_EQ(run(2), 0);
+
+        writeText(m_dir / "Shaders/sky.hlsl", "FAIL float4 ps_main() : SV_TARGET { return 1.0; }\n");
+
+        EXPECT_EQ(run(2), 1);
+
+        // Only the edited entry compiled again, the other one kept its output
+        EXPECT_EQ(m_compiles, 3);
+        EXPECT_TRUE(std::filesystem::exists(m_out / "lit.ps_main.cso"));
+    }
+}
@@ -0,0 +1,115 @@
+#include "testutils.h"
+
+#include "graphics/eshadercache.h"
+#include "utils/eddc.h"
+
+#include <gtest/gtest.h>
+
+namespace EProject
+{
+    namespace
+    {
+        constexpr uint64_t cCompilerVersion = 1;
+
+        // Stands in for the HLSL compiler, the bytecode is the source text
+        class ShaderCacheTest : public ::testing::Test
+        {
+        protected:
+            ShaderCacheTest() : m_dir("ShaderCache")
+            {
+                writeText(m_dir / "Shaders/Common.hlsl", "static const float Scale = 1.0;\n");
+                writeText(m_dir / "Shaders/Lit.hlsl", "#include \"Common.hlsl\"\nfloat4 ps_main() : SV_TARGET { return Scale; }\n");
+
+                m_desc.filePath = m_dir / "Shaders/Lit.hlsl";
+                m_desc.entryPoint = "ps_main";
+                m_desc.target = "ps_5_0";
+            }
+
+            ShaderCache makeCache()
+            {
+                return ShaderCache(m_dir / "Cache", cCompilerVersion, [this](const ShaderCompileDesc& desc, std::vector<uint8_t>& bytecode, std::string& errors)
+                {
+                    ++m_compiles;
+
+                    std::ifstream file(desc.filePath, std::ios::binary);
+                    if (!file)
+                    {
+                        errors = "missing " + desc.filePath.u8string();
+                        return false;
+                    }
+
+                    bytecode.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+                    return true;
+                });
+            }
+
+            TempDir m_dir;
+            ShaderCompileDesc m_desc;
+            int m_compiles = 0;
+        };
+    }
+
+    TEST_F(ShaderCacheTest, SecondRunHits)
+    {
+        std::vector<uint8_t> first;
+        std::vector<uint8_t> second;
+        std::string errors;
+
+        {
+            auto cache = makeCache();
+            ASSERT_TRUE(cache.get(m_desc, first, errors));
+            EXPECT_EQ(cache.getStats().compiled, 1u);
+        }
+
+        auto cache = makeCache();
+        ASSERT_TRUE(cache.get(m_desc, second, errors));
+
+        EXPECT_EQ(m_compiles, 1);
+        EXPECT_EQ(cache.getStats().hits, 1u);
+        EXPECT_EQ(cache.getStats().compiled, 0u);
+        EXPECT_EQ(first, second);
+    }
+
+    TEST_F(ShaderCacheTest, TouchingIncludeMisses)
+    {
+        std::vector<uint8_t> bytecode;
+        std::string errors;
+
+        auto cache = makeCache();
+        ASSERT_TRUE(cache.get(m_desc, bytecode, errors));
+        const uint64_t before = cache.computeKey(m_desc);
+
+        writeText(m_dir / "Shaders/Common.hlsl", "static const float Scale = 2.0;\n");
+
+        EXPECT_NE(cache.computeKey(m_desc), before);
+        ASSERT_TRUE(cache.get(m_desc, bytecode, errors));
+
+        EXPECT_EQ(m_compiles, 2);
+        EXPECT_EQ(cache.getStats().hits, 0u);
+        EXPECT_EQ(cache.getStats().compiled, 2u);
+    }
+
+    TEST_F(ShaderCacheTest, TruncatedEntryCompilesAgain)
+    {
+        std::vector<uint8_t> compiled;
+        std::vector<uint8_t> bytecode;
+        std::string errors;
+
+        auto cache = makeCache();
+        ASSERT_TRUE(cache.get(m_desc, compiled, errors));
+
+        const auto entry = DerivedDataCache(m_dir / "Cache").getPath(cache.computeKey(m_desc));
+        ASSERT_TRUE(std::filesystem::exists(entry));
+        std::filesystem::resize_file(entry, std::filesystem::file_size(entry) - 3);
+
+        ASSERT_TRUE(cache.get(m_desc, bytecode, errors));
+        EXPECT_EQ(bytecode, compiled);
+        EXPECT_EQ(m_compiles, 2);
+        EXPECT_EQ(cache.getStats().corrupt, 1u);
+
+        // The entry was replaced, the next lookup hits
+        ASSERT_TRUE(cache.get(m_desc, bytecode, errors));
+        EXPECT_EQ(m_compiles, 2);
+        EXPECT_EQ(cache.getStats().hits, 1u);
+    }
+}
@@ -0,0 +1,72 @@
+#include "egapi.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+namespace EProject
+{
+    namespace
+    {
+        // A pass that really changes a state and restores it, then one whose edits cancel out
+        void drawPasses(States* states)
+        {
+            states->push();
+            states->setCull(CullMode::None);
+            states->setBlend(true, Blend::Src_Alpha, Blend::Inv_Src_Alpha);
+            states->validateStates();
+            states->pop();
+            states->validateStates();
+
+            states->push();
+            states->setCull(CullMode::None);
+            states->setCull(CullMode::Back);
+            states->validateStates();
+            states->pop();
+            states->validateStates();
+
+            // Nothing changed since the last validate
+            states->validateStates();
+        }
+    }
+
+    TEST(StatesTest, KnownStatesCreateNothing)
+    {
+        auto device = std::make_shared<GDevice>();
+        States* states = device->getStates();
+
+        device->beginFrame();
+        drawPasses(states);
+        device->beginFrame();
+
+        EXPECT_GT(states->getFrameStats().created, 0u);
+
+        drawPasses(states);
+        device->beginFrame();
+
+        EXPECT_EQ(states->getFrameStats().created, 0u);
+    }
+
+    TEST(StatesTest, PushPopBindsOnlyRealChanges)
+    {
+        auto device = std::make_shared<GDevice>();
+        States* states = device->getStates();
+
+        device->beginFrame();
+        states->validateStates();
+        drawPasses(states);
+
+        device->beginFrame();
+        device->resetCounters();
+        drawPasses(states);
+        device->beginFrame();
+
+        // The first pass binds its state and the restored one, the second pass and its pop
+        // land on the bound state
+        const auto& stats = states->getFrameStats();
+        EXPECT_EQ(stats.binds, 2u);
+        EXPECT_EQ(stats.filtered, 2u);
+        EXPECT_EQ(stats.created, 0u);
+        EXPECT_EQ(device->getCounters().stateChanges, 2u);
+    }
+}
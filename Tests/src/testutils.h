@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace EProject
+{
+    // Fresh directory under the system temp dir, removed again with the test
+    class TempDir final
+    {
+    public:
+        explicit TempDir(const std::string& name)
+            : m_path(std::filesystem::temp_directory_path() / ("EProjectTests_" + name))
+        {
+            std::filesystem::remove_all(m_path);
+            std::filesystem::create_directories(m_path);
+        }
+
+        ~TempDir()
+        {
+            std::error_code ec;
+            std::filesystem::remove_all(m_path, ec);
+        }
+
+        TempDir(const TempDir&) = delete;
+        TempDir& operator=(const TempDir&) = delete;
+
+        const std::filesystem::path& getPath() const { return m_path; }
+
+        std::filesystem::path operator/(const std::string& name) const { return m_path / name; }
+
+    private:
+        std::filesystem::path m_path;
+    };
+
+    inline void writeText(const std::filesystem::path& path, const std::string& text)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream(path, std::ios::binary) << text;
+    }
+
+    // Uncompressed 32 bit TGA filled with one color, so every value makes a different file
+    inline void writeTga(const std::filesystem::path& path, int width, int height, uint8_t value)
+    {
+        std::vector<uint8_t> data(18 + static_cast<size_t>(width) * height * 4, value);
+
+        const uint8_t header[18] = { 0, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+            static_cast<uint8_t>(width), static_cast<uint8_t>(width >> 8), static_cast<uint8_t>(height), static_cast<uint8_t>(height >> 8), 32, 8 };
+
+        std::copy(std::begin(header), std::end(header), data.begin());
+
+        std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+
+    // Unit cube around the origin as a .gltf with its .bin next to it, one primitive without material
+    inline void writeCubeGltf(const std::filesystem::path& path)
+    {
+        const float positions[8][3] = {
+            { -0.5f, -0.5f, -0.5f }, { 0.5f, -0.5f, -0.5f }, { 0.5f, 0.5f, -0.5f }, { -0.5f, 0.5f, -0.5f },
+            { -0.5f, -0.5f, 0.5f }, { 0.5f, -0.5f, 0.5f }, { 0.5f, 0.5f, 0.5f }, { -0.5f, 0.5f, 0.5f } };
+
+        const uint32_t indices[36] = {
+            0, 2, 1, 0, 3, 2,   4, 5, 6, 4, 6, 7,   0, 1, 5, 0, 5, 4,
+            3, 6, 2, 3, 7, 6,   0, 4, 7, 0, 7, 3,   1, 2, 6, 1, 6, 5 };
+
+        auto bin = path;
+        bin.replace_extension(".bin");
+
+        std::ofstream file(bin, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(positions), sizeof(positions));
+        file.write(reinterpret_cast<const char*>(indices), sizeof(indices));
+
+        writeText(path, R"({
+            "asset": { "version": "2.0" },
+            "buffers": [ { "uri": ")" + bin.filename().u8string() + R"(", "byteLength": 240 } ],
+            "bufferViews": [ { "buffer": 0, "byteOffset": 0, "byteLength": 96 }, { "buffer": 0, "byteOffset": 96, "byteLength": 144 } ],
+            "accessors": [
+                { "bufferView": 0, "componentType": 5126, "count": 8, "type": "VEC3", "min": [ -0.5, -0.5, -0.5 ], "max": [ 0.5, 0.5, 0.5 ] },
+                { "bufferView": 1, "componentType": 5125, "count": 36, "type": "SCALAR" } ],
+            "meshes": [ { "name": "cube", "primitives": [ { "attributes": { "POSITION": 0 }, "indices": 1 } ] } ]
+        })");
+    }
+}